@@ -18,14 +18,31 @@ struct ContentView: View {
     @State private var accessedURLs: [URL] = []  // Keep security scope active
     @State private var showRAW = true
     @State private var showJPG = true
+    @State private var sortField: ImageCatalog.Field?  // nil = file name
+    @State private var sortAscending = true
+    @State private var isStacking = false
+    @State private var isMergingHDR = false
+    @State private var isFindingDuplicates = false
+    @State private var collapsedDuplicates: Set<URL> = []  // Hidden burst frames
+    @State private var isRankingSharpness = false
 
     private var filteredImages: [RAWImage] {
-        images.filter { image in
+        let visible = images.filter { image in
             let ext = image.url.pathExtension.lowercased()
             let isRAW = ext == "nef" || ext == "nrw"
-            let isJPG = ext == "jpg" || ext == "jpeg"
-            return (isRAW && showRAW) || (isJPG && showJPG)
+            // Stacked TIFFs are rendered images, listed with the JPGs
+            let isJPG = ext == "jpg" || ext == "jpeg" || ext == "tif" || ext == "tiff"
+            return ((isRAW && showRAW) || (isJPG && showJPG)) && !collapsedDuplicates.contains(image.url)
         }
+
+        // Sort by catalog columns so large folders never touch the SDK
+        guard let sortField else {
+            return sortAscending ? visible : visible.reversed()
+        }
+        let byURL = Dictionary(visible.map { ($0.url, $0) }, uniquingKeysWith: { first, _ in first })
+        return ImageCatalog.shared
+            .sort(visible.map { $0.url }, by: sortField, ascending: sortAscending)
+            .compactMap { byURL[$0] }
     }
 
     private var rawCount: Int {
@@ -33,7 +50,7 @@ struct ContentView: View {
     }
 
     private var jpgCount: Int {
-        images.filter { ["jpg", "jpeg"].contains($0.url.pathExtension.lowercased()) }.count
+        images.filter { ["jpg", "jpeg", "tif", "tiff"].contains($0.url.pathExtension.lowercased()) }.count
     }
 
     var body: some View {
@@ -65,6 +82,12 @@ struct ContentView: View {
                     } label: {
                         Label("Show in Finder", systemImage: "folder")
                     }
+
+                    Button {
+                        image.isPinned.toggle()
+                    } label: {
+                        Label(image.isPinned ? "Unpin from Memory" : "Keep in Memory", systemImage: image.isPinned ? "pin.slash" : "pin")
+                    }
                 }
             }
             .safeAreaInset(edge: .bottom) {
@@ -118,6 +141,19 @@ struct ContentView: View {
                                 .background(showJPG ? Color.accentColor.opacity(0.15) : Color.clear)
                                 .cornerRadius(6)
                             }
+
+                            if !collapsedDuplicates.isEmpty {
+                                Spacer()
+                                Button {
+                                    collapsedDuplicates = []
+                                } label: {
+                                    Text("\(collapsedDuplicates.count) duplicates hidden")
+                                        .font(.caption)
+                                }
+                                .buttonStyle(.plain)
+                                .foregroundColor(.secondary)
+                                .help("Show the frames hidden by Find Duplicates")
+                            }
                         }
                         .padding(8)
                     }
@@ -150,6 +186,7 @@ struct ContentView: View {
             Text(errorMessage ?? "Unknown error")
         }
         .onChange(of: selectedImage) { _, newImage in
+            ImageCache.shared.select(newImage)
             newImage?.load()
         }
         .toolbar {
@@ -159,11 +196,104 @@ struct ContentView: View {
                 }
                 .keyboardShortcut("o", modifiers: .command)
 
+                Menu {
+                    Picker("Sort By", selection: $sortField) {
+                        Text("File Name").tag(ImageCatalog.Field?.none)
+                        Text("Capture Date").tag(ImageCatalog.Field?.some(.dateTime))
+                        Text("ISO").tag(ImageCatalog.Field?.some(.iso))
+                        Text("Shutter Speed").tag(ImageCatalog.Field?.some(.exposureTime))
+                        Text("Aperture").tag(ImageCatalog.Field?.some(.fNumber))
+                        Text("Focal Length").tag(ImageCatalog.Field?.some(.focalLength))
+                        Text("Lens").tag(ImageCatalog.Field?.some(.lens))
+                        Text("Camera Model").tag(ImageCatalog.Field?.some(.model))
+                        Text("Sharpness").tag(ImageCatalog.Field?.some(.sharpness))
+                    }
+                    .pickerStyle(.inline)
+
+                    Toggle("Ascending", isOn: $sortAscending)
+                } label: {
+                    Label("Sort", systemImage: "arrow.up.arrow.down")
+                }
+                .disabled(images.isEmpty)
+
+                Button(action: { isFindingDuplicates = true }) {
+                    Label("Find Duplicates", systemImage: "square.on.square")
+                }
+                .help("Group near-identical frames, such as bursts, and collapse each group to one frame")
+                .disabled(images.count < 2)
+
+                Button(action: { isRankingSharpness = true }) {
+                    Label("Rank by Sharpness", systemImage: "scope")
+                }
+                .help("Score every frame by focus to find the sharpest ones")
+                .disabled(images.isEmpty)
+
+                Button(action: { isStacking = true }) {
+                    Label("Stack Frames", systemImage: "square.stack.3d.down.right")
+                }
+                .help("Merge a burst of NEF files to reduce noise or remove moving subjects")
+                .disabled(rawCount < 2)
+
+                Button(action: { isMergingHDR = true }) {
+                    Label("Merge to HDR", systemImage: "camera.aperture")
+                }
+                .help("Merge an exposure bracket into one high dynamic range image")
+                .disabled(rawCount < 2)
+
                 if let image = selectedImage {
-                    ExportButton(rawImage: image, exportAction: exportTIFF)
+                    ExportButton(rawImage: image, exportAction: exportImage)
                 }
             }
         }
+        .sheet(isPresented: $isFindingDuplicates) {
+            DuplicatesView(
+                images: filteredImages,
+                onCollapse: { groups in
+                    for group in groups {
+                        // Keep the sharpest frame once the folder has been ranked, else the first
+                        let keep = group.urls.max {
+                            (SharpnessScoring.score(for: $0)?.value ?? -1) < (SharpnessScoring.score(for: $1)?.value ?? -1)
+                        } ?? group.urls[0]
+                        collapsedDuplicates.formUnion(group.urls.filter { $0 != keep })
+                    }
+                    if let selected = selectedImage, collapsedDuplicates.contains(selected.url) {
+                        selectedImage = filteredImages.first
+                    }
+                }
+            )
+        }
+        .sheet(isPresented: $isRankingSharpness) {
+            SharpnessView(
+                images: filteredImages,
+                onSortBySharpness: {
+                    sortField = .sharpness
+                    sortAscending = false
+                }
+            )
+        }
+        .sheet(isPresented: $isStacking) {
+            StackingView(
+                images: images.filter { ["nef", "nrw"].contains($0.url.pathExtension.lowercased()) },
+                onStacked: { url in
+                    let stacked = RAWImage(url: url)
+                    images.append(stacked)
+                    selectedImage = stacked
+                }
+            )
+        }
+        .sheet(isPresented: $isMergingHDR) {
+            HDRMergeView(
+                urls: images.map(\.url),
+                onMerged: { url in
+                    let merged = RAWImage(url: url)
+                    // Starting tone map: pull the merged highlights down and lift the shadows
+                    merged.adjustments.highlights = 0.3
+                    merged.adjustments.shadows = 0.4
+                    images.append(merged)
+                    selectedImage = merged
+                }
+            )
+        }
         .onDrop(of: [.fileURL], isTargeted: $isDropTargeted) { providers in
             handleDrop(providers: providers)
         }
@@ -281,6 +411,14 @@ struct ContentView: View {
         // Create RAWImage objects
         let newImages = nefFiles.map { RAWImage(url: $0) }
         images = newImages
+        collapsedDuplicates = []
+        RAWImage.restoreFromCatalog(newImages)
+
+        // Hash previews in the background so Find Duplicates is ready when asked
+        let urls = nefFiles
+        Task.detached(priority: .utility) {
+            DuplicateGrouping.shared.prepare(urls)
+        }
 
         // Select first image
         if let first = images.first {
@@ -297,61 +435,48 @@ struct ContentView: View {
 
     private func isSupportedImageFile(_ url: URL) -> Bool {
         let ext = url.pathExtension.lowercased()
-        return ext == "nef" || ext == "nrw" || ext == "jpg" || ext == "jpeg"
+        return ext == "nef" || ext == "nrw" || ext == "jpg" || ext == "jpeg" || ext == "tif" || ext == "tiff"
     }
     
-    private func exportTIFF() {
-        guard let image = selectedImage?.processedImage ?? selectedImage?.image else {
+    private func exportImage() {
+        guard let selectedImage, selectedImage.image != nil else {
             errorMessage = "No image to export"
             showError = true
             return
         }
 
+        let format = ImageExporter.format
         let panel = NSSavePanel()
-        panel.allowedContentTypes = [.tiff]
-        panel.nameFieldStringValue = selectedImage?.url.deletingPathExtension().lastPathComponent ?? "export"
+        panel.allowedContentTypes = [format.contentType]
+        panel.nameFieldStringValue = selectedImage.url.deletingPathExtension().lastPathComponent
         panel.canCreateDirectories = true
         
         panel.begin { response in
             guard response == .OK, let url = panel.url else { return }
             
-            do {
-                try saveTIFF(image: image, to: url)
-            } catch {
-                errorMessage = "Failed to export TIFF: \(error.localizedDescription)"
-                showError = true
+            // The preview only renders visible pixels; export renders the full frame on demand
+            Task { @MainActor in
+                guard let image = await selectedImage.fullResolutionImage() else {
+                    errorMessage = "Failed to render image for export"
+                    showError = true
+                    return
+                }
+                let adjustments = selectedImage.adjustments
+                let upscaleFactor = adjustments.upscalingEnabled ? adjustments.upscaleFactor : 1
+                nonisolated(unsafe) let rendered = image
+                do {
+                    // Written straight to the file; resampled and dithered rows are encoded as they are produced
+                    try await Task.detached(priority: .userInitiated) {
+                        try ImageExporter.export(image: rendered, to: url, upscaleFactor: upscaleFactor)
+                    }.value
+                } catch {
+                    errorMessage = "Failed to export \(format.displayName): \(error.localizedDescription)"
+                    showError = true
+                }
             }
         }
     }
     
-    private func saveTIFF(image: NSImage, to url: URL) throws {
-        guard let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
-            throw NSError(domain: "DirtyRAW", code: 1, userInfo: [NSLocalizedDescriptionKey: "Failed to convert image"])
-        }
-        
-        let data = NSMutableData()
-        guard let destination = CGImageDestinationCreateWithData(
-            data as CFMutableData,
-            UTType.tiff.identifier as CFString,
-            1,
-            nil
-        ) else {
-            throw NSError(domain: "DirtyRAW", code: 2, userInfo: [NSLocalizedDescriptionKey: "Failed to create TIFF destination"])
-        }
-        
-        let options: [CFString: Any] = [
-            kCGImagePropertyTIFFCompression: 1, // No compression
-        ]
-        
-        CGImageDestinationAddImage(destination, cgImage, options as CFDictionary)
-        
-        guard CGImageDestinationFinalize(destination) else {
-            throw NSError(domain: "DirtyRAW", code: 3, userInfo: [NSLocalizedDescriptionKey: "Failed to finalize TIFF"])
-        }
-        
-        try data.write(to: url, options: .atomic)
-    }
-
     // MARK: - View Components
 
     @ViewBuilder
@@ -430,68 +555,117 @@ struct ContentView: View {
 
 struct ImagePreviewView: View {
     @ObservedObject var rawImage: RAWImage
+    @ObservedObject private var renderStats = RenderStats.shared
+    @ObservedObject private var maskEditor = MaskEditor.shared
+    @ObservedObject private var memoryMonitor = MemoryMonitor.shared
+    @State private var isPainting = false
     @State private var scale: CGFloat = 1.0
     @State private var offset: CGSize = .zero
     @State private var lastOffset: CGSize = .zero
     @State private var showControls = true
+    @Environment(\.displayScale) private var displayScale
     
     private let minScale: CGFloat = 0.1
     private let maxScale: CGFloat = 10.0
 
     var body: some View {
         Group {
-            if rawImage.isLoading {
+            if rawImage.isLoading && rawImage.previewImage == nil {
                 ProgressView("Decoding RAW...")
                     .frame(maxWidth: .infinity, maxHeight: .infinity)
-            } else if let image = rawImage.processedImage ?? rawImage.image {
+            } else if let image = rawImage.previewImage ?? rawImage.image {
                 ZStack(alignment: .bottom) {
                     // Image with zoom and pan
                     GeometryReader { geometry in
-                        Image(nsImage: image)
-                            .resizable()
-                            .aspectRatio(contentMode: .fit)
-                            .scaleEffect(scale)
-                            .offset(offset)
-                            .gesture(
-                                MagnificationGesture()
-                                    .onChanged { value in
-                                        let newScale = scale * value
-                                        self.scale = min(max(newScale, minScale), maxScale)
-                                    }
-                            )
-                            .gesture(
-                                DragGesture()
-                                    .onChanged { value in
-                                        offset = CGSize(
-                                            width: lastOffset.width + value.translation.width,
-                                            height: lastOffset.height + value.translation.height
-                                        )
-                                    }
-                                    .onEnded { _ in
-                                        lastOffset = offset
-                                    }
-                            )
-                            .onTapGesture(count: 2) {
-                                withAnimation(.spring(response: 0.3)) {
-                                    if scale == 1.0 {
-                                        scale = 2.0
-                                    } else {
-                                        resetView()
-                                    }
+                        let fitted = fittedSize(for: image.size, in: geometry.size)
+                        let pointsPerPixel = image.size.width > 0 ? fitted.width / image.size.width : 0
+
+                        ZStack(alignment: .topLeading) {
+                            Image(nsImage: image)
+                                .resizable()
+
+                            // Visible region rendered at zoom resolution
+                            if let detail = rawImage.detailImage {
+                                Image(nsImage: detail)
+                                    .resizable()
+                                    .frame(
+                                        width: rawImage.detailRect.width * pointsPerPixel,
+                                        height: rawImage.detailRect.height * pointsPerPixel
+                                    )
+                                    .offset(
+                                        x: rawImage.detailRect.minX * pointsPerPixel,
+                                        y: rawImage.detailRect.minY * pointsPerPixel
+                                    )
+                            }
+                        }
+                        .frame(width: fitted.width, height: fitted.height, alignment: .topLeading)
+                        // Takes priority over panning while a brush mask is selected
+                        .gesture(paintGesture(canvasSize: fitted), including: maskEditor.paintingMaskID == nil ? .subviews : .all)
+                        .scaleEffect(scale)
+                        .offset(offset)
+                        .gesture(
+                            MagnificationGesture()
+                                .onChanged { value in
+                                    let newScale = scale * value
+                                    self.scale = min(max(newScale, minScale), maxScale)
+                                }
+                        )
+                        .gesture(
+                            DragGesture()
+                                .onChanged { value in
+                                    offset = CGSize(
+                                        width: lastOffset.width + value.translation.width,
+                                        height: lastOffset.height + value.translation.height
+                                    )
+                                }
+                                .onEnded { _ in
+                                    lastOffset = offset
+                                }
+                        )
+                        .onTapGesture(count: 2) {
+                            withAnimation(.spring(response: 0.3)) {
+                                if scale == 1.0 {
+                                    scale = 2.0
+                                } else {
+                                    resetView()
                                 }
                             }
-                            .frame(width: geometry.size.width, height: geometry.size.height)
+                        }
+                        .frame(width: geometry.size.width, height: geometry.size.height)
+                        .onAppear {
+                            updateViewport(imageSize: image.size, viewSize: geometry.size)
+                        }
+                        .onChange(of: geometry.size) { _, newSize in
+                            updateViewport(imageSize: image.size, viewSize: newSize)
+                        }
+                        .onChange(of: scale) { _, _ in
+                            updateViewport(imageSize: image.size, viewSize: geometry.size)
+                        }
+                        .onChange(of: lastOffset) { _, _ in
+                            updateViewport(imageSize: image.size, viewSize: geometry.size)
+                        }
+                        .onChange(of: rawImage.id) { _, _ in
+                            updateViewport(imageSize: image.size, viewSize: geometry.size)
+                        }
                     }
                     .background(Color(nsColor: .controlBackgroundColor))
                     
-                    // Processing indicator
-                    if rawImage.isProcessing {
+                    // Processing indicator (also shown over the quick preview while the SDK develops)
+                    if rawImage.isProcessing || rawImage.isLoading {
                         ProgressView()
                             .scaleEffect(0.8)
                             .frame(maxWidth: .infinity, maxHeight: .infinity)
                             .background(Color.black.opacity(0.3))
                     }
 
+                    // Memory accounting (Settings › Diagnostics)
+                    if memoryMonitor.isOverlayVisible {
+                        MemoryOverlayView()
+                            .allowsHitTesting(false)
+                            .padding(12)
+                            .frame(maxWidth: .infinity, maxHeight: .infinity, alignment: .topTrailing)
+                    }
+
                     // Control panel
                     if showControls {
                         HStack(spacing: 16) {
@@ -536,6 +710,29 @@ struct ImagePreviewView: View {
                                 .font(.system(.caption, design: .monospaced))
                                 .foregroundColor(.secondary)
                                 .help("Image Dimensions")
+
+                            Divider()
+                                .frame(height: 20)
+
+                            // Render responsiveness
+                            Text(String(format: "%.0f ms", renderStats.averageFrameTime * 1000))
+                                .font(.system(.caption, design: .monospaced))
+                                .foregroundColor(.secondary)
+                                .help(String(
+                                    format: "Frame time (average %.0f ms, last %.0f ms, full quality %.0f ms), %d dropped frames, %d CPU workers %.0f%% busy",
+                                    renderStats.averageFrameTime * 1000,
+                                    renderStats.lastFrameTime * 1000,
+                                    renderStats.lastRefineTime * 1000,
+                                    renderStats.droppedFrames,
+                                    NKJobSystem.workerCount,
+                                    renderStats.workerUtilization * 100
+                                ))
+
+                            if renderStats.droppedFrames > 0 {
+                                Text("\(renderStats.droppedFrames) dropped")
+                                    .font(.system(.caption, design: .monospaced))
+                                    .foregroundColor(.secondary)
+                            }
                         }
                         .padding(.horizontal, 16)
                         .padding(.vertical, 8)
@@ -570,6 +767,36 @@ struct ImagePreviewView: View {
         }
     }
     
+    private func fittedSize(for imageSize: CGSize, in viewSize: CGSize) -> CGSize {
+        guard imageSize.width > 0, imageSize.height > 0 else { return .zero }
+        let ratio = min(viewSize.width / imageSize.width, viewSize.height / imageSize.height)
+        return CGSize(width: imageSize.width * ratio, height: imageSize.height * ratio)
+    }
+
+    /// Maps the view's zoom/pan state back to the visible source region and asks the image to
+    /// render just that region at display resolution.
+    private func updateViewport(imageSize: CGSize, viewSize: CGSize) {
+        let fitted = fittedSize(for: imageSize, in: viewSize)
+        guard fitted.width > 0, scale > 0 else { return }
+        let pointsPerPixel = fitted.width / imageSize.width
+
+        // The fitted image is centered, scaled about its center, then offset
+        let minX = fitted.width / 2 + (-viewSize.width / 2 - offset.width) / scale
+        let minY = fitted.height / 2 + (-viewSize.height / 2 - offset.height) / scale
+        let visible = CGRect(
+            x: minX / pointsPerPixel,
+            y: minY / pointsPerPixel,
+            width: viewSize.width / scale / pointsPerPixel,
+            height: viewSize.height / scale / pointsPerPixel
+        )
+
+        rawImage.updateViewport(
+            visibleRect: visible,
+            scale: pointsPerPixel * scale * displayScale,
+            fitScale: pointsPerPixel * displayScale
+        )
+    }
+
     private func zoomIn() {
         withAnimation(.easeInOut(duration: 0.2)) {
             scale = min(scale * 1.2, maxScale)
@@ -582,6 +809,32 @@ struct ImagePreviewView: View {
         }
     }
     
+    /// Paints into the selected brush mask. Locations are in the unscaled image frame, so they
+    /// map straight to frame fractions whatever the zoom.
+    private func paintGesture(canvasSize: CGSize) -> some Gesture {
+        DragGesture(minimumDistance: 0)
+            .onChanged { value in
+                guard canvasSize.width > 0, canvasSize.height > 0 else { return }
+                let point = CGPoint(
+                    x: min(max(value.location.x / canvasSize.width, 0), 1),
+                    y: min(max(value.location.y / canvasSize.height, 0), 1)
+                )
+                var adjustments = rawImage.adjustments
+                if isPainting {
+                    maskEditor.continueStroke(to: point, in: &adjustments)
+                } else {
+                    maskEditor.beginStroke(at: point, in: &adjustments)
+                    isPainting = true
+                }
+                guard adjustments.localAdjustments != rawImage.adjustments.localAdjustments else { return }
+                rawImage.adjustments = adjustments
+                rawImage.applyAdjustments()
+            }
+            .onEnded { _ in
+                isPainting = false
+            }
+    }
+
     private func resetView() {
         withAnimation(.easeInOut(duration: 0.3)) {
             scale = 1.0
@@ -608,7 +861,7 @@ struct ExportButton: View {
             if rawImage.isLoading {
                 Label("Loading...", systemImage: "arrow.clockwise")
             } else {
-                Label("Export TIFF", systemImage: "square.and.arrow.up")
+                Label("Export", systemImage: "square.and.arrow.up")
             }
         }
         .disabled(rawImage.isLoading || rawImage.image == nil)
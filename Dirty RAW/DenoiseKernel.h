@@ -0,0 +1,27 @@
+//
+//  DenoiseKernel.h
+//  Dirty RAW
+//
+
+#import <CoreImage/CoreImage.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Runs the native luma/chroma denoiser as a Core Image processor, so it works the same on the
+/// Metal and software renderers and inside tiled and region renders.
+@interface NKDenoiseKernel : CIImageProcessorKernel
+
+/// Pixels read beyond each side of the requested output.
+@property (class, nonatomic, readonly) CGFloat halo;
+
+/// Denoises `image`. Strengths are noise standard deviations in working-space units;
+/// `lumaDetail` (0...1) is the fraction of removed luma detail that is restored.
+/// Pixels outside the extent are edge-replicated, and the result is cropped to the extent.
++ (CIImage *)applyToImage:(CIImage *)image
+             lumaStrength:(float)lumaStrength
+           chromaStrength:(float)chromaStrength
+               lumaDetail:(float)lumaDetail;
+
+@end
+
+NS_ASSUME_NONNULL_END
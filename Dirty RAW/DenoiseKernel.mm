@@ -0,0 +1,89 @@
+//
+//  DenoiseKernel.mm
+//  Dirty RAW
+//
+
+#import "DenoiseKernel.h"
+
+#include "Native/Denoise.hpp"
+
+static NSString * const NKDenoiseLumaKey = @"lumaStrength";
+static NSString * const NKDenoiseChromaKey = @"chromaStrength";
+static NSString * const NKDenoiseDetailKey = @"lumaDetail";
+
+@implementation NKDenoiseKernel
+
++ (CGFloat)halo {
+    return dirtyraw::kDenoiseHalo;
+}
+
++ (CIImage *)applyToImage:(CIImage *)image
+             lumaStrength:(float)lumaStrength
+           chromaStrength:(float)chromaStrength
+               lumaDetail:(float)lumaDetail {
+    CGRect extent = image.extent;
+    if (CGRectIsEmpty(extent) || CGRectIsInfinite(extent)) return image;
+
+    NSError *error = nil;
+    CIImage *output = [self applyWithExtent:extent
+                                     inputs:@[[image imageByClampingToExtent]]
+                                  arguments:@{
+                                      NKDenoiseLumaKey: @(lumaStrength),
+                                      NKDenoiseChromaKey: @(chromaStrength),
+                                      NKDenoiseDetailKey: @(lumaDetail),
+                                  }
+                                      error:&error];
+    if (!output) {
+        NSLog(@"NKDenoiseKernel: %@", error);
+        return image;
+    }
+    return output;
+}
+
++ (CIFormat)outputFormat {
+    return kCIFormatRGBAf;
+}
+
++ (CIFormat)formatForInputAtIndex:(int)input {
+    return kCIFormatRGBAf;
+}
+
++ (CGRect)roiForInput:(int)input arguments:(NSDictionary<NSString *, id> *)arguments outputRect:(CGRect)outputRect {
+    return CGRectInset(outputRect, -dirtyraw::kDenoiseHalo, -dirtyraw::kDenoiseHalo);
+}
+
++ (BOOL)processWithInputs:(NSArray<id<CIImageProcessorInput>> *)inputs
+                arguments:(NSDictionary<NSString *, id> *)arguments
+                   output:(id<CIImageProcessorOutput>)output
+                    error:(NSError **)error {
+    id<CIImageProcessorInput> input = inputs.firstObject;
+    if (!input || !input.baseAddress || !output.baseAddress) return NO;
+
+    // Buffers are stored top row first, so the row offset is measured from the top edges.
+    CGRect inputRegion = input.region;
+    CGRect outputRegion = output.region;
+    NSInteger offsetX = NSInteger(CGRectGetMinX(outputRegion) - CGRectGetMinX(inputRegion)) - dirtyraw::kDenoiseHalo;
+    NSInteger offsetY = NSInteger(CGRectGetMaxY(inputRegion) - CGRectGetMaxY(outputRegion)) - dirtyraw::kDenoiseHalo;
+    int width = int(CGRectGetWidth(outputRegion));
+    int height = int(CGRectGetHeight(outputRegion));
+    if (offsetX < 0 || offsetY < 0
+        || CGRectGetWidth(inputRegion) < offsetX + width + 2 * dirtyraw::kDenoiseHalo
+        || CGRectGetHeight(inputRegion) < offsetY + height + 2 * dirtyraw::kDenoiseHalo) {
+        return NO;
+    }
+
+    size_t sourceStride = input.bytesPerRow / sizeof(float);
+    const float *source = static_cast<const float *>(input.baseAddress) + size_t(offsetY) * sourceStride + size_t(offsetX) * 4;
+
+    dirtyraw::DenoiseParameters parameters;
+    parameters.lumaStrength = [arguments[NKDenoiseLumaKey] floatValue];
+    parameters.chromaStrength = [arguments[NKDenoiseChromaKey] floatValue];
+    parameters.lumaDetail = [arguments[NKDenoiseDetailKey] floatValue];
+
+    dirtyraw::denoiseRGBA(source, sourceStride,
+                          static_cast<float *>(output.baseAddress), output.bytesPerRow / sizeof(float),
+                          width, height, parameters);
+    return YES;
+}
+
+@end
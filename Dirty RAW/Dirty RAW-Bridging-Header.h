@@ -7,5 +7,16 @@
 #define Dirty_RAW_Bridging_Header_h
 
 #import "NikonSDKWrapper.h"
+#import "NEFFile.h"
+#import "DenoiseKernel.h"
+#import "LensCorrectionKernel.h"
+#import "LocalAdjustmentKernel.h"
+#import "FilmGrainKernel.h"
+#import "ExportStream.h"
+#import "JobSystem.h"
+#import "FrameStacker.h"
+#import "DuplicateDetector.h"
+#import "SharpnessScorer.h"
+#import "MemoryLedger.h"
 
 #endif /* Dirty_RAW_Bridging_Header_h */
@@ -28,6 +28,10 @@ struct Dirty_RAWApp: App {
                 .keyboardShortcut("o", modifiers: .command)
             }
         }
+
+        Settings {
+            SettingsView()
+        }
     }
 }
 
@@ -41,6 +45,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
     }
 
     func applicationWillTerminate(_ notification: Notification) {
+        ImageCatalog.shared.flush()
         NikonSDKWrapper.closeLibrary()
     }
 
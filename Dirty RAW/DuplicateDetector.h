@@ -0,0 +1,41 @@
+//
+//  DuplicateDetector.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Perceptual signature of one image (see Native/PerceptualHash.hpp).
+@interface NKImageSignature : NSObject
+/// 64-bit DCT pHash; near-identical frames differ in a few bits.
+@property (nonatomic, readonly) uint64_t perceptualHash;
+/// Coarse chroma grid, compared alongside the hash.
+@property (nonatomic, readonly) NSData *colorSignature;
+@end
+
+/// Finds near-duplicate frames for culling: bursts, RAW+JPEG pairs and re-exports.
+@interface NKDuplicateDetector : NSObject
+
+/// Computes the signature of every file in `paths` from a small decode: the embedded preview of
+/// NEF/NRW files, an ImageIO thumbnail of anything else. Files are processed in parallel on the
+/// job system at batch priority, so previews stay responsive. The result has an entry per path,
+/// NSNull where the file couldn't be read. `progress` gets the finished fraction on the calling
+/// thread and returns NO to cancel, which returns nil. Blocks; call off the main thread.
++ (nullable NSArray *)signaturesForPaths:(NSArray<NSString *> *)paths
+                                progress:(BOOL (^)(double fraction))progress
+    NS_SWIFT_NAME(signatures(paths:progress:));
+
+/// Groups `signatures` (NKImageSignature or NSNull) whose hashes differ in at most `maxDistance`
+/// bits (0...15) and whose colours are within `colorTolerance` (mean chroma difference, 0...255),
+/// transitively. Returns the groups of two or more as arrays of indices into `signatures`,
+/// ascending, in order of their first index.
++ (NSArray<NSArray<NSNumber *> *> *)groupSignatures:(NSArray *)signatures
+                                        maxDistance:(NSInteger)maxDistance
+                                     colorTolerance:(double)colorTolerance
+    NS_SWIFT_NAME(group(_:maxDistance:colorTolerance:));
+
+@end
+
+NS_ASSUME_NONNULL_END
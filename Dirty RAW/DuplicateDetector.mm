@@ -0,0 +1,169 @@
+//
+//  DuplicateDetector.mm
+//  Dirty RAW
+//
+
+#import "DuplicateDetector.h"
+#import "NEFFile.h"
+
+#import <ImageIO/ImageIO.h>
+
+#include "Native/JobSystem.hpp"
+#include "Native/Parallel.hpp"
+#include "Native/PerceptualHash.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+/// Smallest embedded NEF preview worth decoding; the 160 px thumbnail is letterboxed.
+constexpr NSUInteger kPreviewDimension = 256;
+/// Long side the hash is computed from. ImageIO decodes JPEGs at a fraction of full size.
+constexpr NSUInteger kThumbnailSize = 128;
+/// Files per batch between progress reports.
+constexpr NSUInteger kBatchSize = 256;
+
+/// Decodes a small version of the image at `path` and computes its signature.
+bool computeSignature(NSString *path, dirtyraw::ImageSignature &signature) {
+    CGImageSourceRef source = NULL;
+    NSString *extension = path.pathExtension.lowercaseString;
+    if ([extension isEqualToString:@"nef"] || [extension isEqualToString:@"nrw"]) {
+        NKNEFFile *file = [[NKNEFFile alloc] initWithFilePath:path];
+        NKNEFPreview *preview = [file previewWithMinimumDimension:kPreviewDimension];
+        if (!preview) return false;
+        source = CGImageSourceCreateWithData((__bridge CFDataRef)preview.jpegData, NULL);
+    } else {
+        source = CGImageSourceCreateWithURL((__bridge CFURLRef)[NSURL fileURLWithPath:path], NULL);
+    }
+    if (!source) return false;
+
+    // Stored orientation is ignored on purpose: a NEF's preview and its JPEG sibling are both
+    // stored unrotated
+    NSDictionary *options = @{
+        (id)kCGImageSourceCreateThumbnailFromImageAlways: @YES,
+        (id)kCGImageSourceThumbnailMaxPixelSize: @(kThumbnailSize),
+        (id)kCGImageSourceShouldCacheImmediately: @YES,
+    };
+    CGImageRef thumbnail = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    if (!thumbnail) return false;
+
+    size_t width = CGImageGetWidth(thumbnail);
+    size_t height = CGImageGetHeight(thumbnail);
+    std::vector<uint8_t> pixels(width * height * 4);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGContextRef context = CGBitmapContextCreate(pixels.data(), width, height, 8, width * 4, colorSpace,
+                                                 kCGImageAlphaNoneSkipLast | kCGBitmapByteOrderDefault);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        CGImageRelease(thumbnail);
+        return false;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), thumbnail);
+    CGContextRelease(context);
+    CGImageRelease(thumbnail);
+
+    signature = dirtyraw::computeSignature(pixels.data(), width * 4, int(width), int(height));
+    return true;
+}
+
+} // namespace
+
+@interface NKImageSignature () {
+    dirtyraw::ImageSignature _signature;
+}
+- (instancetype)initWithSignature:(const dirtyraw::ImageSignature &)signature;
+- (const dirtyraw::ImageSignature &)signature;
+@end
+
+@implementation NKImageSignature
+
+- (instancetype)initWithSignature:(const dirtyraw::ImageSignature &)signature {
+    if (self = [super init]) {
+        _signature = signature;
+    }
+    return self;
+}
+
+- (const dirtyraw::ImageSignature &)signature {
+    return _signature;
+}
+
+- (uint64_t)perceptualHash {
+    return _signature.hash;
+}
+
+- (NSData *)colorSignature {
+    return [NSData dataWithBytes:_signature.color length:sizeof(_signature.color)];
+}
+
+@end
+
+@implementation NKDuplicateDetector
+
++ (NSArray *)signaturesForPaths:(NSArray<NSString *> *)paths progress:(BOOL (^)(double))progress {
+    NSUInteger count = paths.count;
+    std::vector<dirtyraw::ImageSignature> signatures(count);
+    std::vector<uint8_t> valid(count, 0);
+
+    // Runs in the background after a folder is opened; previews cut in between files
+    dirtyraw::JobScope scope(dirtyraw::JobPriority::batch);
+    for (NSUInteger batch = 0; batch < count; batch += kBatchSize) {
+        if (!progress(double(batch) / double(std::max<NSUInteger>(count, 1)))) return nil;
+        NSUInteger batchEnd = std::min(batch + kBatchSize, count);
+        dirtyraw::parallelFor(int(batch), int(batchEnd), [&](int begin, int end) {
+            for (int index = begin; index < end; ++index) @autoreleasepool {
+                valid[index] = computeSignature(paths[NSUInteger(index)], signatures[index]);
+            }
+        });
+    }
+    if (!progress(1)) return nil;
+
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:count];
+    NSUInteger failures = 0;
+    for (NSUInteger index = 0; index < count; ++index) {
+        if (valid[index]) {
+            [result addObject:[[NKImageSignature alloc] initWithSignature:signatures[index]]];
+        } else {
+            [result addObject:[NSNull null]];
+            ++failures;
+        }
+    }
+    if (failures > 0) {
+        NSLog(@"NKDuplicateDetector: No preview for %lu of %lu files", (unsigned long)failures, (unsigned long)count);
+    }
+    return result;
+}
+
++ (NSArray<NSArray<NSNumber *> *> *)groupSignatures:(NSArray *)signatures
+                                        maxDistance:(NSInteger)maxDistance
+                                     colorTolerance:(double)colorTolerance {
+    std::vector<dirtyraw::ImageSignature> values(signatures.count);
+    std::vector<bool> valid(signatures.count, false);
+    for (NSUInteger index = 0; index < signatures.count; ++index) {
+        id entry = signatures[index];
+        if ([entry isKindOfClass:[NKImageSignature class]]) {
+            values[index] = [(NKImageSignature *)entry signature];
+            valid[index] = true;
+        }
+    }
+
+    std::vector<int> groups = dirtyraw::groupSignatures(values, valid, int(maxDistance), float(colorTolerance));
+
+    // Groups are numbered in order of their first member, so members are collected in order
+    std::vector<std::vector<int>> members(groups.empty() ? 0 : *std::max_element(groups.begin(), groups.end()) + 1);
+    for (size_t index = 0; index < groups.size(); ++index) {
+        members[groups[index]].push_back(int(index));
+    }
+    NSMutableArray<NSArray<NSNumber *> *> *result = [NSMutableArray array];
+    for (const std::vector<int> &group : members) {
+        if (group.size() < 2) continue;
+        NSMutableArray<NSNumber *> *indices = [NSMutableArray arrayWithCapacity:group.size()];
+        for (int index : group) [indices addObject:@(index)];
+        [result addObject:indices];
+    }
+    return result;
+}
+
+@end
@@ -0,0 +1,78 @@
+//
+//  ExportStream.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, NKExportFormat) {
+    NKExportFormatTIFF = 0,
+    NKExportFormatJPEG = 1,
+    NKExportFormatPNG = 2,
+};
+
+typedef NS_ENUM(NSInteger, NKTIFFCompression) {
+    NKTIFFCompressionUncompressed = 0,
+    /// Deflate with horizontal prediction: lossless, typically half the size on photos.
+    NKTIFFCompressionDeflate = 1,
+};
+
+typedef NS_ENUM(NSInteger, NKChromaSubsampling) {
+    /// 4:4:4, full-resolution colour.
+    NKChromaSubsamplingFull = 0,
+    /// 4:2:2, colour at half the horizontal resolution.
+    NKChromaSubsamplingHorizontal = 1,
+    /// 4:2:0, colour at half the resolution both ways; the smallest files.
+    NKChromaSubsamplingBoth = 2,
+};
+
+@interface NKExportOptions : NSObject
+@property (nonatomic) NKExportFormat format;
+/// 16 or 8 (dithered). JPEG is always 8.
+@property (nonatomic) NSUInteger bitsPerComponent;
+@property (nonatomic) NKTIFFCompression tiffCompression;
+/// 1...100 on the libjpeg scale.
+@property (nonatomic) NSInteger jpegQuality;
+@property (nonatomic) NKChromaSubsampling jpegSubsampling;
+/// Output size relative to the image: > 1 upscales (see `newImageFromImage:`), < 1 downscales
+/// with a Lanczos-3 filter widened to the reduction.
+@property (nonatomic) double scale;
+@end
+
+@interface NKExportResult : NSObject
+@property (nonatomic, readonly) NSUInteger width;
+@property (nonatomic, readonly) NSUInteger height;
+@property (nonatomic, readonly) unsigned long long bytesWritten;
+/// Wall time from reading the source to closing the file.
+@property (nonatomic, readonly) NSTimeInterval seconds;
+@property (nonatomic, readonly) double megapixelsPerSecond;
+@end
+
+/// Row-streaming export stage on the CPU: Lanczos-3 resampling (upscaling with edge-directed
+/// refinement, or downscaling) and/or dithered quantization to 8 bits, without GPU or size limits.
+@interface NKExportStream : NSObject
+
+/// Returns an RGBA image `factor` times larger than `image` (factor >= 1; 1 keeps the size)
+/// with `bitsPerComponent` 16, or 8 with ordered dithering instead of truncation. The pixels
+/// are computed band by band as a consumer such as `CGImageDestination` reads them, so the
+/// output frame is never held in memory in full. Returns NULL if `image` cannot be read.
++ (nullable CGImageRef)newImageFromImage:(CGImageRef)image
+                           upscaleFactor:(double)factor
+                        bitsPerComponent:(NSUInteger)bitsPerComponent
+    CF_RETURNS_RETAINED NS_SWIFT_NAME(makeImage(from:upscaleFactor:bitsPerComponent:));
+
+/// Writes `image` to `url` with the native encoders in Native/ImageEncoder.hpp, embedding the
+/// image's ICC profile. Bands of rows are resampled, quantized and handed to the encoder as they
+/// are produced, and each encoder compresses its chunks on all cores. Returns nil (and removes
+/// the partial file) if the image can't be read, the options are invalid or a write fails.
+/// Blocks for the whole export; call off the main thread.
++ (nullable NKExportResult *)writeImage:(CGImageRef)image
+                                  toURL:(NSURL *)url
+                                options:(NKExportOptions *)options NS_SWIFT_NAME(write(_:to:options:));
+
+@end
+
+NS_ASSUME_NONNULL_END
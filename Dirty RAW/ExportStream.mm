@@ -0,0 +1,309 @@
+//
+//  ExportStream.mm
+//  Dirty RAW
+//
+
+#import "ExportStream.h"
+
+#include "Native/Dither.hpp"
+#include "Native/Downscale.hpp"
+#include "Native/ImageEncoder.hpp"
+#include "Native/JobSystem.hpp"
+#include "Native/Upscale.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// Output rows rendered per band; each band is split across threads.
+constexpr int kBandRows = 64;
+
+/// Premultiplied RGBA16 in host byte order: the source layout and the 16-bit output layout.
+constexpr CGBitmapInfo kSourceInfo = kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder16Host;
+
+/// State behind the sequential data provider and the native encoders: the source pixels, the
+/// optional resampler and one band of output rows.
+struct ExportStream {
+    std::vector<uint16_t> source;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    std::unique_ptr<dirtyraw::Upscaler> upscaler;
+    std::unique_ptr<dirtyraw::Downscaler> downscaler;
+    bool dither = false;
+
+    /// Resampled 16-bit rows of the current band.
+    std::vector<uint16_t> band;
+    /// 8-bit rows of the current band when dithering.
+    std::vector<uint8_t> band8;
+    /// 16-bit rows of the current band, in `source` or `band`.
+    const uint16_t *bandRows = nullptr;
+    int bandFirstRow = -1;
+    int bandRowCount = 0;
+    /// Read position in the output byte stream.
+    size_t position = 0;
+
+    int outputWidth() const {
+        if (upscaler) return upscaler->outputWidth();
+        return downscaler ? downscaler->outputWidth() : sourceWidth;
+    }
+    int outputHeight() const {
+        if (upscaler) return upscaler->outputHeight();
+        return downscaler ? downscaler->outputHeight() : sourceHeight;
+    }
+    size_t rowElements() const { return size_t(outputWidth()) * 4; }
+    size_t rowBytes() const { return rowElements() * (dither ? sizeof(uint8_t) : sizeof(uint16_t)); }
+    size_t totalBytes() const { return rowBytes() * outputHeight(); }
+
+    /// Row `row` of the output; the rest of its band follows at `rowBytes()` intervals.
+    const uint8_t *rowPointer(int row) {
+        if (row < bandFirstRow || row >= bandFirstRow + bandRowCount) {
+            bandFirstRow = row - row % kBandRows;
+            bandRowCount = std::min(kBandRows, outputHeight() - bandFirstRow);
+            // Exports yield to preview renders between jobs
+            dirtyraw::JobScope scope(dirtyraw::JobPriority::batch);
+
+            if (upscaler) {
+                upscaler->renderRows(bandFirstRow, bandRowCount, band.data(), rowElements());
+                bandRows = band.data();
+            } else if (downscaler) {
+                downscaler->renderRows(bandFirstRow, bandRowCount, band.data(), rowElements());
+                bandRows = band.data();
+            } else {
+                bandRows = source.data() + size_t(bandFirstRow) * rowElements();
+            }
+            if (dither) {
+                dirtyraw::ditherRGBA16To8(bandRows, rowElements(), band8.data(), rowElements(),
+                                          outputWidth(), bandRowCount, bandFirstRow);
+            }
+        }
+
+        size_t offset = size_t(row - bandFirstRow) * rowElements();
+        if (dither) return band8.data() + offset;
+        return reinterpret_cast<const uint8_t *>(bandRows + offset);
+    }
+};
+
+size_t ExportStreamGetBytes(void *info, void *buffer, size_t count) {
+    auto *stream = static_cast<ExportStream *>(info);
+    size_t rowBytes = stream->rowBytes();
+    size_t copied = 0;
+    count = std::min(count, stream->totalBytes() - stream->position);
+
+    while (copied < count) {
+        int row = int(stream->position / rowBytes);
+        size_t offset = stream->position % rowBytes;
+        size_t chunk = std::min(rowBytes - offset, count - copied);
+        std::memcpy(static_cast<uint8_t *>(buffer) + copied, stream->rowPointer(row) + offset, chunk);
+        copied += chunk;
+        stream->position += chunk;
+    }
+    return copied;
+}
+
+off_t ExportStreamSkipForward(void *info, off_t count) {
+    auto *stream = static_cast<ExportStream *>(info);
+    size_t skipped = std::min(size_t(std::max<off_t>(count, 0)), stream->totalBytes() - stream->position);
+    stream->position += skipped;
+    return off_t(skipped);
+}
+
+void ExportStreamRewind(void *info) {
+    static_cast<ExportStream *>(info)->position = 0;
+}
+
+void ExportStreamRelease(void *info) {
+    delete static_cast<ExportStream *>(info);
+}
+
+/// Draws `image` into a new stream's 16-bit source and sets up resampling by `scale` and, with
+/// `dither`, quantization to 8 bits. `colorSpace` receives the (retained) RGB space of the output.
+/// Null if the image can't be drawn.
+std::unique_ptr<ExportStream> makeStream(CGImageRef image, double scale, bool dither, CGColorSpaceRef *colorSpace) {
+    size_t width = CGImageGetWidth(image);
+    size_t height = CGImageGetHeight(image);
+    if (width == 0 || height == 0 || !(scale > 0)) return nullptr;
+
+    CGColorSpaceRef space = CGImageGetColorSpace(image);
+    if (!space || CGColorSpaceGetModel(space) != kCGColorSpaceModelRGB) {
+        space = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    } else {
+        CGColorSpaceRetain(space);
+    }
+
+    // Normalize the source to premultiplied RGBA16 in host byte order
+    auto stream = std::make_unique<ExportStream>();
+    stream->source.resize(width * height * 4);
+    stream->sourceWidth = int(width);
+    stream->sourceHeight = int(height);
+    CGContextRef context = CGBitmapContextCreate(stream->source.data(), width, height, 16,
+                                                 width * 4 * sizeof(uint16_t), space, kSourceInfo);
+    if (!context) {
+        CGColorSpaceRelease(space);
+        return nullptr;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), image);
+    CGContextRelease(context);
+
+    if (scale > 1) {
+        stream->upscaler = std::make_unique<dirtyraw::Upscaler>(stream->source.data(), width * 4,
+                                                                int(width), int(height), scale);
+    } else if (scale < 1) {
+        stream->downscaler = std::make_unique<dirtyraw::Downscaler>(stream->source.data(), width * 4,
+                                                                    int(width), int(height), scale);
+    }
+    if (stream->upscaler || stream->downscaler) {
+        stream->band.resize(stream->rowElements() * kBandRows);
+    }
+    stream->dither = dither;
+    if (stream->dither) {
+        stream->band8.resize(stream->rowElements() * kBandRows);
+    }
+
+    *colorSpace = space;
+    return stream;
+}
+
+} // namespace
+
+@implementation NKExportOptions
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _format = NKExportFormatTIFF;
+        _bitsPerComponent = 16;
+        _tiffCompression = NKTIFFCompressionDeflate;
+        _jpegQuality = 90;
+        _jpegSubsampling = NKChromaSubsamplingBoth;
+        _scale = 1;
+    }
+    return self;
+}
+
+@end
+
+@interface NKExportResult ()
+@property (nonatomic, readwrite) NSUInteger width;
+@property (nonatomic, readwrite) NSUInteger height;
+@property (nonatomic, readwrite) unsigned long long bytesWritten;
+@property (nonatomic, readwrite) NSTimeInterval seconds;
+@end
+
+@implementation NKExportResult
+
+- (double)megapixelsPerSecond {
+    return _seconds > 0 ? double(_width) * double(_height) / _seconds / 1e6 : 0;
+}
+
+@end
+
+@implementation NKExportStream
+
++ (CGImageRef)newImageFromImage:(CGImageRef)image
+                  upscaleFactor:(double)factor
+               bitsPerComponent:(NSUInteger)bitsPerComponent {
+    if (!(factor >= 1)) return NULL;
+    if (bitsPerComponent != 8 && bitsPerComponent != 16) return NULL;
+
+    CGColorSpaceRef colorSpace = NULL;
+    std::unique_ptr<ExportStream> stream = makeStream(image, factor, bitsPerComponent == 8, &colorSpace);
+    if (!stream) return NULL;
+
+    size_t outputWidth = stream->outputWidth();
+    size_t outputHeight = stream->outputHeight();
+    size_t rowBytes = stream->rowBytes();
+    CGBitmapInfo outputInfo = stream->dither
+        ? CGBitmapInfo(kCGImageAlphaPremultipliedLast | kCGBitmapByteOrderDefault)
+        : kSourceInfo;
+
+    CGDataProviderSequentialCallbacks callbacks = {
+        .version = 0,
+        .getBytes = ExportStreamGetBytes,
+        .skipForward = ExportStreamSkipForward,
+        .rewind = ExportStreamRewind,
+        .releaseInfo = ExportStreamRelease,
+    };
+    ExportStream *info = stream.release();
+    CGDataProviderRef provider = CGDataProviderCreateSequential(info, &callbacks);
+    if (!provider) {
+        delete info;
+        CGColorSpaceRelease(colorSpace);
+        return NULL;
+    }
+
+    CGImageRef output = CGImageCreate(outputWidth, outputHeight, bitsPerComponent, bitsPerComponent * 4, rowBytes,
+                                      colorSpace, outputInfo, provider, NULL, true, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    CGColorSpaceRelease(colorSpace);
+    return output;
+}
+
++ (NKExportResult *)writeImage:(CGImageRef)image toURL:(NSURL *)url options:(NKExportOptions *)options {
+    auto start = std::chrono::steady_clock::now();
+    int bits = options.format == NKExportFormatJPEG ? 8 : int(options.bitsPerComponent);
+    if (bits != 8 && bits != 16) return nil;
+
+    CGColorSpaceRef colorSpace = NULL;
+    std::unique_ptr<ExportStream> stream = makeStream(image, options.scale, bits == 8, &colorSpace);
+    if (!stream) {
+        NSLog(@"NKExportStream: Failed to read the image for %@", url.lastPathComponent);
+        return nil;
+    }
+
+    dirtyraw::EncoderSettings settings;
+    settings.width = stream->outputWidth();
+    settings.height = stream->outputHeight();
+    settings.bitsPerSample = bits;
+    settings.jpegQuality = int(std::clamp<NSInteger>(options.jpegQuality, 1, 100));
+    settings.jpegSubsampling = dirtyraw::ChromaSubsampling(options.jpegSubsampling);
+    settings.tiffDeflate = options.tiffCompression == NKTIFFCompressionDeflate;
+    CFDataRef profile = CGColorSpaceCopyICCData(colorSpace);
+    if (profile) {
+        const uint8_t *bytes = CFDataGetBytePtr(profile);
+        settings.iccProfile.assign(bytes, bytes + CFDataGetLength(profile));
+        CFRelease(profile);
+    }
+    CGColorSpaceRelease(colorSpace);
+
+    std::string path = url.fileSystemRepresentation;
+    std::unique_ptr<dirtyraw::FileWriter> writer = dirtyraw::FileWriter::create(path);
+    if (!writer) {
+        NSLog(@"NKExportStream: Failed to create %@", url.path);
+        return nil;
+    }
+    std::unique_ptr<dirtyraw::ImageEncoder> encoder;
+    switch (options.format) {
+        case NKExportFormatTIFF: encoder = dirtyraw::makeTIFFEncoder(*writer, settings); break;
+        case NKExportFormatJPEG: encoder = dirtyraw::makeJPEGEncoder(*writer, settings); break;
+        case NKExportFormatPNG: encoder = dirtyraw::makePNGEncoder(*writer, settings); break;
+    }
+
+    // Exports yield to preview renders between jobs, including the encoders' compression jobs
+    dirtyraw::JobScope scope(dirtyraw::JobPriority::batch);
+    bool ok = encoder != nullptr;
+    for (int row = 0; ok && row < settings.height; row += kBandRows) {
+        int rowCount = std::min(kBandRows, settings.height - row);
+        ok = encoder->writeRows(stream->rowPointer(row), stream->rowBytes(), rowCount);
+    }
+    ok = ok && encoder->finish();
+    ok = writer->close() && ok;
+    if (!ok) {
+        NSLog(@"NKExportStream: Failed to write %@", url.path);
+        ::unlink(path.c_str());
+        return nil;
+    }
+
+    NKExportResult *result = [[NKExportResult alloc] init];
+    result.width = NSUInteger(settings.width);
+    result.height = NSUInteger(settings.height);
+    result.bytesWritten = writer->position();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+@end
@@ -0,0 +1,26 @@
+//
+//  FilmGrainKernel.h
+//  Dirty RAW
+//
+
+#import <CoreImage/CoreImage.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Adds film grain from the native cached grain fields. Grain is anchored to the frame, so
+/// tiles and region renders of one image line up and re-renders are identical.
+@interface NKFilmGrainKernel : CIImageProcessorKernel
+
+/// Grains `image`, a region of a frame spanning `frame` (the full image extent).
+/// `amount` and `roughness` are 0...1; `size` is the grain size in render pixels; `seed` picks
+/// the per-image grain pattern.
++ (CIImage *)applyToImage:(CIImage *)image
+                    frame:(CGRect)frame
+                   amount:(float)amount
+                     size:(float)size
+                roughness:(float)roughness
+                     seed:(uint32_t)seed;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,86 @@
+//
+//  FilmGrainKernel.mm
+//  Dirty RAW
+//
+
+#import "FilmGrainKernel.h"
+
+#include "Native/FilmGrain.hpp"
+
+static NSString * const NKGrainParametersKey = @"parameters";
+static NSString * const NKGrainFrameKey = @"frame";
+
+@implementation NKFilmGrainKernel
+
++ (CIImage *)applyToImage:(CIImage *)image
+                    frame:(CGRect)frame
+                   amount:(float)amount
+                     size:(float)size
+                roughness:(float)roughness
+                     seed:(uint32_t)seed {
+    if (amount <= 0 || CGRectIsEmpty(image.extent) || CGRectIsInfinite(image.extent)) return image;
+
+    dirtyraw::GrainParameters parameters;
+    parameters.amount = amount;
+    parameters.size = size;
+    parameters.roughness = roughness;
+    parameters.seed = seed;
+
+    NSError *error = nil;
+    CIImage *output = [self applyWithExtent:image.extent
+                                     inputs:@[image]
+                                  arguments:@{
+                                      NKGrainParametersKey: [NSData dataWithBytes:&parameters length:sizeof(parameters)],
+                                      NKGrainFrameKey: [CIVector vectorWithCGRect:CGRectIntegral(frame)],
+                                  }
+                                      error:&error];
+    if (!output) {
+        NSLog(@"NKFilmGrainKernel: %@", error);
+        return image;
+    }
+    return output;
+}
+
++ (CIFormat)outputFormat {
+    return kCIFormatRGBAf;
+}
+
++ (CIFormat)formatForInputAtIndex:(int)input {
+    return kCIFormatRGBAf;
+}
+
++ (CGRect)roiForInput:(int)input arguments:(NSDictionary<NSString *, id> *)arguments outputRect:(CGRect)outputRect {
+    return outputRect;
+}
+
++ (BOOL)processWithInputs:(NSArray<id<CIImageProcessorInput>> *)inputs
+                arguments:(NSDictionary<NSString *, id> *)arguments
+                   output:(id<CIImageProcessorOutput>)output
+                    error:(NSError **)error {
+    id<CIImageProcessorInput> input = inputs.firstObject;
+    NSData *parameterData = arguments[NKGrainParametersKey];
+    CIVector *frameVector = arguments[NKGrainFrameKey];
+    if (!input || !input.baseAddress || !output.baseAddress
+        || parameterData.length != sizeof(dirtyraw::GrainParameters) || !frameVector) {
+        return NO;
+    }
+
+    dirtyraw::GrainParameters parameters;
+    [parameterData getBytes:&parameters length:sizeof(parameters)];
+
+    // Buffers are stored top row first; grain rows are counted from the top of the frame
+    CGRect frame = frameVector.CGRectValue;
+    CGRect region = output.region;
+    size_t inputStride = input.bytesPerRow / sizeof(float);
+    size_t offsetX = size_t(CGRectGetMinX(region) - CGRectGetMinX(input.region));
+    size_t offsetY = size_t(CGRectGetMaxY(input.region) - CGRectGetMaxY(region));
+    const float *source = static_cast<const float *>(input.baseAddress) + offsetY * inputStride + offsetX * 4;
+
+    dirtyraw::applyFilmGrain(source, inputStride,
+                             static_cast<float *>(output.baseAddress), output.bytesPerRow / sizeof(float),
+                             int(CGRectGetMinX(region) - CGRectGetMinX(frame)), int(CGRectGetMaxY(frame) - CGRectGetMaxY(region)),
+                             int(CGRectGetWidth(region)), int(CGRectGetHeight(region)), parameters);
+    return YES;
+}
+
+@end
@@ -0,0 +1,54 @@
+//
+//  FrameStacker.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+#import "NikonSDKWrapper.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, NKStackMode) {
+    /// Average of all frames: the most noise reduction.
+    NKStackModeMean = 0,
+    /// Per-channel median: removes anything that moves through fewer than half the frames.
+    NKStackModeMedian = 1,
+    /// Average of the frames within `clipSigma` standard deviations of the median.
+    NKStackModeSigmaClippedMean = 2,
+};
+
+/// Merges bursts and exposure brackets of NEF/NRW files into one frame. See Native/Stacking.hpp
+/// and Native/HDRMerge.hpp.
+@interface NKFrameStacker : NSObject
+
+/// Develops every file in `paths` into `colorSpace`, aligns each to the first by translation
+/// and combines them with `mode`. Returns a half-float linear image in the renderer's working
+/// space (like `decodeToImage`) with the first file's framing, or NULL if a file can't be
+/// developed, the sizes differ, or `progress` cancels.
+///
+/// Frames are developed in bands and spilled to the temporary directory, so memory use does
+/// not grow with the number of frames; scratch disk does (width x height x 8 bytes per frame).
+/// `progress` gets the finished fraction on the calling thread and returns NO to cancel.
+/// Blocks for the whole stack; call off the main thread.
++ (nullable CGImageRef)newStackedImageFromPaths:(NSArray<NSString *> *)paths
+                                           mode:(NKStackMode)mode
+                                      clipSigma:(double)clipSigma
+                                     colorSpace:(NKOutputColorSpace)colorSpace
+                                       progress:(BOOL (^)(double fraction))progress
+    CF_RETURNS_RETAINED NS_SWIFT_NAME(makeStackedImage(paths:mode:clipSigma:colorSpace:progress:));
+
+/// Develops the exposure bracket in `paths` and merges it into one linear radiance image at
+/// the first file's exposure (values above 1 are highlights that file clipped), ready to be
+/// tone-mapped by the adjustment pipeline. `exposures` holds each file's relative exposure from
+/// EXIF; the ratios are re-measured from well-exposed pixels and EXIF is the fallback. Frames
+/// are aligned by rank rather than brightness. Memory, progress and failure as above.
++ (nullable CGImageRef)newMergedHDRImageFromPaths:(NSArray<NSString *> *)paths
+                                        exposures:(NSArray<NSNumber *> *)exposures
+                                       colorSpace:(NKOutputColorSpace)colorSpace
+                                         progress:(BOOL (^)(double fraction))progress
+    CF_RETURNS_RETAINED NS_SWIFT_NAME(makeMergedHDRImage(paths:exposures:colorSpace:progress:));
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,196 @@
+//
+//  FrameStacker.mm
+//  Dirty RAW
+//
+
+#import "FrameStacker.h"
+
+#include "Native/HDRMerge.hpp"
+#include "Native/JobSystem.hpp"
+#include "Native/Stacking.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace {
+
+/// Rows developed per SDK call while spilling a frame.
+constexpr NSUInteger kDevelopBandRows = 512;
+/// Largest shift searched between frames, as a fraction of the long side.
+constexpr double kMaxShiftFraction = 0.05;
+/// Share of the progress spent developing and aligning; the combine takes the rest.
+constexpr double kDevelopShare = 0.7;
+
+/// Frames developed into spill files and aligned to the first.
+struct DevelopedFrames {
+    std::vector<std::unique_ptr<dirtyraw::SpillFile>> spills;
+    std::vector<dirtyraw::StackFrame> frames;
+    NSUInteger width = 0;
+    NSUInteger height = 0;
+    size_t stride = 0;
+};
+
+/// Develops every file in `paths` in bands into spill files and aligns each frame to the first.
+/// With `equalize`, alignment compares ranks instead of brightness (for exposure brackets).
+/// `report` gets the fraction of `kDevelopShare` done and returns false to cancel.
+bool developFrames(NSArray<NSString *> *paths, NKOutputColorSpace colorSpace, bool equalize,
+                   const std::function<bool(double)> &report, DevelopedFrames &developed) {
+    std::string directory = NSTemporaryDirectory().fileSystemRepresentation;
+    NSUInteger &width = developed.width;
+    NSUInteger &height = developed.height;
+    size_t &stride = developed.stride;
+    std::unique_ptr<dirtyraw::AlignmentProxy> referenceProxy;
+
+    for (NSUInteger index = 0; index < paths.count; ++index) @autoreleasepool {
+        NSString *path = paths[index];
+        NikonSDKWrapper *wrapper = [[NikonSDKWrapper alloc] initWithFilePath:path];
+        if (!wrapper) {
+            NSLog(@"NKFrameStacker: Failed to open %@", path.lastPathComponent);
+            return false;
+        }
+        // Falls back to sRGB if the profile can't be set; `decodeRows` linearizes whichever it got
+        [wrapper useOutputColorSpace:colorSpace];
+        NKImageInfo *info = [wrapper getImageInfo];
+        if (!info) {
+            NSLog(@"NKFrameStacker: No image info for %@", path.lastPathComponent);
+            return false;
+        }
+        if (index == 0) {
+            width = info.width;
+            height = info.height;
+            stride = size_t(width) * 4;
+        } else if (info.width != width || info.height != height) {
+            NSLog(@"NKFrameStacker: %@ is %lux%lu, expected %lux%lu", path.lastPathComponent,
+                  (unsigned long)info.width, (unsigned long)info.height, (unsigned long)width, (unsigned long)height);
+            return false;
+        }
+
+        auto spill = dirtyraw::SpillFile::create(directory, stride * height * sizeof(uint16_t));
+        if (!spill) {
+            NSLog(@"NKFrameStacker: Failed to create a scratch file for %@", path.lastPathComponent);
+            return false;
+        }
+
+        // Develop in bands straight into the spill file, building the alignment proxy on the way
+        uint16_t *pixels = reinterpret_cast<uint16_t *>(spill->data());
+        auto proxy = std::make_unique<dirtyraw::AlignmentProxy>(int(width), int(height));
+        for (NSUInteger row = 0; row < height; row += kDevelopBandRows) {
+            NSUInteger rowCount = std::min(kDevelopBandRows, height - row);
+            uint16_t *band = pixels + stride * row;
+            if (![wrapper decodeRows:NSMakeRange(row, rowCount) ofImage:info intoRGBA:band rowStride:stride]) {
+                NSLog(@"NKFrameStacker: Failed to develop rows %lu-%lu of %@",
+                      (unsigned long)row, (unsigned long)(row + rowCount), path.lastPathComponent);
+                return false;
+            }
+            proxy->addRows(band, stride, int(row), int(rowCount));
+            spill->flush();
+            if (!report(kDevelopShare * (index + double(row + rowCount) / height) / paths.count)) return false;
+        }
+        [wrapper closeSession];
+        if (equalize) proxy->equalize();
+
+        dirtyraw::StackFrame frame { pixels, stride, int(width), int(height), {} };
+        if (index == 0) {
+            referenceProxy = std::move(proxy);
+        } else {
+            int maxShift = int(std::max(width, height) * kMaxShiftFraction);
+            dirtyraw::Translation estimate = dirtyraw::estimateTranslation(*referenceProxy, *proxy, maxShift);
+            frame.offset = dirtyraw::refineTranslation(developed.frames[0], frame, estimate,
+                                                       dirtyraw::AlignmentProxy::kFactor + 1, equalize);
+        }
+        developed.spills.push_back(std::move(spill));
+        developed.frames.push_back(frame);
+    }
+    return true;
+}
+
+/// Wraps `output` (half-float RGBA in the working space) in an image that owns it.
+CGImageRef createWorkingSpaceImage(std::vector<uint16_t> *output, NSUInteger width, NSUInteger height, size_t stride) {
+    // Hand the output buffer to Core Graphics without copying it
+    NSData *pixels = [[NSData alloc] initWithBytesNoCopy:output->data()
+                                                  length:output->size() * sizeof(uint16_t)
+                                             deallocator:^(void *bytes, NSUInteger length) {
+        delete output;
+    }];
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+    if (!provider) return NULL;
+
+    CGColorSpaceRef workingSpace = CGColorSpaceCreateWithName(kCGColorSpaceExtendedLinearSRGB);
+    CGBitmapInfo bitmapInfo = (CGBitmapInfo)kCGImageAlphaNoneSkipLast
+        | kCGBitmapFloatComponents
+        | kCGBitmapByteOrder16Host;
+    CGImageRef image = CGImageCreate(width, height, 16, 64, stride * sizeof(uint16_t), workingSpace,
+                                     bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    CGColorSpaceRelease(workingSpace);
+    return image;
+}
+
+} // namespace
+
+@implementation NKFrameStacker
+
++ (CGImageRef)newStackedImageFromPaths:(NSArray<NSString *> *)paths
+                                  mode:(NKStackMode)mode
+                             clipSigma:(double)clipSigma
+                            colorSpace:(NKOutputColorSpace)colorSpace
+                              progress:(BOOL (^)(double fraction))progress {
+    if (paths.count == 0) return NULL;
+
+    // Stacks yield to preview renders; a NO from `progress` skips the remaining jobs
+    dirtyraw::JobContext context { dirtyraw::JobPriority::batch, dirtyraw::CancellationToken() };
+    dirtyraw::JobScope scope(context);
+    auto report = [&](double fraction) {
+        if (!progress(fraction)) context.token.cancel();
+        return !context.token.isCancelled();
+    };
+
+    DevelopedFrames developed;
+    if (!developFrames(paths, colorSpace, false, report, developed)) return NULL;
+
+    auto *output = new std::vector<uint16_t>(developed.stride * developed.height);
+    dirtyraw::stackFrames(developed.frames, dirtyraw::StackMode(mode), float(clipSigma), output->data(), developed.stride,
+                          [&](double fraction) { report(kDevelopShare + (1 - kDevelopShare) * fraction); });
+    if (context.token.isCancelled()) {
+        delete output;
+        return NULL;
+    }
+    return createWorkingSpaceImage(output, developed.width, developed.height, developed.stride);
+}
+
++ (CGImageRef)newMergedHDRImageFromPaths:(NSArray<NSString *> *)paths
+                               exposures:(NSArray<NSNumber *> *)exposures
+                              colorSpace:(NKOutputColorSpace)colorSpace
+                                progress:(BOOL (^)(double fraction))progress {
+    if (paths.count == 0 || exposures.count != paths.count) return NULL;
+
+    dirtyraw::JobContext context { dirtyraw::JobPriority::batch, dirtyraw::CancellationToken() };
+    dirtyraw::JobScope scope(context);
+    auto report = [&](double fraction) {
+        if (!progress(fraction)) context.token.cancel();
+        return !context.token.isCancelled();
+    };
+
+    DevelopedFrames developed;
+    if (!developFrames(paths, colorSpace, true, report, developed)) return NULL;
+
+    // The SDK's develop isn't exactly linear in exposure, so the EXIF ratios are only a fallback
+    std::vector<float> measured { 1.0f };
+    for (size_t index = 1; index < developed.frames.size(); ++index) {
+        float fromEXIF = exposures[index].floatValue / exposures[0].floatValue;
+        measured.push_back(dirtyraw::estimateExposureRatio(developed.frames[0], developed.frames[index], fromEXIF));
+    }
+
+    auto *output = new std::vector<uint16_t>(developed.stride * developed.height);
+    dirtyraw::mergeExposures(developed.frames, measured, output->data(), developed.stride,
+                             [&](double fraction) { report(kDevelopShare + (1 - kDevelopShare) * fraction); });
+    if (context.token.isCancelled()) {
+        delete output;
+        return NULL;
+    }
+    return createWorkingSpaceImage(output, developed.width, developed.height, developed.stride);
+}
+
+@end
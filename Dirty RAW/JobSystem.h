@@ -0,0 +1,22 @@
+//
+//  JobSystem.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Swift view of the native job system that runs the CPU image kernels.
+@interface NKJobSystem : NSObject
+
+/// Number of pool workers (threads that submit work also run jobs, and aren't counted).
+@property (class, nonatomic, readonly) NSInteger workerCount;
+
+/// Fraction of wall time (0...1) each worker spent running jobs since the previous call;
+/// the first call measures from launch.
++ (NSArray<NSNumber *> *)sampleWorkerUtilization;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,41 @@
+//
+//  JobSystem.mm
+//  Dirty RAW
+//
+
+#import "JobSystem.h"
+
+#include "Native/JobSystem.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+@implementation NKJobSystem
+
++ (NSInteger)workerCount {
+    return dirtyraw::JobSystem::shared().workerCount();
+}
+
++ (NSArray<NSNumber *> *)sampleWorkerUtilization {
+    static std::mutex mutex;
+    static uint64_t previousTime = dirtyraw::JobSystem::now();
+    static std::vector<uint64_t> previousBusy;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<dirtyraw::WorkerStats> stats = dirtyraw::JobSystem::shared().stats();
+    uint64_t time = dirtyraw::JobSystem::now();
+    double elapsed = double(time - previousTime);
+    previousBusy.resize(stats.size(), 0);
+
+    NSMutableArray<NSNumber *> *result = [NSMutableArray arrayWithCapacity:stats.size()];
+    for (size_t index = 0; index < stats.size(); ++index) {
+        double busy = double(stats[index].busyNanoseconds - previousBusy[index]);
+        [result addObject:@(elapsed > 0 ? std::min(busy / elapsed, 1.0) : 0.0)];
+        previousBusy[index] = stats[index].busyNanoseconds;
+    }
+    previousTime = time;
+    return result;
+}
+
+@end
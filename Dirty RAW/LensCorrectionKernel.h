@@ -0,0 +1,34 @@
+//
+//  LensCorrectionKernel.h
+//  Dirty RAW
+//
+
+#import <CoreImage/CoreImage.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Lens coefficients at one focal length and aperture; radii are normalized to the frame's
+/// half-diagonal. See `dirtyraw::LensModel`.
+typedef struct NKLensModel {
+    /// Distortion: a corrected pixel at radius r samples the source at r * (1 + k1 r^2 + k2 r^4 + k3 r^6).
+    float k1, k2, k3;
+    /// Vignetting: relative illumination at radius r is 1 + v1 r^2 + v2 r^4 + v3 r^6.
+    float v1, v2, v3;
+    /// Lateral CA: red and blue source radii relative to green.
+    float caRed, caBlue;
+} NKLensModel;
+
+/// Applies distortion, vignetting and lateral CA correction in one native resampling pass,
+/// driven by remap tables cached per (model, frame size).
+@interface NKLensCorrectionKernel : CIImageProcessorKernel
+
+/// Pixels read beyond each side of the requested output for `model` on a frame of `frameSize`.
++ (CGFloat)haloForModel:(NKLensModel)model frameSize:(CGSize)frameSize NS_SWIFT_NAME(halo(model:frameSize:));
+
+/// Corrects `image`, a region of a frame spanning `frame` (the full image extent, which is
+/// larger than `image.extent` in region renders). The result is cropped to `image.extent`.
++ (CIImage *)applyToImage:(CIImage *)image frame:(CGRect)frame model:(NKLensModel)model;
+
+@end
+
+NS_ASSUME_NONNULL_END
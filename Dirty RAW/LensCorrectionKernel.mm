@@ -0,0 +1,120 @@
+//
+//  LensCorrectionKernel.mm
+//  Dirty RAW
+//
+
+#import "LensCorrectionKernel.h"
+
+#include "Native/LensCorrection.hpp"
+
+#include <cmath>
+
+static NSString * const NKLensModelKey = @"model";
+static NSString * const NKLensFrameKey = @"frame";
+
+namespace {
+
+dirtyraw::LensModel nativeModel(const NKLensModel &model) {
+    dirtyraw::LensModel native;
+    native.k1 = model.k1;
+    native.k2 = model.k2;
+    native.k3 = model.k3;
+    native.v1 = model.v1;
+    native.v2 = model.v2;
+    native.v3 = model.v3;
+    native.caRed = model.caRed;
+    native.caBlue = model.caBlue;
+    return native;
+}
+
+/// Remap table for the frame and model passed to the kernel.
+std::shared_ptr<const dirtyraw::RemapTable> tableForArguments(NSDictionary<NSString *, id> *arguments, CGRect &frame) {
+    NSData *modelData = arguments[NKLensModelKey];
+    CIVector *frameVector = arguments[NKLensFrameKey];
+    if (modelData.length != sizeof(NKLensModel) || !frameVector) return nullptr;
+
+    NKLensModel model;
+    [modelData getBytes:&model length:sizeof(model)];
+    frame = frameVector.CGRectValue;
+    return dirtyraw::cachedRemapTable(nativeModel(model), int(CGRectGetWidth(frame)), int(CGRectGetHeight(frame)));
+}
+
+/// Core Image rects are bottom-up; the native tables count rows from the top of the frame.
+CGRect topDown(CGRect rect, CGRect frame) {
+    return CGRectMake(CGRectGetMinX(rect) - CGRectGetMinX(frame), CGRectGetMaxY(frame) - CGRectGetMaxY(rect),
+                      CGRectGetWidth(rect), CGRectGetHeight(rect));
+}
+
+} // namespace
+
+@implementation NKLensCorrectionKernel
+
++ (CGFloat)haloForModel:(NKLensModel)model frameSize:(CGSize)frameSize {
+    auto table = dirtyraw::cachedRemapTable(nativeModel(model), int(frameSize.width), int(frameSize.height));
+    return std::ceil(table->maxDisplacement()) + 2;
+}
+
++ (CIImage *)applyToImage:(CIImage *)image frame:(CGRect)frame model:(NKLensModel)model {
+    CGRect extent = CGRectIntersection(image.extent, frame);
+    if (CGRectIsEmpty(extent) || CGRectIsInfinite(extent) || CGRectIsEmpty(frame)) return image;
+
+    NSError *error = nil;
+    CIImage *output = [self applyWithExtent:extent
+                                     inputs:@[[image imageByClampingToExtent]]
+                                  arguments:@{
+                                      NKLensModelKey: [NSData dataWithBytes:&model length:sizeof(model)],
+                                      NKLensFrameKey: [CIVector vectorWithCGRect:CGRectIntegral(frame)],
+                                  }
+                                      error:&error];
+    if (!output) {
+        NSLog(@"NKLensCorrectionKernel: %@", error);
+        return image;
+    }
+    return output;
+}
+
++ (CIFormat)outputFormat {
+    return kCIFormatRGBAf;
+}
+
++ (CIFormat)formatForInputAtIndex:(int)input {
+    return kCIFormatRGBAf;
+}
+
++ (CGRect)roiForInput:(int)input arguments:(NSDictionary<NSString *, id> *)arguments outputRect:(CGRect)outputRect {
+    CGRect frame;
+    auto table = tableForArguments(arguments, frame);
+    if (!table) return outputRect;
+
+    CGRect output = CGRectIntegral(topDown(outputRect, frame));
+    int x, y, width, height;
+    table->sourceBounds(int(CGRectGetMinX(output)), int(CGRectGetMinY(output)),
+                        int(CGRectGetWidth(output)), int(CGRectGetHeight(output)), x, y, width, height);
+    // Back to bottom-up coordinates
+    return CGRectMake(CGRectGetMinX(frame) + x, CGRectGetMaxY(frame) - (y + height), width, height);
+}
+
++ (BOOL)processWithInputs:(NSArray<id<CIImageProcessorInput>> *)inputs
+                arguments:(NSDictionary<NSString *, id> *)arguments
+                   output:(id<CIImageProcessorOutput>)output
+                    error:(NSError **)error {
+    id<CIImageProcessorInput> input = inputs.firstObject;
+    if (!input || !input.baseAddress || !output.baseAddress) return NO;
+
+    CGRect frame;
+    auto table = tableForArguments(arguments, frame);
+    if (!table) return NO;
+
+    // Buffers are stored top row first, matching the table's orientation
+    CGRect source = topDown(input.region, frame);
+    CGRect destination = topDown(output.region, frame);
+    table->apply(static_cast<const float *>(input.baseAddress), input.bytesPerRow / sizeof(float),
+                 int(CGRectGetMinX(source)), int(CGRectGetMinY(source)),
+                 int(CGRectGetWidth(source)), int(CGRectGetHeight(source)),
+                 static_cast<float *>(output.baseAddress), output.bytesPerRow / sizeof(float),
+                 int(CGRectGetMinX(destination)), int(CGRectGetMinY(destination)),
+                 int(CGRectGetWidth(destination)), int(CGRectGetHeight(destination)));
+    return YES;
+}
+
+@end
@@ -0,0 +1,25 @@
+//
+//  LocalAdjustmentKernel.h
+//  Dirty RAW
+//
+
+#import <CoreImage/CoreImage.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Blends a locally adjusted image over the global result through a vector mask that is
+/// rasterized natively in cached tiles. See Native/LocalMask.hpp for the mask data layout.
+@interface NKLocalAdjustmentKernel : CIImageProcessorKernel
+
+/// `adjusted` blended over `image` by `mask` coverage on a frame spanning `frame` (the full
+/// image extent, which is larger than `image.extent` in region renders). Only the mask's bounds
+/// go through the kernel; everywhere else `image` passes through untouched, so the cost follows
+/// the masked area. Returns `image` if `mask` is malformed or covers nothing.
++ (CIImage *)blendImage:(CIImage *)adjusted
+              overImage:(CIImage *)image
+                   mask:(NSData *)mask
+                  frame:(CGRect)frame NS_SWIFT_NAME(blend(_:over:mask:frame:));
+
+@end
+
+NS_ASSUME_NONNULL_END
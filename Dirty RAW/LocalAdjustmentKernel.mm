@@ -0,0 +1,108 @@
+//
+//  LocalAdjustmentKernel.mm
+//  Dirty RAW
+//
+
+#import "LocalAdjustmentKernel.h"
+
+#include "Native/LocalMask.hpp"
+
+static NSString * const NKLocalMaskKey = @"mask";
+static NSString * const NKLocalFrameKey = @"frame";
+
+namespace {
+
+std::shared_ptr<const dirtyraw::LocalMask> parseMask(NSData *data) {
+    if (data.length < sizeof(float)) return nullptr;
+    return dirtyraw::LocalMask::parse(static_cast<const float *>(data.bytes), data.length / sizeof(float));
+}
+
+/// Core Image rects are bottom-up; masks count rows from the top of the frame.
+CGRect topDown(CGRect rect, CGRect frame) {
+    return CGRectMake(CGRectGetMinX(rect) - CGRectGetMinX(frame), CGRectGetMaxY(frame) - CGRectGetMaxY(rect),
+                      CGRectGetWidth(rect), CGRectGetHeight(rect));
+}
+
+/// First float of `input` at the top-left corner of `region`.
+const float *pixelAt(id<CIImageProcessorInput> input, CGRect region) {
+    CGRect inputRegion = input.region;
+    NSInteger offsetX = NSInteger(CGRectGetMinX(region) - CGRectGetMinX(inputRegion));
+    NSInteger offsetY = NSInteger(CGRectGetMaxY(inputRegion) - CGRectGetMaxY(region));
+    if (!input.baseAddress || offsetX < 0 || offsetY < 0
+        || CGRectGetWidth(inputRegion) < offsetX + CGRectGetWidth(region)
+        || CGRectGetHeight(inputRegion) < offsetY + CGRectGetHeight(region)) {
+        return nullptr;
+    }
+    return static_cast<const float *>(input.baseAddress) + size_t(offsetY) * (input.bytesPerRow / sizeof(float)) + size_t(offsetX) * 4;
+}
+
+} // namespace
+
+@implementation NKLocalAdjustmentKernel
+
++ (CIImage *)blendImage:(CIImage *)adjusted overImage:(CIImage *)image mask:(NSData *)mask frame:(CGRect)frame {
+    auto parsed = parseMask(mask);
+    frame = CGRectIntegral(frame);
+    if (!parsed || CGRectIsEmpty(frame) || CGRectIsInfinite(image.extent)) return image;
+
+    int x, y, width, height;
+    parsed->bounds(int(CGRectGetWidth(frame)), int(CGRectGetHeight(frame)), x, y, width, height);
+    CGRect bounds = CGRectMake(CGRectGetMinX(frame) + x, CGRectGetMaxY(frame) - (y + height), width, height);
+    CGRect extent = CGRectIntersection(bounds, image.extent);
+    if (CGRectIsEmpty(extent)) return image;
+
+    NSError *error = nil;
+    CIImage *output = [self applyWithExtent:extent
+                                     inputs:@[[image imageByClampingToExtent], [adjusted imageByClampingToExtent]]
+                                  arguments:@{
+                                      NKLocalMaskKey: mask,
+                                      NKLocalFrameKey: [CIVector vectorWithCGRect:frame],
+                                  }
+                                      error:&error];
+    if (!output) {
+        NSLog(@"NKLocalAdjustmentKernel: %@", error);
+        return image;
+    }
+    // The kernel's output is opaque inside the mask bounds and absent outside them
+    return [[output imageByCompositingOverImage:image] imageByCroppingToRect:image.extent];
+}
+
++ (CIFormat)outputFormat {
+    return kCIFormatRGBAf;
+}
+
++ (CIFormat)formatForInputAtIndex:(int)input {
+    return kCIFormatRGBAf;
+}
+
++ (CGRect)roiForInput:(int)input arguments:(NSDictionary<NSString *, id> *)arguments outputRect:(CGRect)outputRect {
+    return outputRect;
+}
+
++ (BOOL)processWithInputs:(NSArray<id<CIImageProcessorInput>> *)inputs
+                arguments:(NSDictionary<NSString *, id> *)arguments
+                   output:(id<CIImageProcessorOutput>)output
+                    error:(NSError **)error {
+    if (inputs.count < 2 || !output.baseAddress) return NO;
+
+    auto mask = parseMask(arguments[NKLocalMaskKey]);
+    CIVector *frameVector = arguments[NKLocalFrameKey];
+    if (!mask || !frameVector) return NO;
+
+    CGRect frame = frameVector.CGRectValue;
+    CGRect region = output.region;
+    const float *background = pixelAt(inputs[0], region);
+    const float *adjusted = pixelAt(inputs[1], region);
+    if (!background || !adjusted) return NO;
+
+    CGRect pixels = topDown(region, frame);
+    mask->blend(background, inputs[0].bytesPerRow / sizeof(float),
+                adjusted, inputs[1].bytesPerRow / sizeof(float),
+                static_cast<float *>(output.baseAddress), output.bytesPerRow / sizeof(float),
+                int(CGRectGetWidth(frame)), int(CGRectGetHeight(frame)),
+                int(CGRectGetMinX(pixels)), int(CGRectGetMinY(pixels)),
+                int(CGRectGetWidth(pixels)), int(CGRectGetHeight(pixels)));
+    return YES;
+}
+
+@end
@@ -0,0 +1,81 @@
+//
+//  MemoryLedger.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// What a reported allocation is for (see Native/MemoryLedger.hpp).
+typedef NS_ENUM(NSInteger, NKMemoryCategory) {
+    NKMemoryCategorySourceBitmaps = 0,
+    NKMemoryCategoryProcessedBitmaps = 1,
+    NKMemoryCategoryPreviewBitmaps = 2,
+    NKMemoryCategoryThumbnails = 3,
+    NKMemoryCategoryDecodeBuffers = 4,
+    NKMemoryCategorySDKSessions = 5,
+    NKMemoryCategoryRenderIntermediates = 6,
+    NKMemoryCategoryRenderCache = 7,
+    NKMemoryCategoryViewportTiles = 8,
+    NKMemoryCategoryLUTTables = 9,
+    NKMemoryCategoryLUTTextures = 10,
+};
+
+@interface NKMemoryUsage : NSObject
+@property (nonatomic, readonly) int64_t currentBytes;
+@property (nonatomic, readonly) int64_t peakBytes;
+/// Reports that changed the count; a count that keeps climbing while idle is churn.
+@property (nonatomic, readonly) uint64_t changeCount;
+@end
+
+/// Holdings of one owner, typically an open image.
+@interface NKMemoryOwnerUsage : NSObject
+@property (nonatomic, readonly) uint64_t ownerID;
+@property (nonatomic, readonly) NSString *name;
+/// Sum over categories.
+@property (nonatomic, readonly) NKMemoryUsage *total;
+- (int64_t)bytesForCategory:(NKMemoryCategory)category NS_SWIFT_NAME(bytes(for:));
+@end
+
+@interface NKMemorySnapshot : NSObject
+@property (nonatomic, readonly) NSDate *date;
+/// Physical footprint of the process when the snapshot was taken.
+@property (nonatomic, readonly) int64_t footprintBytes;
+/// Sum over categories.
+@property (nonatomic, readonly) NKMemoryUsage *total;
+/// Registered owners, largest first.
+@property (nonatomic, readonly) NSArray<NKMemoryOwnerUsage *> *owners;
+- (NKMemoryUsage *)usageForCategory:(NKMemoryCategory)category NS_SWIFT_NAME(usage(for:));
+@end
+
+/// Tagged byte counts of the app's large allocations, per category and per owner, with peaks.
+/// Thread-safe; reports are cheap but should be made when holdings change, not per tile.
+@interface NKMemoryLedger : NSObject
+
+/// Every category, in declaration order.
+@property (class, nonatomic, readonly) NSArray<NSNumber *> *allCategories;
+
+/// Stable camel-case key of `category`, as used in reports.
++ (NSString *)keyForCategory:(NKMemoryCategory)category NS_SWIFT_NAME(key(for:));
+
+/// Returns a new owner id (never 0) to attribute allocations to.
++ (uint64_t)registerOwnerNamed:(NSString *)name NS_SWIFT_NAME(registerOwner(named:));
+/// Forgets `owner` and whatever it still holds.
++ (void)releaseOwner:(uint64_t)owner;
+
+/// Adds `delta` bytes (negative to release) to `category`, attributed to `owner` (0: none).
+/// Reports for a released owner are ignored.
++ (void)addBytes:(int64_t)delta category:(NKMemoryCategory)category owner:(uint64_t)owner
+    NS_SWIFT_NAME(add(_:for:owner:));
+/// Sets what `owner` (0: none) holds in `category`, for owners that keep a running total.
++ (void)setBytes:(int64_t)bytes category:(NKMemoryCategory)category owner:(uint64_t)owner
+    NS_SWIFT_NAME(set(_:for:owner:));
+
++ (NKMemorySnapshot *)snapshot;
+/// Starts peaks over from current usage.
++ (void)resetPeaks;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,133 @@
+//
+//  MemoryLedger.mm
+//  Dirty RAW
+//
+
+#import "MemoryLedger.h"
+
+#include "Native/MemoryLedger.hpp"
+
+#include <vector>
+
+static_assert(NKMemoryCategoryLUTTextures + 1 == dirtyraw::kMemoryCategoryCount,
+              "NKMemoryCategory must mirror dirtyraw::MemoryCategory");
+
+@interface NKMemoryUsage ()
+- (instancetype)initWithUsage:(const dirtyraw::MemoryUsage &)usage;
+@end
+
+@implementation NKMemoryUsage
+
+- (instancetype)initWithUsage:(const dirtyraw::MemoryUsage &)usage {
+    if (self = [super init]) {
+        _currentBytes = usage.current;
+        _peakBytes = usage.peak;
+        _changeCount = usage.changes;
+    }
+    return self;
+}
+
+@end
+
+@interface NKMemoryOwnerUsage () {
+    std::vector<int64_t> _bytes;
+}
+- (instancetype)initWithOwner:(const dirtyraw::MemoryOwnerUsage &)owner;
+@end
+
+@implementation NKMemoryOwnerUsage
+
+- (instancetype)initWithOwner:(const dirtyraw::MemoryOwnerUsage &)owner {
+    if (self = [super init]) {
+        _ownerID = owner.owner;
+        _name = [NSString stringWithUTF8String:owner.name.c_str()] ?: @"";
+        _total = [[NKMemoryUsage alloc] initWithUsage:owner.total];
+        _bytes.assign(owner.bytes, owner.bytes + dirtyraw::kMemoryCategoryCount);
+    }
+    return self;
+}
+
+- (int64_t)bytesForCategory:(NKMemoryCategory)category {
+    return category >= 0 && size_t(category) < _bytes.size() ? _bytes[size_t(category)] : 0;
+}
+
+@end
+
+@interface NKMemorySnapshot () {
+    NSArray<NKMemoryUsage *> *_categories;
+}
+- (instancetype)initWithSnapshot:(const dirtyraw::MemorySnapshot &)snapshot footprint:(int64_t)footprint;
+@end
+
+@implementation NKMemorySnapshot
+
+- (instancetype)initWithSnapshot:(const dirtyraw::MemorySnapshot &)snapshot footprint:(int64_t)footprint {
+    if (self = [super init]) {
+        _date = [NSDate date];
+        _footprintBytes = footprint;
+        _total = [[NKMemoryUsage alloc] initWithUsage:snapshot.total];
+
+        NSMutableArray<NKMemoryUsage *> *categories = [NSMutableArray arrayWithCapacity:dirtyraw::kMemoryCategoryCount];
+        for (const dirtyraw::MemoryUsage &usage : snapshot.categories) {
+            [categories addObject:[[NKMemoryUsage alloc] initWithUsage:usage]];
+        }
+        _categories = categories;
+
+        NSMutableArray<NKMemoryOwnerUsage *> *owners = [NSMutableArray arrayWithCapacity:snapshot.owners.size()];
+        for (const dirtyraw::MemoryOwnerUsage &owner : snapshot.owners) {
+            [owners addObject:[[NKMemoryOwnerUsage alloc] initWithOwner:owner]];
+        }
+        _owners = owners;
+    }
+    return self;
+}
+
+- (NKMemoryUsage *)usageForCategory:(NKMemoryCategory)category {
+    if (category < 0 || NSUInteger(category) >= _categories.count) {
+        return [[NKMemoryUsage alloc] initWithUsage:dirtyraw::MemoryUsage()];
+    }
+    return _categories[NSUInteger(category)];
+}
+
+@end
+
+@implementation NKMemoryLedger
+
++ (NSArray<NSNumber *> *)allCategories {
+    NSMutableArray<NSNumber *> *categories = [NSMutableArray arrayWithCapacity:dirtyraw::kMemoryCategoryCount];
+    for (NSInteger category = 0; category < dirtyraw::kMemoryCategoryCount; ++category) {
+        [categories addObject:@(category)];
+    }
+    return categories;
+}
+
++ (NSString *)keyForCategory:(NKMemoryCategory)category {
+    return @(dirtyraw::memoryCategoryName(dirtyraw::MemoryCategory(category)));
+}
+
++ (uint64_t)registerOwnerNamed:(NSString *)name {
+    return dirtyraw::MemoryLedger::shared().registerOwner(name.UTF8String ?: "");
+}
+
++ (void)releaseOwner:(uint64_t)owner {
+    dirtyraw::MemoryLedger::shared().releaseOwner(owner);
+}
+
++ (void)addBytes:(int64_t)delta category:(NKMemoryCategory)category owner:(uint64_t)owner {
+    dirtyraw::MemoryLedger::shared().add(dirtyraw::MemoryCategory(category), delta, owner);
+}
+
++ (void)setBytes:(int64_t)bytes category:(NKMemoryCategory)category owner:(uint64_t)owner {
+    dirtyraw::MemoryLedger::shared().set(dirtyraw::MemoryCategory(category), bytes, owner);
+}
+
++ (NKMemorySnapshot *)snapshot {
+    return [[NKMemorySnapshot alloc] initWithSnapshot:dirtyraw::MemoryLedger::shared().snapshot()
+                                            footprint:dirtyraw::processFootprint()];
+}
+
++ (void)resetPeaks {
+    dirtyraw::MemoryLedger::shared().resetPeaks();
+}
+
+@end
@@ -0,0 +1,103 @@
+//
+//  BracketGrouping.swift
+//  Dirty RAW
+//
+
+import Foundation
+
+/// Finds exposure brackets among NEF/NRW files from their EXIF: frames shot back to back with
+/// the same camera and focal length whose exposures differ. Metadata comes from the catalog,
+/// or from the native NEF parser for files not catalogued yet, so no SDK session is opened.
+enum BracketGrouping {
+    struct Bracket: Identifiable {
+        /// Files in merge order: the reference (middle) exposure first.
+        let urls: [URL]
+        /// Exposure of each file relative to `urls[0]` (2 = one stop brighter).
+        let exposures: [Double]
+
+        var id: URL { urls[0] }
+
+        /// Spread of the bracket in stops.
+        var stops: ClosedRange<Double> {
+            let values = exposures.map { log2($0) }
+            return values.min()!...values.max()!
+        }
+    }
+
+    private struct Frame {
+        let url: URL
+        let date: Date
+        let duration: Double
+        let model: String
+        let focalLength: Double
+        /// Relative exposure: time x ISO / f-number², or 2^bias when those are missing.
+        let exposure: Double
+    }
+
+    /// Longest pause between the end of one frame and the start of the next within a bracket.
+    /// EXIF times have one-second resolution, so this can't be much tighter.
+    private static let maximumGap: TimeInterval = 2
+    /// Exposures closer than this (in stops) count as the same bracket step.
+    private static let stepTolerance = 0.15
+
+    /// Brackets of two or more distinct exposures among `urls`, in capture order.
+    static func brackets(in urls: [URL]) -> [Bracket] {
+        let frames = urls.compactMap(frame(for:)).sorted { $0.date < $1.date }
+
+        var groups: [[Frame]] = []
+        var current: [Frame] = []
+        for frame in frames {
+            if let previous = current.last {
+                let gap = frame.date.timeIntervalSince(previous.date) - previous.duration
+                let sameSetup = frame.model == previous.model && abs(frame.focalLength - previous.focalLength) < 0.5
+                // A repeated exposure starts the next bracket of a sequence
+                let repeatsStep = current.contains { abs(log2($0.exposure / frame.exposure)) < stepTolerance }
+                if gap > maximumGap || !sameSetup || repeatsStep {
+                    groups.append(current)
+                    current = []
+                }
+            }
+            current.append(frame)
+        }
+        groups.append(current)
+
+        return groups.filter { $0.count >= 2 }.map { group in
+            // The middle exposure is the reference: it's what the user metered for
+            let ordered = group.sorted { $0.exposure < $1.exposure }
+            let reference = ordered[ordered.count / 2]
+            let merged = [reference] + group.filter { $0.url != reference.url }
+            return Bracket(
+                urls: merged.map(\.url),
+                exposures: merged.map { $0.exposure / reference.exposure }
+            )
+        }
+    }
+
+    private static func frame(for url: URL) -> Frame? {
+        let ext = url.pathExtension.lowercased()
+        guard ext == "nef" || ext == "nrw" else { return nil }
+
+        let exif: NKEXIFData?
+        if let entry = ImageCatalog.shared.entry(for: url) {
+            exif = entry.exif
+        } else {
+            exif = NKNEFFile(filePath: url.path)?.getEXIFData()
+        }
+        guard let exif, let date = exif.dateTime else { return nil }
+
+        let exposure: Double
+        if exif.exposureTime > 0, exif.fNumber > 0, exif.iso > 0 {
+            exposure = exif.exposureTime * Double(exif.iso) / (exif.fNumber * exif.fNumber)
+        } else {
+            exposure = pow(2, exif.exposureBias)
+        }
+        return Frame(
+            url: url,
+            date: date,
+            duration: max(exif.exposureTime, 0),
+            model: exif.model ?? "",
+            focalLength: exif.focalLength,
+            exposure: exposure
+        )
+    }
+}
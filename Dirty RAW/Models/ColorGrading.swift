@@ -0,0 +1,174 @@
+//
+//  ColorGrading.swift
+//  Dirty RAW
+//
+
+import Foundation
+
+/// Per-hue HSL mixer, black & white channel mixer and split toning. None of these are render
+/// passes of their own: the LUT stage compiles them, together with the selected .cube LUT, into a
+/// single 3D LUT cached by parameters, so grading costs one LUT lookup per pixel however much of
+/// it is used. Values are applied to sRGB-encoded colour, the LUT domain.
+struct ColorGrading: Hashable {
+    enum Band: Int, CaseIterable, Identifiable {
+        case red, orange, yellow, green, aqua, blue, purple, magenta
+
+        var id: Int { rawValue }
+
+        var displayName: String {
+            switch self {
+            case .red: return "Red"
+            case .orange: return "Orange"
+            case .yellow: return "Yellow"
+            case .green: return "Green"
+            case .aqua: return "Aqua"
+            case .blue: return "Blue"
+            case .purple: return "Purple"
+            case .magenta: return "Magenta"
+            }
+        }
+
+        /// Hue (degrees) at which each band has full effect; it fades out towards its neighbours.
+        static let centerHues: [Float] = [0, 30, 60, 120, 180, 240, 270, 300]
+    }
+
+    struct BandAdjustment: Hashable {
+        var hue: Double = 0.0         // -1.0 to 1.0 (±30°)
+        var saturation: Double = 0.0  // -1.0 to 1.0
+        var luminance: Double = 0.0   // -1.0 to 1.0
+    }
+
+    var bands = Array(repeating: BandAdjustment(), count: Band.allCases.count)
+
+    // Black & White
+    var isMonochrome = false
+    var mixerRed: Double = 0.4        // -2.0 to 2.0
+    var mixerGreen: Double = 0.4      // -2.0 to 2.0
+    var mixerBlue: Double = 0.2       // -2.0 to 2.0
+
+    // Split Toning
+    var shadowHue: Double = 220       // 0 to 360 degrees
+    var shadowSaturation: Double = 0  // 0.0 to 1.0
+    var highlightHue: Double = 40     // 0 to 360 degrees
+    var highlightSaturation: Double = 0 // 0.0 to 1.0
+    var splitBalance: Double = 0      // -1.0 (more shadows) to 1.0 (more highlights)
+
+    subscript(band: Band) -> BandAdjustment {
+        get { bands[band.rawValue] }
+        set { bands[band.rawValue] = newValue }
+    }
+
+    private var hasMixer: Bool { bands.contains { $0 != BandAdjustment() } }
+    private var hasSplitToning: Bool { shadowSaturation > 0 || highlightSaturation > 0 }
+
+    /// Grading changes nothing (parameters that only matter when enabled are ignored).
+    var isNeutral: Bool { !hasMixer && !isMonochrome && !hasSplitToning }
+
+    /// Maps one sRGB-encoded colour; used to build the LUT, never per pixel.
+    func apply(_ red: Float, _ green: Float, _ blue: Float) -> (Float, Float, Float) {
+        var (r, g, b) = (red, green, blue)
+
+        if hasMixer {
+            var (h, s, l) = Self.hsl(r, g, b)
+            // Greys have no hue for the bands to act on
+            if s > 0.0001 {
+                let (lower, upper, t) = Self.bandPosition(hue: h)
+                func mixed(_ keyPath: KeyPath<BandAdjustment, Double>) -> Float {
+                    Float(bands[lower][keyPath: keyPath]) * (1 - t) + Float(bands[upper][keyPath: keyPath]) * t
+                }
+                let luminance = mixed(\.luminance)
+                h = (h + mixed(\.hue) * 30 + 360).truncatingRemainder(dividingBy: 360)
+                // Luminance moves saturated colours most and stays inside 0...1
+                l += luminance * 0.5 * s * (luminance > 0 ? 1 - l : l)
+                s = min(max(s * (1 + mixed(\.saturation)), 0), 1)
+                (r, g, b) = Self.rgb(h, s, l)
+            }
+        }
+
+        if isMonochrome {
+            let grey = Float(mixerRed) * r + Float(mixerGreen) * g + Float(mixerBlue) * b
+            (r, g, b) = (grey, grey, grey)
+        }
+
+        if hasSplitToning {
+            let luma = Self.luma(r, g, b)
+            let pivot = 0.5 + Float(splitBalance) * 0.25
+            let shadowWeight = Float(shadowSaturation) * (1 - Self.smoothstep(0, 2 * pivot, luma))
+            let highlightWeight = Float(highlightSaturation) * Self.smoothstep(2 * pivot - 1, 1, luma)
+            // Tints are shifted to zero luma so toning changes colour, not brightness
+            func tone(hue: Double, weight: Float) {
+                guard weight > 0 else { return }
+                let tint = Self.rgb(Float(hue), 1, 0.5)
+                let tintLuma = Self.luma(tint.0, tint.1, tint.2)
+                r += (tint.0 - tintLuma) * weight * 0.5
+                g += (tint.1 - tintLuma) * weight * 0.5
+                b += (tint.2 - tintLuma) * weight * 0.5
+            }
+            tone(hue: shadowHue, weight: shadowWeight)
+            tone(hue: highlightHue, weight: highlightWeight)
+        }
+
+        return (r, g, b)
+    }
+
+    // MARK: - Private
+
+    /// Neighbouring bands around `hue` and the weight of the upper one.
+    private static func bandPosition(hue: Float) -> (Int, Int, Float) {
+        let centers = Band.centerHues
+        for index in centers.indices {
+            let start = centers[index]
+            let end = index + 1 < centers.count ? centers[index + 1] : 360
+            if hue >= start && hue < end {
+                return (index, (index + 1) % centers.count, (hue - start) / (end - start))
+            }
+        }
+        return (0, 1, 0)
+    }
+
+    private static func luma(_ r: Float, _ g: Float, _ b: Float) -> Float {
+        0.2126 * r + 0.7152 * g + 0.0722 * b
+    }
+
+    private static func smoothstep(_ edge0: Float, _ edge1: Float, _ x: Float) -> Float {
+        let t = min(max((x - edge0) / (edge1 - edge0), 0), 1)
+        return t * t * (3 - 2 * t)
+    }
+
+    /// Hue in degrees, saturation and lightness in 0...1.
+    private static func hsl(_ r: Float, _ g: Float, _ b: Float) -> (Float, Float, Float) {
+        let maximum = max(r, g, b)
+        let minimum = min(r, g, b)
+        let l = (maximum + minimum) / 2
+        let delta = maximum - minimum
+        guard delta > 0 else { return (0, 0, l) }
+
+        let s = delta / (1 - abs(2 * l - 1))
+        var h: Float
+        if maximum == r {
+            h = ((g - b) / delta).truncatingRemainder(dividingBy: 6)
+        } else if maximum == g {
+            h = (b - r) / delta + 2
+        } else {
+            h = (r - g) / delta + 4
+        }
+        h *= 60
+        if h < 0 { h += 360 }
+        return (h, min(s, 1), l)
+    }
+
+    private static func rgb(_ h: Float, _ s: Float, _ l: Float) -> (Float, Float, Float) {
+        let chroma = (1 - abs(2 * l - 1)) * s
+        let sector = h / 60
+        let x = chroma * (1 - abs(sector.truncatingRemainder(dividingBy: 2) - 1))
+        let m = l - chroma / 2
+        switch Int(sector) % 6 {
+        case 0: return (chroma + m, x + m, m)
+        case 1: return (x + m, chroma + m, m)
+        case 2: return (m, chroma + m, x + m)
+        case 3: return (m, x + m, chroma + m)
+        case 4: return (x + m, m, chroma + m)
+        default: return (chroma + m, m, x + m)
+        }
+    }
+}
@@ -0,0 +1,78 @@
+//
+//  DuplicateGrouping.swift
+//  Dirty RAW
+//
+
+import Foundation
+
+/// Finds near-duplicate frames for culling (bursts, RAW+JPEG pairs, re-exports) by perceptual
+/// hash, see `NKDuplicateDetector`. Signatures are kept for the session per file version, and
+/// are computed in the background as soon as a folder is opened, so grouping is ready by the
+/// time the user asks for it; regrouping with other settings only re-runs the hash search.
+final class DuplicateGrouping {
+    static let shared = DuplicateGrouping()
+
+    struct Group: Identifiable {
+        /// Members in the order they were passed in.
+        let urls: [URL]
+
+        var id: URL { urls[0] }
+    }
+
+    /// Hash bits two frames may differ in and still count as near-duplicates. Resized and
+    /// recompressed copies differ in 0-4 bits, burst frames with some movement in up to ~10;
+    /// unrelated frames in about 32.
+    static let defaultMaxDistance = 8
+    /// Mean chroma difference (0...255) allowed between near-duplicates.
+    static let colorTolerance = 12.0
+
+    private let lock = NSLock()
+    /// Held while hashing, so a request during the background pass waits for it instead of
+    /// hashing the same files again.
+    private let hashingLock = NSLock()
+    private var signatures: [ImageCatalog.Key: NKImageSignature] = [:]
+
+    private init() {}
+
+    /// Computes and keeps the signatures of `urls` not seen yet. Returns false if `progress`
+    /// cancelled (it gets the finished fraction and returns false to cancel).
+    @discardableResult
+    func prepare(_ urls: [URL], progress: @escaping (Double) -> Bool = { _ in true }) -> Bool {
+        hashingLock.lock()
+        defer { hashingLock.unlock() }
+
+        let keys = urls.map { ImageCatalog.Key(url: $0) }
+        lock.lock()
+        let missing = zip(urls, keys).filter { _, key in key.map { signatures[$0] == nil } ?? false }
+        lock.unlock()
+        guard !missing.isEmpty else { return progress(1) }
+
+        guard let computed = NKDuplicateDetector.signatures(paths: missing.map { $0.0.path }, progress: progress) else {
+            return false
+        }
+        lock.lock()
+        for ((_, key), signature) in zip(missing, computed) {
+            if let key, let signature = signature as? NKImageSignature {
+                signatures[key] = signature
+            }
+        }
+        lock.unlock()
+        return true
+    }
+
+    /// Groups of two or more near-duplicates among `urls`, in order of their first member.
+    /// Returns nil if `progress` cancels while signatures are still being computed.
+    func groups(in urls: [URL], maxDistance: Int = defaultMaxDistance,
+                progress: @escaping (Double) -> Bool = { _ in true }) -> [Group]? {
+        guard prepare(urls, progress: progress) else { return nil }
+
+        lock.lock()
+        let entries: [Any] = urls.map { url in
+            ImageCatalog.Key(url: url).flatMap { signatures[$0] } ?? NSNull()
+        }
+        lock.unlock()
+
+        return NKDuplicateDetector.group(entries, maxDistance: maxDistance, colorTolerance: Self.colorTolerance)
+            .map { indices in Group(urls: indices.map { urls[$0.intValue] }) }
+    }
+}
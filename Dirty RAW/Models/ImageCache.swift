@@ -0,0 +1,136 @@
+//
+//  ImageCache.swift
+//  Dirty RAW
+//
+
+import Foundation
+import AppKit
+
+/// Global byte budget for the full-resolution bitmaps held by `RAWImage` instances.
+/// - Every `RAWImage` reports its `image` + `processedImage` footprint here.
+/// - When the total exceeds the budget, least-recently-used images are evicted; the selected
+///   image and pinned images are never evicted.
+/// - Evicted images keep their thumbnail, EXIF and adjustments and are re-decoded on next access.
+@MainActor
+final class ImageCache {
+    static let shared = ImageCache()
+
+    private static let budgetDefaultsKey = "DirtyRAW.ImageCacheBudgetMB"
+
+    private struct Entry {
+        weak var owner: RAWImage?
+        var bytes: Int
+        var lastAccess: UInt64
+    }
+
+    private var entries: [ObjectIdentifier: Entry] = [:]
+    private var accessClock: UInt64 = 0
+    private var selectedID: ObjectIdentifier?
+    private var isEvicting = false
+
+    /// Maximum bytes of decoded/processed bitmaps kept alive across all images.
+    var byteBudget: Int {
+        didSet {
+            UserDefaults.standard.set(byteBudget >> 20, forKey: Self.budgetDefaultsKey)
+            enforceBudget()
+        }
+    }
+
+    private(set) var residentBytes = 0
+
+    private init() {
+        let storedMB = UserDefaults.standard.integer(forKey: Self.budgetDefaultsKey)
+        if storedMB > 0 {
+            byteBudget = storedMB << 20
+        } else {
+            // Default: a quarter of physical memory, clamped to 1–8 GB
+            let quarter = Int(ProcessInfo.processInfo.physicalMemory / 4)
+            byteBudget = min(max(quarter, 1 << 30), 8 << 30)
+        }
+    }
+
+    // MARK: - Tracking
+
+    /// Records the current bitmap footprint of `image` and marks it as recently used.
+    func update(_ image: RAWImage) {
+        let id = ObjectIdentifier(image)
+        let bytes = image.residentBitmapBytes
+
+        if let previous = entries[id] {
+            residentBytes -= previous.bytes
+        }
+
+        guard bytes > 0 else {
+            entries[id] = nil
+            return
+        }
+
+        accessClock += 1
+        entries[id] = Entry(owner: image, bytes: bytes, lastAccess: accessClock)
+        residentBytes += bytes
+        enforceBudget()
+    }
+
+    /// Marks `image` as recently used without changing its footprint.
+    func touch(_ image: RAWImage) {
+        let id = ObjectIdentifier(image)
+        guard entries[id] != nil else { return }
+        accessClock += 1
+        entries[id]?.lastAccess = accessClock
+    }
+
+    func remove(_ image: RAWImage) {
+        let id = ObjectIdentifier(image)
+        if let previous = entries.removeValue(forKey: id) {
+            residentBytes -= previous.bytes
+        }
+    }
+
+    /// The selected image is exempt from eviction until another image is selected.
+    func select(_ image: RAWImage?) {
+        selectedID = image.map(ObjectIdentifier.init)
+        if let image {
+            touch(image)
+        }
+        enforceBudget()
+    }
+
+    // MARK: - Eviction
+
+    private func enforceBudget() {
+        // Evicting clears bitmaps, which re-enters `update`; only the outermost call evicts.
+        guard !isEvicting else { return }
+        pruneReleasedOwners()
+        guard residentBytes > byteBudget else { return }
+
+        isEvicting = true
+        defer { isEvicting = false }
+
+        let candidates = entries
+            .filter { id, entry in
+                guard let owner = entry.owner else { return false }
+                return id != selectedID && !owner.isPinned
+            }
+            .sorted { $0.value.lastAccess < $1.value.lastAccess }
+
+        for (_, entry) in candidates {
+            guard residentBytes > byteBudget else { break }
+            entry.owner?.evictBitmaps()
+        }
+    }
+
+    private func pruneReleasedOwners() {
+        for (id, entry) in entries where entry.owner == nil {
+            residentBytes -= entry.bytes
+            entries[id] = nil
+        }
+    }
+}
+
+extension NSImage {
+    /// Bytes held by the backing bitmap (0 if there is none).
+    var bitmapByteCount: Int {
+        guard let cgImage = cgImage(forProposedRect: nil, context: nil, hints: nil) else { return 0 }
+        return cgImage.bytesPerRow * cgImage.height
+    }
+}
@@ -0,0 +1,686 @@
+//
+//  ImageCatalog.swift
+//  Dirty RAW
+//
+
+import Foundation
+import AppKit
+
+/// Persistent metadata + thumbnail catalog.
+/// - `catalog.bin` stores one contiguous column per field (structure-of-arrays), so sorting or
+///   filtering by any EXIF field walks a single array and never opens an SDK session.
+/// - `thumbs.bin` stores packed JPEG thumbnails addressed by the offset/length columns.
+/// - Rows are keyed by path + file size + modification time and updated incrementally.
+final class ImageCatalog {
+    static let shared = ImageCatalog()
+
+    struct Key: Hashable {
+        let path: String
+        let fileSize: UInt64
+        let modificationTime: Double
+
+        init?(url: URL) {
+            guard let values = try? url.resourceValues(forKeys: [.fileSizeKey, .contentModificationDateKey]),
+                  let size = values.fileSize,
+                  let date = values.contentModificationDate else {
+                return nil
+            }
+            path = url.standardizedFileURL.path
+            fileSize = UInt64(size)
+            modificationTime = date.timeIntervalSince1970
+        }
+    }
+
+    /// Catalog columns. Raw values are persisted, so never renumber existing cases.
+    /// Numeric columns are all Float64 so a single code path sorts/filters any of them.
+    enum Field: UInt32, CaseIterable {
+        case fileSize = 1
+        case modificationTime
+        case dateTime
+        case exposureTime
+        case fNumber
+        case focalLength
+        case iso
+        case exposureBias
+        case meteringMode
+        case exposureProgram
+        case whiteBalance
+        case colorTemperature
+        case flash
+        case fileFormat
+        case pictureControl
+        case activeDLighting
+        case noiseReduction
+        case width
+        case height
+        case byteDepth
+        case colorType
+        case orientation
+        case resolution
+        case thumbnailOffset
+        case thumbnailLength
+        /// Focus score from `SharpnessScoring`; 0 until scored.
+        case sharpness
+        /// Weighting and measurement revision the score was computed with (see
+        /// `SharpnessScoring`), plus one; 0 until scored.
+        case sharpnessWeighting
+
+        case path = 100
+        case make
+        case model
+        case lens
+        case software
+        case artist
+        case copyright
+        case shootingData
+        /// Per-region focus heatmap, encoded by `SharpnessScoring`.
+        case sharpnessMap
+
+        var isString: Bool { rawValue >= 100 }
+    }
+
+    struct Entry {
+        let exif: NKEXIFData
+        let info: NKImageInfo
+        let thumbnail: NSImage?
+    }
+
+    private static let magic: UInt64 = 0x31474C5441435244 // "DRCATLG1"
+    private static let formatVersion: UInt32 = 1
+    private static let shootingDataSeparator: Character = "\u{1F}"
+
+    private let lock = NSLock()
+    private let saveQueue = DispatchQueue(label: "DirtyRAW.ImageCatalog.save", qos: .utility)
+    private var saveScheduled = false
+
+    private var rowCount = 0
+    private var numeric: [Field: [Double]] = [:]
+    private var strings: [Field: [String]] = [:]
+    private var rowForPath: [String: Int] = [:]
+    private var liveThumbnailBytes: UInt64 = 0
+    private var thumbnailHandle: FileHandle?
+
+    private init() {
+        for field in Field.allCases {
+            if field.isString {
+                strings[field] = []
+            } else {
+                numeric[field] = []
+            }
+        }
+        restore()
+    }
+
+    // MARK: - Lookup
+
+    /// Returns cached metadata for `url` if the file is unchanged since it was catalogued.
+    func entry(for url: URL) -> Entry? {
+        guard let key = Key(url: url) else { return nil }
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let row = validRowLocked(for: key) else { return nil }
+        return makeEntryLocked(row: row)
+    }
+
+    /// Records metadata + thumbnail for `url`, replacing any stale row for the same path. A row
+    /// that is still valid is merged into: non-empty fields overwrite it, so the SDK's EXIF
+    /// (colour temperature, lens) fills in a row first written by the native scan, and an existing
+    /// thumbnail is kept.
+    func record(url: URL, exif: NKEXIFData?, info: NKImageInfo?, thumbnail: NSImage?) {
+        guard let key = Key(url: url) else { return }
+
+        lock.lock()
+        let needsThumbnail = validRowLocked(for: key).map { numeric[.thumbnailLength]![$0] == 0 } ?? true
+        lock.unlock()
+
+        let thumbData = needsThumbnail ? thumbnail.flatMap(Self.encodeThumbnail) : nil
+
+        lock.lock()
+        let row: Int
+        let merging: Bool
+        if let existing = rowForPath[key.path] {
+            row = existing
+            merging = validRowLocked(for: key) != nil
+            if !merging {
+                // The file changed, so its focus score no longer applies
+                numeric[.sharpness]![row] = 0
+                numeric[.sharpnessWeighting]![row] = 0
+                strings[.sharpnessMap]![row] = ""
+            }
+        } else {
+            row = rowCount
+            rowCount += 1
+            merging = false
+            for field in Field.allCases {
+                if field.isString {
+                    strings[field]!.append("")
+                } else {
+                    numeric[field]!.append(0)
+                }
+            }
+            rowForPath[key.path] = row
+        }
+
+        var changed = !merging
+        strings[.path]![row] = key.path
+        numeric[.fileSize]![row] = Double(key.fileSize)
+        numeric[.modificationTime]![row] = key.modificationTime
+        changed = writeEXIFLocked(exif, row: row, merging: merging) || changed
+        changed = writeInfoLocked(info, row: row, merging: merging) || changed
+
+        if let thumbData, let offset = appendThumbnailLocked(thumbData) {
+            liveThumbnailBytes -= min(liveThumbnailBytes, UInt64(numeric[.thumbnailLength]![row]))
+            numeric[.thumbnailOffset]![row] = Double(offset)
+            numeric[.thumbnailLength]![row] = Double(thumbData.count)
+            liveThumbnailBytes += UInt64(thumbData.count)
+            changed = true
+        } else if !merging {
+            liveThumbnailBytes -= min(liveThumbnailBytes, UInt64(numeric[.thumbnailLength]![row]))
+            numeric[.thumbnailOffset]![row] = 0
+            numeric[.thumbnailLength]![row] = 0
+        }
+        lock.unlock()
+
+        if changed {
+            scheduleSave()
+        }
+    }
+
+    /// Focus score, the weighting it was computed with, and the encoded heatmap of `url`, if
+    /// scored since the file last changed.
+    func sharpness(for url: URL) -> (score: Double, weighting: Int, heatmap: String)? {
+        guard let key = Key(url: url) else { return nil }
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let row = validRowLocked(for: key), numeric[.sharpnessWeighting]![row] > 0 else { return nil }
+        return (numeric[.sharpness]![row], Int(numeric[.sharpnessWeighting]![row]) - 1, strings[.sharpnessMap]![row])
+    }
+
+    /// Stores a focus score for `url`. Files not catalogued yet are skipped; they can't be
+    /// sorted by catalog columns anyway.
+    func recordSharpness(url: URL, score: Double, weighting: Int, heatmap: String) {
+        guard let key = Key(url: url) else { return }
+
+        lock.lock()
+        guard let row = validRowLocked(for: key) else {
+            lock.unlock()
+            return
+        }
+        numeric[.sharpness]![row] = score
+        numeric[.sharpnessWeighting]![row] = Double(weighting + 1)
+        strings[.sharpnessMap]![row] = heatmap
+        lock.unlock()
+
+        scheduleSave()
+    }
+
+    // MARK: - Queries
+
+    /// Orders `urls` by a catalog column. URLs missing from the catalog keep their relative order at the end.
+    func sort(_ urls: [URL], by field: Field, ascending: Bool = true) -> [URL] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        var known: [(url: URL, row: Int)] = []
+        var unknown: [URL] = []
+        known.reserveCapacity(urls.count)
+        for url in urls {
+            if let row = rowForPath[url.standardizedFileURL.path] {
+                known.append((url, row))
+            } else {
+                unknown.append(url)
+            }
+        }
+
+        if field.isString {
+            let column = strings[field]!
+            known.sort { lhs, rhs in
+                let order = column[lhs.row].localizedStandardCompare(column[rhs.row])
+                return ascending ? order == .orderedAscending : order == .orderedDescending
+            }
+        } else {
+            let column = numeric[field]!
+            known.sort { lhs, rhs in
+                // Missing values (NaN) sort after every present value, in either direction
+                let a = column[lhs.row], b = column[rhs.row]
+                if a.isNaN || b.isNaN {
+                    return !a.isNaN && b.isNaN
+                }
+                return ascending ? a < b : a > b
+            }
+        }
+
+        return known.map { $0.url } + unknown
+    }
+
+    /// All catalogued paths whose numeric `field` lies within `range`.
+    func paths(where field: Field, in range: ClosedRange<Double>) -> [String] {
+        precondition(!field.isString, "Range filters only apply to numeric columns")
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        let column = numeric[field]!
+        let pathColumn = strings[.path]!
+        var result: [String] = []
+        for row in 0..<rowCount where range.contains(column[row]) {
+            result.append(pathColumn[row])
+        }
+        return result
+    }
+
+    /// Writes pending changes immediately (e.g. on app termination).
+    func flush() {
+        saveQueue.sync {
+            self.saveNow()
+        }
+    }
+
+    // MARK: - Row Encoding
+
+    private func validRowLocked(for key: Key) -> Int? {
+        guard let row = rowForPath[key.path],
+              numeric[.fileSize]![row] == Double(key.fileSize),
+              numeric[.modificationTime]![row] == key.modificationTime else {
+            return nil
+        }
+        return row
+    }
+
+    /// Writes `exif` to `row`; when `merging`, empty strings, zeros and missing values leave the
+    /// row as it is. Returns whether anything changed.
+    private func writeEXIFLocked(_ exif: NKEXIFData?, row: Int, merging: Bool) -> Bool {
+        var changed = false
+        func writeString(_ field: Field, _ value: String?) {
+            let value = value ?? ""
+            guard !(merging && value.isEmpty), strings[field]![row] != value else { return }
+            strings[field]![row] = value
+            changed = true
+        }
+        func writeNumber(_ field: Field, _ value: Double) {
+            guard !(merging && (value == 0 || value.isNaN)) else { return }
+            let current = numeric[field]![row]
+            guard current != value, !(current.isNaN && value.isNaN) else { return }
+            numeric[field]![row] = value
+            changed = true
+        }
+
+        writeString(.make, exif?.make)
+        writeString(.model, exif?.model)
+        writeString(.lens, exif?.lensInfo)
+        writeString(.software, exif?.software)
+        writeString(.artist, exif?.artist)
+        writeString(.copyright, exif?.copyright)
+        writeString(.shootingData, (exif?.shootingData ?? []).joined(separator: String(Self.shootingDataSeparator)))
+
+        writeNumber(.dateTime, exif?.dateTime?.timeIntervalSince1970 ?? .nan)
+        writeNumber(.exposureTime, exif?.exposureTime ?? 0)
+        writeNumber(.fNumber, exif?.fNumber ?? 0)
+        writeNumber(.focalLength, exif?.focalLength ?? 0)
+        writeNumber(.iso, Double(exif?.iso ?? 0))
+        writeNumber(.exposureBias, exif?.exposureBias ?? 0)
+        writeNumber(.meteringMode, Double(exif?.meteringMode ?? 0))
+        writeNumber(.exposureProgram, Double(exif?.exposureProgram ?? 0))
+        writeNumber(.whiteBalance, Double(exif?.whiteBalance ?? 0))
+        writeNumber(.colorTemperature, exif?.colorTemperatureKelvin?.doubleValue ?? .nan)
+        writeNumber(.flash, Double(exif?.flash ?? 0))
+        writeNumber(.fileFormat, Double(exif?.fileFormat ?? 0))
+        writeNumber(.pictureControl, Double(exif?.pictureControl ?? 0))
+        writeNumber(.activeDLighting, Double(exif?.activeDLighting ?? 0))
+        writeNumber(.noiseReduction, Double(exif?.noiseReduction ?? 0))
+        return changed
+    }
+
+    /// Writes `info` to `row`, with the same merging rules as `writeEXIFLocked`.
+    private func writeInfoLocked(_ info: NKImageInfo?, row: Int, merging: Bool) -> Bool {
+        var changed = false
+        func writeNumber(_ field: Field, _ value: Double) {
+            guard !(merging && value == 0), numeric[field]![row] != value else { return }
+            numeric[field]![row] = value
+            changed = true
+        }
+
+        writeNumber(.width, Double(info?.width ?? 0))
+        writeNumber(.height, Double(info?.height ?? 0))
+        writeNumber(.byteDepth, Double(info?.byteDepth ?? 0))
+        writeNumber(.colorType, Double(info?.colorType ?? 0))
+        writeNumber(.orientation, Double(info?.orientation ?? 0))
+        writeNumber(.resolution, info?.resolution ?? 0)
+        return changed
+    }
+
+    private func makeEntryLocked(row: Int) -> Entry {
+        func string(_ field: Field) -> String? {
+            let value = strings[field]![row]
+            return value.isEmpty ? nil : value
+        }
+        func value(_ field: Field) -> Double {
+            numeric[field]![row]
+        }
+        func unsigned(_ field: Field) -> UInt {
+            UInt(max(value(field), 0))
+        }
+
+        let exif = NKEXIFData()
+        exif.make = string(.make)
+        exif.model = string(.model)
+        exif.lensInfo = string(.lens)
+        exif.software = string(.software)
+        exif.artist = string(.artist)
+        exif.copyright = string(.copyright)
+        if let shooting = string(.shootingData) {
+            exif.shootingData = shooting.split(separator: Self.shootingDataSeparator).map(String.init)
+        }
+        if !value(.dateTime).isNaN {
+            exif.dateTime = Date(timeIntervalSince1970: value(.dateTime))
+        }
+        exif.exposureTime = value(.exposureTime)
+        exif.fNumber = value(.fNumber)
+        exif.focalLength = value(.focalLength)
+        exif.iso = unsigned(.iso)
+        exif.exposureBias = value(.exposureBias)
+        exif.meteringMode = unsigned(.meteringMode)
+        exif.exposureProgram = unsigned(.exposureProgram)
+        exif.whiteBalance = unsigned(.whiteBalance)
+        if !value(.colorTemperature).isNaN {
+            exif.colorTemperatureKelvin = NSNumber(value: value(.colorTemperature))
+        }
+        exif.flash = unsigned(.flash)
+        exif.fileFormat = unsigned(.fileFormat)
+        exif.pictureControl = unsigned(.pictureControl)
+        exif.activeDLighting = unsigned(.activeDLighting)
+        exif.noiseReduction = unsigned(.noiseReduction)
+
+        let info = NKImageInfo()
+        info.width = unsigned(.width)
+        info.height = unsigned(.height)
+        info.byteDepth = unsigned(.byteDepth)
+        info.colorType = unsigned(.colorType)
+        info.orientation = unsigned(.orientation)
+        info.resolution = value(.resolution)
+
+        var thumbnail: NSImage?
+        let length = Int(value(.thumbnailLength))
+        if length > 0, let data = readThumbnailLocked(offset: UInt64(value(.thumbnailOffset)), length: length) {
+            thumbnail = NSImage(data: data)
+        }
+
+        return Entry(exif: exif, info: info, thumbnail: thumbnail)
+    }
+
+    // MARK: - Thumbnail Blob
+
+    private static func encodeThumbnail(_ image: NSImage) -> Data? {
+        guard let tiff = image.tiffRepresentation,
+              let rep = NSBitmapImageRep(data: tiff) else {
+            return nil
+        }
+        return rep.representation(using: .jpeg, properties: [.compressionFactor: 0.8])
+    }
+
+    private func openThumbnailHandleLocked() -> FileHandle? {
+        if let thumbnailHandle { return thumbnailHandle }
+        guard let url = try? catalogDirectory().appendingPathComponent("thumbs.bin") else { return nil }
+        if !FileManager.default.fileExists(atPath: url.path) {
+            FileManager.default.createFile(atPath: url.path, contents: nil)
+        }
+        thumbnailHandle = try? FileHandle(forUpdating: url)
+        return thumbnailHandle
+    }
+
+    private func appendThumbnailLocked(_ data: Data) -> UInt64? {
+        guard let handle = openThumbnailHandleLocked(),
+              let offset = try? handle.seekToEnd() else {
+            return nil
+        }
+        do {
+            try handle.write(contentsOf: data)
+        } catch {
+            return nil
+        }
+        return offset
+    }
+
+    private func readThumbnailLocked(offset: UInt64, length: Int) -> Data? {
+        guard let handle = openThumbnailHandleLocked() else { return nil }
+        do {
+            try handle.seek(toOffset: offset)
+            return try handle.read(upToCount: length)
+        } catch {
+            return nil
+        }
+    }
+
+    /// Rewrites `thumbs.bin` with only the live thumbnails once more than half of it is garbage.
+    private func compactThumbnailsLocked() {
+        guard let handle = openThumbnailHandleLocked(),
+              let fileSize = try? handle.seekToEnd(),
+              fileSize > 8 << 20,
+              liveThumbnailBytes < fileSize / 2,
+              let directory = try? catalogDirectory() else {
+            return
+        }
+
+        let tempURL = directory.appendingPathComponent("thumbs.bin.tmp")
+        FileManager.default.createFile(atPath: tempURL.path, contents: nil)
+        guard let output = try? FileHandle(forWritingTo: tempURL) else { return }
+
+        var newOffsets = numeric[.thumbnailOffset]!
+        var written: UInt64 = 0
+        for row in 0..<rowCount {
+            let length = Int(numeric[.thumbnailLength]![row])
+            guard length > 0,
+                  let data = readThumbnailLocked(offset: UInt64(numeric[.thumbnailOffset]![row]), length: length) else {
+                continue
+            }
+            try? output.write(contentsOf: data)
+            newOffsets[row] = Double(written)
+            written += UInt64(data.count)
+        }
+        try? output.close()
+        try? handle.close()
+        thumbnailHandle = nil
+
+        let url = directory.appendingPathComponent("thumbs.bin")
+        if (try? FileManager.default.replaceItemAt(url, withItemAt: tempURL)) != nil {
+            numeric[.thumbnailOffset] = newOffsets
+            liveThumbnailBytes = written
+        }
+    }
+
+    // MARK: - Persistence
+
+    private func scheduleSave() {
+        lock.lock()
+        let alreadyScheduled = saveScheduled
+        saveScheduled = true
+        lock.unlock()
+        guard !alreadyScheduled else { return }
+
+        saveQueue.asyncAfter(deadline: .now() + 1.0) { [weak self] in
+            self?.saveNow()
+        }
+    }
+
+    /// File layout (little-endian):
+    ///   header:    magic u64, version u32, rowCount u32, columnCount u32, reserved u32
+    ///   directory: columnCount × (field u32, reserved u32, offset u64, length u64)
+    ///   payloads:  8-byte aligned; numeric = rowCount × f64,
+    ///              string = (rowCount + 1) × u32 byte offsets followed by the UTF-8 heap
+    private func saveNow() {
+        lock.lock()
+        saveScheduled = false
+        compactThumbnailsLocked()
+
+        let fields = Field.allCases
+        var payloads: [Data] = []
+        payloads.reserveCapacity(fields.count)
+        for field in fields {
+            var payload = Data()
+            if field.isString {
+                var heap = Data()
+                var offsets: [UInt32] = [0]
+                offsets.reserveCapacity(rowCount + 1)
+                for value in strings[field]! {
+                    heap.append(contentsOf: Array(value.utf8))
+                    offsets.append(UInt32(heap.count))
+                }
+                offsets.withUnsafeBytes { payload.append(contentsOf: $0) }
+                payload.append(heap)
+            } else {
+                numeric[field]!.withUnsafeBytes { payload.append(contentsOf: $0) }
+            }
+            payloads.append(payload)
+        }
+        let rows = rowCount
+        lock.unlock()
+
+        var data = Data()
+        data.appendLittleEndian(Self.magic)
+        data.appendLittleEndian(Self.formatVersion)
+        data.appendLittleEndian(UInt32(rows))
+        data.appendLittleEndian(UInt32(fields.count))
+        data.appendLittleEndian(UInt32(0))
+
+        let headerSize = 24 + fields.count * 24
+        var offset = UInt64(Self.aligned(headerSize))
+        for (field, payload) in zip(fields, payloads) {
+            data.appendLittleEndian(field.rawValue)
+            data.appendLittleEndian(UInt32(0))
+            data.appendLittleEndian(offset)
+            data.appendLittleEndian(UInt64(payload.count))
+            offset += UInt64(Self.aligned(payload.count))
+        }
+        for payload in payloads {
+            data.append(Data(count: Self.aligned(data.count) - data.count))
+            data.append(payload)
+        }
+
+        do {
+            let url = try catalogDirectory().appendingPathComponent("catalog.bin")
+            try data.write(to: url, options: .atomic)
+        } catch {
+            print("ImageCatalog: Failed to save catalog: \(error.localizedDescription)")
+        }
+    }
+
+    private func restore() {
+        guard let url = try? catalogDirectory().appendingPathComponent("catalog.bin"),
+              let data = try? Data(contentsOf: url, options: .alwaysMapped) else {
+            return
+        }
+
+        // A truncated or corrupt file is dropped as a whole; the next save replaces it
+        guard let restored = data.withUnsafeBytes(Self.parseCatalog) else {
+            print("ImageCatalog: Discarding unreadable catalog")
+            return
+        }
+        numeric = restored.numeric
+        strings = restored.strings
+        rowCount = restored.rows
+
+        let paths = strings[.path]!
+        for (row, path) in paths.enumerated() where !path.isEmpty {
+            rowForPath[path] = row
+        }
+        liveThumbnailBytes = numeric[.thumbnailLength]!.reduce(0) { $0 + UInt64($1) }
+    }
+
+    /// Reads `catalog.bin`, or returns nil if any part of it is out of bounds or holds values
+    /// the catalog never writes. Columns added by newer versions stay zero-filled for old rows.
+    private static func parseCatalog(_ raw: UnsafeRawBufferPointer) -> (rows: Int, numeric: [Field: [Double]], strings: [Field: [String]])? {
+        guard raw.count >= 24,
+              raw.loadUnaligned(fromByteOffset: 0, as: UInt64.self) == magic,
+              raw.loadUnaligned(fromByteOffset: 8, as: UInt32.self) == formatVersion else {
+            return nil
+        }
+        let rows = Int(raw.loadUnaligned(fromByteOffset: 12, as: UInt32.self))
+        let columnCount = Int(raw.loadUnaligned(fromByteOffset: 16, as: UInt32.self))
+        guard columnCount <= (raw.count - 24) / 24 else { return nil }
+
+        var numeric: [Field: [Double]] = [:]
+        var strings: [Field: [String]] = [:]
+
+        for column in 0..<columnCount {
+            let entry = 24 + column * 24
+            let fieldID = raw.loadUnaligned(fromByteOffset: entry, as: UInt32.self)
+            guard let offset = Int(exactly: raw.loadUnaligned(fromByteOffset: entry + 8, as: UInt64.self)),
+                  let length = Int(exactly: raw.loadUnaligned(fromByteOffset: entry + 16, as: UInt64.self)),
+                  offset <= raw.count, length <= raw.count - offset else {
+                return nil
+            }
+            guard let field = Field(rawValue: fieldID) else { continue }
+            let payload = UnsafeRawBufferPointer(rebasing: raw[offset..<(offset + length)])
+
+            if field.isString {
+                let tableSize = (rows + 1) * 4
+                guard length >= tableSize else { return nil }
+                var values: [String] = []
+                values.reserveCapacity(rows)
+                for row in 0..<rows {
+                    let start = tableSize + Int(payload.loadUnaligned(fromByteOffset: row * 4, as: UInt32.self))
+                    let end = tableSize + Int(payload.loadUnaligned(fromByteOffset: (row + 1) * 4, as: UInt32.self))
+                    guard start <= end, end <= length else { return nil }
+                    values.append(String(decoding: UnsafeRawBufferPointer(rebasing: payload[start..<end]), as: UTF8.self))
+                }
+                strings[field] = values
+            } else {
+                guard length == rows * 8 else { return nil }
+                let values = (0..<rows).map { payload.loadUnaligned(fromByteOffset: $0 * 8, as: Double.self) }
+                guard values.allSatisfy({ isValid($0, for: field) }) else { return nil }
+                numeric[field] = values
+            }
+        }
+
+        for field in Field.allCases {
+            if field.isString {
+                strings[field] = strings[field] ?? Array(repeating: "", count: rows)
+            } else {
+                numeric[field] = numeric[field] ?? Array(repeating: 0, count: rows)
+            }
+        }
+        return (rows, numeric, strings)
+    }
+
+    /// Whether `value` is one `record` could have written to `field`: finite, except for the
+    /// optional date and colour temperature (NaN when missing), and a byte count or offset
+    /// where the column is converted to an integer.
+    private static func isValid(_ value: Double, for field: Field) -> Bool {
+        switch field {
+        case .dateTime, .colorTemperature:
+            return value.isNaN || value.isFinite
+        case .thumbnailOffset, .thumbnailLength, .sharpnessWeighting:
+            return value >= 0 && value <= Double(1 << 53) && value.rounded() == value
+        default:
+            // Unsigned EXIF fields are read back through `UInt(_:)`
+            return value.isFinite && abs(value) <= Double(1 << 53)
+        }
+    }
+
+    private func catalogDirectory() throws -> URL {
+        let appSupport = try FileManager.default.url(
+            for: .applicationSupportDirectory,
+            in: .userDomainMask,
+            appropriateFor: nil,
+            create: true
+        )
+        let directory = appSupport.appendingPathComponent("DirtyRAW", isDirectory: true)
+            .appendingPathComponent("Catalog", isDirectory: true)
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        return directory
+    }
+
+    private static func aligned(_ value: Int) -> Int {
+        (value + 7) & ~7
+    }
+}
+
+private extension Data {
+    mutating func appendLittleEndian<T: FixedWidthInteger>(_ value: T) {
+        withUnsafeBytes(of: value.littleEndian) { append(contentsOf: $0) }
+    }
+}
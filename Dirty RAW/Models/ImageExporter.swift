@@ -0,0 +1,178 @@
+//
+//  ImageExporter.swift
+//  Dirty RAW
+//
+
+import Foundation
+import AppKit
+import Combine
+import UniformTypeIdentifiers
+
+/// Exports edited images with the native streaming encoders (see ExportStream.h): JPEG, 8/16-bit
+/// PNG and Deflate-compressed TIFF, optionally resampled on the way out. The settings here are the
+/// user's export preferences and persist across launches.
+enum ImageExporter {
+
+    enum Format: Int, CaseIterable, Identifiable {
+        case tiff = 0
+        case jpeg = 1
+        case png = 2
+
+        var id: Int { rawValue }
+
+        var displayName: String {
+            switch self {
+            case .tiff: return "TIFF"
+            case .jpeg: return "JPEG"
+            case .png: return "PNG"
+            }
+        }
+
+        var contentType: UTType {
+            switch self {
+            case .tiff: return .tiff
+            case .jpeg: return .jpeg
+            case .png: return .png
+            }
+        }
+
+        fileprivate var nativeFormat: NKExportFormat {
+            switch self {
+            case .tiff: return .tiff
+            case .jpeg: return .jpeg
+            case .png: return .png
+            }
+        }
+    }
+
+    enum ExportError: LocalizedError {
+        case noImage
+        case failedToWrite(Format)
+
+        var errorDescription: String? {
+            switch self {
+            case .noImage:
+                return "No image to export"
+            case .failedToWrite(let format):
+                return "Failed to write \(format.displayName) file"
+            }
+        }
+    }
+
+    private static let formatDefaultsKey = "DirtyRAW.ExportFormat"
+    private static let bitDepthDefaultsKey = "DirtyRAW.ExportBitDepth"
+    private static let tiffCompressionDefaultsKey = "DirtyRAW.ExportTIFFCompression"
+    private static let jpegQualityDefaultsKey = "DirtyRAW.ExportJPEGQuality"
+    private static let jpegSubsamplingDefaultsKey = "DirtyRAW.ExportJPEGSubsampling"
+    private static let longEdgeDefaultsKey = "DirtyRAW.ExportLongEdge"
+
+    static var format: Format {
+        get { Format(rawValue: UserDefaults.standard.integer(forKey: formatDefaultsKey)) ?? .tiff }
+        set { UserDefaults.standard.set(newValue.rawValue, forKey: formatDefaultsKey) }
+    }
+
+    /// Bits per channel of TIFF and PNG exports (16, or 8 for web and proof deliverables).
+    /// JPEG is always 8.
+    static var bitDepth: Int {
+        get { UserDefaults.standard.integer(forKey: bitDepthDefaultsKey) == 8 ? 8 : 16 }
+        set { UserDefaults.standard.set(newValue, forKey: bitDepthDefaultsKey) }
+    }
+
+    static var tiffCompression: NKTIFFCompression {
+        get {
+            let stored = UserDefaults.standard.object(forKey: tiffCompressionDefaultsKey) as? Int
+            return stored.flatMap(NKTIFFCompression.init(rawValue:)) ?? .deflate
+        }
+        set { UserDefaults.standard.set(newValue.rawValue, forKey: tiffCompressionDefaultsKey) }
+    }
+
+    static var jpegQuality: Int {
+        get {
+            let stored = UserDefaults.standard.integer(forKey: jpegQualityDefaultsKey)
+            return stored == 0 ? 90 : min(max(stored, 1), 100)
+        }
+        set { UserDefaults.standard.set(newValue, forKey: jpegQualityDefaultsKey) }
+    }
+
+    static var jpegSubsampling: NKChromaSubsampling {
+        get {
+            let stored = UserDefaults.standard.object(forKey: jpegSubsamplingDefaultsKey) as? Int
+            return stored.flatMap(NKChromaSubsampling.init(rawValue:)) ?? .both
+        }
+        set { UserDefaults.standard.set(newValue.rawValue, forKey: jpegSubsamplingDefaultsKey) }
+    }
+
+    /// Longest side of exported images in pixels; larger renders are downscaled on export.
+    /// 0 exports at the rendered size.
+    static var longEdge: Int {
+        get { max(UserDefaults.standard.integer(forKey: longEdgeDefaultsKey), 0) }
+        set { UserDefaults.standard.set(newValue, forKey: longEdgeDefaultsKey) }
+    }
+
+    /// Writes `image` to `url` in the current `format`. `upscaleFactor` > 1 upscales on the way
+    /// out; a `longEdge` limit then caps the result (and downscales larger renders on its own).
+    /// Resampling, dithering and encoding all run on the row stream, so the output frame never
+    /// exists in memory in full. Blocks; call off the main thread.
+    @discardableResult
+    static func export(image: NSImage, to url: URL, upscaleFactor: Double = 1) throws -> NKExportResult {
+        guard let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
+            throw ExportError.noImage
+        }
+
+        let format = Self.format
+        var scale = max(upscaleFactor, 1)
+        let longEdge = Self.longEdge
+        if longEdge > 0 {
+            let longest = Double(max(cgImage.width, cgImage.height))
+            scale = min(scale, Double(longEdge) / longest)
+        }
+
+        let options = NKExportOptions()
+        options.format = format.nativeFormat
+        options.bitsPerComponent = UInt(bitDepth)
+        options.tiffCompression = tiffCompression
+        options.jpegQuality = jpegQuality
+        options.jpegSubsampling = jpegSubsampling
+        options.scale = scale
+
+        guard let result = NKExportStream.write(cgImage, to: url, options: options) else {
+            throw ExportError.failedToWrite(format)
+        }
+        let megapixels = Double(result.width * result.height) / 1_000_000
+        let bytes = Double(result.bytesWritten)
+        let seconds = result.seconds
+        Task { @MainActor in
+            ExportThroughput.shared.record(format: format, megapixels: megapixels, bytes: bytes, seconds: seconds)
+        }
+        return result
+    }
+}
+
+/// Export throughput per format over this session, shown in Settings.
+@MainActor
+final class ExportThroughput: ObservableObject {
+    static let shared = ExportThroughput()
+
+    struct Record {
+        var exports = 0
+        var megapixels: Double = 0
+        var bytes: Double = 0
+        var seconds: TimeInterval = 0
+
+        var megapixelsPerSecond: Double { seconds > 0 ? megapixels / seconds : 0 }
+        var megabytesPerSecond: Double { seconds > 0 ? bytes / 1_048_576 / seconds : 0 }
+    }
+
+    @Published private(set) var records: [ImageExporter.Format: Record] = [:]
+
+    private init() {}
+
+    func record(format: ImageExporter.Format, megapixels: Double, bytes: Double, seconds: TimeInterval) {
+        var record = records[format] ?? Record()
+        record.exports += 1
+        record.megapixels += megapixels
+        record.bytes += bytes
+        record.seconds += seconds
+        records[format] = record
+    }
+}
@@ -6,8 +6,9 @@
 import Foundation
 import CoreImage
 import Metal
-import MetalFX
 import AppKit
+import Accelerate
+import os
 
 struct ImageAdjustments {
     var exposure: Double = 0.0        // -2.0 to 2.0 EV
@@ -41,7 +42,26 @@ struct ImageAdjustments {
     var noiseLevel: Double = 0.02     // 0.0 to 0.1
     var noiseSharpness: Double = 0.4  // 0.0 to 2.0
 
-    // MetalFX Upscaling
+    // Lens Corrections. The profile and shooting settings are read from EXIF when the image is
+    // first opened; the amounts scale each correction.
+    var lensCorrectionEnabled: Bool = false
+    var lensProfileID: String = "none"
+    var lensFocalLength: Double = 0        // mm
+    var lensAperture: Double = 0           // f-number
+    var lensDistortionAmount: Double = 1.0 // 0.0 to 1.0
+    var lensVignettingAmount: Double = 1.0 // 0.0 to 1.0
+    var lensCAAmount: Double = 1.0         // 0.0 to 1.0
+
+    // Local Adjustments, applied in order after the global colour controls
+    var localAdjustments: [LocalAdjustment] = []
+
+    // Film Grain. The seed comes from the file name, so each image keeps its own grain pattern.
+    var grainAmount: Double = 0.0          // 0.0 to 1.0
+    var grainSize: Double = 1.5            // 0.5 to 4.0 source pixels
+    var grainRoughness: Double = 0.5       // 0.0 to 1.0
+    var grainSeed: UInt32 = 0
+
+    // Upscaling (applied when exporting)
     var upscalingEnabled: Bool = false
     var upscaleMode: Int = 0          // 0 = 1.5x, 1 = 2x, 2 = 3x
 
@@ -50,6 +70,9 @@ struct ImageAdjustments {
     var lutID: String = "none"        // "none" | "bundle:<name>" | "import:<uuid>"
     var lutIntensity: Double = 1.0    // 0.0 to 1.0
 
+    // Colour mixer, B&W and split toning; compiled into the LUT stage
+    var colorGrading = ColorGrading()
+
     var upscaleFactor: Double {
         switch upscaleMode {
         case 0: return 1.5
@@ -79,14 +102,51 @@ struct ImageAdjustments {
         toneCurveHighlights == 0.75 &&
         toneCurveWhites == 1.0 &&
         noiseReductionEnabled == false &&
+        lensCorrectionEnabled == false &&
+        lensDistortionAmount == 1.0 &&
+        lensVignettingAmount == 1.0 &&
+        lensCAAmount == 1.0 &&
+        localAdjustments.isEmpty &&
         upscalingEnabled == false &&
         lutEnabled == false &&
         lutID == "none" &&
-        lutIntensity == 1.0
+        lutIntensity == 1.0 &&
+        colorGrading == ColorGrading() &&
+        grainAmount == 0.0 &&
+        grainSize == 1.5 &&
+        grainRoughness == 0.5
     }
 
     mutating func reset() {
+        // The lens, its settings and the grain seed describe the file, not an edit
+        let lens = (lensProfileID, lensFocalLength, lensAperture)
+        let seed = grainSeed
         self = ImageAdjustments()
+        (lensProfileID, lensFocalLength, lensAperture) = lens
+        grainSeed = seed
+    }
+}
+
+extension NKOutputColorSpace {
+    static let allSpaces: [NKOutputColorSpace] = [.sRGB, .displayP3, .adobeRGB, .proPhoto]
+
+    var displayName: String {
+        switch self {
+        case .sRGB: return "sRGB"
+        case .displayP3: return "Display P3"
+        case .adobeRGB: return "Adobe RGB (1998)"
+        case .proPhoto: return "ProPhoto RGB"
+        @unknown default: return "sRGB"
+        }
+    }
+
+    var cgColorSpace: CGColorSpace {
+        switch self {
+        case .displayP3: return CGColorSpace(name: CGColorSpace.displayP3)!
+        case .adobeRGB: return CGColorSpace(name: CGColorSpace.adobeRGB1998)!
+        case .proPhoto: return CGColorSpace(name: CGColorSpace.rommrgb)!
+        default: return CGColorSpace(name: CGColorSpace.sRGB)!
+        }
     }
 }
 
@@ -102,6 +162,47 @@ class ImageProcessor {
         return MetalLUTKernel(device: device)
     }()
 
+    private static let intermediateBudgetDefaultsKey = "DirtyRAW.RenderCacheBudgetMB"
+    private static let intermediatePrecisionDefaultsKey = "DirtyRAW.RenderIntermediatePrecision"
+    private static let outputColorSpaceDefaultsKey = "DirtyRAW.OutputColorSpace"
+
+    private var renderGraph: RenderGraph!
+
+    /// Upper bound for cached stage intermediates (bytes).
+    var intermediateCacheBudget: Int {
+        get { renderGraph.byteBudget }
+        set {
+            renderGraph.byteBudget = newValue
+            UserDefaults.standard.set(newValue >> 20, forKey: Self.intermediateBudgetDefaultsKey)
+        }
+    }
+
+    /// Storage precision of cached stage intermediates.
+    var intermediatePrecision: IntermediatePrecision {
+        get { renderGraph.precision }
+        set {
+            renderGraph.precision = newValue
+            UserDefaults.standard.set(newValue.rawValue, forKey: Self.intermediatePrecisionDefaultsKey)
+        }
+    }
+
+    /// Bytes the Metal device has allocated: cached intermediates and LUT textures, plus what the
+    /// Core Image context keeps for itself (render targets, tile buffers) that nothing reports.
+    var metalAllocatedBytes: Int {
+        device?.currentAllocatedSize ?? 0
+    }
+
+    /// Space exports are encoded in. NEF/NRW files are also developed by the SDK into this space,
+    /// so a wide-gamut export keeps colours outside sRGB; it applies to images decoded afterwards.
+    var outputColorSpace: NKOutputColorSpace {
+        get {
+            NKOutputColorSpace(rawValue: UserDefaults.standard.integer(forKey: Self.outputColorSpaceDefaultsKey)) ?? .sRGB
+        }
+        set {
+            UserDefaults.standard.set(newValue.rawValue, forKey: Self.outputColorSpaceDefaultsKey)
+        }
+    }
+
     private init() {
         // Create Metal device for GPU acceleration
         device = MTLCreateSystemDefaultDevice()
@@ -124,24 +225,32 @@ class ImageProcessor {
             ])
             print("ImageProcessor: Metal not available, using CPU")
         }
-    }
 
-    var isMetalFXAvailable: Bool {
-        guard let device = device else { return false }
-        if #available(macOS 13.0, *) {
-            let descriptor = MTLFXSpatialScalerDescriptor()
-            descriptor.inputWidth = 100
-            descriptor.inputHeight = 100
-            descriptor.outputWidth = 200
-            descriptor.outputHeight = 200
-            descriptor.colorTextureFormat = .rgba16Float
-            descriptor.outputTextureFormat = .rgba16Float
-            return MTLFXSpatialScalerDescriptor.supportsDevice(device)
-        }
-        return false
+        let storedBudgetMB = UserDefaults.standard.integer(forKey: Self.intermediateBudgetDefaultsKey)
+        let storedPrecision = UserDefaults.standard.object(forKey: Self.intermediatePrecisionDefaultsKey) as? Int
+        renderGraph = RenderGraph(
+            stages: makeRenderStages(),
+            byteBudget: storedBudgetMB > 0 ? storedBudgetMB << 20 : 1536 << 20,
+            precision: storedPrecision.flatMap(IntermediatePrecision.init(rawValue:)) ?? .rgba16Float,
+            materialize: { [unowned self] image, precision in
+                self.materialize(image, precision: precision)
+            }
+        )
     }
 
-    func process(image: NSImage, adjustments: ImageAdjustments) -> NSImage? {
+    /// Renders `image` with `adjustments`.
+    /// Pass a stable `sourceKey` (unique per decoded bitmap) to reuse cached stage intermediates
+    /// across calls; `nil` renders from scratch without touching the intermediate cache.
+    /// The result is encoded in `colorSpace` (default sRGB) as part of the same render, so a
+    /// wide-gamut output costs nothing extra. Exports pass `.RGBA16` so 8-bit output can be
+    /// dithered down from full precision rather than truncated by the renderer.
+    func process(
+        image: NSImage,
+        adjustments: ImageAdjustments,
+        sourceKey: AnyHashable? = nil,
+        colorSpace: CGColorSpace? = nil,
+        format: CIFormat = .RGBA8
+    ) -> NSImage? {
         guard let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
             return nil
         }
@@ -149,304 +258,446 @@ class ImageProcessor {
         var ciImage = CIImage(cgImage: cgImage)
 
         // Apply adjustments only if not default (excluding upscaling check)
-        let hasAdjustments = adjustments.exposure != 0.0 ||
-            adjustments.brightness != 0.0 ||
-            adjustments.contrast != 1.0 ||
-            adjustments.saturation != 1.0 ||
-            adjustments.highlights != 1.0 ||
-            adjustments.shadows != 0.0 ||
-            adjustments.temperature != adjustments.referenceTemperature ||
-            adjustments.tint != adjustments.referenceTint ||
-            adjustments.sharpness != 0.0 ||
-            adjustments.vibrance != 0.0 ||
-            adjustments.hue != 0.0 ||
-            adjustments.toneCurveBlacks != 0.0 ||
-            adjustments.toneCurveShadows != 0.25 ||
-            adjustments.toneCurveMids != 0.5 ||
-            adjustments.toneCurveHighlights != 0.75 ||
-            adjustments.toneCurveWhites != 1.0 ||
-            adjustments.noiseReductionEnabled ||
-            (adjustments.lutEnabled && adjustments.lutID != "none" && adjustments.lutIntensity > 0.0001)
-
-        if hasAdjustments {
-            ciImage = applyAdjustments(to: ciImage, adjustments: adjustments)
+        if renderGraph.hasActiveStages(adjustments) {
+            guard let evaluated = renderGraph.evaluate(source: ciImage, sourceKey: sourceKey, adjustments: adjustments) else {
+                return nil
+            }
+            ciImage = evaluated
         }
 
         // Render with Metal context
-        guard let outputCGImage = context.createCGImage(ciImage, from: ciImage.extent) else {
+        let outputColorSpace = colorSpace ?? CGColorSpace(name: CGColorSpace.sRGB)!
+        guard let outputCGImage = context.createCGImage(
+            ciImage,
+            from: ciImage.extent,
+            format: format,
+            colorSpace: outputColorSpace
+        ) else {
             return nil
         }
 
-        var resultImage = NSImage(cgImage: outputCGImage, size: image.size)
+        return NSImage(cgImage: outputCGImage, size: image.size)
+    }
 
-        // Apply MetalFX upscaling if enabled
-        if adjustments.upscalingEnabled {
-            if let upscaled = applyMetalFXUpscaling(to: resultImage, factor: adjustments.upscaleFactor) {
-                resultImage = upscaled
+    /// Renders only `rect` of the adjusted image at `scale`.
+    /// `rect` is in scaled pixel space with a bottom-left origin (Core Image convention), clipped
+    /// to the scaled frame. The region is propagated backwards through the pipeline, so spatial
+    /// stages only read their halo around it and the Metal LUT pass allocates region-sized textures.
+    /// Upscaling is an export-time step and is not applied here.
+    /// Returns nil without finishing the render once `isCancelled` reports true.
+    func renderRegion(
+        source cgImage: CGImage,
+        sourceKey: AnyHashable?,
+        adjustments: ImageAdjustments,
+        scale: CGFloat,
+        rect: CGRect,
+        isCancelled: () -> Bool = { false }
+    ) -> CGImage? {
+        var ciImage = CIImage(cgImage: cgImage)
+        var variant = 0
+        var renderScale: CGFloat = 1
+
+        if scale < 0.999 {
+            let scaledExtent = CGRect(
+                x: 0, y: 0,
+                width: (CGFloat(cgImage.width) * scale).rounded(.up),
+                height: (CGFloat(cgImage.height) * scale).rounded(.up)
+            )
+            ciImage = Self.applyFilter("CILanczosScaleTransform", to: ciImage.clampedToExtent(), [
+                kCIInputScaleKey: scale,
+                kCIInputAspectRatioKey: 1.0,
+            ]).cropped(to: scaledExtent)
+            variant = Int((scale * 10_000).rounded())
+            renderScale = scale
+        }
+
+        let region = rect.intersection(ciImage.extent).integral
+        guard !region.isEmpty else { return nil }
+
+        if renderGraph.hasActiveStages(adjustments) {
+            guard let evaluated = renderGraph.evaluate(
+                source: ciImage,
+                sourceKey: sourceKey,
+                variant: variant,
+                scale: renderScale,
+                adjustments: adjustments,
+                region: region,
+                isCancelled: isCancelled
+            ) else {
+                return nil
             }
+            ciImage = evaluated
         }
 
-        return resultImage
+        return context.createCGImage(ciImage, from: region)
     }
 
-    /// Returns max upscale factors available for given image size (1.5x, 2x, 3x)
-    func availableUpscaleFactors(for imageSize: NSSize) -> (canScale1_5x: Bool, canScale2x: Bool, canScale3x: Bool) {
-        let maxTextureSize = 16384.0
-        let maxFactor = min(maxTextureSize / imageSize.width, maxTextureSize / imageSize.height)
-        return (
-            canScale1_5x: maxFactor >= 1.5,
-            canScale2x: maxFactor >= 2.0,
-            canScale3x: maxFactor >= 3.0
-        )
+    /// Identifies the rendered output for `sourceKey` + `adjustments`, e.g. for tile caching.
+    func renderKey(sourceKey: AnyHashable, adjustments: ImageAdjustments) -> Int {
+        var hasher = Hasher()
+        hasher.combine(renderGraph.outputKey(sourceKey: sourceKey, adjustments: adjustments))
+        hasher.combine(renderGraph.precision.rawValue)
+        return hasher.finalize()
     }
 
-    @available(macOS 13.0, *)
-    private func applyMetalFXUpscaling(to image: NSImage, factor: Double) -> NSImage? {
-        guard let device = device,
-              let commandQueue = commandQueue,
-              let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
-            return nil
-        }
-
-        let inputWidth = cgImage.width
-        let inputHeight = cgImage.height
-        let outputWidth = Int(Double(inputWidth) * factor)
-        let outputHeight = Int(Double(inputHeight) * factor)
-
-        // Create spatial scaler descriptor
-        let descriptor = MTLFXSpatialScalerDescriptor()
-        descriptor.inputWidth = inputWidth
-        descriptor.inputHeight = inputHeight
-        descriptor.outputWidth = outputWidth
-        descriptor.outputHeight = outputHeight
-        descriptor.colorTextureFormat = .rgba16Float
-        descriptor.outputTextureFormat = .rgba16Float
-        descriptor.colorProcessingMode = .perceptual
-
-        guard let scaler = descriptor.makeSpatialScaler(device: device) else {
-            print("MetalFX: Failed to create spatial scaler")
-            return nil
-        }
+    /// Launch-independent identity of the render for `adjustments`, for `RenderCache`. Edits
+    /// that render the same way (e.g. a parameter of a disabled stage) share it.
+    func canonicalRenderKey(adjustments: ImageAdjustments) -> String {
+        "\(renderGraph.precision.rawValue)|\(renderGraph.canonicalKey(adjustments: adjustments))"
+    }
 
-        // Create input texture
-        let inputDescriptor = MTLTextureDescriptor.texture2DDescriptor(
-            pixelFormat: .rgba16Float,
-            width: inputWidth,
-            height: inputHeight,
-            mipmapped: false
-        )
-        inputDescriptor.usage = [.shaderRead, .shaderWrite, .renderTarget]
-        inputDescriptor.storageMode = .private
+    /// Drops cached stage intermediates for a source bitmap that is being released.
+    func releaseIntermediates(for sourceKey: AnyHashable) {
+        renderGraph.purge(sourceKey: sourceKey)
+    }
 
-        guard let inputTexture = device.makeTexture(descriptor: inputDescriptor) else {
-            return nil
+    /// Loads LUTs into GPU residency in the background so picking one renders without a parse
+    /// and upload stall. Stops once the residency budget is full rather than evicting.
+    func prewarmLUTs(ids: [String]) {
+        guard let kernel = metalLUTKernel else { return }
+        Task.detached(priority: .utility) {
+            for id in ids where id != "none" {
+                if LUTResidency.shared.contains(textureFor: id) { continue }
+                // A 65³ half-float cube is about 2.2 MB
+                guard LUTResidency.shared.residentBytes + (65 * 65 * 65 * 8) <= LUTResidency.shared.byteBudget else { break }
+                _ = kernel.lutTexture(id: id)
+            }
         }
+    }
 
-        // Create output texture
-        let outputDescriptor = MTLTextureDescriptor.texture2DDescriptor(
-            pixelFormat: .rgba16Float,
-            width: outputWidth,
-            height: outputHeight,
-            mipmapped: false
-        )
-        outputDescriptor.usage = [.shaderRead, .shaderWrite, .renderTarget]
-        outputDescriptor.storageMode = .private
-
-        guard let outputTexture = device.makeTexture(descriptor: outputDescriptor) else {
-            return nil
-        }
+    // MARK: - Render Graph
+
+    /// Pipeline stages in application order. Lens corrections, spatial filters (highlights/shadows,
+    /// sharpening, noise reduction) and the Metal LUT pass are checkpoints; the colour stages
+    /// between them stay lazy so Core Image fuses them into a single kernel. Grain comes last and
+    /// stays lazy too, so grain edits resume from the LUT checkpoint.
+    private func makeRenderStages() -> [RenderStage] {
+        [
+            RenderStage(
+                name: "lensCorrection",
+                isCheckpoint: true,
+                isActive: { $0.lensCorrectionEnabled && $0.lensProfileID != "none" },
+                parameters: {
+                    // The resolved coefficients as well as the inputs: a profile re-imported under
+                    // the same ID must not resume from checkpoints made with the old one.
+                    let model = LensProfileStore.shared.model(for: $0)
+                    let coefficients = model.map { [$0.k1, $0.k2, $0.k3, $0.v1, $0.v2, $0.v3, $0.caRed, $0.caBlue] } ?? []
+                    return [
+                        AnyHashable($0.lensProfileID), AnyHashable($0.lensFocalLength), AnyHashable($0.lensAperture),
+                        AnyHashable($0.lensDistortionAmount), AnyHashable($0.lensVignettingAmount), AnyHashable($0.lensCAAmount),
+                        AnyHashable(coefficients),
+                    ]
+                },
+                apply: { image, adjustments, frame in
+                    // Optics act first: the remap table is built once per lens setting and render
+                    // size and shared by every frame that uses it.
+                    guard let model = LensProfileStore.shared.model(for: adjustments) else { return image }
+                    return NKLensCorrectionKernel.apply(to: image, frame: frame.extent, model: model)
+                },
+                halo: { adjustments, frame in
+                    guard let model = LensProfileStore.shared.model(for: adjustments) else { return 0 }
+                    return NKLensCorrectionKernel.halo(model: model, frameSize: frame.extent.size)
+                }
+            ),
+            RenderStage(
+                name: "exposure",
+                isCheckpoint: false,
+                isActive: { $0.exposure != 0.0 },
+                parameters: { $0.exposure },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CIExposureAdjust", to: image, [
+                        kCIInputEVKey: adjustments.exposure,
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "highlightShadow",
+                isCheckpoint: true,
+                isActive: { $0.highlights != 1.0 || $0.shadows != 0.0 },
+                parameters: { [$0.highlights, $0.shadows] },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CIHighlightShadowAdjust", to: image, [
+                        "inputHighlightAmount": adjustments.highlights,
+                        "inputShadowAmount": adjustments.shadows,
+                    ])
+                },
+                // Local tone mapping blurs a luminance mask with a wide radius
+                halo: { _, _ in 64 }
+            ),
+            RenderStage(
+                name: "whiteBalance",
+                isCheckpoint: false,
+                isActive: { $0.temperature != $0.referenceTemperature || $0.tint != $0.referenceTint },
+                parameters: { [$0.referenceTemperature, $0.referenceTint, $0.temperature, $0.tint] },
+                apply: { image, adjustments, _ in
+                    // Map from reference (decoded image) white point to user-selected target white point.
+                    Self.applyFilter("CITemperatureAndTint", to: image, [
+                        "inputNeutral": CIVector(x: adjustments.referenceTemperature, y: adjustments.referenceTint),
+                        "inputTargetNeutral": CIVector(x: adjustments.temperature, y: adjustments.tint),
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "vibrance",
+                isCheckpoint: false,
+                isActive: { $0.vibrance != 0.0 },
+                parameters: { $0.vibrance },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CIVibrance", to: image, [
+                        "inputAmount": adjustments.vibrance,
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "hue",
+                isCheckpoint: false,
+                isActive: { $0.hue != 0.0 },
+                parameters: { $0.hue },
+                apply: { image, adjustments, _ in
+                    // Convert degrees to radians
+                    Self.applyFilter("CIHueAdjust", to: image, [
+                        kCIInputAngleKey: adjustments.hue * .pi / 180.0,
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "toneCurve",
+                isCheckpoint: false,
+                isActive: {
+                    $0.toneCurveBlacks != 0.0 ||
+                    $0.toneCurveShadows != 0.25 ||
+                    $0.toneCurveMids != 0.5 ||
+                    $0.toneCurveHighlights != 0.75 ||
+                    $0.toneCurveWhites != 1.0
+                },
+                parameters: { [$0.toneCurveBlacks, $0.toneCurveShadows, $0.toneCurveMids, $0.toneCurveHighlights, $0.toneCurveWhites] },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CIToneCurve", to: image, [
+                        "inputPoint0": CIVector(x: 0.0, y: CGFloat(adjustments.toneCurveBlacks)),
+                        "inputPoint1": CIVector(x: 0.25, y: CGFloat(adjustments.toneCurveShadows)),
+                        "inputPoint2": CIVector(x: 0.5, y: CGFloat(adjustments.toneCurveMids)),
+                        "inputPoint3": CIVector(x: 0.75, y: CGFloat(adjustments.toneCurveHighlights)),
+                        "inputPoint4": CIVector(x: 1.0, y: CGFloat(adjustments.toneCurveWhites)),
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "colorControls",
+                isCheckpoint: false,
+                isActive: { $0.brightness != 0.0 || $0.contrast != 1.0 || $0.saturation != 1.0 },
+                parameters: { [$0.brightness, $0.contrast, $0.saturation] },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CIColorControls", to: image, [
+                        kCIInputBrightnessKey: adjustments.brightness,
+                        kCIInputContrastKey: adjustments.contrast,
+                        kCIInputSaturationKey: adjustments.saturation,
+                    ])
+                }
+            ),
+            RenderStage(
+                name: "localAdjustments",
+                isCheckpoint: false,
+                isActive: { $0.localAdjustments.contains { !$0.isNeutral } },
+                parameters: { $0.localAdjustments.filter { !$0.isNeutral } },
+                apply: { image, adjustments, frame in
+                    // Each mask only costs its own bounds: the kernel passes everything outside
+                    // them straight through and skips empty tiles inside them.
+                    adjustments.localAdjustments.filter { !$0.isNeutral }.reduce(image) { image, local in
+                        NKLocalAdjustmentKernel.blend(
+                            Self.applyLocalCorrections(local, to: image),
+                            over: image,
+                            mask: local.maskData,
+                            frame: frame.extent
+                        )
+                    }
+                }
+            ),
+            RenderStage(
+                name: "sharpen",
+                isCheckpoint: true,
+                isActive: { $0.sharpness > 0.0 },
+                parameters: { $0.sharpness },
+                apply: { image, adjustments, _ in
+                    Self.applyFilter("CISharpenLuminance", to: image, [
+                        kCIInputSharpnessKey: adjustments.sharpness,
+                    ])
+                },
+                halo: { _, _ in 4 }
+            ),
+            RenderStage(
+                name: "noiseReduction",
+                isCheckpoint: true,
+                isActive: { $0.noiseReductionEnabled && $0.noiseLevel > 0 },
+                parameters: { [$0.noiseLevel, $0.noiseSharpness] },
+                apply: { image, adjustments, _ in
+                    // noiseLevel sets the luma strength, chroma gets three times as much since
+                    // colour noise is blotchier and the eye tolerates smoothing it; noiseSharpness
+                    // (0...2) restores up to half of the luma detail the filter removed.
+                    NKDenoiseKernel.apply(
+                        to: image,
+                        lumaStrength: Float(adjustments.noiseLevel),
+                        chromaStrength: Float(adjustments.noiseLevel * 3),
+                        lumaDetail: Float(min(max(adjustments.noiseSharpness, 0), 2) / 4)
+                    )
+                },
+                halo: { _, _ in NKDenoiseKernel.halo }
+            ),
+            RenderStage(
+                name: "lut",
+                isCheckpoint: true,
+                isActive: { Self.isLUTActive($0) || !$0.colorGrading.isNeutral },
+                parameters: { [AnyHashable($0.lutID), AnyHashable($0.lutIntensity), AnyHashable($0.colorGrading)] },
+                apply: { [unowned self] image, adjustments, _ in
+                    self.applyLUT(to: image, adjustments: adjustments)
+                }
+            ),
+            RenderStage(
+                name: "filmGrain",
+                isCheckpoint: false,
+                isActive: { $0.grainAmount > 0.0 },
+                parameters: { [AnyHashable($0.grainAmount), AnyHashable($0.grainSize), AnyHashable($0.grainRoughness), AnyHashable($0.grainSeed)] },
+                apply: { image, adjustments, frame in
+                    // Grain size is set in source pixels; preview levels shrink it with the image
+                    NKFilmGrainKernel.apply(
+                        to: image,
+                        frame: frame.extent,
+                        amount: Float(adjustments.grainAmount),
+                        size: Float(adjustments.grainSize * frame.scale),
+                        roughness: Float(adjustments.grainRoughness),
+                        seed: adjustments.grainSeed
+                    )
+                }
+            ),
+        ]
+    }
 
-        // Convert CGImage to CIImage and render to input texture
-        let ciImage = CIImage(cgImage: cgImage)
-        guard let commandBuffer = commandQueue.makeCommandBuffer() else {
-            return nil
+    /// A local adjustment's corrections on the whole image; the mask limits where they show.
+    private static func applyLocalCorrections(_ local: LocalAdjustment, to image: CIImage) -> CIImage {
+        var image = image
+        if local.exposure != 0 {
+            image = applyFilter("CIExposureAdjust", to: image, [kCIInputEVKey: local.exposure])
         }
-
-        context.render(ciImage, to: inputTexture, commandBuffer: commandBuffer, bounds: ciImage.extent, colorSpace: CGColorSpace(name: CGColorSpace.sRGB)!)
-
-        // Apply MetalFX upscaling
-        scaler.colorTexture = inputTexture
-        scaler.outputTexture = outputTexture
-        scaler.encode(commandBuffer: commandBuffer)
-
-        commandBuffer.commit()
-        commandBuffer.waitUntilCompleted()
-
-        // Read back from output texture
-        let readDescriptor = MTLTextureDescriptor.texture2DDescriptor(
-            pixelFormat: .rgba16Float,
-            width: outputWidth,
-            height: outputHeight,
-            mipmapped: false
-        )
-        readDescriptor.usage = .shaderRead
-        readDescriptor.storageMode = .managed
-
-        guard let readTexture = device.makeTexture(descriptor: readDescriptor),
-              let blitBuffer = commandQueue.makeCommandBuffer(),
-              let blitEncoder = blitBuffer.makeBlitCommandEncoder() else {
-            return nil
+        if local.contrast != 0 || local.saturation != 0 {
+            image = applyFilter("CIColorControls", to: image, [
+                kCIInputContrastKey: 1 + local.contrast,
+                kCIInputSaturationKey: 1 + local.saturation,
+            ])
         }
-
-        blitEncoder.copy(from: outputTexture, to: readTexture)
-        blitEncoder.endEncoding()
-        blitBuffer.commit()
-        blitBuffer.waitUntilCompleted()
-
-        // Convert texture to CGImage
-        let outputCIImage = CIImage(mtlTexture: readTexture, options: [.colorSpace: CGColorSpace(name: CGColorSpace.sRGB)!])
-        guard let outputCIImage = outputCIImage,
-              let outputCGImage = context.createCGImage(outputCIImage, from: outputCIImage.extent) else {
-            return nil
+        if local.warmth != 0 {
+            // Same direction as the white balance slider: a higher target neutral warms
+            image = applyFilter("CITemperatureAndTint", to: image, [
+                "inputNeutral": CIVector(x: 6500, y: 0),
+                "inputTargetNeutral": CIVector(x: 6500 + local.warmth * 2000, y: 0),
+            ])
         }
-
-        return NSImage(cgImage: outputCGImage, size: NSSize(width: outputWidth, height: outputHeight))
+        return image
     }
 
-    private func applyAdjustments(to image: CIImage, adjustments: ImageAdjustments) -> CIImage {
-        var result = image
-
-        // Exposure adjustment
-        if adjustments.exposure != 0.0 {
-            if let filter = CIFilter(name: "CIExposureAdjust") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.exposure, forKey: kCIInputEVKey)
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
-        }
-
-        // Highlights and Shadows
-        if adjustments.highlights != 1.0 || adjustments.shadows != 0.0 {
-            if let filter = CIFilter(name: "CIHighlightShadowAdjust") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.highlights, forKey: "inputHighlightAmount")
-                filter.setValue(adjustments.shadows, forKey: "inputShadowAmount")
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
+    private static func applyFilter(_ name: String, to image: CIImage, _ parameters: [String: Any]) -> CIImage {
+        guard let filter = CIFilter(name: name) else { return image }
+        filter.setValue(image, forKey: kCIInputImageKey)
+        for (key, value) in parameters {
+            filter.setValue(value, forKey: key)
         }
+        return filter.outputImage ?? image
+    }
 
-        // Temperature and Tint (White Balance)
-        if adjustments.temperature != adjustments.referenceTemperature || adjustments.tint != adjustments.referenceTint {
-            if let filter = CIFilter(name: "CITemperatureAndTint") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                // Map from reference (decoded image) white point to user-selected target white point.
-                let neutral = CIVector(x: adjustments.referenceTemperature, y: adjustments.referenceTint)
-                let targetNeutral = CIVector(x: adjustments.temperature, y: adjustments.tint)
-                filter.setValue(neutral, forKey: "inputNeutral")
-                filter.setValue(targetNeutral, forKey: "inputTargetNeutral")
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
-        }
+    /// Renders a checkpoint into GPU memory (or a CPU bitmap without Metal) at the configured precision.
+    private func materialize(_ image: CIImage, precision: IntermediatePrecision) -> CIImage? {
+        let extent = image.extent.integral
+        let width = max(Int(extent.width), 1)
+        let height = max(Int(extent.height), 1)
+        let colorSpace = precision.colorSpace
+
+        if let device, let commandQueue {
+            let desc = MTLTextureDescriptor.texture2DDescriptor(
+                pixelFormat: precision.pixelFormat,
+                width: width,
+                height: height,
+                mipmapped: false
+            )
+            desc.usage = [.shaderRead, .shaderWrite]
+            desc.storageMode = .private
 
-        // Vibrance
-        if adjustments.vibrance != 0.0 {
-            if let filter = CIFilter(name: "CIVibrance") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.vibrance, forKey: "inputAmount")
-                if let output = filter.outputImage {
-                    result = output
-                }
+            guard let texture = device.makeTexture(descriptor: desc),
+                  let commandBuffer = commandQueue.makeCommandBuffer() else {
+                return nil
             }
-        }
+            context.render(image, to: texture, commandBuffer: commandBuffer, bounds: extent, colorSpace: colorSpace)
+            commandBuffer.commit()
+            commandBuffer.waitUntilCompleted()
 
-        // Hue
-        if adjustments.hue != 0.0 {
-            if let filter = CIFilter(name: "CIHueAdjust") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                // Convert degrees to radians
-                let radians = adjustments.hue * .pi / 180.0
-                filter.setValue(radians, forKey: kCIInputAngleKey)
-                if let output = filter.outputImage {
-                    result = output
-                }
+            guard let output = CIImage(mtlTexture: texture, options: [.colorSpace: colorSpace]) else {
+                return nil
             }
+            return output.transformed(by: CGAffineTransform(translationX: extent.origin.x, y: extent.origin.y))
         }
 
-        // Tone Curve
-        let hasToneCurveChanges = adjustments.toneCurveBlacks != 0.0 ||
-            adjustments.toneCurveShadows != 0.25 ||
-            adjustments.toneCurveMids != 0.5 ||
-            adjustments.toneCurveHighlights != 0.75 ||
-            adjustments.toneCurveWhites != 1.0
-
-        if hasToneCurveChanges {
-            if let filter = CIFilter(name: "CIToneCurve") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(CIVector(x: 0.0, y: CGFloat(adjustments.toneCurveBlacks)), forKey: "inputPoint0")
-                filter.setValue(CIVector(x: 0.25, y: CGFloat(adjustments.toneCurveShadows)), forKey: "inputPoint1")
-                filter.setValue(CIVector(x: 0.5, y: CGFloat(adjustments.toneCurveMids)), forKey: "inputPoint2")
-                filter.setValue(CIVector(x: 0.75, y: CGFloat(adjustments.toneCurveHighlights)), forKey: "inputPoint3")
-                filter.setValue(CIVector(x: 1.0, y: CGFloat(adjustments.toneCurveWhites)), forKey: "inputPoint4")
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
+        guard let cgImage = context.createCGImage(image, from: extent, format: precision.ciFormat, colorSpace: colorSpace) else {
+            return nil
         }
+        return CIImage(cgImage: cgImage).transformed(by: CGAffineTransform(translationX: extent.origin.x, y: extent.origin.y))
+    }
 
-        // Color Controls (brightness, contrast, saturation)
-        if adjustments.brightness != 0.0 || adjustments.contrast != 1.0 || adjustments.saturation != 1.0 {
-            if let filter = CIFilter(name: "CIColorControls") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.brightness, forKey: kCIInputBrightnessKey)
-                filter.setValue(adjustments.contrast, forKey: kCIInputContrastKey)
-                filter.setValue(adjustments.saturation, forKey: kCIInputSaturationKey)
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
-        }
+    private static func isLUTActive(_ adjustments: ImageAdjustments) -> Bool {
+        adjustments.lutEnabled && adjustments.lutID != "none" && adjustments.lutIntensity > 0.0001
+    }
 
-        // Sharpness
-        if adjustments.sharpness > 0.0 {
-            if let filter = CIFilter(name: "CISharpenLuminance") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.sharpness, forKey: kCIInputSharpnessKey)
-                if let output = filter.outputImage {
-                    result = output
-                }
-            }
-        }
+    private func applyLUT(to image: CIImage, adjustments: ImageAdjustments) -> CIImage {
+        var result = image
 
-        // Noise Reduction
-        if adjustments.noiseReductionEnabled {
-            if let filter = CIFilter(name: "CINoiseReduction") {
-                filter.setValue(result, forKey: kCIInputImageKey)
-                filter.setValue(adjustments.noiseLevel, forKey: "inputNoiseLevel")
-                filter.setValue(adjustments.noiseSharpness, forKey: "inputSharpness")
-                if let output = filter.outputImage {
-                    result = output
-                }
+        // LUT (apply at the end of the color pipeline). Grading is baked into a combined cube
+        // with the user LUT and its intensity, keyed by every parameter that goes into it.
+        let lutID: String
+        let intensity: Double
+        var load: (() -> LUT3D?)?
+        // Values outside the cube's [0,1] domain skip the lookup. A plain LUT passes them on per
+        // channel; a graded cube would let them bypass the grade (colour back in B&W highlights,
+        // mixer and toning missing), so only their luminance is carried through it.
+        let neutralExcess = !adjustments.colorGrading.isNeutral
+        if adjustments.colorGrading.isNeutral {
+            lutID = adjustments.lutID
+            intensity = min(max(adjustments.lutIntensity, 0.0), 1.0)
+        } else {
+            let grading = adjustments.colorGrading
+            let baseID = Self.isLUTActive(adjustments) ? adjustments.lutID : nil
+            let baseIntensity = Float(min(max(adjustments.lutIntensity, 0.0), 1.0))
+            var hasher = Hasher()
+            hasher.combine(grading)
+            hasher.combine(baseID)
+            hasher.combine(baseIntensity)
+            lutID = "graded:\(hasher.finalize())"
+            intensity = 1
+            load = { [id = lutID] in
+                Self.makeGradedLUT(id: id, grading: grading, base: baseID.flatMap { LUTStore.shared.loadLUT(id: $0) }, baseIntensity: baseIntensity)
             }
         }
 
-        // LUT (apply at the end of the color pipeline)
-        if adjustments.lutEnabled,
-           adjustments.lutID != "none",
-           adjustments.lutIntensity > 0.0001,
-           let lut = LUTStore.shared.resolveLUT(id: adjustments.lutID) {
-            let intensity = min(max(adjustments.lutIntensity, 0.0), 1.0)
-
-            // Prefer Metal compute path (supports 65³ and is GPU accelerated).
-            if let metalOut = applyLUTWithMetal(to: result, lut: lut, intensity: Float(intensity)) {
+        if intensity > 0.0001 {
+            // Prefer Metal compute path (supports 65³ and is GPU accelerated). Only the texture
+            // stays resident; the parsed cube is not kept alongside it.
+            if let metalOut = applyLUTWithMetal(to: result, lutID: lutID, intensity: Float(intensity), neutralExcess: neutralExcess, load: load) {
                 result = metalOut
-            } else {
+            } else if let lut = load.map({ LUTResidency.shared.lut(id: lutID, load: $0) }) ?? LUTStore.shared.resolveLUT(id: lutID) {
                 // Fallback: Core Image color cube
                 if let cubeFilter = CIFilter(name: "CIColorCubeWithColorSpace") ?? CIFilter(name: "CIColorCube") {
                     cubeFilter.setValue(result, forKey: kCIInputImageKey)
                     cubeFilter.setValue(lut.dimension, forKey: "inputCubeDimension")
-                    cubeFilter.setValue(lut.cubeData, forKey: "inputCubeData")
+                    cubeFilter.setValue(lut.floatCubeData(), forKey: "inputCubeData")
 
                     if cubeFilter.inputKeys.contains("inputColorSpace") {
                         cubeFilter.setValue(CGColorSpace(name: CGColorSpace.sRGB), forKey: "inputColorSpace")
                     }
 
-                    if let lutOutput = cubeFilter.outputImage {
+                    if var lutOutput = cubeFilter.outputImage {
+                        // The cube clamps to [0,1]; add back what the input held outside it
+                        let inRange = result.applyingFilter("CIColorClamp")
+                        var excess = result.applyingFilter("CISubtractBlendMode", parameters: [kCIInputBackgroundImageKey: inRange])
+                        if neutralExcess {
+                            let luma = CIVector(x: 0.2126, y: 0.7152, z: 0.0722, w: 0)
+                            excess = excess.applyingFilter("CIColorMatrix", parameters: ["inputRVector": luma, "inputGVector": luma, "inputBVector": luma])
+                        }
+                        lutOutput = excess.applyingFilter("CIAdditionCompositing", parameters: [kCIInputBackgroundImageKey: lutOutput])
                         if intensity >= 0.999 {
                             result = lutOutput
                         } else {
@@ -471,10 +722,29 @@ class ImageProcessor {
         return result
     }
 
-    private func applyLUTWithMetal(to image: CIImage, lut: LUT3D, intensity: Float) -> CIImage? {
+    /// Combined cube for `grading` followed by `base` at `baseIntensity`, sampled at the base
+    /// LUT's resolution (at least 33³).
+    private static func makeGradedLUT(id: String, grading: ColorGrading, base: LUT3D?, baseIntensity: Float) -> LUT3D {
+        let sampler = base.map(LUTSampler.init)
+        let dimension = max(base?.dimension ?? 0, 33)
+        let data = CubeLUTParser.generateCubeData(dimension: dimension) { r, g, b in
+            let graded = grading.apply(r, g, b)
+            guard let sampler else { return graded }
+            let mapped = sampler.sample(graded.0, graded.1, graded.2)
+            return (
+                graded.0 + (mapped.0 - graded.0) * baseIntensity,
+                graded.1 + (mapped.1 - graded.1) * baseIntensity,
+                graded.2 + (mapped.2 - graded.2) * baseIntensity
+            )
+        }
+        return LUT3D(id: id, displayName: "Color Grading", dimension: dimension, cubeData: data)
+    }
+
+    private func applyLUTWithMetal(to image: CIImage, lutID: String, intensity: Float, neutralExcess: Bool, load: (() -> LUT3D?)? = nil) -> CIImage? {
         guard let device,
               let commandQueue,
               let kernel = metalLUTKernel,
+              let lutTexture = kernel.lutTexture(id: lutID, load: load),
               let commandBuffer = commandQueue.makeCommandBuffer() else {
             return nil
         }
@@ -507,20 +777,17 @@ class ImageProcessor {
             return nil
         }
 
-        // Render CIImage -> inputTexture
+        // Render CIImage -> inputTexture in the working space, so Core Image does no colour
+        // conversion here; the kernel applies the sRGB curve the LUT expects itself.
+        let workingSpace = CGColorSpace(name: CGColorSpace.extendedLinearSRGB)!
         context.render(
             image,
             to: inputTexture,
             commandBuffer: commandBuffer,
             bounds: extent,
-            colorSpace: CGColorSpace(name: CGColorSpace.sRGB)!
+            colorSpace: workingSpace
         )
 
-        // LUT 3D texture
-        guard let lutTexture = kernel.makeLUTTexture(cacheKey: lut.id, dimension: lut.dimension, cubeData: lut.cubeData) else {
-            return nil
-        }
-
         // Encode compute
         if let encoder = commandBuffer.makeComputeCommandEncoder() {
             kernel.encode(
@@ -528,8 +795,9 @@ class ImageProcessor {
                 input: inputTexture,
                 output: outputTexture,
                 lut: lutTexture,
-                lutDimension: UInt32(lut.dimension),
-                intensity: intensity
+                lutDimension: UInt32(lutTexture.width),
+                intensity: intensity,
+                neutralExcess: neutralExcess
             )
             encoder.endEncoding()
         } else {
@@ -540,10 +808,13 @@ class ImageProcessor {
         commandBuffer.waitUntilCompleted()
 
         // Wrap output texture back into CIImage
-        guard let outCI = CIImage(mtlTexture: outputTexture, options: [.colorSpace: CGColorSpace(name: CGColorSpace.sRGB)!]) else {
+        guard let outCI = CIImage(mtlTexture: outputTexture, options: [.colorSpace: workingSpace]) else {
             return nil
         }
-        return outCI.cropped(to: extent)
+        // Textures are sized to the requested region; move the result back to its origin
+        return outCI
+            .transformed(by: CGAffineTransform(translationX: extent.origin.x, y: extent.origin.y))
+            .cropped(to: extent)
     }
 
     // Process with completion for async updates
@@ -563,8 +834,6 @@ private final class MetalLUTKernel {
     private let device: MTLDevice
     private let pipeline: MTLComputePipelineState
     private let sampler: MTLSamplerState
-    private var lutCache: [String: MTLTexture] = [:]
-    private let lock = NSLock()
 
     init?(device: MTLDevice) {
         self.device = device
@@ -576,8 +845,22 @@ private final class MetalLUTKernel {
         struct LUTParams {
             uint  lutDim;
             float intensity;
+            uint  neutralExcess;
         };
 
+        // sRGB curve, mirrored for negative (out of gamut) values
+        static float3 srgbEncode(float3 x) {
+            float3 a = abs(x);
+            float3 e = select(1.055f * pow(a, 1.0f / 2.4f) - 0.055f, a * 12.92f, a <= 0.0031308f);
+            return copysign(e, x);
+        }
+
+        static float3 srgbDecode(float3 x) {
+            float3 a = abs(x);
+            float3 d = select(pow((a + 0.055f) / 1.055f, 2.4f), a / 12.92f, a <= 0.04045f);
+            return copysign(d, x);
+        }
+
         kernel void lut3dApply(
             texture2d<half, access::read>  inTex  [[texture(0)]],
             texture2d<half, access::write> outTex [[texture(1)]],
@@ -588,9 +871,18 @@ private final class MetalLUTKernel {
         ) {
             if (gid.x >= outTex.get_width() || gid.y >= outTex.get_height()) return;
 
+            // Input is linear; .cube LUTs are defined on sRGB-encoded values. The cube only covers
+            // [0,1], so whatever lies outside it (highlights above 1.0 before the display roll-off)
+            // is carried past the lookup rather than clipped.
             half4 inH = inTex.read(gid);
             float4 inF = float4(inH);
-            float3 rgb = clamp(inF.rgb, 0.0f, 1.0f);
+            float3 encoded = srgbEncode(inF.rgb);
+            float3 rgb = clamp(encoded, 0.0f, 1.0f);
+            float3 excess = encoded - rgb;
+            if (params.neutralExcess != 0) {
+                // Graded cubes: keep the excess as brightness only, so the grade decides colour
+                excess = float3(dot(excess, float3(0.2126f, 0.7152f, 0.0722f)));
+            }
 
             float dim = max(float(params.lutDim), 2.0f);
             float invDim = 1.0f / dim;
@@ -600,7 +892,7 @@ private final class MetalLUTKernel {
             float4 mapped = lutTex.sample(s, uvw);
 
             float t = clamp(params.intensity, 0.0f, 1.0f);
-            float3 outRgb = mix(inF.rgb, mapped.rgb, t);
+            float3 outRgb = srgbDecode(mix(encoded, mapped.rgb + excess, t));
             outTex.write(half4(outRgb, inF.a), gid);
         }
         """
@@ -626,17 +918,18 @@ private final class MetalLUTKernel {
         sampler = s
     }
 
-    func makeLUTTexture(cacheKey: String, dimension: Int, cubeData: Data) -> MTLTexture? {
-        lock.lock()
-        if let cached = lutCache[cacheKey] {
-            lock.unlock()
-            return cached
+    /// Resident 3D texture for a LUT, parsed (or built by `load`) and uploaded on first use.
+    fileprivate func lutTexture(id: String, load: (() -> LUT3D?)? = nil) -> MTLTexture? {
+        LUTResidency.shared.texture(id: id) {
+            (load ?? { LUTStore.shared.loadLUT(id: id) })().flatMap(makeLUTTexture)
         }
-        lock.unlock()
+    }
 
+    private func makeLUTTexture(_ lut: LUT3D) -> MTLTexture? {
+        let dimension = lut.dimension
         let desc = MTLTextureDescriptor()
         desc.textureType = .type3D
-        desc.pixelFormat = .rgba32Float
+        desc.pixelFormat = .rgba16Float
         desc.width = dimension
         desc.height = dimension
         desc.depth = dimension
@@ -646,9 +939,9 @@ private final class MetalLUTKernel {
 
         guard let tex = device.makeTexture(descriptor: desc) else { return nil }
 
-        let bytesPerRow = dimension * 4 * MemoryLayout<Float>.size
+        let bytesPerRow = dimension * 4 * MemoryLayout<UInt16>.size
         let bytesPerImage = bytesPerRow * dimension
-        cubeData.withUnsafeBytes { raw in
+        lut.cubeData.withUnsafeBytes { raw in
             guard let base = raw.baseAddress else { return }
             tex.replace(
                 region: MTLRegionMake3D(0, 0, 0, dimension, dimension, dimension),
@@ -659,10 +952,6 @@ private final class MetalLUTKernel {
                 bytesPerImage: bytesPerImage
             )
         }
-
-        lock.lock()
-        lutCache[cacheKey] = tex
-        lock.unlock()
         return tex
     }
 
@@ -672,14 +961,15 @@ private final class MetalLUTKernel {
         output: MTLTexture,
         lut: MTLTexture,
         lutDimension: UInt32,
-        intensity: Float
+        intensity: Float,
+        neutralExcess: Bool
     ) {
         encoder.setComputePipelineState(pipeline)
         encoder.setTexture(input, index: 0)
         encoder.setTexture(output, index: 1)
         encoder.setTexture(lut, index: 2)
 
-        var params = LUTParams(lutDim: lutDimension, intensity: intensity)
+        var params = LUTParams(lutDim: lutDimension, intensity: intensity, neutralExcess: neutralExcess ? 1 : 0)
         encoder.setBytes(&params, length: MemoryLayout<LUTParams>.size, index: 0)
         encoder.setSamplerState(sampler, index: 0)
 
@@ -693,6 +983,7 @@ private final class MetalLUTKernel {
     private struct LUTParams {
         var lutDim: UInt32
         var intensity: Float
+        var neutralExcess: UInt32
     }
 }
 
@@ -702,10 +993,203 @@ fileprivate struct LUT3D {
     let id: String
     let displayName: String
     let dimension: Int
+    /// RGBA half floats, B (outer) -> G -> R (inner).
     let cubeData: Data
+
+    /// RGBA Float32 copy, the only layout `CIColorCube` accepts.
+    func floatCubeData() -> Data {
+        let count = cubeData.count / MemoryLayout<UInt16>.size
+        var floats = Data(count: count * MemoryLayout<Float>.size)
+        cubeData.withUnsafeBytes { source in
+            floats.withUnsafeMutableBytes { destination in
+                var src = vImage_Buffer(
+                    data: UnsafeMutableRawPointer(mutating: source.baseAddress!),
+                    height: 1, width: vImagePixelCount(count), rowBytes: source.count
+                )
+                var dst = vImage_Buffer(
+                    data: destination.baseAddress!,
+                    height: 1, width: vImagePixelCount(count), rowBytes: destination.count
+                )
+                vImageConvert_Planar16FtoPlanarF(&src, &dst, vImage_Flags(kvImageNoFlags))
+            }
+        }
+        return floats
+    }
+}
+
+/// Trilinear lookups into a parsed LUT, for compositing it into generated cubes.
+fileprivate struct LUTSampler {
+    let dimension: Int
+    /// RGBA floats, B (outer) -> G -> R (inner).
+    let values: [Float]
+
+    init(_ lut: LUT3D) {
+        dimension = lut.dimension
+        values = lut.floatCubeData().withUnsafeBytes { Array($0.bindMemory(to: Float.self)) }
+    }
+
+    func sample(_ r: Float, _ g: Float, _ b: Float) -> (Float, Float, Float) {
+        let maxIndex = Float(dimension - 1)
+        func position(_ value: Float) -> (Int, Int, Float) {
+            let x = min(max(value, 0), 1) * maxIndex
+            let i = min(Int(x), dimension - 2)
+            return (i, i + 1, x - Float(i))
+        }
+        let (r0, r1, tr) = position(r)
+        let (g0, g1, tg) = position(g)
+        let (b0, b1, tb) = position(b)
+
+        func value(_ ri: Int, _ gi: Int, _ bi: Int, _ channel: Int) -> Float {
+            values[((bi * dimension + gi) * dimension + ri) * 4 + channel]
+        }
+        func channel(_ c: Int) -> Float {
+            func lerp(_ a: Float, _ b: Float, _ t: Float) -> Float { a + (b - a) * t }
+            let c00 = lerp(value(r0, g0, b0, c), value(r1, g0, b0, c), tr)
+            let c10 = lerp(value(r0, g1, b0, c), value(r1, g1, b0, c), tr)
+            let c01 = lerp(value(r0, g0, b1, c), value(r1, g0, b1, c), tr)
+            let c11 = lerp(value(r0, g1, b1, c), value(r1, g1, b1, c), tr)
+            return lerp(lerp(c00, c10, tg), lerp(c01, c11, tg), tb)
+        }
+        return (channel(0), channel(1), channel(2))
+    }
+}
+
+/// Byte-budgeted cache of parsed LUTs and their GPU textures with least-recently-used eviction.
+/// Lookups hold an unfair lock only for the hash lookup and recency stamp; parsing, half-float
+/// conversion and texture upload run outside it, so a render never waits behind a LUT load.
+final class LUTResidency {
+    static let shared = LUTResidency()
+
+    private static let budgetDefaultsKey = "DirtyRAW.LUTCacheBudgetMB"
+
+    private enum Payload {
+        case cube(LUT3D)
+        case texture(MTLTexture)
+    }
+
+    private struct Key: Hashable {
+        let id: String
+        let isTexture: Bool
+    }
+
+    private struct Entry {
+        let payload: Payload
+        let bytes: Int
+        var lastUse: UInt64
+    }
+
+    private struct State {
+        var entries: [Key: Entry] = [:]
+        var totalBytes = 0
+        var clock: UInt64 = 0
+        var byteBudget: Int
+    }
+
+    // Unchecked variants: textures are not Sendable but are only handed out, never mutated
+    private let state: OSAllocatedUnfairLock<State>
+
+    private init() {
+        let storedMB = UserDefaults.standard.integer(forKey: Self.budgetDefaultsKey)
+        state = OSAllocatedUnfairLock(uncheckedState: State(byteBudget: storedMB > 0 ? storedMB << 20 : 128 << 20))
+    }
+
+    /// Upper bound for resident LUT data (bytes).
+    var byteBudget: Int {
+        get { state.withLockUnchecked { $0.byteBudget } }
+        set {
+            state.withLockUnchecked { state in
+                state.byteBudget = newValue
+                Self.evict(&state)
+            }
+            UserDefaults.standard.set(newValue >> 20, forKey: Self.budgetDefaultsKey)
+        }
+    }
+
+    var residentBytes: Int {
+        state.withLockUnchecked { $0.totalBytes }
+    }
+
+    fileprivate func lut(id: String, load: () -> LUT3D?) -> LUT3D? {
+        let key = Key(id: id, isTexture: false)
+        if case .cube(let lut)? = lookup(key) {
+            return lut
+        }
+        guard let lut = load() else { return nil }
+        insert(.cube(lut), bytes: lut.cubeData.count, for: key)
+        return lut
+    }
+
+    func texture(id: String, make: () -> MTLTexture?) -> MTLTexture? {
+        let key = Key(id: id, isTexture: true)
+        if case .texture(let texture)? = lookup(key) {
+            return texture
+        }
+        guard let texture = make() else { return nil }
+        insert(.texture(texture), bytes: texture.allocatedSize, for: key)
+        return texture
+    }
+
+    func contains(textureFor id: String) -> Bool {
+        state.withLockUnchecked { $0.entries[Key(id: id, isTexture: true)] != nil }
+    }
+
+    func purge(id: String) {
+        state.withLockUnchecked { state in
+            for key in [Key(id: id, isTexture: false), Key(id: id, isTexture: true)] {
+                if let removed = state.entries.removeValue(forKey: key) {
+                    Self.account(&state, key, bytes: -removed.bytes)
+                }
+            }
+        }
+    }
+
+    // MARK: - Private
+
+    private func lookup(_ key: Key) -> Payload? {
+        state.withLockUnchecked { state in
+            guard var entry = state.entries[key] else { return nil }
+            state.clock += 1
+            entry.lastUse = state.clock
+            state.entries[key] = entry
+            return entry.payload
+        }
+    }
+
+    private func insert(_ payload: Payload, bytes: Int, for key: Key) {
+        state.withLockUnchecked { state in
+            // Another thread may have loaded the same LUT meanwhile; keep a single copy
+            if let existing = state.entries[key] {
+                Self.account(&state, key, bytes: -existing.bytes)
+            }
+            state.clock += 1
+            state.entries[key] = Entry(payload: payload, bytes: bytes, lastUse: state.clock)
+            Self.account(&state, key, bytes: bytes)
+            Self.evict(&state, keeping: key)
+        }
+    }
+
+    /// Drops least recently used entries until the budget holds. `keeping` is never evicted, so a
+    /// single LUT larger than the budget still renders.
+    private static func evict(_ state: inout State, keeping: Key? = nil) {
+        guard state.totalBytes > state.byteBudget else { return }
+        let candidates = state.entries
+            .filter { $0.key != keeping }
+            .sorted { $0.value.lastUse < $1.value.lastUse }
+        for (key, entry) in candidates {
+            guard state.totalBytes > state.byteBudget else { break }
+            state.entries.removeValue(forKey: key)
+            account(&state, key, bytes: -entry.bytes)
+        }
+    }
+
+    /// Adjusts the resident total and reports the change to the memory ledger.
+    private static func account(_ state: inout State, _ key: Key, bytes delta: Int) {
+        state.totalBytes += delta
+        NKMemoryLedger.add(Int64(delta), for: key.isTexture ? .lutTextures : .lutTables, owner: 0)
+    }
 }
 
-/// Thread-safe LUT registry + cache.
+/// Thread-safe LUT registry. Parsed LUTs are held by `LUTResidency`.
 /// - Built-in LUTs are generated programmatically.
 /// - Imported LUTs are copied into Application Support, so we don't rely on security-scoped bookmarks.
 final class LUTStore {
@@ -719,7 +1203,6 @@ final class LUTStore {
     }
 
     private let lock = NSLock()
-    private var cache: [String: LUT3D] = [:]
     private var imported: [String: ImportedLUT] = [:] // id -> meta
 
     private struct ImportedLUT: Codable {
@@ -773,28 +1256,27 @@ final class LUTStore {
         }
         try FileManager.default.copyItem(at: url, to: destinationURL)
 
-        // Validate by parsing once (and warm the cache)
-        let lut = try CubeLUTParser.parse(fileURL: destinationURL, id: "import:\(uuid)", displayName: displayName)
+        // Validate by parsing once; the LUT is loaded into the residency cache when first used
+        let id = "import:\(uuid)"
+        _ = try CubeLUTParser.parse(fileURL: destinationURL, id: id, displayName: displayName)
 
         lock.lock()
-        cache[lut.id] = lut
         imported[uuid] = ImportedLUT(id: uuid, displayName: displayName, fileName: storedFileName)
         persistImportedIndexLocked()
         lock.unlock()
 
         NotificationCenter.default.post(name: Self.didChangeNotification, object: nil)
-        return lut.id
+        return id
     }
 
+    /// Parsed LUT, kept resident for the Core Image fallback path.
     fileprivate func resolveLUT(id: String) -> LUT3D? {
-        if id == "none" { return nil }
+        LUTResidency.shared.lut(id: id) { loadLUT(id: id) }
+    }
 
-        lock.lock()
-        if let cached = cache[id] {
-            lock.unlock()
-            return cached
-        }
-        lock.unlock()
+    /// Parses a LUT from its bundle or Application Support file without caching it.
+    fileprivate func loadLUT(id: String) -> LUT3D? {
+        if id == "none" { return nil }
 
         // Bundle LUTs
         if id.hasPrefix("bundle:") {
@@ -802,15 +1284,7 @@ final class LUTStore {
             guard let fileURL = Bundle.main.url(forResource: name, withExtension: "cube", subdirectory: "LUTs") else {
                 return nil
             }
-            do {
-                let parsed = try CubeLUTParser.parse(fileURL: fileURL, id: id, displayName: name)
-                lock.lock()
-                cache[id] = parsed
-                lock.unlock()
-                return parsed
-            } catch {
-                return nil
-            }
+            return try? CubeLUTParser.parse(fileURL: fileURL, id: id, displayName: name)
         }
 
         // Imported LUTs
@@ -821,16 +1295,10 @@ final class LUTStore {
             lock.unlock()
             guard let meta else { return nil }
 
-            do {
-                let fileURL = try applicationSupportLUTsDirectory().appendingPathComponent(meta.fileName)
-                let parsed = try CubeLUTParser.parse(fileURL: fileURL, id: id, displayName: meta.displayName)
-                lock.lock()
-                cache[id] = parsed
-                lock.unlock()
-                return parsed
-            } catch {
+            guard let fileURL = try? applicationSupportLUTsDirectory().appendingPathComponent(meta.fileName) else {
                 return nil
             }
+            return try? CubeLUTParser.parse(fileURL: fileURL, id: id, displayName: meta.displayName)
         }
 
         return nil
@@ -967,7 +1435,7 @@ fileprivate enum CubeLUTParser {
             rgba.append(1.0)
         }
 
-        return LUT3D(id: id, displayName: displayName, dimension: dimension, cubeData: floatsToData(rgba))
+        return LUT3D(id: id, displayName: displayName, dimension: dimension, cubeData: halfFloatData(rgba))
     }
 
     static func generateCubeData(
@@ -993,10 +1461,25 @@ fileprivate enum CubeLUTParser {
             }
         }
 
-        return floatsToData(rgba)
+        return halfFloatData(rgba)
     }
 
-    private static func floatsToData(_ floats: [Float]) -> Data {
-        floats.withUnsafeBytes { Data($0) }
+    /// Packs Float32 values as half floats, the LUT storage format.
+    private static func halfFloatData(_ floats: [Float]) -> Data {
+        var halves = Data(count: floats.count * MemoryLayout<UInt16>.size)
+        floats.withUnsafeBytes { source in
+            halves.withUnsafeMutableBytes { destination in
+                var src = vImage_Buffer(
+                    data: UnsafeMutableRawPointer(mutating: source.baseAddress!),
+                    height: 1, width: vImagePixelCount(floats.count), rowBytes: source.count
+                )
+                var dst = vImage_Buffer(
+                    data: destination.baseAddress!,
+                    height: 1, width: vImagePixelCount(floats.count), rowBytes: destination.count
+                )
+                vImageConvert_PlanarFtoPlanar16F(&src, &dst, vImage_Flags(kvImageNoFlags))
+            }
+        }
+        return halves
     }
 }
@@ -0,0 +1,179 @@
+//
+//  JPEGDecoder.swift
+//  Dirty RAW
+//
+
+import Foundation
+import AppKit
+import ImageIO
+
+/// Decodes JPEG data from a single memory-mapped read.
+///
+/// The file is opened once and every consumer (full decode, scaled previews, thumbnails,
+/// metadata) shares the same `CGImageSource`. Reduced sizes use ImageIO's subsample factor,
+/// which the JPEG codec applies in the DCT domain (1/2, 1/4, 1/8), so a fit-to-window preview
+/// or a thumbnail never materializes the full-resolution bitmap.
+final class JPEGDecoder {
+    /// Scale denominators the JPEG codec can apply while decoding.
+    static let scaleDenominators = [1, 2, 4, 8]
+
+    private let source: CGImageSource
+
+    /// Image properties of the primary image, read once when the decoder is created.
+    let properties: [String: Any]
+    let pixelWidth: Int
+    let pixelHeight: Int
+
+    /// EXIF orientation of the primary image (1 when absent).
+    var orientation: Int {
+        properties[kCGImagePropertyOrientation as String] as? Int ?? 1
+    }
+
+    convenience init?(url: URL) {
+        guard let data = try? Data(contentsOf: url, options: .alwaysMapped) else { return nil }
+        self.init(data: data)
+    }
+
+    /// Wraps JPEG bytes already in memory, e.g. a preview embedded in a NEF.
+    init?(data: Data) {
+        let options: [CFString: Any] = [kCGImageSourceShouldCache: false]
+        guard let source = CGImageSourceCreateWithData(data as CFData, options as CFDictionary),
+              CGImageSourceGetCount(source) > 0,
+              let properties = CGImageSourceCopyPropertiesAtIndex(source, 0, nil) as? [String: Any],
+              let width = properties[kCGImagePropertyPixelWidth as String] as? Int,
+              let height = properties[kCGImagePropertyPixelHeight as String] as? Int,
+              width > 0, height > 0 else {
+            return nil
+        }
+
+        self.source = source
+        self.properties = properties
+        self.pixelWidth = width
+        self.pixelHeight = height
+    }
+
+    // MARK: - Decoding
+
+    /// Largest DCT scale denominator that still yields at least `minimumDimension` pixels on
+    /// the long edge.
+    func scaleDenominator(forMinimumDimension minimumDimension: Int) -> Int {
+        let longEdge = max(pixelWidth, pixelHeight)
+        return Self.scaleDenominators.last { longEdge / $0 >= minimumDimension } ?? 1
+    }
+
+    /// Decodes the image at 1/`denominator` size (1, 2, 4 or 8), without applying orientation.
+    func decode(scaleDenominator denominator: Int = 1) -> CGImage? {
+        var options: [CFString: Any] = [kCGImageSourceShouldCacheImmediately: true]
+        if denominator > 1 {
+            options[kCGImageSourceSubsampleFactor] = denominator
+        }
+        return CGImageSourceCreateImageAtIndex(source, 0, options as CFDictionary)
+    }
+
+    /// Decodes at the smallest DCT scale covering `minimumDimension` on the long edge.
+    func decode(minimumDimension: Int) -> CGImage? {
+        decode(scaleDenominator: scaleDenominator(forMinimumDimension: minimumDimension))
+    }
+
+    /// Thumbnail no larger than `maxPixelSize`, oriented upright. The DCT-scaled decode does
+    /// most of the reduction, leaving only a small resample for the final size.
+    func thumbnail(maxPixelSize: Int) -> CGImage? {
+        let options: [CFString: Any] = [
+            kCGImageSourceCreateThumbnailFromImageAlways: true,
+            kCGImageSourceCreateThumbnailWithTransform: true,
+            kCGImageSourceThumbnailMaxPixelSize: maxPixelSize,
+            kCGImageSourceSubsampleFactor: scaleDenominator(forMinimumDimension: maxPixelSize),
+            kCGImageSourceShouldCacheImmediately: true,
+        ]
+        return CGImageSourceCreateThumbnailAtIndex(source, 0, options as CFDictionary)
+    }
+
+    /// Full-resolution image sized in pixels, matching how the rest of the app treats `NSImage.size`.
+    func fullImage() -> NSImage? {
+        guard let cgImage = decode() else { return nil }
+        return NSImage(cgImage: cgImage, size: NSSize(width: cgImage.width, height: cgImage.height))
+    }
+
+    /// Thumbnail wrapped for the sidebar. `pointSize` is the long edge in points; the pixel
+    /// size is twice that so it stays sharp on Retina displays.
+    func thumbnailImage(pointSize: CGFloat) -> NSImage? {
+        guard let cgThumb = thumbnail(maxPixelSize: Int(pointSize * 2)) else { return nil }
+        let ratio = pointSize / CGFloat(max(cgThumb.width, cgThumb.height))
+        return NSImage(
+            cgImage: cgThumb,
+            size: NSSize(width: CGFloat(cgThumb.width) * ratio, height: CGFloat(cgThumb.height) * ratio)
+        )
+    }
+
+    // MARK: - Metadata
+
+    func exifData() -> NKEXIFData {
+        let exifData = NKEXIFData()
+
+        // TIFF properties
+        if let tiff = properties[kCGImagePropertyTIFFDictionary as String] as? [String: Any] {
+            exifData.make = tiff[kCGImagePropertyTIFFMake as String] as? String
+            exifData.model = tiff[kCGImagePropertyTIFFModel as String] as? String
+            exifData.software = tiff[kCGImagePropertyTIFFSoftware as String] as? String
+            exifData.artist = tiff[kCGImagePropertyTIFFArtist as String] as? String
+            exifData.copyright = tiff[kCGImagePropertyTIFFCopyright as String] as? String
+
+            if let dateString = tiff[kCGImagePropertyTIFFDateTime as String] as? String {
+                let formatter = DateFormatter()
+                formatter.dateFormat = "yyyy:MM:dd HH:mm:ss"
+                exifData.dateTime = formatter.date(from: dateString)
+            }
+        }
+
+        // EXIF properties
+        if let exif = properties[kCGImagePropertyExifDictionary as String] as? [String: Any] {
+            if let exposure = exif[kCGImagePropertyExifExposureTime as String] as? Double {
+                exifData.exposureTime = exposure
+            }
+            if let fNumber = exif[kCGImagePropertyExifFNumber as String] as? Double {
+                exifData.fNumber = fNumber
+            }
+            if let isoArray = exif[kCGImagePropertyExifISOSpeedRatings as String] as? [Int], let iso = isoArray.first {
+                exifData.iso = UInt(iso)
+            }
+            if let focal = exif[kCGImagePropertyExifFocalLength as String] as? Double {
+                exifData.focalLength = focal
+            }
+            if let bias = exif[kCGImagePropertyExifExposureBiasValue as String] as? Double {
+                exifData.exposureBias = bias
+            }
+            if let metering = exif[kCGImagePropertyExifMeteringMode as String] as? Int {
+                exifData.meteringMode = UInt(metering)
+            }
+            if let program = exif[kCGImagePropertyExifExposureProgram as String] as? Int {
+                exifData.exposureProgram = UInt(program)
+            }
+            if let flash = exif[kCGImagePropertyExifFlash as String] as? Int {
+                exifData.flash = UInt(flash)
+            }
+            if let lens = exif[kCGImagePropertyExifLensModel as String] as? String {
+                exifData.lensInfo = lens
+            }
+        }
+
+        // File format for JPEG
+        exifData.fileFormat = 3 // JPEG
+
+        return exifData
+    }
+
+    func imageInfo() -> NKImageInfo {
+        let info = NKImageInfo()
+        info.width = UInt(pixelWidth)
+        info.height = UInt(pixelHeight)
+        info.byteDepth = 1 // 8-bit for JPEG
+        info.colorType = 2 // RGB
+        info.orientation = UInt(orientation)
+
+        if let dpi = properties[kCGImagePropertyDPIWidth as String] as? Double {
+            info.resolution = dpi
+        }
+
+        return info
+    }
+}
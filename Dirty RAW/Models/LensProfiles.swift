@@ -0,0 +1,229 @@
+//
+//  LensProfiles.swift
+//  Dirty RAW
+//
+
+import Foundation
+
+/// Optical calibration of one lens, read from JSON:
+///
+///     {
+///       "id": "nikkor-z-24-70-f4-s",
+///       "name": "NIKKOR Z 24-70mm f/4 S",
+///       "match": ["NIKKOR Z 24-70mm f/4 S"],
+///       "calibrations": [
+///         { "focalLength": 24, "aperture": 4, "k1": -0.041, "k2": 0.012, "v1": -0.62, "v2": 0.21, "caRed": 1.0003, "caBlue": 0.9996 }
+///       ]
+///     }
+///
+/// Coefficients follow `NKLensModel`; omitted ones are neutral. A calibration without an aperture
+/// applies at every aperture. A file may hold one profile or an array of them.
+struct LensProfile: Codable, Identifiable {
+    struct Calibration: Codable {
+        var focalLength: Double
+        var aperture: Double?
+        var k1: Double
+        var k2: Double
+        var k3: Double
+        var v1: Double
+        var v2: Double
+        var v3: Double
+        var caRed: Double
+        var caBlue: Double
+
+        init(from decoder: Decoder) throws {
+            let container = try decoder.container(keyedBy: CodingKeys.self)
+            focalLength = try container.decode(Double.self, forKey: .focalLength)
+            aperture = try container.decodeIfPresent(Double.self, forKey: .aperture)
+            k1 = try container.decodeIfPresent(Double.self, forKey: .k1) ?? 0
+            k2 = try container.decodeIfPresent(Double.self, forKey: .k2) ?? 0
+            k3 = try container.decodeIfPresent(Double.self, forKey: .k3) ?? 0
+            v1 = try container.decodeIfPresent(Double.self, forKey: .v1) ?? 0
+            v2 = try container.decodeIfPresent(Double.self, forKey: .v2) ?? 0
+            v3 = try container.decodeIfPresent(Double.self, forKey: .v3) ?? 0
+            caRed = try container.decodeIfPresent(Double.self, forKey: .caRed) ?? 1
+            caBlue = try container.decodeIfPresent(Double.self, forKey: .caBlue) ?? 1
+        }
+
+        fileprivate var coefficients: [Double] { [k1, k2, k3, v1, v2, v3, caRed, caBlue] }
+    }
+
+    let id: String
+    let name: String
+    /// Lens names as written to EXIF by the camera.
+    let match: [String]
+    let calibrations: [Calibration]
+
+    /// Coefficients at `focalLength` (mm) and `aperture` (f-number): interpolated in aperture
+    /// stops between the calibrations at each bracketing focal length, then linearly in focal
+    /// length. Settings outside the calibrated range use the nearest calibration.
+    func model(focalLength: Double, aperture: Double) -> NKLensModel? {
+        let focalLengths = Array(Set(calibrations.map(\.focalLength))).sorted()
+        guard let first = focalLengths.first, let last = focalLengths.last else { return nil }
+
+        let focal = min(max(focalLength > 0 ? focalLength : first, first), last)
+        let upperIndex = focalLengths.firstIndex { $0 >= focal } ?? focalLengths.count - 1
+        let upper = focalLengths[upperIndex]
+        let lower = upperIndex > 0 ? focalLengths[upperIndex - 1] : upper
+
+        let atLower = coefficients(focalLength: lower, aperture: aperture)
+        let atUpper = coefficients(focalLength: upper, aperture: aperture)
+        let t = upper > lower ? (focal - lower) / (upper - lower) : 0
+        let c = zip(atLower, atUpper).map { $0 + ($1 - $0) * t }
+
+        return NKLensModel(
+            k1: Float(c[0]), k2: Float(c[1]), k3: Float(c[2]),
+            v1: Float(c[3]), v2: Float(c[4]), v3: Float(c[5]),
+            caRed: Float(c[6]), caBlue: Float(c[7])
+        )
+    }
+
+    private func coefficients(focalLength: Double, aperture: Double) -> [Double] {
+        let entries = calibrations.filter { $0.focalLength == focalLength }
+        let stopped = entries
+            .compactMap { entry in entry.aperture.map { (stops: 2 * log2($0), entry: entry) } }
+            .sorted { $0.stops < $1.stops }
+        guard !stopped.isEmpty, aperture > 0 else {
+            return (entries.first { $0.aperture == nil } ?? entries[0]).coefficients
+        }
+
+        let stops = min(max(2 * log2(aperture), stopped[0].stops), stopped[stopped.count - 1].stops)
+        let upperIndex = stopped.firstIndex { $0.stops >= stops } ?? stopped.count - 1
+        let upper = stopped[upperIndex]
+        let lower = upperIndex > 0 ? stopped[upperIndex - 1] : upper
+        let t = upper.stops > lower.stops ? (stops - lower.stops) / (upper.stops - lower.stops) : 0
+        return zip(lower.entry.coefficients, upper.entry.coefficients).map { $0 + ($1 - $0) * t }
+    }
+}
+
+/// Thread-safe registry of lens profiles.
+/// - Bundled profiles live in Resources/LensProfiles/*.json.
+/// - Imported profiles are copied into Application Support, like imported LUTs.
+final class LensProfileStore {
+    static let shared = LensProfileStore()
+    static let didChangeNotification = Notification.Name("DirtyRAW.LensProfileStoreDidChange")
+
+    enum ImportError: LocalizedError {
+        case noProfiles
+
+        var errorDescription: String? {
+            switch self {
+            case .noProfiles:
+                return "The file contains no lens profiles"
+            }
+        }
+    }
+
+    private let lock = NSLock()
+    private var profiles: [String: LensProfile] = [:]
+
+    private init() {
+        var urls = Bundle.main.urls(forResourcesWithExtension: "json", subdirectory: "LensProfiles") ?? []
+        if let directory = try? applicationSupportProfilesDirectory(),
+           let imported = try? FileManager.default.contentsOfDirectory(at: directory, includingPropertiesForKeys: nil) {
+            urls.append(contentsOf: imported.filter { $0.pathExtension.lowercased() == "json" })
+        }
+        for url in urls {
+            for profile in (try? Self.decode(contentsOf: url)) ?? [] {
+                profiles[profile.id] = profile
+            }
+        }
+    }
+
+    /// Profiles sorted by name.
+    func allProfiles() -> [LensProfile] {
+        lock.lock()
+        defer { lock.unlock() }
+        return profiles.values.sorted { $0.name.localizedCaseInsensitiveCompare($1.name) == .orderedAscending }
+    }
+
+    func profile(id: String) -> LensProfile? {
+        lock.lock()
+        defer { lock.unlock() }
+        return profiles[id]
+    }
+
+    /// Profile for the EXIF lens name, preferring the longest matching name.
+    func profile(matchingLens lensInfo: String) -> LensProfile? {
+        let lens = Self.normalized(lensInfo)
+        guard !lens.isEmpty else { return nil }
+
+        lock.lock()
+        defer { lock.unlock() }
+        var best: (profile: LensProfile, length: Int)?
+        for profile in profiles.values {
+            for name in profile.match.map(Self.normalized) where !name.isEmpty && lens.contains(name) {
+                if name.count > best?.length ?? 0 {
+                    best = (profile, name.count)
+                }
+            }
+        }
+        return best?.profile
+    }
+
+    /// Model for the lens settings in `adjustments`, scaled by the per-correction amounts.
+    func model(for adjustments: ImageAdjustments) -> NKLensModel? {
+        guard let profile = profile(id: adjustments.lensProfileID),
+              var model = profile.model(focalLength: adjustments.lensFocalLength, aperture: adjustments.lensAperture) else {
+            return nil
+        }
+        let distortion = Float(min(max(adjustments.lensDistortionAmount, 0), 1))
+        let vignetting = Float(min(max(adjustments.lensVignettingAmount, 0), 1))
+        let chromatic = Float(min(max(adjustments.lensCAAmount, 0), 1))
+        model.k1 *= distortion
+        model.k2 *= distortion
+        model.k3 *= distortion
+        model.v1 *= vignetting
+        model.v2 *= vignetting
+        model.v3 *= vignetting
+        model.caRed = 1 + (model.caRed - 1) * chromatic
+        model.caBlue = 1 + (model.caBlue - 1) * chromatic
+        return model
+    }
+
+    /// Copies a profile file into Application Support and registers its profiles.
+    /// Returns the imported profiles.
+    func importProfiles(from url: URL) throws -> [LensProfile] {
+        let imported = try Self.decode(contentsOf: url)
+        guard !imported.isEmpty else { throw ImportError.noProfiles }
+
+        let destinationURL = try applicationSupportProfilesDirectory()
+            .appendingPathComponent("\(UUID().uuidString)-\(url.lastPathComponent)")
+        try FileManager.default.createDirectory(at: destinationURL.deletingLastPathComponent(), withIntermediateDirectories: true)
+        try FileManager.default.copyItem(at: url, to: destinationURL)
+
+        lock.lock()
+        for profile in imported {
+            profiles[profile.id] = profile
+        }
+        lock.unlock()
+
+        NotificationCenter.default.post(name: Self.didChangeNotification, object: nil)
+        return imported
+    }
+
+    // MARK: - Private
+
+    private static func decode(contentsOf url: URL) throws -> [LensProfile] {
+        let data = try Data(contentsOf: url)
+        if let list = try? JSONDecoder().decode([LensProfile].self, from: data) {
+            return list
+        }
+        return [try JSONDecoder().decode(LensProfile.self, from: data)]
+    }
+
+    private static func normalized(_ name: String) -> String {
+        name.lowercased().split(whereSeparator: \.isWhitespace).joined(separator: " ")
+    }
+
+    private func applicationSupportProfilesDirectory() throws -> URL {
+        let appSupport = try FileManager.default.url(
+            for: .applicationSupportDirectory,
+            in: .userDomainMask,
+            appropriateFor: nil,
+            create: true
+        )
+        return appSupport.appendingPathComponent("DirtyRAW", isDirectory: true)
+            .appendingPathComponent("LensProfiles", isDirectory: true)
+    }
+}
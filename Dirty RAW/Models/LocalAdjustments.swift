@@ -0,0 +1,145 @@
+//
+//  LocalAdjustments.swift
+//  Dirty RAW
+//
+
+import Foundation
+import CoreGraphics
+
+/// A set of corrections applied through a mask. Mask geometry is stored as shapes in frame
+/// fractions (top-left origin), so one edit renders at every preview level and at export; the
+/// native side rasterizes it in cached tiles (see Native/LocalMask.hpp).
+struct LocalAdjustment: Identifiable, Hashable {
+    struct BrushStroke: Hashable {
+        var points: [CGPoint] = []
+        /// Fraction of the frame's long side.
+        var radius: Double
+        /// 0 = soft edge over the whole radius, 1 = hard edge.
+        var hardness: Double
+        var isEraser: Bool
+    }
+
+    enum Mask: Hashable {
+        /// Full effect before `start`, fading to none at `end`.
+        case linear(start: CGPoint, end: CGPoint)
+        /// Full effect inside the ellipse shrunk by `feather` (0...1), none outside it.
+        case radial(center: CGPoint, radius: CGSize, feather: Double, inverted: Bool)
+        case brush([BrushStroke])
+
+        var displayName: String {
+            switch self {
+            case .linear: return "Linear"
+            case .radial: return "Radial"
+            case .brush: return "Brush"
+            }
+        }
+    }
+
+    let id: UUID
+    var name: String
+    var mask: Mask
+    var isEnabled: Bool = true
+
+    var exposure: Double = 0.0    // -2.0 to 2.0 EV
+    var contrast: Double = 0.0    // -0.5 to 0.5
+    var saturation: Double = 0.0  // -1.0 to 1.0
+    var warmth: Double = 0.0      // -1.0 to 1.0
+
+    init(name: String, mask: Mask) {
+        self.id = UUID()
+        self.name = name
+        self.mask = mask
+    }
+
+    static func linear() -> LocalAdjustment {
+        LocalAdjustment(name: "Linear", mask: .linear(start: CGPoint(x: 0.5, y: 0.2), end: CGPoint(x: 0.5, y: 0.5)))
+    }
+
+    static func radial() -> LocalAdjustment {
+        LocalAdjustment(
+            name: "Radial",
+            mask: .radial(center: CGPoint(x: 0.5, y: 0.5), radius: CGSize(width: 0.25, height: 0.25), feather: 0.5, inverted: false)
+        )
+    }
+
+    static func brush() -> LocalAdjustment {
+        LocalAdjustment(name: "Brush", mask: .brush([]))
+    }
+
+    /// No correction to apply, or nothing masked.
+    var isNeutral: Bool {
+        if !isEnabled || (exposure == 0 && contrast == 0 && saturation == 0 && warmth == 0) { return true }
+        if case .brush(let strokes) = mask {
+            return !strokes.contains { !$0.isEraser && !$0.points.isEmpty }
+        }
+        return false
+    }
+
+    /// Shape data in the layout read by `NKLocalAdjustmentKernel`.
+    var maskData: Data {
+        var values: [Float] = []
+        switch mask {
+        case .linear(let start, let end):
+            values = [0, Float(start.x), Float(start.y), Float(end.x), Float(end.y)]
+        case .radial(let center, let radius, let feather, let inverted):
+            values = [1, Float(center.x), Float(center.y), Float(radius.width), Float(radius.height), Float(feather), inverted ? 1 : 0]
+        case .brush(let strokes):
+            let painted = strokes.filter { !$0.points.isEmpty }
+            values = [2, Float(painted.count)]
+            for stroke in painted {
+                values += [Float(stroke.points.count), Float(stroke.radius), Float(stroke.hardness), stroke.isEraser ? 1 : 0]
+                for point in stroke.points {
+                    values += [Float(point.x), Float(point.y)]
+                }
+            }
+        }
+        return values.withUnsafeBufferPointer { Data(buffer: $0) }
+    }
+}
+
+/// Brush state shared by the adjustments panel and the preview, which paints strokes into the
+/// mask selected here.
+final class MaskEditor: ObservableObject {
+    static let shared = MaskEditor()
+
+    /// Brush mask receiving strokes; nil when the preview isn't painting.
+    @Published var paintingMaskID: UUID?
+    @Published var brushRadius: Double = 0.03   // fraction of the long side
+    @Published var brushHardness: Double = 0.5
+    @Published var isErasing = false
+
+    private init() {}
+
+    /// Starts a stroke at `point` (frame fractions) on the painting mask.
+    func beginStroke(at point: CGPoint, in adjustments: inout ImageAdjustments) {
+        updateMask(in: &adjustments) { strokes in
+            strokes.append(LocalAdjustment.BrushStroke(
+                points: [point],
+                radius: brushRadius,
+                hardness: brushHardness,
+                isEraser: isErasing
+            ))
+        }
+    }
+
+    /// Extends the current stroke; points closer than a tenth of the brush radius are dropped.
+    func continueStroke(to point: CGPoint, in adjustments: inout ImageAdjustments) {
+        updateMask(in: &adjustments) { strokes in
+            guard var stroke = strokes.popLast() else { return }
+            if let last = stroke.points.last, hypot(point.x - last.x, point.y - last.y) >= stroke.radius * 0.1 {
+                stroke.points.append(point)
+            }
+            strokes.append(stroke)
+        }
+    }
+
+    private func updateMask(in adjustments: inout ImageAdjustments, _ body: (inout [LocalAdjustment.BrushStroke]) -> Void) {
+        guard let id = paintingMaskID,
+              let index = adjustments.localAdjustments.firstIndex(where: { $0.id == id }),
+              case .brush(var strokes) = adjustments.localAdjustments[index].mask else {
+            return
+        }
+        body(&strokes)
+        adjustments.localAdjustments[index].mask = .brush(strokes)
+    }
+}
@@ -0,0 +1,174 @@
+//
+//  MemoryMonitor.swift
+//  Dirty RAW
+//
+
+import AppKit
+import Combine
+import UniformTypeIdentifiers
+
+/// Surfaces the memory ledger (see MemoryLedger.h): an overlay refreshed once a second, console
+/// dumps and a JSON report, so a regression in what the app holds shows up as a category, or an
+/// image, that grew.
+/// - Tagged: bytes owners report (bitmaps, caches, LUTs, SDK sessions, decode buffers)
+/// - Untracked: process footprint minus tagged bytes (Core Image internals, frameworks, heap)
+/// - Metal: what the GPU device has allocated, covering Core Image's own render targets
+@MainActor
+final class MemoryMonitor: ObservableObject {
+    static let shared = MemoryMonitor()
+
+    private static let overlayDefaultsKey = "DirtyRAW.ShowMemoryOverlay"
+
+    @Published private(set) var snapshot = NKMemoryLedger.snapshot()
+    @Published private(set) var metalAllocatedBytes = 0
+
+    /// Shows the overlay on the preview; it is only refreshed while visible.
+    @Published var isOverlayVisible: Bool {
+        didSet {
+            UserDefaults.standard.set(isOverlayVisible, forKey: Self.overlayDefaultsKey)
+            updateTimer()
+        }
+    }
+
+    private var timer: Timer?
+
+    private init() {
+        isOverlayVisible = UserDefaults.standard.bool(forKey: Self.overlayDefaultsKey)
+        updateTimer()
+    }
+
+    /// Footprint not accounted for by any category.
+    var untrackedBytes: Int64 {
+        max(snapshot.footprintBytes - snapshot.total.currentBytes, 0)
+    }
+
+    func refresh() {
+        snapshot = NKMemoryLedger.snapshot()
+        metalAllocatedBytes = ImageProcessor.shared.metalAllocatedBytes
+    }
+
+    func resetPeaks() {
+        NKMemoryLedger.resetPeaks()
+        refresh()
+    }
+
+    /// Prints the current snapshot as a table: categories, then the largest owners.
+    func logSnapshot() {
+        refresh()
+        var lines = ["MemoryMonitor: footprint \(Self.megabytes(snapshot.footprintBytes)), tagged \(Self.megabytes(snapshot.total.currentBytes)) (peak \(Self.megabytes(snapshot.total.peakBytes))), untracked \(Self.megabytes(untrackedBytes)), Metal \(Self.megabytes(Int64(metalAllocatedBytes)))"]
+        for category in Self.categories {
+            let usage = snapshot.usage(for: category)
+            guard usage.peakBytes > 0 else { continue }
+            let key = NKMemoryLedger.key(for: category).padding(toLength: 20, withPad: " ", startingAt: 0)
+            lines.append("  \(key) \(Self.megabytes(usage.currentBytes)) (peak \(Self.megabytes(usage.peakBytes)), \(usage.changeCount) changes)")
+        }
+        for owner in snapshot.owners.prefix(10) where owner.total.currentBytes > 0 {
+            lines.append("  \(owner.name): \(Self.megabytes(owner.total.currentBytes)) (peak \(Self.megabytes(owner.total.peakBytes)))")
+        }
+        print(lines.joined(separator: "\n"))
+    }
+
+    /// Snapshot as JSON, with byte counts per category and per owner.
+    func reportJSON() -> Data? {
+        refresh()
+        let report = Report(snapshot: snapshot, metalAllocatedBytes: Int64(metalAllocatedBytes), untrackedBytes: untrackedBytes)
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+        encoder.dateEncodingStrategy = .iso8601
+        return try? encoder.encode(report)
+    }
+
+    /// Asks where to save `reportJSON()`.
+    func saveReport() {
+        guard let data = reportJSON() else { return }
+        let panel = NSSavePanel()
+        panel.allowedContentTypes = [.json]
+        panel.nameFieldStringValue = "Dirty RAW Memory Report"
+        panel.canCreateDirectories = true
+        panel.begin { response in
+            guard response == .OK, let url = panel.url else { return }
+            do {
+                try data.write(to: url, options: .atomic)
+            } catch {
+                print("MemoryMonitor: Failed to write report: \(error)")
+            }
+        }
+    }
+
+    static var categories: [NKMemoryCategory] {
+        NKMemoryLedger.allCategories.compactMap { NKMemoryCategory(rawValue: $0.intValue) }
+    }
+
+    static func megabytes(_ bytes: Int64) -> String {
+        String(format: "%.1f MB", Double(bytes) / Double(1 << 20))
+    }
+
+    private func updateTimer() {
+        timer?.invalidate()
+        timer = nil
+        guard isOverlayVisible else { return }
+        refresh()
+        timer = Timer.scheduledTimer(withTimeInterval: 1, repeats: true) { _ in
+            Task { @MainActor in
+                MemoryMonitor.shared.refresh()
+            }
+        }
+    }
+}
+
+// MARK: - Report
+
+private extension MemoryMonitor {
+    struct Usage: Encodable {
+        let currentBytes: Int64
+        let peakBytes: Int64
+        let changes: UInt64
+
+        init(_ usage: NKMemoryUsage) {
+            currentBytes = usage.currentBytes
+            peakBytes = usage.peakBytes
+            changes = usage.changeCount
+        }
+    }
+
+    struct Owner: Encodable {
+        let name: String
+        let total: Usage
+        /// Non-zero categories only.
+        let bytes: [String: Int64]
+    }
+
+    struct Report: Encodable {
+        let date: Date
+        let footprintBytes: Int64
+        let metalAllocatedBytes: Int64
+        /// Working memory the Nikon SDK may use before paging to its VM file.
+        let sdkVirtualMemoryLimitBytes: UInt64
+        let tagged: Usage
+        let untrackedBytes: Int64
+        let categories: [String: Usage]
+        let owners: [Owner]
+
+        init(snapshot: NKMemorySnapshot, metalAllocatedBytes: Int64, untrackedBytes: Int64) {
+            date = snapshot.date
+            footprintBytes = snapshot.footprintBytes
+            self.metalAllocatedBytes = metalAllocatedBytes
+            sdkVirtualMemoryLimitBytes = NikonSDKWrapper.virtualMemoryBytes
+            tagged = Usage(snapshot.total)
+            self.untrackedBytes = untrackedBytes
+            categories = Dictionary(uniqueKeysWithValues: MemoryMonitor.categories.map {
+                (NKMemoryLedger.key(for: $0), Usage(snapshot.usage(for: $0)))
+            })
+            owners = snapshot.owners.map { owner in
+                Owner(
+                    name: owner.name,
+                    total: Usage(owner.total),
+                    bytes: Dictionary(uniqueKeysWithValues: MemoryMonitor.categories.compactMap { category in
+                        let bytes = owner.bytes(for: category)
+                        return bytes != 0 ? (NKMemoryLedger.key(for: category), bytes) : nil
+                    })
+                )
+            }
+        }
+    }
+}
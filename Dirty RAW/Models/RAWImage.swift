@@ -27,30 +27,127 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
         hasher.combine(id)
     }
 
-    @Published var image: NSImage?
-    @Published var processedImage: NSImage?
-    @Published var thumbnail: NSImage?
+    @Published var image: NSImage? {
+        didSet {
+            ImageCache.shared.update(self)
+            reportMemory()
+        }
+    }
+    /// Full-resolution render with the current adjustments; produced on demand for export
+    /// (see `fullResolutionImage()`) and dropped whenever the adjustments change.
+    @Published var processedImage: NSImage? {
+        didSet {
+            ImageCache.shared.update(self)
+            reportMemory()
+        }
+    }
+    /// Space `processedImage` is encoded in.
+    private var processedColorSpace: NKOutputColorSpace = .sRGB
+    /// Whole frame rendered at the viewport's fit scale (base display layer).
+    @Published var previewImage: NSImage? {
+        didSet { reportMemory() }
+    }
+    /// Visible region rendered at the viewport's zoom scale, when finer than `previewImage`.
+    @Published var detailImage: NSImage? {
+        didSet { reportMemory() }
+    }
+    /// Region of the source frame covered by `detailImage` (pixels, top-left origin).
+    @Published var detailRect: CGRect = .zero
+    @Published var thumbnail: NSImage? {
+        didSet { reportMemory() }
+    }
     @Published var exifData: NKEXIFData?
     @Published var imageInfo: NKImageInfo?
     @Published var isLoading = false
     @Published var isProcessing = false
     @Published var error: String?
     @Published var adjustments = ImageAdjustments()
+    /// Pinned images are never evicted by `ImageCache`.
+    @Published var isPinned = false
+    /// Identifies the decoded pixels: the file's path, size and modification time (as in
+    /// `ImageCatalog`) plus the decode settings. Keys `RenderCache`, so renders survive eviction,
+    /// re-decoding and relaunches.
+    private(set) var contentKey: String?
 
     private var sdkWrapper: NikonSDKWrapper?
+    /// This image's owner in the memory ledger; its bitmaps, SDK session and decode buffers are
+    /// reported under it.
+    private let memoryOwner: UInt64
     private var processingTask: Task<Void, Never>?
+    private var hasLoadedOnce = false
+    private var decodeGeneration = 0
+    private var adjustmentGeneration = 0
+    private var viewport: Viewport?
+    /// A render was started and has not presented a frame yet.
+    private var isFramePending = false
+
+    /// Scale levels below the fit level used for the immediate pass while a control is moving.
+    private static let interactiveLevelOffset = 3
+    /// Input must be quiet this long before the full-quality pass replaces the coarse one.
+    private static let settleDelay: UInt64 = 120_000_000
+    /// Long edge, in pixels, of the DCT-scaled JPEG decode shown before the full-size one.
+    private static let previewDimension = 2048
+
+    /// What the preview currently shows, in source pixels and output pixels per source pixel.
+    private struct Viewport: Equatable {
+        var visibleRect: CGRect
+        var scale: CGFloat
+        var fitScale: CGFloat
+    }
+
+    /// Identifies the current decoded bitmap for the render graph's intermediate cache.
+    private var renderSourceKey: String {
+        "\(id.uuidString)#\(decodeGeneration)"
+    }
+
+    /// Bytes held by the decoded and processed bitmaps (shared bitmaps are counted once).
+    var residentBitmapBytes: Int {
+        var bytes = image?.bitmapByteCount ?? 0
+        if let processedImage, processedImage !== image {
+            bytes += processedImage.bitmapByteCount
+        }
+        return bytes
+    }
 
     init(url: URL) {
         self.url = url
         self.fileName = url.lastPathComponent
+        self.memoryOwner = NKMemoryLedger.registerOwner(named: url.lastPathComponent)
+        // FNV-1a of the file name: stable across launches, unlike `hashValue`
+        self.adjustments.grainSeed = url.lastPathComponent.utf8.reduce(2166136261 as UInt32) { ($0 ^ UInt32($1)) &* 16777619 }
+    }
+
+    deinit {
+        NKMemoryLedger.releaseOwner(memoryOwner)
+    }
+
+    /// Reports the bitmaps held to the memory ledger. A processed image that is the decoded one
+    /// (nothing to render) is counted once, as a source bitmap.
+    private func reportMemory() {
+        var processedBytes = 0
+        if let processedImage, processedImage !== image {
+            processedBytes = processedImage.bitmapByteCount
+        }
+        let previewBytes = (previewImage?.bitmapByteCount ?? 0) + (detailImage?.bitmapByteCount ?? 0)
+        NKMemoryLedger.set(Int64(image?.bitmapByteCount ?? 0), for: .sourceBitmaps, owner: memoryOwner)
+        NKMemoryLedger.set(Int64(processedBytes), for: .processedBitmaps, owner: memoryOwner)
+        NKMemoryLedger.set(Int64(previewBytes), for: .previewBitmaps, owner: memoryOwner)
+        NKMemoryLedger.set(Int64(thumbnail?.bitmapByteCount ?? 0), for: .thumbnails, owner: memoryOwner)
     }
 
     func load() {
+        // Already decoded: just mark as recently used
+        if image != nil {
+            ImageCache.shared.touch(self)
+            return
+        }
         guard !isLoading else { return }
         isLoading = true
         error = nil
+        let previewDimension = Self.previewDimension
+        let outputColorSpace = ImageProcessor.shared.outputColorSpace
 
-        Task.detached { [weak self, url] in
+        Task.detached { [weak self, url, viewport, adjustments, memoryOwner] in
             guard let self = self else { return }
 
             let isAccessing = url.startAccessingSecurityScopedResource()
@@ -60,6 +157,25 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
                 }
             }
 
+            // Revisiting: show the frame as it was last rendered while the decode runs. A file
+            // changed on disk has a new size or modification time, so it never matches old renders.
+            let loadedContentKey = Self.contentKey(of: url, colorSpace: outputColorSpace)
+            var showsCachedRender = false
+            if let loadedContentKey, let viewport,
+               let cached = ViewportRenderer.shared.cachedFrame(contentKey: loadedContentKey, adjustments: adjustments, scale: viewport.fitScale) {
+                let levelScale = ViewportRenderer.scale(forLevel: ViewportRenderer.level(for: viewport.fitScale))
+                nonisolated(unsafe) let cachedFrame = NSImage(
+                    cgImage: cached,
+                    size: NSSize(width: CGFloat(cached.width) / levelScale, height: CGFloat(cached.height) / levelScale)
+                )
+                showsCachedRender = true
+                await MainActor.run {
+                    if self.image == nil {
+                        self.previewImage = cachedFrame
+                    }
+                }
+            }
+
             let ext = url.pathExtension.lowercased()
             let isNikonRAW = ext == "nef" || ext == "nrw"
 
@@ -70,8 +186,21 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
 
             // Try NikonSDKWrapper for NEF/NRW files
             if isNikonRAW {
+                // Show a native quick develop while the SDK develops the full image
+                if !showsCachedRender, let quick = NikonSDKWrapper.quickDevelopImage(withFilePath: url.path) {
+                    nonisolated(unsafe) let quickImage = quick
+                    await MainActor.run {
+                        if self.image == nil {
+                            self.previewImage = quickImage
+                        }
+                    }
+                }
+
                 wrapper = NikonSDKWrapper(filePath: url.path)
                 if let w = wrapper {
+                    w.memoryOwner = memoryOwner
+                    // Develop straight into the export space; the decode converts it to linear once
+                    w.useOutputColorSpace(outputColorSpace)
                     nonisolated(unsafe) let wrapperImage = w.decodeToImage()
                     nonisolated(unsafe) let wrapperExif = w.getEXIFData()
                     nonisolated(unsafe) let wrapperInfo = w.getImageInfo()
@@ -81,12 +210,28 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
                 }
             }
 
-            // Fallback to macOS native methods for JPG or if NEF failed
-            if image == nil {
-                image = self.loadImageNative(url: url)
+            // Fallback to ImageIO for JPG or if NEF failed. One mapped read serves the preview,
+            // the full decode, the thumbnail and the metadata.
+            var thumbnail: NSImage?
+            if image == nil, let decoder = JPEGDecoder(url: url) {
+                if !isNikonRAW, !showsCachedRender, let fitted = decoder.decode(minimumDimension: previewDimension) {
+                    // DCT-scaled decode shown while the full-size one runs
+                    nonisolated(unsafe) let preview = NSImage(
+                        cgImage: fitted,
+                        size: NSSize(width: decoder.pixelWidth, height: decoder.pixelHeight)
+                    )
+                    await MainActor.run {
+                        if self.image == nil {
+                            self.previewImage = preview
+                        }
+                    }
+                }
+
+                image = decoder.fullImage()
                 if image != nil {
-                    exif = self.loadEXIFNative(url: url)
-                    info = self.loadImageInfoNative(url: url, image: image!)
+                    exif = decoder.exifData()
+                    info = decoder.imageInfo()
+                    thumbnail = decoder.thumbnailImage(pointSize: 80)
                 }
             }
 
@@ -98,14 +243,21 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
                 return
             }
 
-            // Generate thumbnail
-            let thumbSize: CGFloat = 80
-            let ratio = min(thumbSize / loadedImage.size.width, thumbSize / loadedImage.size.height)
-            let newSize = NSSize(width: loadedImage.size.width * ratio, height: loadedImage.size.height * ratio)
-            let thumb = NSImage(size: newSize)
-            thumb.lockFocus()
-            loadedImage.draw(in: NSRect(origin: .zero, size: newSize))
-            thumb.unlockFocus()
+            // Generate thumbnail (JPEGs already have one from the DCT-scaled decode)
+            let thumb: NSImage
+            if let thumbnail {
+                thumb = thumbnail
+            } else {
+                let thumbSize: CGFloat = 80
+                let ratio = min(thumbSize / loadedImage.size.width, thumbSize / loadedImage.size.height)
+                let newSize = NSSize(width: loadedImage.size.width * ratio, height: loadedImage.size.height * ratio)
+                thumb = NSImage(size: newSize)
+                thumb.lockFocus()
+                loadedImage.draw(in: NSRect(origin: .zero, size: newSize))
+                thumb.unlockFocus()
+            }
+
+            ImageCatalog.shared.record(url: url, exif: exif, info: info, thumbnail: thumb)
 
             // Capture values for sendable closure
             nonisolated(unsafe) let finalWrapper = wrapper
@@ -116,158 +268,324 @@ class RAWImage: ObservableObject, Identifiable, Hashable {
 
             await MainActor.run {
                 self.sdkWrapper = finalWrapper
+                self.decodeGeneration += 1
+                self.contentKey = loadedContentKey
                 self.image = finalImage
-                self.processedImage = finalImage
+                self.processedImage = nil
                 self.thumbnail = finalThumb
                 self.exifData = finalExif
                 self.imageInfo = finalInfo
 
-                // Align WB controls with RAW as-shot baseline when Nikon provides Kelvin.
-                if let kelvin = finalExif?.colorTemperatureKelvin?.doubleValue, kelvin > 0 {
-                    self.adjustments.referenceTemperature = kelvin
-                    self.adjustments.referenceTint = 0
-                    self.adjustments.temperature = kelvin
-                    self.adjustments.tint = 0
+                if !self.hasLoadedOnce {
+                    // Align WB controls with RAW as-shot baseline when Nikon provides Kelvin.
+                    if let kelvin = finalExif?.colorTemperatureKelvin?.doubleValue, kelvin > 0 {
+                        self.adjustments.referenceTemperature = kelvin
+                        self.adjustments.referenceTint = 0
+                        self.adjustments.temperature = kelvin
+                        self.adjustments.tint = 0
+                    }
+                    if let exif = finalExif {
+                        self.adjustments.lensFocalLength = exif.focalLength
+                        self.adjustments.lensAperture = exif.fNumber
+                        if let lens = exif.lensInfo, let profile = LensProfileStore.shared.profile(matchingLens: lens) {
+                            self.adjustments.lensProfileID = profile.id
+                        }
+                    }
+                    self.hasLoadedOnce = true
                 }
+                self.renderViewport()
 
                 self.isLoading = false
             }
         }
     }
 
-    // MARK: - Native macOS Loading Methods
+    /// The file's catalog key, plus the colour space it is developed into. Only reads the file's
+    /// attributes, so it costs nothing before the first preview.
+    private nonisolated static func contentKey(of url: URL, colorSpace: NKOutputColorSpace) -> String? {
+        guard let key = ImageCatalog.Key(url: url) else { return nil }
+        return "\(key.path)|\(key.fileSize)|\(key.modificationTime)@\(colorSpace.rawValue)"
+    }
 
-    private nonisolated func loadImageNative(url: URL) -> NSImage? {
-        // Use NSImage's native loading which handles memory more efficiently
-        guard let image = NSImage(contentsOf: url) else {
-            return nil
-        }
+    /// Fills thumbnails and metadata from the on-disk catalog without opening SDK sessions.
+    /// Files missing from the catalog are scanned natively and then recorded: NEF/NRW with the
+    /// container parser, which only reads the IFDs and the smallest embedded preview, and JPEGs
+    /// with a DCT-scaled decode. Scans run concurrently, one per core.
+    static func restoreFromCatalog(_ images: [RAWImage]) {
+        let urls = images.map { $0.url }
+        Task.detached(priority: .utility) {
+            let width = max(1, ProcessInfo.processInfo.activeProcessorCount)
+
+            await withTaskGroup(of: (Int, ImageCatalog.Entry?).self) { group in
+                var next = 0
+                func enqueue() {
+                    guard next < urls.count else { return }
+                    let index = next
+                    let url = urls[index]
+                    next += 1
+                    group.addTask {
+                        nonisolated(unsafe) let entry = ImageCatalog.shared.entry(for: url) ?? scanNative(url: url)
+                        return (index, entry)
+                    }
+                }
 
-        // Get actual pixel dimensions from the image representation
-        if let rep = image.representations.first {
-            let pixelWidth = rep.pixelsWide
-            let pixelHeight = rep.pixelsHigh
-            if pixelWidth > 0 && pixelHeight > 0 {
-                image.size = NSSize(width: pixelWidth, height: pixelHeight)
+                for _ in 0..<width {
+                    enqueue()
+                }
+
+                while let (index, entry) = await group.next() {
+                    enqueue()
+                    guard let entry else { continue }
+                    nonisolated(unsafe) let cached = entry
+
+                    await MainActor.run {
+                        let image = images[index]
+                        if image.thumbnail == nil {
+                            image.thumbnail = cached.thumbnail
+                        }
+                        if image.exifData == nil {
+                            image.exifData = cached.exif
+                            image.imageInfo = cached.info
+                        }
+                    }
+                }
             }
         }
-
-        return image
     }
 
-    private nonisolated func loadEXIFNative(url: URL) -> NKEXIFData? {
-        guard let imageSource = CGImageSourceCreateWithURL(url as CFURL, nil),
-              let properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, nil) as? [String: Any] else {
-            return nil
-        }
-
-        let exifData = NKEXIFData()
-
-        // TIFF properties
-        if let tiff = properties[kCGImagePropertyTIFFDictionary as String] as? [String: Any] {
-            exifData.make = tiff[kCGImagePropertyTIFFMake as String] as? String
-            exifData.model = tiff[kCGImagePropertyTIFFModel as String] as? String
-            exifData.software = tiff[kCGImagePropertyTIFFSoftware as String] as? String
-            exifData.artist = tiff[kCGImagePropertyTIFFArtist as String] as? String
-            exifData.copyright = tiff[kCGImagePropertyTIFFCopyright as String] as? String
+    /// Reads metadata and a thumbnail from a NEF/NRW container or a JPEG without the Nikon SDK.
+    private nonisolated static func scanNative(url: URL) -> ImageCatalog.Entry? {
+        let ext = url.pathExtension.lowercased()
+        let isNikonRAW = ext == "nef" || ext == "nrw"
+        guard isNikonRAW || ext == "jpg" || ext == "jpeg" else { return nil }
 
-            if let dateString = tiff[kCGImagePropertyTIFFDateTime as String] as? String {
-                let formatter = DateFormatter()
-                formatter.dateFormat = "yyyy:MM:dd HH:mm:ss"
-                exifData.dateTime = formatter.date(from: dateString)
+        let isAccessing = url.startAccessingSecurityScopedResource()
+        defer {
+            if isAccessing {
+                url.stopAccessingSecurityScopedResource()
             }
         }
 
-        // EXIF properties
-        if let exif = properties[kCGImagePropertyExifDictionary as String] as? [String: Any] {
-            if let exposure = exif[kCGImagePropertyExifExposureTime as String] as? Double {
-                exifData.exposureTime = exposure
-            }
-            if let fNumber = exif[kCGImagePropertyExifFNumber as String] as? Double {
-                exifData.fNumber = fNumber
-            }
-            if let isoArray = exif[kCGImagePropertyExifISOSpeedRatings as String] as? [Int], let iso = isoArray.first {
-                exifData.iso = UInt(iso)
-            }
-            if let focal = exif[kCGImagePropertyExifFocalLength as String] as? Double {
-                exifData.focalLength = focal
-            }
-            if let bias = exif[kCGImagePropertyExifExposureBiasValue as String] as? Double {
-                exifData.exposureBias = bias
-            }
-            if let metering = exif[kCGImagePropertyExifMeteringMode as String] as? Int {
-                exifData.meteringMode = UInt(metering)
-            }
-            if let program = exif[kCGImagePropertyExifExposureProgram as String] as? Int {
-                exifData.exposureProgram = UInt(program)
-            }
-            if let flash = exif[kCGImagePropertyExifFlash as String] as? Int {
-                exifData.flash = UInt(flash)
-            }
-            if let lens = exif[kCGImagePropertyExifLensModel as String] as? String {
-                exifData.lensInfo = lens
-            }
+        let exif: NKEXIFData?
+        let info: NKImageInfo?
+        let thumbnail: NSImage?
+
+        if isNikonRAW {
+            guard let file = NKNEFFile(filePath: url.path) else { return nil }
+            exif = file.getEXIFData()
+            info = file.getImageInfo()
+            // Same point size as thumbnails drawn in load(); the extra pixels serve Retina
+            thumbnail = file.preview(withMinimumDimension: 160)
+                .flatMap { JPEGDecoder(data: $0.jpegData) }?
+                .thumbnailImage(pointSize: 80)
+        } else {
+            guard let decoder = JPEGDecoder(url: url) else { return nil }
+            exif = decoder.exifData()
+            info = decoder.imageInfo()
+            thumbnail = decoder.thumbnailImage(pointSize: 80)
         }
 
-        // File format for JPEG
-        exifData.fileFormat = 3 // JPEG
+        ImageCatalog.shared.record(url: url, exif: exif, info: info, thumbnail: thumbnail)
+        return ImageCatalog.Entry(exif: exif, info: info, thumbnail: thumbnail)
+    }
 
-        return exifData
+    func applyAdjustments() {
+        guard image != nil else { return }
+        adjustmentGeneration += 1
+        processedImage = nil
+        renderViewport(progressive: true)
     }
 
-    private nonisolated func loadImageInfoNative(url: URL, image: NSImage) -> NKImageInfo? {
-        guard let imageSource = CGImageSourceCreateWithURL(url as CFURL, nil),
-              let properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, nil) as? [String: Any] else {
-            return nil
-        }
+    func resetAdjustments() {
+        adjustments.reset()
+        applyAdjustments()
+    }
 
-        let info = NKImageInfo()
-        info.width = UInt(image.size.width)
-        info.height = UInt(image.size.height)
-        info.byteDepth = 1 // 8-bit for JPEG
-        info.colorType = 2 // RGB
+    // MARK: - Viewport Rendering
+
+    /// Called by the preview when its visible region or zoom changes.
+    /// - `visibleRect`: visible part of the frame in source pixels (top-left origin)
+    /// - `scale`: display pixels per source pixel at the current zoom
+    /// - `fitScale`: display pixels per source pixel when the whole frame fits
+    func updateViewport(visibleRect: CGRect, scale: CGFloat, fitScale: CGFloat) {
+        let newViewport = Viewport(visibleRect: visibleRect, scale: scale, fitScale: fitScale)
+        guard newViewport != viewport else { return }
+        viewport = newViewport
+        renderViewport()
+    }
 
-        if let orientation = properties[kCGImagePropertyOrientation as String] as? Int {
-            info.orientation = UInt(orientation)
+    /// Renders the base layer for the whole frame, then the visible tiles at zoom scale.
+    /// Only pixels that can be seen are processed; cached tiles are reused across pans.
+    /// - `progressive`: for edits, first presents a coarse frame immediately and refines once
+    ///   input has been quiet for `settleDelay`. New input cancels the task, which aborts any
+    ///   render still in flight between GPU passes.
+    private func renderViewport(progressive: Bool = false) {
+        guard let image, let viewport,
+              let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
+            return
         }
 
-        if let dpi = properties[kCGImagePropertyDPIWidth as String] as? Double {
-            info.resolution = dpi
+        // Abort the superseded render; if it never presented, the frame was dropped
+        processingTask?.cancel()
+        if isFramePending {
+            RenderStats.shared.recordDroppedFrame()
         }
+        isFramePending = true
 
-        return info
-    }
+        isProcessing = true
 
-    func applyAdjustments() {
-        guard let image = image else { return }
+        nonisolated(unsafe) let source = cgImage
+        let imageSize = image.size
+        let start = RenderStats.now()
+        let coarseLevelOffset = Self.interactiveLevelOffset
+        let settleDelay = Self.settleDelay
+
+        processingTask = Task.detached { [weak self, adjustments, renderSourceKey, contentKey] in
+            let renderer = ViewportRenderer.shared
+            let fitLevel = ViewportRenderer.level(for: viewport.fitScale)
+
+            if progressive {
+                let coarse = renderer.renderFrame(
+                    source: source,
+                    sourceKey: renderSourceKey,
+                    contentKey: contentKey,
+                    adjustments: adjustments,
+                    scale: ViewportRenderer.scale(forLevel: fitLevel + coarseLevelOffset),
+                    persistent: false
+                )
+                if Task.isCancelled { return }
+
+                nonisolated(unsafe) let coarseRender = coarse
+                await MainActor.run {
+                    guard let self = self, self.image != nil, let coarseRender else { return }
+                    self.previewImage = NSImage(cgImage: coarseRender.image, size: imageSize)
+                    // The detail layer still shows the previous adjustments
+                    self.detailImage = nil
+                    self.presentedFrame(since: start)
+                }
 
-        // Cancel previous processing
-        processingTask?.cancel()
+                try? await Task.sleep(nanoseconds: settleDelay)
+                if Task.isCancelled { return }
+            }
 
-        isProcessing = true
+            let frame = renderer.renderFrame(
+                source: source,
+                sourceKey: renderSourceKey,
+                contentKey: contentKey,
+                adjustments: adjustments,
+                scale: viewport.fitScale
+            )
+            if Task.isCancelled { return }
 
-        processingTask = Task.detached { [weak self, adjustments, image] in
-            let processed = ImageProcessor.shared.process(image: image, adjustments: adjustments)
+            nonisolated(unsafe) let frameRender = frame
+            await MainActor.run {
+                guard let self = self, self.image != nil, let frameRender else { return }
+                self.previewImage = NSImage(cgImage: frameRender.image, size: imageSize)
+                self.presentedFrame(since: start)
+            }
 
-            nonisolated(unsafe) let finalProcessed = processed
+            // The base layer is enough unless the zoom needs a finer scale level
+            var detail: ViewportRender?
+            if ViewportRenderer.level(for: viewport.scale) < fitLevel {
+                detail = renderer.renderVisible(
+                    source: source,
+                    sourceKey: renderSourceKey,
+                    adjustments: adjustments,
+                    scale: viewport.scale,
+                    visibleRect: viewport.visibleRect
+                )
+            }
+            if Task.isCancelled { return }
 
+            nonisolated(unsafe) let detailRender = detail
             await MainActor.run {
-                guard let self = self else { return }
-                self.processedImage = finalProcessed
+                guard let self = self, self.image != nil else { return }
+                self.detailImage = detailRender.map { NSImage(cgImage: $0.image, size: $0.sourceRect.size) }
+                self.detailRect = detailRender?.sourceRect ?? .zero
                 self.isProcessing = false
+                RenderStats.shared.recordRefine(since: start)
             }
         }
     }
 
-    func resetAdjustments() {
-        adjustments.reset()
-        processedImage = image
+    private func presentedFrame(since start: UInt64) {
+        guard isFramePending else { return }
+        isFramePending = false
+        RenderStats.shared.recordFrame(since: start)
+    }
+
+    /// Full-resolution render with the current adjustments, encoded in the output colour space
+    /// at 16 bits per channel. Upscaling and 8-bit quantization are applied by the exporter.
+    /// Cached in `processedImage` until the adjustments or the output colour space change, and
+    /// in `RenderCache`'s disk tier for exporting the same edit again later.
+    /// Always rendered, even without adjustments: decoded NEFs are stored linear.
+    func fullResolutionImage() async -> NSImage? {
+        let colorSpace = ImageProcessor.shared.outputColorSpace
+        if let processedImage, processedColorSpace == colorSpace {
+            return processedImage
+        }
+        guard let image else { return nil }
+
+        let generation = adjustmentGeneration
+        nonisolated(unsafe) let source = image
+        let rendered = await Task.detached(priority: .userInitiated) { [adjustments, renderSourceKey, contentKey] in
+            let cacheKey = contentKey.map {
+                RenderCache.Key(
+                    source: $0,
+                    adjustments: "\(ImageProcessor.shared.canonicalRenderKey(adjustments: adjustments))|\(colorSpace.rawValue)",
+                    level: RenderCache.Key.fullResolution
+                )
+            }
+            if let cacheKey, let cached = RenderCache.shared.image(for: cacheKey) {
+                return NSImage(cgImage: cached, size: source.size)
+            }
+
+            let rendered = ImageProcessor.shared.process(
+                image: source,
+                adjustments: adjustments,
+                sourceKey: renderSourceKey,
+                colorSpace: colorSpace.cgColorSpace,
+                format: .RGBA16
+            )
+            if let cacheKey, let cgImage = rendered?.cgImage(forProposedRect: nil, context: nil, hints: nil) {
+                RenderCache.shared.store(cgImage, for: cacheKey)
+            }
+            return rendered
+        }.value
+
+        if generation == adjustmentGeneration, self.image != nil {
+            processedImage = rendered
+            processedColorSpace = colorSpace
+        }
+        return rendered
+    }
+
+    /// Releases full-resolution bitmaps and the SDK session under memory pressure.
+    /// Thumbnail, metadata and adjustments are kept; `load()` re-decodes on next access.
+    func evictBitmaps() {
+        processingTask?.cancel()
+        processingTask = nil
+        isProcessing = false
+        isFramePending = false
+        sdkWrapper?.closeSession()
+        sdkWrapper = nil
+        ImageProcessor.shared.releaseIntermediates(for: renderSourceKey)
+        ViewportRenderer.shared.purge(sourceKey: renderSourceKey)
+        processedImage = nil
+        previewImage = nil
+        detailImage = nil
+        image = nil
     }
 
     func close() {
         sdkWrapper?.closeSession()
         sdkWrapper = nil
+        ImageProcessor.shared.releaseIntermediates(for: renderSourceKey)
+        ViewportRenderer.shared.purge(sourceKey: renderSourceKey)
         image = nil
+        processedImage = nil
+        previewImage = nil
+        detailImage = nil
         exifData = nil
         imageInfo = nil
     }
@@ -0,0 +1,282 @@
+//
+//  RenderCache.swift
+//  Dirty RAW
+//
+
+import Foundation
+import CoreGraphics
+import CryptoKit
+
+/// Finished renders keyed by content rather than by the objects that produced them, so going
+/// back to an earlier state (toggling an adjustment off and on, resetting, revisiting an image
+/// that was evicted, relaunching) returns the earlier render instead of rendering again.
+/// - Memory tier: LRU under a byte budget; holds whole-frame preview renders.
+/// - Disk tier: LZFSE-compressed bitmaps in Caches, pruned least recently used first. Also
+///   holds full-resolution export renders, which are too large to keep in memory twice.
+/// Keys combine `RAWImage.contentKey` (the file's identity and how it was decoded) with
+/// `ImageProcessor.canonicalRenderKey(adjustments:)`, which ignores parameters of inactive
+/// stages and is stable across launches.
+final class RenderCache {
+    static let shared = RenderCache()
+
+    private static let memoryBudgetDefaultsKey = "DirtyRAW.RenderResultCacheBudgetMB"
+    private static let diskBudgetDefaultsKey = "DirtyRAW.RenderDiskCacheBudgetMB"
+
+    struct Key: Hashable {
+        /// `RAWImage.contentKey`.
+        let source: String
+        /// `ImageProcessor.canonicalRenderKey(adjustments:)`.
+        let adjustments: String
+        /// `ViewportRenderer` scale level, or `Key.fullResolution`.
+        let level: Int
+
+        static let fullResolution = -1
+    }
+
+    private struct Entry {
+        let image: CGImage
+        let bytes: Int
+        var lastUse: UInt64
+    }
+
+    /// Pixel layout stored ahead of the compressed bitmap in a disk entry.
+    private struct FileHeader: Codable {
+        var width: Int
+        var height: Int
+        var bitsPerComponent: Int
+        var bitsPerPixel: Int
+        var bytesPerRow: Int
+        var bitmapInfo: UInt32
+        var colorSpace: Data
+    }
+
+    private let lock = NSLock()
+    private var entries: [Key: Entry] = [:]
+    private var useClock: UInt64 = 0
+    private var cachedBytes = 0 {
+        didSet { NKMemoryLedger.add(Int64(cachedBytes - oldValue), for: .renderCache, owner: 0) }
+    }
+    /// Disk writes and pruning, off the render path.
+    private let diskQueue = DispatchQueue(label: "DirtyRAW.RenderCache.disk", qos: .utility)
+
+    /// Maximum bytes of renders kept in memory.
+    var byteBudget: Int {
+        didSet {
+            UserDefaults.standard.set(byteBudget >> 20, forKey: Self.memoryBudgetDefaultsKey)
+            lock.lock()
+            evict(toFit: byteBudget)
+            lock.unlock()
+        }
+    }
+
+    /// Maximum bytes of compressed renders kept on disk; 0 turns the disk tier off.
+    var diskBudget: Int {
+        didSet {
+            UserDefaults.standard.set(diskBudget >> 20, forKey: Self.diskBudgetDefaultsKey)
+            let budget = diskBudget
+            diskQueue.async { self.pruneDisk(toFit: budget) }
+        }
+    }
+
+    private init() {
+        let defaults = UserDefaults.standard
+        let memoryMB = defaults.integer(forKey: Self.memoryBudgetDefaultsKey)
+        byteBudget = memoryMB > 0 ? memoryMB << 20 : 512 << 20
+        diskBudget = defaults.object(forKey: Self.diskBudgetDefaultsKey) != nil
+            ? defaults.integer(forKey: Self.diskBudgetDefaultsKey) << 20
+            : 2 << 30
+    }
+
+    // MARK: - Lookup
+
+    /// Cached render for `key` from memory, or from disk (which promotes it to memory).
+    func image(for key: Key) -> CGImage? {
+        lock.lock()
+        if entries[key] != nil {
+            useClock += 1
+            entries[key]?.lastUse = useClock
+            let image = entries[key]?.image
+            lock.unlock()
+            return image
+        }
+        let diskEnabled = diskBudget > 0
+        lock.unlock()
+
+        guard diskEnabled, let image = readFromDisk(key) else { return nil }
+        if key.level != Key.fullResolution {
+            storeInMemory(image, for: key)
+        }
+        return image
+    }
+
+    /// Keeps `image` as the render for `key`. Full-resolution renders only go to disk.
+    /// - `persistent`: also write it to the disk tier (skipped for throwaway interactive frames).
+    func store(_ image: CGImage, for key: Key, persistent: Bool = true) {
+        if key.level != Key.fullResolution {
+            storeInMemory(image, for: key)
+        }
+        guard persistent, diskBudget > 0 else { return }
+        let budget = diskBudget
+        diskQueue.async {
+            self.writeToDisk(image, for: key)
+            self.pruneDisk(toFit: budget)
+        }
+    }
+
+    /// Empties both tiers.
+    func removeAll() {
+        lock.lock()
+        entries.removeAll()
+        cachedBytes = 0
+        lock.unlock()
+        diskQueue.async {
+            guard let directory = try? Self.directory() else { return }
+            try? FileManager.default.removeItem(at: directory)
+        }
+    }
+
+    // MARK: - Memory Tier
+
+    private func storeInMemory(_ image: CGImage, for key: Key) {
+        let bytes = image.bytesPerRow * image.height
+
+        lock.lock()
+        defer { lock.unlock() }
+        guard bytes <= byteBudget else { return }
+
+        if let previous = entries[key] {
+            cachedBytes -= previous.bytes
+        }
+        useClock += 1
+        entries[key] = Entry(image: image, bytes: bytes, lastUse: useClock)
+        cachedBytes += bytes
+        evict(toFit: byteBudget)
+    }
+
+    /// Call with `lock` held.
+    private func evict(toFit budget: Int) {
+        guard cachedBytes > budget else { return }
+        let ordered = entries.sorted { $0.value.lastUse < $1.value.lastUse }
+        for (staleKey, entry) in ordered {
+            guard cachedBytes > budget else { break }
+            cachedBytes -= entry.bytes
+            entries[staleKey] = nil
+        }
+    }
+
+    // MARK: - Disk Tier
+
+    private static func directory() throws -> URL {
+        let caches = try FileManager.default.url(
+            for: .cachesDirectory,
+            in: .userDomainMask,
+            appropriateFor: nil,
+            create: true
+        )
+        return caches.appendingPathComponent("DirtyRAW", isDirectory: true)
+            .appendingPathComponent("Renders", isDirectory: true)
+    }
+
+    /// File for `key`. The app build is part of the name, so renders made by an older
+    /// pipeline are never returned; they age out through pruning.
+    private static func fileURL(for key: Key) throws -> URL {
+        let build = Bundle.main.infoDictionary?["CFBundleVersion"] as? String ?? ""
+        let name = "\(build)|\(key.source)|\(key.level)|\(key.adjustments)"
+        let digest = SHA256.hash(data: Data(name.utf8)).map { String(format: "%02x", $0) }.joined()
+        return try directory().appendingPathComponent(digest).appendingPathExtension("render")
+    }
+
+    private func writeToDisk(_ image: CGImage, for key: Key) {
+        guard let url = try? Self.fileURL(for: key),
+              !FileManager.default.fileExists(atPath: url.path),
+              let pixels = image.dataProvider?.data as Data?,
+              let compressed = try? (pixels as NSData).compressed(using: .lzfse) as Data,
+              let colorSpace = image.colorSpace?.copyICCData() as Data? else {
+            return
+        }
+
+        let header = FileHeader(
+            width: image.width,
+            height: image.height,
+            bitsPerComponent: image.bitsPerComponent,
+            bitsPerPixel: image.bitsPerPixel,
+            bytesPerRow: image.bytesPerRow,
+            bitmapInfo: image.bitmapInfo.rawValue,
+            colorSpace: colorSpace
+        )
+        guard let headerData = try? PropertyListEncoder().encode(header) else { return }
+
+        var file = Data()
+        var headerLength = UInt32(headerData.count).littleEndian
+        withUnsafeBytes(of: &headerLength) { file.append(contentsOf: $0) }
+        file.append(headerData)
+        file.append(compressed)
+
+        do {
+            try FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+            try file.write(to: url, options: .atomic)
+        } catch {
+            print("RenderCache: Failed to write \(url.lastPathComponent): \(error.localizedDescription)")
+        }
+    }
+
+    private func readFromDisk(_ key: Key) -> CGImage? {
+        guard let url = try? Self.fileURL(for: key),
+              let file = try? Data(contentsOf: url, options: .alwaysMapped),
+              file.count > 4 else {
+            return nil
+        }
+
+        let headerLength = Int(file.prefix(4).withUnsafeBytes { UInt32(littleEndian: $0.loadUnaligned(as: UInt32.self)) })
+        guard file.count > 4 + headerLength,
+              let header = try? PropertyListDecoder().decode(FileHeader.self, from: file.subdata(in: 4..<(4 + headerLength))),
+              let pixels = try? (file.subdata(in: (4 + headerLength)..<file.count) as NSData).decompressed(using: .lzfse) as Data,
+              pixels.count >= header.bytesPerRow * header.height,
+              let colorSpace = CGColorSpace(iccData: header.colorSpace as CFData),
+              let provider = CGDataProvider(data: pixels as CFData) else {
+            // Unreadable entries are dropped rather than retried on every lookup
+            try? FileManager.default.removeItem(at: url)
+            return nil
+        }
+
+        // Mark as recently used for pruning
+        try? FileManager.default.setAttributes([.modificationDate: Date()], ofItemAtPath: url.path)
+
+        return CGImage(
+            width: header.width,
+            height: header.height,
+            bitsPerComponent: header.bitsPerComponent,
+            bitsPerPixel: header.bitsPerPixel,
+            bytesPerRow: header.bytesPerRow,
+            space: colorSpace,
+            bitmapInfo: CGBitmapInfo(rawValue: header.bitmapInfo),
+            provider: provider,
+            decode: nil,
+            shouldInterpolate: true,
+            intent: .defaultIntent
+        )
+    }
+
+    /// Deletes the least recently used files until the tier fits `budget`.
+    private func pruneDisk(toFit budget: Int) {
+        let keys: [URLResourceKey] = [.fileSizeKey, .contentModificationDateKey]
+        guard let directory = try? Self.directory(),
+              let urls = try? FileManager.default.contentsOfDirectory(at: directory, includingPropertiesForKeys: keys) else {
+            return
+        }
+
+        var files = urls.compactMap { url -> (url: URL, bytes: Int, date: Date)? in
+            guard let values = try? url.resourceValues(forKeys: Set(keys)) else { return nil }
+            return (url, values.fileSize ?? 0, values.contentModificationDate ?? .distantPast)
+        }
+        var total = files.reduce(0) { $0 + $1.bytes }
+        guard total > budget else { return }
+
+        files.sort { $0.date < $1.date }
+        for file in files {
+            guard total > budget else { break }
+            try? FileManager.default.removeItem(at: file.url)
+            total -= file.bytes
+        }
+    }
+}
@@ -0,0 +1,335 @@
+//
+//  RenderGraph.swift
+//  Dirty RAW
+//
+
+import Foundation
+import CoreImage
+import Metal
+
+/// Storage format for cached stage outputs.
+enum IntermediatePrecision: Int, CaseIterable, Identifiable {
+    case rgba8 = 0
+    case rgba16Float = 1
+    case rgba32Float = 2
+
+    var id: Int { rawValue }
+
+    var displayName: String {
+        switch self {
+        case .rgba8: return "8-bit"
+        case .rgba16Float: return "16-bit float"
+        case .rgba32Float: return "32-bit float"
+        }
+    }
+
+    var pixelFormat: MTLPixelFormat {
+        switch self {
+        case .rgba8: return .rgba8Unorm
+        case .rgba16Float: return .rgba16Float
+        case .rgba32Float: return .rgba32Float
+        }
+    }
+
+    var ciFormat: CIFormat {
+        switch self {
+        case .rgba8: return .RGBA8
+        case .rgba16Float: return .RGBAh
+        case .rgba32Float: return .RGBAf
+        }
+    }
+
+    var bytesPerPixel: Int {
+        switch self {
+        case .rgba8: return 4
+        case .rgba16Float: return 8
+        case .rgba32Float: return 16
+        }
+    }
+
+    /// 8-bit intermediates stay gamma-encoded; float intermediates are stored linear.
+    var colorSpace: CGColorSpace {
+        switch self {
+        case .rgba8: return CGColorSpace(name: CGColorSpace.sRGB)!
+        case .rgba16Float, .rgba32Float: return CGColorSpace(name: CGColorSpace.extendedLinearSRGB)!
+        }
+    }
+}
+
+/// Where a stage's input sits in the image. Region renders crop the input and preview levels
+/// scale it, so stages that depend on position or pixel size (geometric corrections) read the
+/// frame instead of the input's extent.
+struct RenderFrame {
+    /// Full image extent at the render scale.
+    let extent: CGRect
+    /// Render pixels per source pixel (1 for full-resolution renders).
+    let scale: CGFloat
+}
+
+/// One node of the adjustment pipeline.
+struct RenderStage {
+    let name: String
+    /// Expensive stages materialize their output into the intermediate cache so edits to
+    /// downstream stages resume from here instead of re-running them. Cheap colour stages
+    /// between checkpoints stay lazy and are fused by Core Image.
+    let isCheckpoint: Bool
+    let isActive: (ImageAdjustments) -> Bool
+    /// Every parameter that affects this stage's output; hashed into the stage key.
+    let parameters: (ImageAdjustments) -> AnyHashable
+    let apply: (CIImage, ImageAdjustments, RenderFrame) -> CIImage
+    /// Extra input pixels each side that the stage reads to produce an output pixel
+    /// (in working-resolution pixels). Used to pad region-of-interest requests.
+    var halo: (ImageAdjustments, RenderFrame) -> CGFloat = { _, _ in 0 }
+}
+
+/// Linear stage graph with a bounded cache of materialized checkpoint outputs.
+/// A stage's key is hash(upstream key, stage name, stage parameters), so a parameter change
+/// only invalidates the edited stage and everything downstream of it.
+final class RenderGraph {
+    private struct CachedOutput {
+        let sourceKey: AnyHashable
+        let image: CIImage
+        let bytes: Int
+        var lastUse: UInt64
+    }
+
+    let stages: [RenderStage]
+    private let materialize: (CIImage, IntermediatePrecision) -> CIImage?
+
+    private let lock = NSLock()
+    private var cache: [Int: CachedOutput] = [:]
+    private var useClock: UInt64 = 0
+    private var _cachedBytes = 0 {
+        didSet { NKMemoryLedger.add(Int64(_cachedBytes - oldValue), for: .renderIntermediates, owner: 0) }
+    }
+    private var _byteBudget: Int
+    private var _precision: IntermediatePrecision
+
+    init(
+        stages: [RenderStage],
+        byteBudget: Int,
+        precision: IntermediatePrecision,
+        materialize: @escaping (CIImage, IntermediatePrecision) -> CIImage?
+    ) {
+        self.stages = stages
+        self._byteBudget = byteBudget
+        self._precision = precision
+        self.materialize = materialize
+    }
+
+    var byteBudget: Int {
+        get { lock.lock(); defer { lock.unlock() }; return _byteBudget }
+        set {
+            lock.lock()
+            _byteBudget = newValue
+            evictLocked()
+            lock.unlock()
+        }
+    }
+
+    /// Changing precision drops every cached intermediate.
+    var precision: IntermediatePrecision {
+        get { lock.lock(); defer { lock.unlock() }; return _precision }
+        set {
+            lock.lock()
+            if newValue != _precision {
+                _precision = newValue
+                cache.removeAll()
+                _cachedBytes = 0
+            }
+            lock.unlock()
+        }
+    }
+
+    var cachedBytes: Int {
+        lock.lock()
+        defer { lock.unlock() }
+        return _cachedBytes
+    }
+
+    func hasActiveStages(_ adjustments: ImageAdjustments) -> Bool {
+        stages.contains { $0.isActive(adjustments) }
+    }
+
+    /// Runs the pipeline, resuming from the deepest cached checkpoint that is still valid.
+    /// - `sourceKey`: identifies the source bitmap; `nil` bypasses the intermediate cache.
+    /// - `variant`: distinguishes derived sources sharing a key (e.g. downscaled render levels).
+    /// - `scale`: render pixels per source pixel of a downscaled `source`, passed to stages.
+    /// - `region`: when set, only this output rect is produced. The request is propagated
+    ///   backwards through the stages, growing by each active stage's halo, and every stage's
+    ///   output is cropped to what downstream stages need. Partial renders resume from a
+    ///   full-frame checkpoint when there is one, and otherwise from (and into) checkpoints
+    ///   keyed by the rect the stage produced, so a viewport tile re-renders only from the
+    ///   edited stage on like a whole frame does.
+    /// - `isCancelled`: polled around each checkpoint render; returns nil once it reports true so
+    ///   superseded renders stop before the remaining GPU passes are submitted.
+    func evaluate(
+        source: CIImage,
+        sourceKey: AnyHashable?,
+        variant: Int = 0,
+        scale: CGFloat = 1,
+        adjustments: ImageAdjustments,
+        region: CGRect? = nil,
+        isCancelled: () -> Bool = { false }
+    ) -> CIImage? {
+        let precision = self.precision
+        let extent = source.extent
+        let frame = RenderFrame(extent: extent, scale: scale)
+        let isPartial = region.map { !$0.contains(extent) } ?? false
+
+        // Stage keys: inactive stages pass their upstream key through unchanged.
+        var keys: [Int] = []
+        keys.reserveCapacity(stages.count)
+        var hasher = Hasher()
+        hasher.combine(sourceKey)
+        hasher.combine(variant)
+        hasher.combine(precision.rawValue)
+        var key = hasher.finalize()
+        for stage in stages {
+            if stage.isActive(adjustments) {
+                var stageHasher = Hasher()
+                stageHasher.combine(key)
+                stageHasher.combine(stage.name)
+                stageHasher.combine(stage.parameters(adjustments))
+                key = stageHasher.finalize()
+            }
+            keys.append(key)
+        }
+
+        // Backward ROI pass: required[i] is the output rect stage i must produce.
+        var required = Array(repeating: extent, count: stages.count)
+        var requiredSource = extent
+        if let region {
+            var rect = region.intersection(extent)
+            for index in stride(from: stages.count - 1, through: 0, by: -1) {
+                required[index] = rect
+                let stage = stages[index]
+                if stage.isActive(adjustments) {
+                    let halo = stage.halo(adjustments, frame)
+                    rect = rect.insetBy(dx: -halo, dy: -halo).intersection(extent).integral
+                }
+            }
+            requiredSource = rect
+        }
+
+        var image = isPartial ? source.cropped(to: requiredSource) : source
+        var startIndex = 0
+
+        if let sourceKey {
+            lock.lock()
+            for index in stride(from: stages.count - 1, through: 0, by: -1) {
+                let stage = stages[index]
+                guard stage.isCheckpoint, stage.isActive(adjustments) else { continue }
+                let candidates = isPartial ? [keys[index], Self.regionKey(keys[index], rect: required[index])] : [keys[index]]
+                guard let cacheKey = candidates.first(where: { cache[$0]?.sourceKey == sourceKey }),
+                      let hit = cache[cacheKey] else {
+                    continue
+                }
+                useClock += 1
+                cache[cacheKey]?.lastUse = useClock
+                image = isPartial ? hit.image.cropped(to: required[index]) : hit.image
+                startIndex = index + 1
+                break
+            }
+            lock.unlock()
+        }
+
+        for index in startIndex..<stages.count {
+            let stage = stages[index]
+            guard stage.isActive(adjustments) else { continue }
+
+            image = stage.apply(image, adjustments, frame).cropped(to: required[index])
+
+            if stage.isCheckpoint, let sourceKey {
+                if isCancelled() { return nil }
+                if let materialized = materialize(image, precision) {
+                    image = materialized
+                    let cacheKey = isPartial ? Self.regionKey(keys[index], rect: required[index]) : keys[index]
+                    store(materialized, key: cacheKey, sourceKey: sourceKey, precision: precision)
+                }
+            }
+        }
+
+        return isCancelled() ? nil : image
+    }
+
+    /// Key of the final stage output, e.g. for caching rendered tiles.
+    func outputKey(sourceKey: AnyHashable, variant: Int = 0, adjustments: ImageAdjustments) -> Int {
+        var hasher = Hasher()
+        hasher.combine(sourceKey)
+        hasher.combine(variant)
+        for stage in stages where stage.isActive(adjustments) {
+            hasher.combine(stage.name)
+            hasher.combine(stage.parameters(adjustments))
+        }
+        return hasher.finalize()
+    }
+
+    /// Description of what the active stages do with `adjustments`. Unlike `outputKey` it is
+    /// the same in every launch (`Hasher` is seeded per process), so it can key renders on disk.
+    func canonicalKey(adjustments: ImageAdjustments) -> String {
+        stages
+            .filter { $0.isActive(adjustments) }
+            .map { "\($0.name)=\(String(reflecting: $0.parameters(adjustments)))" }
+            .joined(separator: ";")
+    }
+
+    /// Drops intermediates derived from `sourceKey` (e.g. when the source bitmap is released).
+    func purge(sourceKey: AnyHashable) {
+        lock.lock()
+        for (key, entry) in cache where entry.sourceKey == sourceKey {
+            _cachedBytes -= entry.bytes
+            cache[key] = nil
+        }
+        lock.unlock()
+    }
+
+    func purgeAll() {
+        lock.lock()
+        cache.removeAll()
+        _cachedBytes = 0
+        lock.unlock()
+    }
+
+    // MARK: - Private
+
+    /// Key of a stage output cropped to `rect`. Tiles of a level cover the same rects on every
+    /// render, so their checkpoints are found again after an edit.
+    private static func regionKey(_ key: Int, rect: CGRect) -> Int {
+        var hasher = Hasher()
+        hasher.combine(key)
+        hasher.combine(rect.minX)
+        hasher.combine(rect.minY)
+        hasher.combine(rect.width)
+        hasher.combine(rect.height)
+        return hasher.finalize()
+    }
+
+    private func store(_ image: CIImage, key: Int, sourceKey: AnyHashable, precision: IntermediatePrecision) {
+        let bytes = Int(image.extent.width) * Int(image.extent.height) * precision.bytesPerPixel
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        // Precision changed while rendering: the result is still valid for this frame only.
+        guard precision == _precision, bytes <= _byteBudget else { return }
+
+        if let previous = cache[key] {
+            _cachedBytes -= previous.bytes
+        }
+        useClock += 1
+        cache[key] = CachedOutput(sourceKey: sourceKey, image: image, bytes: bytes, lastUse: useClock)
+        _cachedBytes += bytes
+        evictLocked()
+    }
+
+    private func evictLocked() {
+        guard _cachedBytes > _byteBudget else { return }
+        let ordered = cache.sorted { $0.value.lastUse < $1.value.lastUse }
+        for (key, entry) in ordered {
+            guard _cachedBytes > _byteBudget else { break }
+            _cachedBytes -= entry.bytes
+            cache[key] = nil
+        }
+    }
+}
@@ -0,0 +1,61 @@
+//
+//  RenderStats.swift
+//  Dirty RAW
+//
+
+import Foundation
+import Combine
+
+/// Preview responsiveness counters shown in the zoom bar.
+/// - Frame time: from an edit (or viewport change) to the first frame that reflects it
+/// - Refine time: from the same input to the full-quality frame
+/// - Dropped frames: renders superseded by newer input before anything was presented
+/// - Worker load: how busy the native job system's workers were since the previous refine
+@MainActor
+final class RenderStats: ObservableObject {
+    static let shared = RenderStats()
+
+    @Published private(set) var lastFrameTime: TimeInterval = 0
+    @Published private(set) var averageFrameTime: TimeInterval = 0
+    @Published private(set) var lastRefineTime: TimeInterval = 0
+    @Published private(set) var droppedFrames = 0
+    @Published private(set) var workerUtilization: Double = 0
+
+    /// Weight of the newest sample in the running average.
+    private let smoothing = 0.2
+
+    private init() {}
+
+    func recordFrame(since start: UInt64) {
+        let elapsed = Self.seconds(since: start)
+        lastFrameTime = elapsed
+        averageFrameTime = averageFrameTime == 0 ? elapsed : averageFrameTime + (elapsed - averageFrameTime) * smoothing
+    }
+
+    func recordRefine(since start: UInt64) {
+        lastRefineTime = Self.seconds(since: start)
+        let utilization = NKJobSystem.sampleWorkerUtilization().map(\.doubleValue)
+        workerUtilization = utilization.isEmpty ? 0 : utilization.reduce(0, +) / Double(utilization.count)
+    }
+
+    func recordDroppedFrame() {
+        droppedFrames += 1
+    }
+
+    func reset() {
+        lastFrameTime = 0
+        averageFrameTime = 0
+        lastRefineTime = 0
+        droppedFrames = 0
+        workerUtilization = 0
+    }
+
+    /// Monotonic timestamp for `recordFrame(since:)` / `recordRefine(since:)`.
+    nonisolated static func now() -> UInt64 {
+        DispatchTime.now().uptimeNanoseconds
+    }
+
+    private static func seconds(since start: UInt64) -> TimeInterval {
+        TimeInterval(DispatchTime.now().uptimeNanoseconds - start) / 1_000_000_000
+    }
+}
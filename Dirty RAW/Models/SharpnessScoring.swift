@@ -0,0 +1,112 @@
+//
+//  SharpnessScoring.swift
+//  Dirty RAW
+//
+
+import Foundation
+
+/// Ranks frames by focus for culling, see `NKSharpnessScorer`. Scores and their heatmaps are
+/// stored in the image catalog per file version, so they survive relaunches and the image list
+/// sorts by them like any EXIF column. Scores depend on the weighting, so changing it rescores.
+enum SharpnessScoring {
+
+    enum Weighting: Int, CaseIterable, Identifiable {
+        case peak = 0
+        case centre = 1
+        case faces = 2
+
+        var id: Int { rawValue }
+
+        var displayName: String {
+            switch self {
+            case .peak: return "Sharpest Area"
+            case .centre: return "Centre"
+            case .faces: return "Faces"
+            }
+        }
+
+        fileprivate var native: NKSharpnessWeighting {
+            switch self {
+            case .peak: return .peak
+            case .centre: return .centre
+            case .faces: return .faces
+            }
+        }
+    }
+
+    struct Score {
+        /// RMS Laplacian of the preview in 8-bit luma levels; higher is sharper. Comparable
+        /// between frames of similar content, not an absolute grade.
+        let value: Double
+        /// Same measure per region, row-major from the top left of the upright frame,
+        /// `gridSize` × `gridSize` values.
+        let heatmap: [Float]
+    }
+
+    static var gridSize: Int { NKSharpnessScorer.heatmapGridSize }
+
+    private static let weightingDefaultsKey = "DirtyRAW.SharpnessWeighting"
+    /// Heatmap values are stored as UInt16 in steps of 1/32 luma level.
+    private static let heatmapScale: Float = 32
+    /// Stored with the weighting; bumped when the measurement changes, so scores made the old
+    /// way are redone rather than ranked against new ones. 1: fixed analysis size.
+    private static let measurementRevision = 1
+
+    static var weighting: Weighting {
+        get { Weighting(rawValue: UserDefaults.standard.integer(forKey: weightingDefaultsKey)) ?? .peak }
+        set { UserDefaults.standard.set(newValue.rawValue, forKey: weightingDefaultsKey) }
+    }
+
+    /// The stored score of `url` under `weighting`, if scored since the file last changed.
+    static func score(for url: URL, weighting: Weighting = SharpnessScoring.weighting) -> Score? {
+        guard let stored = ImageCatalog.shared.sharpness(for: url),
+              stored.weighting == storedWeighting(weighting) else {
+            return nil
+        }
+        return Score(value: stored.score, heatmap: decodeHeatmap(stored.heatmap))
+    }
+
+    /// Scores the files of `urls` without a current score under `weighting` and stores the
+    /// results in the catalog. Files the catalog doesn't know (rendered TIFFs) are scored but
+    /// not kept. Returns false if `progress` cancelled (it gets the finished fraction and
+    /// returns false to cancel). Blocks; call off the main thread.
+    @discardableResult
+    static func score(_ urls: [URL], weighting: Weighting = SharpnessScoring.weighting,
+                      progress: @escaping (Double) -> Bool = { _ in true }) -> Bool {
+        let missing = urls.filter { score(for: $0, weighting: weighting) == nil }
+        guard !missing.isEmpty else { return progress(1) }
+
+        guard let results = NKSharpnessScorer.scores(paths: missing.map { $0.path },
+                                                     weighting: weighting.native,
+                                                     progress: progress) else {
+            return false
+        }
+        for (url, result) in zip(missing, results) {
+            guard let result = result as? NKSharpnessResult else { continue }
+            ImageCatalog.shared.recordSharpness(url: url, score: result.score, weighting: storedWeighting(weighting),
+                                                heatmap: encodeHeatmap(result.heatmap))
+        }
+        return true
+    }
+
+    /// Weighting column value: the weighting in the low bits, the measurement revision above.
+    private static func storedWeighting(_ weighting: Weighting) -> Int {
+        measurementRevision << 4 | weighting.rawValue
+    }
+
+    // MARK: - Heatmap Encoding
+
+    /// Base64 of little-endian UInt16 values: about 170 characters per catalog row.
+    private static func encodeHeatmap(_ data: Data) -> String {
+        let values = data.withUnsafeBytes { Array($0.bindMemory(to: Float.self)) }
+        let fixed = values.map { UInt16(min(max($0 * heatmapScale, 0), Float(UInt16.max)).rounded()).littleEndian }
+        return fixed.withUnsafeBytes { Data($0) }.base64EncodedString()
+    }
+
+    private static func decodeHeatmap(_ string: String) -> [Float] {
+        guard let data = Data(base64Encoded: string) else { return [] }
+        return data.withUnsafeBytes { raw in
+            (0..<(raw.count / 2)).map { Float(UInt16(littleEndian: raw.loadUnaligned(fromByteOffset: $0 * 2, as: UInt16.self))) / heatmapScale }
+        }
+    }
+}
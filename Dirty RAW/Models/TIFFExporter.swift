@@ -7,6 +7,8 @@ import Foundation
 import AppKit
 import UniformTypeIdentifiers
 
+/// Uncompressed TIFF through ImageIO, which keeps half-float images (stacks, HDR merges) in
+/// float. Edited images are exported by `ImageExporter`.
 class TIFFExporter {
 
     enum ExportError: LocalizedError {
@@ -26,11 +28,27 @@ class TIFFExporter {
         }
     }
 
-    static func export(image: NSImage, to url: URL, bitDepth: Int = 16) throws {
-        guard let cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
+    /// Writes `image` as an uncompressed TIFF with `bitDepth` bits per channel. Deeper sources are
+    /// quantized to 8 bits with ordered dithering, so gradients don't band. With `upscaleFactor` > 1
+    /// the CPU upscaler computes output rows as ImageIO writes them; upscaling and dithering run in
+    /// the same row stream, so the output frame never exists in memory.
+    static func export(image: NSImage, to url: URL, bitDepth: Int = 16, upscaleFactor: Double = 1) throws {
+        guard var cgImage = image.cgImage(forProposedRect: nil, context: nil, hints: nil) else {
             throw ExportError.noImage
         }
 
+        let quantize = bitDepth == 8 && cgImage.bitsPerComponent > 8
+        if upscaleFactor > 1 || quantize {
+            guard let streamed = NKExportStream.makeImage(
+                from: cgImage,
+                upscaleFactor: max(upscaleFactor, 1),
+                bitsPerComponent: bitDepth == 8 ? 8 : 16
+            ) else {
+                throw ExportError.noImage
+            }
+            cgImage = streamed
+        }
+
         guard let destination = CGImageDestinationCreateWithURL(
             url as CFURL,
             UTType.tiff.identifier as CFString,
@@ -0,0 +1,280 @@
+//
+//  ViewportRenderer.swift
+//  Dirty RAW
+//
+
+import Foundation
+import CoreGraphics
+
+/// A rendered region of an image, positioned in source pixel coordinates (top-left origin).
+struct ViewportRender {
+    let image: CGImage
+    /// Region of the source frame covered by `image`.
+    let sourceRect: CGRect
+    /// Render scale relative to the source (1 = one output pixel per source pixel).
+    let scale: CGFloat
+}
+
+/// Renders only the visible part of an image, in fixed-size tiles at snapped scale levels.
+/// - Scales are snapped up to 2^(-n/2) so small zoom changes reuse the same tiles.
+/// - Tiles are cached by (source, rendered output, level, column, row); panning only renders
+///   tiles that were not visible before, and an adjustment change invalidates by key.
+final class ViewportRenderer {
+    static let shared = ViewportRenderer()
+
+    static let tileSize = 512
+
+    private struct TileKey: Hashable {
+        let sourceKey: String
+        let renderKey: Int
+        let level: Int
+        let column: Int
+        let row: Int
+    }
+
+    private struct Tile {
+        let image: CGImage
+        let bytes: Int
+        var lastUse: UInt64
+    }
+
+    private let lock = NSLock()
+    private var tiles: [TileKey: Tile] = [:]
+    private var useClock: UInt64 = 0
+    private var cachedBytes = 0 {
+        didSet { NKMemoryLedger.add(Int64(cachedBytes - oldValue), for: .viewportTiles, owner: 0) }
+    }
+    /// Display tiles are screen-sized, so a small budget covers many pans and zoom levels.
+    private let byteBudget = 256 << 20
+
+    private init() {}
+
+    // MARK: - Scale Levels
+
+    /// Index of the smallest 2^(-n/2) level that is at least `scale` (0 = full resolution).
+    static func level(for scale: CGFloat) -> Int {
+        guard scale > 0, scale < 1 else { return 0 }
+        // Epsilon keeps exact level scales (e.g. `scale(forLevel: 3)`) on their own level
+        return max(Int((-2 * log2(scale) + 1e-6).rounded(.down)), 0)
+    }
+
+    static func scale(forLevel level: Int) -> CGFloat {
+        pow(2, -CGFloat(level) / 2)
+    }
+
+    // MARK: - Rendering
+
+    /// Renders the whole frame at `scale` as a single image (used as the zoomed-out base layer).
+    /// Rendering the full extent lets the render graph cache checkpoints for this level.
+    /// With a `contentKey` (see `RAWImage.contentKey`) frames are also kept in `RenderCache`,
+    /// which outlives the source bitmap; `persistent` frames are written to its disk tier.
+    /// Returns nil if the task was cancelled mid-render.
+    func renderFrame(
+        source: CGImage,
+        sourceKey: String,
+        contentKey: String? = nil,
+        adjustments: ImageAdjustments,
+        scale: CGFloat,
+        persistent: Bool = true
+    ) -> ViewportRender? {
+        let level = Self.level(for: scale)
+        let levelScale = Self.scale(forLevel: level)
+        let processor = ImageProcessor.shared
+        let key = TileKey(
+            sourceKey: sourceKey,
+            renderKey: processor.renderKey(sourceKey: sourceKey, adjustments: adjustments),
+            level: level,
+            column: -1,
+            row: -1
+        )
+        let sourceRect = CGRect(x: 0, y: 0, width: source.width, height: source.height)
+
+        if let cached = cachedTile(for: key) {
+            return ViewportRender(image: cached, sourceRect: sourceRect, scale: levelScale)
+        }
+
+        let resultKey = contentKey.map {
+            RenderCache.Key(source: $0, adjustments: processor.canonicalRenderKey(adjustments: adjustments), level: level)
+        }
+        if let resultKey, let cached = RenderCache.shared.image(for: resultKey) {
+            store(cached, for: key)
+            return ViewportRender(image: cached, sourceRect: sourceRect, scale: levelScale)
+        }
+
+        let scaledSize = Self.scaledSize(of: source, scale: levelScale)
+        guard let image = processor.renderRegion(
+            source: source,
+            sourceKey: sourceKey,
+            adjustments: adjustments,
+            scale: levelScale,
+            rect: CGRect(origin: .zero, size: scaledSize),
+            isCancelled: { Task.isCancelled }
+        ) else {
+            return nil
+        }
+
+        store(image, for: key)
+        if let resultKey {
+            RenderCache.shared.store(image, for: resultKey, persistent: persistent)
+        }
+        return ViewportRender(image: image, sourceRect: sourceRect, scale: levelScale)
+    }
+
+    /// Whole-frame render at `scale` from `RenderCache` alone, without the source bitmap; used to
+    /// show an image that is still decoding the way it was last rendered.
+    func cachedFrame(contentKey: String, adjustments: ImageAdjustments, scale: CGFloat) -> CGImage? {
+        let key = RenderCache.Key(
+            source: contentKey,
+            adjustments: ImageProcessor.shared.canonicalRenderKey(adjustments: adjustments),
+            level: Self.level(for: scale)
+        )
+        return RenderCache.shared.image(for: key)
+    }
+
+    /// Renders the tiles intersecting `visibleRect` (source pixels, top-left origin) at `scale`
+    /// and composes them into one image. Returns nil if the task was cancelled or nothing is visible.
+    func renderVisible(
+        source: CGImage,
+        sourceKey: String,
+        adjustments: ImageAdjustments,
+        scale: CGFloat,
+        visibleRect: CGRect
+    ) -> ViewportRender? {
+        let level = Self.level(for: scale)
+        let levelScale = Self.scale(forLevel: level)
+        let processor = ImageProcessor.shared
+        let renderKey = processor.renderKey(sourceKey: sourceKey, adjustments: adjustments)
+
+        let scaledSize = Self.scaledSize(of: source, scale: levelScale)
+        let scaledBounds = CGRect(origin: .zero, size: scaledSize)
+        let visible = CGRect(
+            x: visibleRect.minX * levelScale,
+            y: visibleRect.minY * levelScale,
+            width: visibleRect.width * levelScale,
+            height: visibleRect.height * levelScale
+        ).intersection(scaledBounds)
+        guard !visible.isNull, !visible.isEmpty else { return nil }
+
+        let tileSize = Self.tileSize
+        let firstColumn = Int(visible.minX) / tileSize
+        let lastColumn = (Int(visible.maxX.rounded(.up)) - 1) / tileSize
+        let firstRow = Int(visible.minY) / tileSize
+        let lastRow = (Int(visible.maxY.rounded(.up)) - 1) / tileSize
+
+        // Union of the visible tiles in scaled top-left coordinates
+        let originX = firstColumn * tileSize
+        let originY = firstRow * tileSize
+        let coveredWidth = min((lastColumn + 1) * tileSize, Int(scaledSize.width)) - originX
+        let coveredHeight = min((lastRow + 1) * tileSize, Int(scaledSize.height)) - originY
+        guard coveredWidth > 0, coveredHeight > 0,
+              let canvas = CGContext(
+                data: nil,
+                width: coveredWidth,
+                height: coveredHeight,
+                bitsPerComponent: 8,
+                bytesPerRow: 0,
+                space: CGColorSpace(name: CGColorSpace.sRGB)!,
+                bitmapInfo: CGImageAlphaInfo.premultipliedLast.rawValue
+              ) else {
+            return nil
+        }
+
+        for row in firstRow...lastRow {
+            for column in firstColumn...lastColumn {
+                if Task.isCancelled { return nil }
+
+                let x = column * tileSize
+                let y = row * tileSize
+                let width = min(tileSize, Int(scaledSize.width) - x)
+                let height = min(tileSize, Int(scaledSize.height) - y)
+                guard width > 0, height > 0 else { continue }
+
+                let key = TileKey(sourceKey: sourceKey, renderKey: renderKey, level: level, column: column, row: row)
+                var tile = cachedTile(for: key)
+                if tile == nil {
+                    // Core Image uses a bottom-left origin
+                    let ciRect = CGRect(x: x, y: Int(scaledSize.height) - y - height, width: width, height: height)
+                    tile = processor.renderRegion(
+                        source: source,
+                        sourceKey: sourceKey,
+                        adjustments: adjustments,
+                        scale: levelScale,
+                        rect: ciRect,
+                        isCancelled: { Task.isCancelled }
+                    )
+                    if let tile {
+                        store(tile, for: key)
+                    }
+                }
+                guard let tile else { continue }
+
+                // CGContext also uses a bottom-left origin
+                canvas.draw(tile, in: CGRect(
+                    x: x - originX,
+                    y: coveredHeight - (y - originY) - height,
+                    width: width,
+                    height: height
+                ))
+            }
+        }
+
+        guard let composed = canvas.makeImage() else { return nil }
+        let sourceRect = CGRect(
+            x: CGFloat(originX) / levelScale,
+            y: CGFloat(originY) / levelScale,
+            width: CGFloat(coveredWidth) / levelScale,
+            height: CGFloat(coveredHeight) / levelScale
+        ).intersection(CGRect(x: 0, y: 0, width: source.width, height: source.height))
+        return ViewportRender(image: composed, sourceRect: sourceRect, scale: levelScale)
+    }
+
+    /// Drops every tile rendered from `sourceKey`.
+    func purge(sourceKey: String) {
+        lock.lock()
+        for (key, tile) in tiles where key.sourceKey == sourceKey {
+            cachedBytes -= tile.bytes
+            tiles[key] = nil
+        }
+        lock.unlock()
+    }
+
+    // MARK: - Private
+
+    private static func scaledSize(of source: CGImage, scale: CGFloat) -> CGSize {
+        CGSize(
+            width: (CGFloat(source.width) * scale).rounded(.up),
+            height: (CGFloat(source.height) * scale).rounded(.up)
+        )
+    }
+
+    private func cachedTile(for key: TileKey) -> CGImage? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard tiles[key] != nil else { return nil }
+        useClock += 1
+        tiles[key]?.lastUse = useClock
+        return tiles[key]?.image
+    }
+
+    private func store(_ image: CGImage, for key: TileKey) {
+        let bytes = image.bytesPerRow * image.height
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        if let previous = tiles[key] {
+            cachedBytes -= previous.bytes
+        }
+        useClock += 1
+        tiles[key] = Tile(image: image, bytes: bytes, lastUse: useClock)
+        cachedBytes += bytes
+
+        guard cachedBytes > byteBudget else { return }
+        let ordered = tiles.sorted { $0.value.lastUse < $1.value.lastUse }
+        for (staleKey, tile) in ordered {
+            guard cachedBytes > byteBudget else { break }
+            cachedBytes -= tile.bytes
+            tiles[staleKey] = nil
+        }
+    }
+}
@@ -0,0 +1,35 @@
+//
+//  NEFFile.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+#import "NikonSDKWrapper.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// An embedded JPEG preview. `jpegData` references the memory-mapped file without copying.
+@interface NKNEFPreview : NSObject
+@property (nonatomic, readonly) NSUInteger width;
+@property (nonatomic, readonly) NSUInteger height;
+@property (nonatomic, readonly) NSData *jpegData;
+@end
+
+/// Reads NEF/NRW metadata and embedded previews with the native TIFF parser, without opening
+/// a Nikon SDK session. Only the pages holding IFDs (and any preview that is read) are loaded.
+@interface NKNEFFile : NSObject
+
+- (nullable instancetype)initWithFilePath:(NSString *)filePath;
+
+/// Embedded JPEG previews, largest first.
+@property (nonatomic, readonly) NSArray<NKNEFPreview *> *previews;
+
+- (NKEXIFData *)getEXIFData;
+- (NKImageInfo *)getImageInfo;
+
+/// Smallest preview whose longer side is at least `dimension` pixels, else the largest one.
+- (nullable NKNEFPreview *)previewWithMinimumDimension:(NSUInteger)dimension;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,150 @@
+//
+//  NEFFile.mm
+//  Dirty RAW
+//
+
+#import "NEFFile.h"
+
+#include "Native/NEFParser.hpp"
+
+#include <memory>
+#include <string>
+
+static NSString * _Nullable NKStringFromStd(const std::string &value) {
+    if (value.empty()) return nil;
+    NSString *string = [[NSString alloc] initWithBytes:value.data() length:value.size() encoding:NSUTF8StringEncoding];
+    // EXIF ASCII fields are not always valid UTF-8
+    return string ?: [[NSString alloc] initWithBytes:value.data() length:value.size() encoding:NSISOLatin1StringEncoding];
+}
+
+/// Maps the MakerNote white balance name to the SDK's kNkfl_WhiteBalance_* values.
+static NSUInteger NKWhiteBalanceFromName(NSString *name) {
+    NSString *upper = name.uppercaseString;
+    if ([upper hasPrefix:@"AUTO"]) return 0x00;
+    if ([upper hasPrefix:@"INCANDESCENT"] || [upper hasPrefix:@"TUNGSTEN"]) return 0x01;
+    if ([upper hasPrefix:@"FLUORESCENT"] || [upper hasPrefix:@"FLUOR"]) return 0x02;
+    if ([upper hasPrefix:@"SUNNY"] || [upper hasPrefix:@"DIRECT SUNLIGHT"]) return 0x03;
+    if ([upper hasPrefix:@"FLASH"] || [upper hasPrefix:@"SPEEDLIGHT"]) return 0x04;
+    if ([upper hasPrefix:@"SHADE"]) return 0x05;
+    if ([upper hasPrefix:@"CLOUDY"] || [upper hasPrefix:@"OVERCAST"]) return 0x06;
+    if ([upper hasPrefix:@"PRESET"]) return 0x07;
+    return 0x00;
+}
+
+@interface NKNEFPreview ()
+@property (nonatomic, readwrite) NSUInteger width;
+@property (nonatomic, readwrite) NSUInteger height;
+@property (nonatomic, readwrite) NSData *jpegData;
+@end
+
+@implementation NKNEFPreview
+@end
+
+@interface NKNEFFile ()
+{
+    std::shared_ptr<dirtyraw::MappedFile> _file;
+    dirtyraw::NEFMetadata _metadata;
+    NSString *_filePath;
+}
+@end
+
+@implementation NKNEFFile
+
+- (nullable instancetype)initWithFilePath:(NSString *)filePath {
+    self = [super init];
+    if (self) {
+        _filePath = [filePath copy];
+        _file = dirtyraw::MappedFile::open(filePath.fileSystemRepresentation);
+        if (!_file) {
+            NSLog(@"NEFFile: Failed to map file: %@", filePath);
+            return nil;
+        }
+
+        auto result = dirtyraw::parseNEF(_file->bytes());
+        if (!result) {
+            NSLog(@"NEFFile: Not a TIFF-based raw file: %@", filePath);
+            return nil;
+        }
+        _metadata = std::move(result->metadata);
+
+        NSMutableArray<NKNEFPreview *> *previews = [NSMutableArray arrayWithCapacity:result->previews.size()];
+        for (const auto &source : result->previews) {
+            // The deallocator keeps the mapping alive for as long as the data is referenced
+            std::shared_ptr<dirtyraw::MappedFile> mapping = _file;
+            NKNEFPreview *preview = [[NKNEFPreview alloc] init];
+            preview.width = source.width;
+            preview.height = source.height;
+            preview.jpegData = [[NSData alloc] initWithBytesNoCopy:(void *)source.jpeg.data()
+                                                            length:source.jpeg.size()
+                                                       deallocator:^(void *bytes, NSUInteger length) {
+                (void)mapping;
+            }];
+            [previews addObject:preview];
+        }
+        _previews = [previews copy];
+    }
+    return self;
+}
+
+- (NKEXIFData *)getEXIFData {
+    NKEXIFData *exif = [[NKEXIFData alloc] init];
+    exif.make = NKStringFromStd(_metadata.make);
+    exif.model = NKStringFromStd(_metadata.model);
+    exif.software = NKStringFromStd(_metadata.software);
+    exif.artist = NKStringFromStd(_metadata.artist);
+    exif.copyright = NKStringFromStd(_metadata.copyright);
+    exif.lensInfo = NKStringFromStd(_metadata.lensModel);
+
+    exif.exposureTime = _metadata.exposureTime;
+    exif.fNumber = _metadata.fNumber;
+    exif.focalLength = _metadata.focalLength;
+    exif.exposureBias = _metadata.exposureBias;
+    exif.iso = _metadata.iso;
+    exif.meteringMode = _metadata.meteringMode;
+    exif.exposureProgram = _metadata.exposureProgram;
+    exif.flash = _metadata.flash;
+
+    NSString *whiteBalance = NKStringFromStd(_metadata.whiteBalance);
+    if (whiteBalance) {
+        exif.whiteBalance = NKWhiteBalanceFromName(whiteBalance);
+    }
+
+    NSString *dateTime = NKStringFromStd(_metadata.dateTime);
+    if (dateTime) {
+        NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.dateFormat = @"yyyy:MM:dd HH:mm:ss";
+        exif.dateTime = [formatter dateFromString:dateTime];
+    }
+
+    // Same numbering as the file formats listed in RAWImage.formattedEXIF
+    exif.fileFormat = [_filePath.pathExtension.lowercaseString isEqualToString:@"nrw"] ? 4 : 1;
+
+    return exif;
+}
+
+- (NKImageInfo *)getImageInfo {
+    NKImageInfo *info = [[NKImageInfo alloc] init];
+    info.width = _metadata.width;
+    info.height = _metadata.height;
+    info.byteDepth = _metadata.bitsPerSample > 8 ? 2 : 1;
+    info.colorType = 2; // RGB after development
+    info.orientation = _metadata.orientation;
+    info.resolution = _metadata.resolution;
+    return info;
+}
+
+- (nullable NKNEFPreview *)previewWithMinimumDimension:(NSUInteger)dimension {
+    NKNEFPreview *chosen = _previews.firstObject;
+    for (NKNEFPreview *preview in _previews) {
+        if (MAX(preview.width, preview.height) >= dimension) {
+            chosen = preview;
+        }
+    }
+    if (chosen) {
+        _file->willNeed({static_cast<const uint8_t *>(chosen.jpegData.bytes), chosen.jpegData.length});
+    }
+    return chosen;
+}
+
+@end
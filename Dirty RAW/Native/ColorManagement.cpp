@@ -0,0 +1,186 @@
+//
+//  ColorManagement.cpp
+//  Dirty RAW
+//
+
+#include "ColorManagement.hpp"
+#include "Parallel.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace dirtyraw {
+
+namespace {
+
+using Matrix3 = std::array<std::array<float, 3>, 3>;
+
+std::vector<float> makeDecodeTable16(RGBSpace space) {
+    std::vector<float> table(65536);
+    for (size_t code = 0; code < table.size(); ++code) {
+        table[code] = float(decodeTransfer(space, double(code) / 65535.0));
+    }
+    return table;
+}
+
+} // namespace
+
+double decodeTransfer(RGBSpace space, double encoded) {
+    switch (space) {
+    case RGBSpace::sRGB:
+    case RGBSpace::displayP3:
+        // IEC 61966-2-1 (Display P3 shares the sRGB curve)
+        return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+    case RGBSpace::adobeRGB:
+        return std::pow(encoded, 563.0 / 256.0);
+    case RGBSpace::proPhoto:
+        // ROMM RGB: gamma 1.8 with a linear segment below 1/512 linear
+        return encoded < 16.0 / 512.0 ? encoded / 16.0 : std::pow(encoded, 1.8);
+    }
+    return encoded;
+}
+
+const Matrix3& toLinearSRGBMatrix(RGBSpace space) {
+    static const Matrix3 identity = {{
+        { 1, 0, 0 },
+        { 0, 1, 0 },
+        { 0, 0, 1 },
+    }};
+    static const Matrix3 displayP3 = {{
+        {  1.2249401f, -0.2249404f,  0.0000000f },
+        { -0.0420569f,  1.0420571f,  0.0000000f },
+        { -0.0196376f, -0.0786361f,  1.0982735f },
+    }};
+    static const Matrix3 adobeRGB = {{
+        {  1.3983557f, -0.3983557f,  0.0000000f },
+        {  0.0000000f,  1.0000000f,  0.0000000f },
+        {  0.0000000f, -0.0429290f,  1.0429290f },
+    }};
+    static const Matrix3 proPhoto = {{
+        {  2.0341926f, -0.7274198f, -0.3067728f },
+        { -0.2288062f,  1.2317163f, -0.0029101f },
+        { -0.0085580f, -0.1532964f,  1.1618544f },
+    }};
+
+    switch (space) {
+    case RGBSpace::sRGB: return identity;
+    case RGBSpace::displayP3: return displayP3;
+    case RGBSpace::adobeRGB: return adobeRGB;
+    case RGBSpace::proPhoto: return proPhoto;
+    }
+    return identity;
+}
+
+const std::vector<float>& decodeTable16(RGBSpace space) {
+    // Built on first use; function-local statics are initialized thread-safely
+    static const std::vector<float> srgb = makeDecodeTable16(RGBSpace::sRGB);
+    static const std::vector<float> adobe = makeDecodeTable16(RGBSpace::adobeRGB);
+    static const std::vector<float> proPhoto = makeDecodeTable16(RGBSpace::proPhoto);
+
+    switch (space) {
+    case RGBSpace::sRGB:
+    case RGBSpace::displayP3: return srgb;
+    case RGBSpace::adobeRGB: return adobe;
+    case RGBSpace::proPhoto: return proPhoto;
+    }
+    return srgb;
+}
+
+uint16_t halfFromFloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        // Infinity / NaN
+        return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return uint16_t(sign | 0x7C00);
+    }
+    if (exponent <= 0) {
+        // Subnormal half (or zero)
+        if (exponent < -10) return uint16_t(sign);
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))) ++halfMantissa;
+        return uint16_t(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    // Carry into the exponent is the correct rounding result
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;
+    return uint16_t(half);
+}
+
+const std::vector<float>& halfToFloatTable() {
+    static const std::vector<float> table = [] {
+        std::vector<float> values(65536);
+        for (uint32_t bits = 0; bits < 65536; ++bits) {
+            uint32_t sign = (bits & 0x8000) << 16;
+            uint32_t exponent = (bits >> 10) & 0x1F;
+            uint32_t mantissa = bits & 0x3FF;
+            uint32_t single;
+            if (exponent == 0x1F) {
+                single = sign | 0x7F800000 | (mantissa << 13);
+            } else if (exponent != 0) {
+                single = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+            } else if (mantissa == 0) {
+                single = sign;
+            } else {
+                // Subnormal half: normalize the mantissa
+                int shift = 0;
+                while (!(mantissa & 0x400)) {
+                    mantissa <<= 1;
+                    ++shift;
+                }
+                single = sign | (uint32_t(127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+            }
+            std::memcpy(&values[bits], &single, sizeof(single));
+        }
+        return values;
+    }();
+    return table;
+}
+
+void linearizeRGB16(const uint16_t* source, size_t sourceStride, RGBSpace space,
+                    uint16_t* destination, size_t destinationStride, int width, int height) {
+    const std::vector<float>& table = decodeTable16(space);
+    const Matrix3& m = toLinearSRGBMatrix(space);
+    bool convertPrimaries = space != RGBSpace::sRGB;
+    const uint16_t one = halfFromFloat(1.0f);
+
+    parallelFor(0, height, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint16_t* in = source + size_t(y) * sourceStride;
+            uint16_t* out = destination + size_t(y) * destinationStride;
+
+            for (int x = 0; x < width; ++x) {
+                float r = table[in[x * 3]];
+                float g = table[in[x * 3 + 1]];
+                float b = table[in[x * 3 + 2]];
+                if (convertPrimaries) {
+                    float lr = m[0][0] * r + m[0][1] * g + m[0][2] * b;
+                    float lg = m[1][0] * r + m[1][1] * g + m[1][2] * b;
+                    float lb = m[2][0] * r + m[2][1] * g + m[2][2] * b;
+                    r = lr;
+                    g = lg;
+                    b = lb;
+                }
+                out[x * 4] = halfFromFloat(r);
+                out[x * 4 + 1] = halfFromFloat(g);
+                out[x * 4 + 2] = halfFromFloat(b);
+                out[x * 4 + 3] = one;
+            }
+        }
+    });
+}
+
+} // namespace dirtyraw
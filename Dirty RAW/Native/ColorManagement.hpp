@@ -0,0 +1,49 @@
+//
+//  ColorManagement.hpp
+//  Dirty RAW
+//
+//  Conversion of gamma-encoded RGB into the renderer's linear working space (linear sRGB
+//  primaries, extended range). Transfer functions are applied through per-space lookup tables
+//  and primaries through a single 3x3 matrix, so decoding a frame is one pass over the pixels.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Encoded RGB spaces the SDK can deliver and exports can target.
+/// Values match `NKOutputColorSpace`.
+enum class RGBSpace : int {
+    sRGB = 0,
+    displayP3 = 1,
+    adobeRGB = 2,
+    proPhoto = 3,
+};
+
+/// Encoded value (0...1) -> linear light.
+double decodeTransfer(RGBSpace space, double encoded);
+
+/// Linear primaries of `space` -> linear sRGB primaries (Bradford-adapted to D65 for ProPhoto).
+const std::array<std::array<float, 3>, 3>& toLinearSRGBMatrix(RGBSpace space);
+
+/// 16-bit code value -> linear light, one entry per code value.
+const std::vector<float>& decodeTable16(RGBSpace space);
+
+/// IEEE 754 binary16 bits for `value` (round to nearest even).
+uint16_t halfFromFloat(float value);
+
+/// Float value of every binary16 bit pattern, indexed by the bits.
+const std::vector<float>& halfToFloatTable();
+
+/// Converts interleaved RGB (16-bit, host order, `sourceStride` in elements) encoded in `space`
+/// into linear sRGB RGBA half floats with alpha 1. Values outside the sRGB gamut stay negative or
+/// above 1 rather than being clipped. Rows are processed in parallel.
+void linearizeRGB16(const uint16_t* source, size_t sourceStride, RGBSpace space,
+                    uint16_t* destination, size_t destinationStride, int width, int height);
+
+} // namespace dirtyraw
@@ -0,0 +1,244 @@
+//
+//  Denoise.cpp
+//  Dirty RAW
+//
+
+#include "Denoise.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kTileSize = 256;
+/// Lower bound of the guided filter's regularisation, for strengths of 0.
+constexpr float kMinimumEpsilon = 1e-6f;
+
+constexpr float kRedWeight = 0.299f;
+constexpr float kGreenWeight = 0.587f;
+constexpr float kBlueWeight = 0.114f;
+
+/// Four lanes of a plane in a 128-bit register (NEON on Apple silicon, SSE on Intel).
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+
+inline Float4 load(const float* values) {
+    Float4 v;
+    std::memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+inline void store(float* values, Float4 v) {
+    std::memcpy(values, &v, sizeof(v));
+}
+
+/// Planes are allocated in whole Float4s, so element-wise passes run over `count` rounded up.
+inline size_t paddedCount(size_t count) {
+    return (count + 3) & ~size_t(3);
+}
+
+/// `sums[x] += row[x]` (or `-=`) across a row of `width` values.
+template <bool Subtract>
+void accumulateRow(float* sums, const float* row, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        store(sums + x, Subtract ? load(sums + x) - load(row + x) : load(sums + x) + load(row + x));
+    }
+    for (; x < width; ++x) {
+        sums[x] = Subtract ? sums[x] - row[x] : sums[x] + row[x];
+    }
+}
+
+/// Mean over a (2r+1)^2 window, normalized by the number of pixels inside the plane so the
+/// edges of the work area are not darkened. `scratch` holds one plane.
+void boxMean(const float* input, float* output, int width, int height, int radius, float* scratch) {
+    // Horizontal running sums
+    for (int y = 0; y < height; ++y) {
+        const float* row = input + size_t(y) * width;
+        float* out = scratch + size_t(y) * width;
+        float sum = 0;
+        for (int x = 0; x < std::min(radius, width); ++x) sum += row[x];
+        for (int x = 0; x < width; ++x) {
+            if (x + radius < width) sum += row[x + radius];
+            if (x - radius - 1 >= 0) sum -= row[x - radius - 1];
+            out[x] = sum;
+        }
+    }
+
+    // Vertical running sums, a whole row at a time in Float4 lanes
+    std::vector<float> sums(width, 0.0f);
+    std::vector<float> columnScale(width);
+    for (int x = 0; x < width; ++x) {
+        columnScale[x] = 1.0f / float(std::min(x + radius, width - 1) - std::max(x - radius, 0) + 1);
+    }
+    for (int y = 0; y < std::min(radius, height); ++y) {
+        accumulateRow<false>(sums.data(), scratch + size_t(y) * width, width);
+    }
+    for (int y = 0; y < height; ++y) {
+        if (y + radius < height) {
+            accumulateRow<false>(sums.data(), scratch + size_t(y + radius) * width, width);
+        }
+        if (y - radius - 1 >= 0) {
+            accumulateRow<true>(sums.data(), scratch + size_t(y - radius - 1) * width, width);
+        }
+
+        float rowScale = 1.0f / float(std::min(y + radius, height - 1) - std::max(y - radius, 0) + 1);
+        float* out = output + size_t(y) * width;
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            store(out + x, load(sums.data() + x) * load(columnScale.data() + x) * rowScale);
+        }
+        for (; x < width; ++x) {
+            out[x] = sums[x] * columnScale[x] * rowScale;
+        }
+    }
+}
+
+/// Per-tile working planes, reused across the tiles a worker processes.
+struct TileBuffers {
+    explicit TileBuffers(size_t count)
+        : luma(count), cb(count), cr(count), filteredLuma(count),
+          meanGuide(count), varianceGuide(count), meanInput(count), covariance(count),
+          coefficientA(count), coefficientB(count), product(count), scratch(count) {}
+
+    std::vector<float> luma, cb, cr, filteredLuma;
+    std::vector<float> meanGuide, varianceGuide, meanInput, covariance;
+    std::vector<float> coefficientA, coefficientB, product, scratch;
+};
+
+/// Guided filter (He et al.): output = mean(a) * guide + mean(b), with a and b fitted per window
+/// so the output is a local linear function of the guide. `meanGuide` and `varianceGuide` must
+/// already hold the guide's box mean and variance at `radius`.
+void guidedFilter(const float* guide, const float* input, float* output, int width, int height,
+                  int radius, float epsilon, TileBuffers& buffers) {
+    size_t count = paddedCount(size_t(width) * height);
+    float* meanInput = buffers.meanInput.data();
+    float* covariance = buffers.covariance.data();
+    float* a = buffers.coefficientA.data();
+    float* b = buffers.coefficientB.data();
+    float* product = buffers.product.data();
+    const float* meanGuide = buffers.meanGuide.data();
+    const float* varianceGuide = buffers.varianceGuide.data();
+
+    boxMean(input, meanInput, width, height, radius, buffers.scratch.data());
+    for (size_t i = 0; i < count; i += 4) store(product + i, load(guide + i) * load(input + i));
+    boxMean(product, covariance, width, height, radius, buffers.scratch.data());
+
+    for (size_t i = 0; i < count; i += 4) {
+        Float4 mean = load(meanGuide + i), meanIn = load(meanInput + i);
+        Float4 coefficient = (load(covariance + i) - mean * meanIn) / (load(varianceGuide + i) + epsilon);
+        store(a + i, coefficient);
+        store(b + i, meanIn - coefficient * mean);
+    }
+
+    boxMean(a, meanInput, width, height, radius, buffers.scratch.data());
+    boxMean(b, covariance, width, height, radius, buffers.scratch.data());
+    for (size_t i = 0; i < count; i += 4) {
+        store(output + i, load(meanInput + i) * load(guide + i) + load(covariance + i));
+    }
+}
+
+/// Fills `meanGuide` / `varianceGuide` for `guide` at `radius`.
+void guideStatistics(const float* guide, int width, int height, int radius, TileBuffers& buffers) {
+    size_t count = paddedCount(size_t(width) * height);
+    float* meanGuide = buffers.meanGuide.data();
+    float* varianceGuide = buffers.varianceGuide.data();
+    float* product = buffers.product.data();
+
+    boxMean(guide, meanGuide, width, height, radius, buffers.scratch.data());
+    for (size_t i = 0; i < count; i += 4) store(product + i, load(guide + i) * load(guide + i));
+    boxMean(product, varianceGuide, width, height, radius, buffers.scratch.data());
+    const Float4 zero = {};
+    for (size_t i = 0; i < count; i += 4) {
+        Float4 mean = load(meanGuide + i);
+        Float4 variance = load(varianceGuide + i) - mean * mean;
+        // Rounding can leave a flat window slightly negative; the lane mask zeroes those
+        store(varianceGuide + i, Float4(Int4(variance) & (variance > zero)));
+    }
+}
+
+} // namespace
+
+void denoiseRGBA(const float* source, size_t sourceStride,
+                 float* destination, size_t destinationStride,
+                 int width, int height, const DenoiseParameters& parameters) {
+    if (width <= 0 || height <= 0) return;
+
+    int columns = (width + kTileSize - 1) / kTileSize;
+    int rows = (height + kTileSize - 1) / kTileSize;
+    int span = kTileSize + 2 * kDenoiseHalo;
+
+    // Floored so a flat window (zero covariance and variance) fits a = 0 rather than 0/0
+    float lumaEpsilon = std::max(parameters.lumaStrength * parameters.lumaStrength, kMinimumEpsilon);
+    float chromaEpsilon = std::max(parameters.chromaStrength * parameters.chromaStrength, kMinimumEpsilon);
+    float detail = std::clamp(parameters.lumaDetail, 0.0f, 1.0f);
+
+    parallelFor(0, columns * rows, [&](int begin, int end) {
+        TileBuffers buffers(paddedCount(size_t(span) * span));
+
+        for (int tile = begin; tile < end; ++tile) {
+            // Output tile in destination coordinates; the work area adds the halo on every side,
+            // which is always inside `source`.
+            int tileX = (tile % columns) * kTileSize;
+            int tileY = (tile / columns) * kTileSize;
+            int tileWidth = std::min(kTileSize, width - tileX);
+            int tileHeight = std::min(kTileSize, height - tileY);
+            int workWidth = tileWidth + 2 * kDenoiseHalo;
+            int workHeight = tileHeight + 2 * kDenoiseHalo;
+
+            float* luma = buffers.luma.data();
+            float* cb = buffers.cb.data();
+            float* cr = buffers.cr.data();
+            float* filteredLuma = buffers.filteredLuma.data();
+
+            for (int y = 0; y < workHeight; ++y) {
+                const float* in = source + size_t(tileY + y) * sourceStride + size_t(tileX) * 4;
+                size_t row = size_t(y) * workWidth;
+                for (int x = 0; x < workWidth; ++x) {
+                    float r = in[x * 4], g = in[x * 4 + 1], b = in[x * 4 + 2];
+                    float l = kRedWeight * r + kGreenWeight * g + kBlueWeight * b;
+                    luma[row + x] = l;
+                    cb[row + x] = b - l;
+                    cr[row + x] = r - l;
+                }
+            }
+
+            // Luma: self-guided, so edges stronger than the noise survive
+            guideStatistics(luma, workWidth, workHeight, kDenoiseLumaRadius, buffers);
+            guidedFilter(luma, luma, filteredLuma, workWidth, workHeight,
+                         kDenoiseLumaRadius, lumaEpsilon, buffers);
+
+            // Chroma: guided by the denoised luma over a wider window
+            guideStatistics(filteredLuma, workWidth, workHeight, kDenoiseChromaRadius, buffers);
+            guidedFilter(filteredLuma, cb, cb, workWidth, workHeight,
+                         kDenoiseChromaRadius, chromaEpsilon, buffers);
+            guidedFilter(filteredLuma, cr, cr, workWidth, workHeight,
+                         kDenoiseChromaRadius, chromaEpsilon, buffers);
+
+            for (int y = 0; y < tileHeight; ++y) {
+                size_t row = size_t(y + kDenoiseHalo) * workWidth + kDenoiseHalo;
+                const float* in = source + size_t(tileY + y + kDenoiseHalo) * sourceStride
+                    + size_t(tileX + kDenoiseHalo) * 4;
+                float* out = destination + size_t(tileY + y) * destinationStride + size_t(tileX) * 4;
+
+                for (int x = 0; x < tileWidth; ++x) {
+                    float l = filteredLuma[row + x] + detail * (luma[row + x] - filteredLuma[row + x]);
+                    float r = l + cr[row + x];
+                    float b = l + cb[row + x];
+                    float g = (l - kRedWeight * r - kBlueWeight * b) / kGreenWeight;
+                    out[x * 4] = r;
+                    out[x * 4 + 1] = g;
+                    out[x * 4 + 2] = b;
+                    out[x * 4 + 3] = in[x * 4 + 3];
+                }
+            }
+        }
+    });
+}
+
+} // namespace dirtyraw
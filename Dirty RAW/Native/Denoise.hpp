@@ -0,0 +1,40 @@
+//
+//  Denoise.hpp
+//  Dirty RAW
+//
+//  CPU noise reduction in a luma/chroma space. Luma is smoothed with a self-guided filter and
+//  chroma with a filter guided by the denoised luma, so colour noise is removed aggressively
+//  while colour edges stay aligned with luminance edges. The frame is split into tiles that are
+//  processed in parallel; each tile reads a halo wide enough that the result is identical to
+//  filtering the whole frame at once.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace dirtyraw {
+
+struct DenoiseParameters {
+    /// Standard deviation of the luma noise to remove, in pixel value units.
+    float lumaStrength = 0.02f;
+    /// Standard deviation of the chroma noise to remove.
+    float chromaStrength = 0.06f;
+    /// Fraction (0...1) of the removed luma detail that is added back.
+    float lumaDetail = 0;
+};
+
+/// Guided filter radii; the halo is two box passes of each, since chroma is guided by the
+/// already filtered luma.
+constexpr int kDenoiseLumaRadius = 2;
+constexpr int kDenoiseChromaRadius = 4;
+constexpr int kDenoiseHalo = 2 * kDenoiseLumaRadius + 2 * kDenoiseChromaRadius;
+
+/// Denoises `width` x `height` RGBA float pixels. `source` points at the top-left of a region
+/// that extends `kDenoiseHalo` pixels beyond the output on every side; strides are in floats.
+/// Alpha is copied unchanged. `source` and `destination` must not overlap.
+void denoiseRGBA(const float* source, size_t sourceStride,
+                 float* destination, size_t destinationStride,
+                 int width, int height, const DenoiseParameters& parameters);
+
+} // namespace dirtyraw
@@ -0,0 +1,133 @@
+//
+//  Dither.cpp
+//  Dirty RAW
+//
+
+#include "Dither.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kMatrixSize = 16;
+/// One threshold per channel for a full period of the matrix.
+constexpr int kPeriodElements = kMatrixSize * 4;
+
+using ThresholdRows = std::array<std::array<uint32_t, kPeriodElements>, kMatrixSize>;
+
+/// One RGBA pixel per 128-bit register (NEON on Apple silicon, SSE on Intel), widened to 32 bits
+/// so the threshold add cannot overflow.
+typedef uint32_t UInt4 __attribute__((vector_size(16)));
+typedef uint16_t UShort4 __attribute__((vector_size(8)));
+typedef uint8_t UChar4 __attribute__((vector_size(4)));
+
+/// floor(v / 257) as a multiply and shift; exact for every v up to 65535 + 256, where it is 255,
+/// so the largest value plus the largest threshold needs no clamp.
+constexpr uint32_t kDivide257Multiplier = 65281;
+constexpr int kDivide257Shift = 24;
+static_assert((65535u + 256u) * kDivide257Multiplier >> kDivide257Shift == 255, "Quantizer must saturate at 255");
+
+/// Rank digit of each quadrant, indexed by (x bit) ^ (y bit) * 3: top-left 0, top-right 2,
+/// bottom-left 3, bottom-right 1.
+constexpr int kQuadrantOrder[4] = { 0, 2, 1, 3 };
+
+/// Rank (0...size² - 1) of a cell in the `size` x `size` Bayer matrix, from the recursion
+/// M(2n) = [4M, 4M + 2; 4M + 3, 4M + 1]. The finest bit of x and y is the most significant
+/// digit, so neighbouring cells land far apart in rank and thresholds are dispersed.
+constexpr int bayerRank(int x, int y, int size = kMatrixSize) {
+    int rank = 0;
+    for (int bit = 1; bit < size; bit *= 2) {
+        int quadrant = ((x & bit) ? 1 : 0) ^ ((y & bit) ? 3 : 0);
+        rank = rank * 4 + kQuadrantOrder[quadrant];
+    }
+    return rank;
+}
+
+template <int N>
+constexpr bool matchesBayer(const int (&expected)[N][N]) {
+    for (int y = 0; y < N; ++y) {
+        for (int x = 0; x < N; ++x) {
+            if (bayerRank(x, y, N) != expected[y][x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+constexpr int kBayer2[2][2] = { { 0, 2 }, { 3, 1 } };
+constexpr int kBayer4[4][4] = {
+    { 0, 8, 2, 10 },
+    { 12, 4, 14, 6 },
+    { 3, 11, 1, 9 },
+    { 15, 7, 13, 5 },
+};
+static_assert(matchesBayer(kBayer2) && matchesBayer(kBayer4), "Bayer ranks must be dispersed");
+// The full matrix keeps the small one's order: the top-left 4x4 cells are its 4x4 ranks * 16
+static_assert(bayerRank(1, 0) == 8 * 16 && bayerRank(0, 1) == 12 * 16 && bayerRank(3, 3) == 5 * 16,
+              "Bayer ranks must be dispersed");
+
+/// Per-row thresholds in 16-bit units, pre-expanded to RGBA so the quantizer adds a whole pixel's
+/// thresholds with one vector load.
+/// A 16-bit value v maps to floor((v + t) / 257) with t ~ 257 * (rank + 0.5) / 256, i.e. one
+/// 8-bit step spread over the matrix; alpha gets the midpoint, which rounds.
+ThresholdRows makeThresholds() {
+    ThresholdRows rows {};
+    for (int y = 0; y < kMatrixSize; ++y) {
+        for (int x = 0; x < kMatrixSize; ++x) {
+            uint32_t threshold = uint32_t((2 * bayerRank(x, y) + 1) * 257 / 512);
+            rows[y][x * 4] = threshold;
+            rows[y][x * 4 + 1] = threshold;
+            rows[y][x * 4 + 2] = threshold;
+            rows[y][x * 4 + 3] = 128;
+        }
+    }
+    return rows;
+}
+
+inline void ditherPixel(const uint16_t* in, uint8_t* out, const uint32_t* thresholds) {
+    UShort4 pixel;
+    UInt4 threshold;
+    std::memcpy(&pixel, in, sizeof(pixel));
+    std::memcpy(&threshold, thresholds, sizeof(threshold));
+    UInt4 value = (__builtin_convertvector(pixel, UInt4) + threshold) * kDivide257Multiplier >> kDivide257Shift;
+    UChar4 quantized = __builtin_convertvector(value, UChar4);
+    std::memcpy(out, &quantized, sizeof(quantized));
+}
+
+/// `elements` is a whole number of RGBA pixels.
+void ditherRow(const uint16_t* in, uint8_t* out, size_t elements, const uint32_t* thresholds) {
+    size_t i = 0;
+    for (; i + kPeriodElements <= elements; i += kPeriodElements) {
+        for (int k = 0; k < kPeriodElements; k += 4) {
+            ditherPixel(in + i + k, out + i + k, thresholds + k);
+        }
+    }
+    for (int k = 0; i < elements; i += 4, k += 4) {
+        ditherPixel(in + i, out + i, thresholds + k);
+    }
+}
+
+} // namespace
+
+void ditherRGBA16To8(const uint16_t* source, size_t sourceStride,
+                     uint8_t* destination, size_t destinationStride,
+                     int width, int height, int firstRow) {
+    static const ThresholdRows thresholds = makeThresholds();
+    size_t elements = size_t(std::max(width, 0)) * 4;
+
+    parallelFor(0, height, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            ditherRow(source + size_t(y) * sourceStride,
+                      destination + size_t(y) * destinationStride,
+                      elements, thresholds[(firstRow + y) & (kMatrixSize - 1)].data());
+        }
+    });
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,25 @@
+//
+//  Dither.hpp
+//  Dirty RAW
+//
+//  16-bit to 8-bit quantization for 8-bit exports. Truncating to the top byte bands smooth
+//  gradients (skies, vignettes) into visible steps; adding an ordered threshold before
+//  quantizing trades the bands for fine, fixed-pattern noise below one 8-bit step.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dirtyraw {
+
+/// Quantizes RGBA rows with 16-bit channels to 8 bits using a 16x16 Bayer threshold matrix.
+/// Colour channels share the threshold so neutral greys stay neutral; alpha is rounded.
+/// `firstRow` is the image row of the first source row and keeps the pattern continuous across
+/// bands. Strides are in elements; rows are processed in parallel.
+void ditherRGBA16To8(const uint16_t* source, size_t sourceStride,
+                     uint8_t* destination, size_t destinationStride,
+                     int width, int height, int firstRow);
+
+} // namespace dirtyraw
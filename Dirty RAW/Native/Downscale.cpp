@@ -0,0 +1,129 @@
+//
+//  Downscale.cpp
+//  Dirty RAW
+//
+
+#include "Downscale.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kLobes = 3;
+constexpr double kPi = 3.14159265358979323846;
+
+/// One RGBA pixel in a 128-bit register (NEON on Apple silicon, SSE on Intel).
+typedef float Float4 __attribute__((vector_size(16)));
+
+inline Float4 loadPixel(const uint16_t* pixel) {
+    return Float4{ float(pixel[0]), float(pixel[1]), float(pixel[2]), float(pixel[3]) };
+}
+
+double lanczos(double x) {
+    if (x == 0) return 1;
+    if (std::abs(x) >= kLobes) return 0;
+    double px = kPi * x;
+    return kLobes * std::sin(px) * std::sin(px / kLobes) / (px * px);
+}
+
+} // namespace
+
+Downscaler::Downscaler(const uint16_t* source, size_t sourceStride, int sourceWidth, int sourceHeight, double scale)
+    : source_(source),
+      sourceStride_(sourceStride),
+      sourceWidth_(sourceWidth),
+      sourceHeight_(sourceHeight),
+      outputWidth_(std::clamp(int(std::lround(sourceWidth * scale)), 1, sourceWidth)),
+      outputHeight_(std::clamp(int(std::lround(sourceHeight * scale)), 1, sourceHeight)) {
+    // Use the exact per-axis ratio so the frame edges line up
+    columnTaps_ = makeTaps(outputWidth_, sourceWidth, double(outputWidth_) / sourceWidth);
+    rowTaps_ = makeTaps(outputHeight_, sourceHeight, double(outputHeight_) / sourceHeight);
+}
+
+Downscaler::Taps Downscaler::makeTaps(int outputSize, int sourceSize, double scale) {
+    Taps taps;
+    taps.first.resize(outputSize);
+    taps.count.resize(outputSize);
+    taps.offset.resize(outputSize);
+
+    // The kernel is stretched by 1 / scale, so it covers kLobes output pixels either side
+    double radius = kLobes / scale;
+    std::vector<double> weights;
+    for (int i = 0; i < outputSize; ++i) {
+        double center = (i + 0.5) / scale - 0.5;
+        int start = int(std::floor(center - radius)) + 1;
+        int end = int(std::floor(center + radius));
+        int first = std::clamp(start, 0, sourceSize - 1);
+        int last = std::clamp(end, 0, sourceSize - 1);
+
+        // Taps past the edge fold onto the edge pixel (clamp-to-edge)
+        weights.assign(last - first + 1, 0);
+        double sum = 0;
+        for (int k = start; k <= end; ++k) {
+            double weight = lanczos((k - center) * scale);
+            weights[std::clamp(k, 0, sourceSize - 1) - first] += weight;
+            sum += weight;
+        }
+
+        taps.first[i] = first;
+        taps.count[i] = last - first + 1;
+        taps.offset[i] = taps.weights.size();
+        for (double weight : weights) taps.weights.push_back(float(weight / sum));
+    }
+    return taps;
+}
+
+void Downscaler::renderRows(int firstRow, int rowCount, uint16_t* destination, size_t destinationStride) const {
+    firstRow = std::clamp(firstRow, 0, outputHeight_);
+    rowCount = std::clamp(rowCount, 0, outputHeight_ - firstRow);
+    if (rowCount == 0) return;
+
+    // Taps are monotonic, so the band's source rows run from the first row's taps to the last's
+    int sourceBegin = rowTaps_.first[firstRow];
+    int lastRow = firstRow + rowCount - 1;
+    int sourceEnd = rowTaps_.first[lastRow] + rowTaps_.count[lastRow];
+
+    // Horizontal pass: the band's source rows resampled to the output width
+    size_t width = size_t(outputWidth_);
+    std::vector<Float4> horizontal(size_t(sourceEnd - sourceBegin) * width);
+    parallelFor(sourceBegin, sourceEnd, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint16_t* in = source_ + size_t(y) * sourceStride_;
+            Float4* out = horizontal.data() + size_t(y - sourceBegin) * width;
+            for (int x = 0; x < outputWidth_; ++x) {
+                const uint16_t* pixel = in + size_t(columnTaps_.first[x]) * 4;
+                const float* weights = columnTaps_.weights.data() + columnTaps_.offset[x];
+                Float4 sum = {};
+                for (int k = 0; k < columnTaps_.count[x]; ++k) sum += weights[k] * loadPixel(pixel + k * 4);
+                out[x] = sum;
+            }
+        }
+    });
+
+    // Vertical pass, accumulating whole rows so the inner loop streams through memory
+    parallelFor(firstRow, firstRow + rowCount, [&](int begin, int end) {
+        std::vector<Float4> accumulator(width);
+        for (int row = begin; row < end; ++row) {
+            std::fill(accumulator.begin(), accumulator.end(), Float4{});
+            const float* weights = rowTaps_.weights.data() + rowTaps_.offset[row];
+            for (int k = 0; k < rowTaps_.count[row]; ++k) {
+                const Float4* in = horizontal.data() + size_t(rowTaps_.first[row] + k - sourceBegin) * width;
+                float weight = weights[k];
+                for (size_t x = 0; x < width; ++x) accumulator[x] += weight * in[x];
+            }
+
+            uint16_t* out = destination + size_t(row - firstRow) * destinationStride;
+            for (size_t x = 0; x < width; ++x) {
+                // Lanczos lobes overshoot at edges; clamp to the representable range
+                Float4 value = accumulator[x];
+                for (int c = 0; c < 4; ++c) out[x * 4 + c] = uint16_t(std::clamp(value[c], 0.0f, 65535.0f) + 0.5f);
+            }
+        }
+    });
+}
+
+} // namespace dirtyraw
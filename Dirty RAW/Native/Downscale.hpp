@@ -0,0 +1,54 @@
+//
+//  Downscale.hpp
+//  Dirty RAW
+//
+//  CPU downscaler for export: separable Lanczos-3 widened by the reduction factor, so every
+//  source pixel contributes and fine detail is filtered rather than aliased. Like `Upscaler`,
+//  output is produced in bands of rows on demand for a row-streaming consumer.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dirtyraw {
+
+class Downscaler {
+public:
+    /// `source` is premultiplied RGBA with 16-bit channels; `sourceStride` is in elements.
+    /// `scale` is in (0, 1). The caller keeps `source` alive for the downscaler's lifetime.
+    Downscaler(const uint16_t* source, size_t sourceStride, int sourceWidth, int sourceHeight, double scale);
+
+    int outputWidth() const { return outputWidth_; }
+    int outputHeight() const { return outputHeight_; }
+
+    /// Renders output rows [firstRow, firstRow + rowCount) into `destination` (RGBA16,
+    /// `destinationStride` in elements). Rows are split across threads.
+    void renderRows(int firstRow, int rowCount, uint16_t* destination, size_t destinationStride) const;
+
+private:
+    /// Filter taps of every output coordinate along one axis, stored flat: output `i` reads
+    /// `count[i]` source pixels from `first[i]`, weighted by `weights[offset[i]...]`.
+    struct Taps {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<size_t> offset;
+        std::vector<float> weights;
+    };
+
+    static Taps makeTaps(int outputSize, int sourceSize, double scale);
+
+    const uint16_t* source_;
+    size_t sourceStride_;
+    int sourceWidth_;
+    int sourceHeight_;
+    int outputWidth_;
+    int outputHeight_;
+
+    Taps columnTaps_;
+    Taps rowTaps_;
+};
+
+} // namespace dirtyraw
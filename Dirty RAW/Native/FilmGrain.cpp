@@ -0,0 +1,248 @@
+//
+//  FilmGrain.cpp
+//  Dirty RAW
+//
+
+#include "FilmGrain.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kPrimaryPeriod = 512;
+constexpr int kSecondaryPeriod = 384;
+/// Fields are kept for this many (size, roughness) pairs, about 1.6 MB each.
+constexpr size_t kCachedFieldSets = 8;
+/// Full-strength grain scales pixel values by up to about ±25% per standard deviation.
+constexpr float kMaximumStrength = 0.25f;
+
+/// One RGBA pixel, or four field values, in a 128-bit register (NEON on Apple silicon, SSE on
+/// Intel).
+typedef float Float4 __attribute__((vector_size(16)));
+
+inline Float4 load(const float* values) {
+    Float4 v;
+    std::memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+inline void store(float* values, Float4 v) {
+    std::memcpy(values, &v, sizeof(v));
+}
+
+inline float horizontalSum(Float4 v) {
+    return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+uint32_t mix(uint32_t value) {
+    // lowbias32 integer hash
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+/// Uniform value in [-1, 1] for lattice node (i, j) of one octave.
+float latticeValue(uint32_t seed, int i, int j) {
+    uint32_t h = mix(seed ^ mix(uint32_t(i) * 0x9e3779b9U ^ mix(uint32_t(j) + 0x632be5abU)));
+    return float(h) * (2.0f / 4294967295.0f) - 1.0f;
+}
+
+/// A period x period tileable field, zero mean and unit variance.
+struct GrainField {
+    int period;
+    std::vector<float> values;
+
+    GrainField(int fieldPeriod, uint32_t seed, float size, float roughness)
+        : period(fieldPeriod), values(size_t(fieldPeriod) * fieldPeriod, 0.0f) {
+        // Octaves from twice the grain size (clumping, stronger when smooth) down to single
+        // pixels, each finer one weighted by the roughness.
+        struct Octave { float cell; float weight; };
+        std::vector<Octave> octaves = { { size * 2, 0.35f * (1 - roughness) }, { size, 1 } };
+        float weight = roughness;
+        for (float cell = size * 0.5f; cell >= 1 && weight > 0.01f; cell *= 0.5f, weight *= roughness) {
+            octaves.push_back({ cell, weight });
+        }
+
+        for (size_t octave = 0; octave < octaves.size(); ++octave) {
+            if (octaves[octave].weight <= 0) continue;
+            // Whole lattice cells per period keep the field tileable
+            int cells = std::clamp(int(std::lround(period / octaves[octave].cell)), 1, period);
+            float cellSize = float(period) / cells;
+            uint32_t octaveSeed = mix(seed + uint32_t(octave) * 0x85ebca6bU);
+            float octaveWeight = octaves[octave].weight;
+            std::vector<float> lattice(size_t(cells) * cells);
+            for (int j = 0; j < cells; ++j) {
+                for (int i = 0; i < cells; ++i) {
+                    lattice[size_t(j) * cells + i] = latticeValue(octaveSeed, i, j);
+                }
+            }
+
+            parallelFor(0, period, [&](int begin, int end) {
+                for (int py = begin; py < end; ++py) {
+                    float v = (py + 0.5f) / cellSize - 0.5f;
+                    int j0 = int(std::floor(v));
+                    float ty = v - j0;
+                    ty = ty * ty * (3 - 2 * ty);
+                    int row0 = ((j0 % cells) + cells) % cells;
+                    const float* above = lattice.data() + size_t(row0) * cells;
+                    const float* below = lattice.data() + size_t((row0 + 1) % cells) * cells;
+
+                    float* out = values.data() + size_t(py) * period;
+                    for (int px = 0; px < period; ++px) {
+                        float u = (px + 0.5f) / cellSize - 0.5f;
+                        int i0 = int(std::floor(u));
+                        float tx = u - i0;
+                        tx = tx * tx * (3 - 2 * tx);
+                        int column0 = ((i0 % cells) + cells) % cells;
+                        int column1 = (column0 + 1) % cells;
+
+                        float top = above[column0] + (above[column1] - above[column0]) * tx;
+                        float bottom = below[column0] + (below[column1] - below[column0]) * tx;
+                        out[px] += octaveWeight * (top + (bottom - top) * ty);
+                    }
+                }
+            });
+        }
+
+        double sum = 0, sumSquares = 0;
+        for (float value : values) {
+            sum += value;
+            sumSquares += double(value) * value;
+        }
+        double mean = sum / values.size();
+        double deviation = std::sqrt(std::max(sumSquares / values.size() - mean * mean, 1e-12));
+        for (float& value : values) {
+            value = float((value - mean) / deviation);
+        }
+    }
+};
+
+struct FieldSet {
+    int sizeKey;
+    int roughnessKey;
+    std::shared_ptr<const GrainField> primary;
+    std::shared_ptr<const GrainField> secondary;
+};
+
+/// Fields for the quantized size and roughness, from a small LRU cache. Sizes snap to quarter
+/// pixels and roughness to tenths, so slider drags reuse a handful of fields.
+FieldSet cachedFields(float size, float roughness) {
+    int sizeKey = std::clamp(int(std::lround(size * 4)), 4, 64);
+    int roughnessKey = std::clamp(int(std::lround(roughness * 10)), 0, 10);
+
+    static std::mutex mutex;
+    // Most recently used first
+    static std::list<FieldSet> entries;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->sizeKey == sizeKey && it->roughnessKey == roughnessKey) {
+                entries.splice(entries.begin(), entries, it);
+                return *it;
+            }
+        }
+    }
+
+    // Built outside the lock; a concurrent build of the same set just loses the insert
+    float cell = sizeKey / 4.0f;
+    float rough = roughnessKey / 10.0f;
+    FieldSet set = {
+        sizeKey, roughnessKey,
+        std::make_shared<const GrainField>(kPrimaryPeriod, 0x5eed0001U, cell, rough),
+        std::make_shared<const GrainField>(kSecondaryPeriod, 0x5eed0002U, cell, rough),
+    };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const FieldSet& entry : entries) {
+        if (entry.sizeKey == sizeKey && entry.roughnessKey == roughnessKey) return entry;
+    }
+    entries.push_front(set);
+    if (entries.size() > kCachedFieldSets) entries.pop_back();
+    return set;
+}
+
+/// Copies `count` values of a field row starting at column `start`, wrapping at the period.
+void readRow(const GrainField& field, int row, int start, int count, float* out, bool accumulate) {
+    const float* values = field.values.data() + size_t(row) * field.period;
+    int column = start;
+    while (count > 0) {
+        int run = std::min(count, field.period - column);
+        if (accumulate) {
+            int i = 0;
+            for (; i + 4 <= run; i += 4) store(out + i, load(out + i) + load(values + column + i));
+            for (; i < run; ++i) out[i] += values[column + i];
+        } else {
+            std::copy(values + column, values + column + run, out);
+        }
+        out += run;
+        count -= run;
+        column = 0;
+    }
+}
+
+inline int wrap(int64_t value, int period) {
+    return int(((value % period) + period) % period);
+}
+
+} // namespace
+
+void applyFilmGrain(const float* source, size_t sourceStride, float* destination, size_t destinationStride,
+                    int x, int y, int width, int height, const GrainParameters& parameters) {
+    if (width <= 0 || height <= 0) return;
+
+    float size = std::max(parameters.size, 0.01f);
+    float strength = std::clamp(parameters.amount, 0.0f, 1.0f) * kMaximumStrength;
+    if (size < 1) {
+        // Sub-pixel grain averages over 1 / size^2 cells per pixel
+        strength *= size;
+        size = 1;
+    }
+    // Two unit-variance fields summed
+    strength *= 0.70710678f;
+
+    FieldSet fields = cachedFields(size, parameters.roughness);
+    uint32_t seed = mix(parameters.seed);
+    int primaryX = int(mix(seed + 1) % kPrimaryPeriod), primaryY = int(mix(seed + 2) % kPrimaryPeriod);
+    int secondaryX = int(mix(seed + 3) % kSecondaryPeriod), secondaryY = int(mix(seed + 4) % kSecondaryPeriod);
+
+    parallelFor(0, height, [&](int begin, int end) {
+        std::vector<float> noise(static_cast<size_t>(width));
+        for (int row = begin; row < end; ++row) {
+            int frameY = y + row;
+            readRow(*fields.primary, wrap(int64_t(frameY) + primaryY, kPrimaryPeriod),
+                    wrap(int64_t(x) + primaryX, kPrimaryPeriod), width, noise.data(), false);
+            readRow(*fields.secondary, wrap(int64_t(frameY) + secondaryY, kSecondaryPeriod),
+                    wrap(int64_t(x) + secondaryX, kSecondaryPeriod), width, noise.data(), true);
+
+            const float* in = source + size_t(row) * sourceStride;
+            float* out = destination + size_t(row) * destinationStride;
+            const float* n = noise.data();
+            // One pixel per vector; the zero alpha weight and unit alpha gain pass alpha through
+            const Float4 luminanceWeights = { 0.2126f, 0.7152f, 0.0722f, 0.0f };
+            for (int i = 0; i < width; ++i) {
+                Float4 pixel = load(in + size_t(i) * 4);
+                float luminance = std::clamp(horizontalSum(pixel * luminanceWeights), 0.0f, 1.0f);
+                // Perceptual lightness is close enough to sqrt of linear luminance for a weight
+                float lightness = std::sqrt(luminance);
+                float weight = 4 * lightness * (1 - lightness);
+                float gain = std::max(1 + strength * weight * n[i], 0.0f);
+                store(out + size_t(i) * 4, pixel * Float4{ gain, gain, gain, 1.0f });
+            }
+        }
+    });
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,38 @@
+//
+//  FilmGrain.hpp
+//  Dirty RAW
+//
+//  Synthetic film grain drawn from precomputed, tileable grain fields. A field is multi-octave
+//  periodic value noise, normalized to zero mean and unit variance, and is generated once per
+//  (grain size, roughness) and cached. Each grain pass sums two fields with coprime-ish periods
+//  (512 and 384 pixels), so the pattern only repeats every 1536 pixels, at seed-dependent offsets
+//  anchored to the frame: tiles, regions and re-renders of one image always get the same grain.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dirtyraw {
+
+struct GrainParameters {
+    /// Strength, 0...1.
+    float amount = 0;
+    /// Grain cell size in render pixels. Below one pixel the grain averages out, so the amplitude
+    /// falls with the size instead of the field getting finer.
+    float size = 1;
+    /// Weight of the finer octaves, 0 (smooth, clumped) ... 1 (sharp, gritty).
+    float roughness = 0.5f;
+    /// Per-image seed; picks the field offsets.
+    uint32_t seed = 0;
+};
+
+/// Grains RGBA float `source` into `destination` (may alias) for frame pixels
+/// [x, x + width) x [y, y + height), rows counted from the top of the frame. Grain is monochrome
+/// and multiplicative, strongest in the midtones and fading towards black and white. Strides are
+/// in floats; rows run in parallel.
+void applyFilmGrain(const float* source, size_t sourceStride, float* destination, size_t destinationStride,
+                    int x, int y, int width, int height, const GrainParameters& parameters);
+
+} // namespace dirtyraw
@@ -0,0 +1,126 @@
+//
+//  HDRMerge.cpp
+//  Dirty RAW
+//
+
+#include "HDRMerge.hpp"
+#include "ColorManagement.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kTileWidth = 256;
+constexpr int kTileHeight = 32;
+
+/// Samples whose brightest channel passes `kClipLevel` are treated as clipped; weights fade
+/// out over `kClipRolloff` below it, so the transition between frames doesn't show.
+constexpr float kClipLevel = 0.95f;
+constexpr float kClipRolloff = 0.2f;
+/// Range of values trusted when comparing frame brightness.
+constexpr float kRatioLow = 0.02f;
+constexpr float kRatioHigh = 0.8f;
+/// Pixel step of the brightness comparison; a 45 MP frame still gives ~700k samples.
+constexpr int kRatioStep = 8;
+constexpr size_t kMinimumRatioSamples = 1000;
+
+inline float highlightWeight(float brightest) {
+    return std::clamp((kClipLevel - brightest) / kClipRolloff, 0.0f, 1.0f);
+}
+
+} // namespace
+
+float estimateExposureRatio(const StackFrame& reference, const StackFrame& frame, float fallback) {
+    const std::vector<float>& half = halfToFloatTable();
+    std::vector<float> ratios;
+    for (int y = 0; y < reference.height; y += kRatioStep) {
+        int fy = y + frame.offset.dy;
+        if (fy < 0 || fy >= frame.height) continue;
+        const uint16_t* referenceRow = reference.pixels + size_t(y) * reference.stride;
+        const uint16_t* frameRow = frame.pixels + size_t(fy) * frame.stride;
+        for (int x = 0; x < reference.width; x += kRatioStep) {
+            int fx = x + frame.offset.dx;
+            if (fx < 0 || fx >= frame.width) continue;
+            // Green carries most of the signal and is the last channel to clip in daylight
+            float a = half[referenceRow[size_t(x) * 4 + 1]];
+            float b = half[frameRow[size_t(fx) * 4 + 1]];
+            if (a < kRatioLow || a > kRatioHigh || b < kRatioLow || b > kRatioHigh) continue;
+            ratios.push_back(b / a);
+        }
+    }
+    if (ratios.size() < kMinimumRatioSamples) return fallback;
+
+    auto middle = ratios.begin() + ratios.size() / 2;
+    std::nth_element(ratios.begin(), middle, ratios.end());
+    return *middle;
+}
+
+void mergeExposures(const std::vector<StackFrame>& frames, const std::vector<float>& exposures,
+                    uint16_t* destination, size_t destinationStride,
+                    const std::function<void(double)>& progress) {
+    if (frames.empty() || exposures.size() != frames.size()) return;
+    const StackFrame& reference = frames[0];
+    int width = reference.width;
+    int height = reference.height;
+    const std::vector<float>& half = halfToFloatTable();
+    const uint16_t one = halfFromFloat(1.0f);
+    int tileColumns = (width + kTileWidth - 1) / kTileWidth;
+
+    for (int bandY = 0; bandY < height; bandY += kTileHeight) {
+        if (currentJobContext().token.isCancelled()) return;
+        int bandHeight = std::min(kTileHeight, height - bandY);
+
+        parallelFor(0, tileColumns, [&](int begin, int end) {
+            for (int column = begin; column < end; ++column) {
+                int tileX = column * kTileWidth;
+                int tileWidth = std::min(kTileWidth, width - tileX);
+
+                for (int y = bandY; y < bandY + bandHeight; ++y) {
+                    uint16_t* out = destination + size_t(y) * destinationStride;
+                    for (int x = tileX; x < tileX + tileWidth; ++x) {
+                        float sum[3] = { 0, 0, 0 };
+                        float totalWeight = 0;
+                        // Where every sample is clipped, the darkest one is the best guess
+                        float fallback[3] = { 0, 0, 0 };
+                        float fallbackExposure = std::numeric_limits<float>::infinity();
+
+                        for (size_t index = 0; index < frames.size(); ++index) {
+                            const StackFrame& frame = frames[index];
+                            int fx = x + frame.offset.dx;
+                            int fy = y + frame.offset.dy;
+                            if (fx < 0 || fy < 0 || fx >= frame.width || fy >= frame.height) continue;
+                            const uint16_t* pixel = frame.pixels + size_t(fy) * frame.stride + size_t(fx) * 4;
+                            float value[3] = { half[pixel[0]], half[pixel[1]], half[pixel[2]] };
+                            float scale = 1.0f / exposures[index];
+
+                            if (exposures[index] < fallbackExposure) {
+                                for (int c = 0; c < 3; ++c) fallback[c] = value[c] * scale;
+                                fallbackExposure = exposures[index];
+                            }
+
+                            float weight = exposures[index] * highlightWeight(std::max({ value[0], value[1], value[2] }));
+                            if (weight <= 0) continue;
+                            for (int c = 0; c < 3; ++c) sum[c] += weight * value[c] * scale;
+                            totalWeight += weight;
+                        }
+
+                        uint16_t* pixel = out + size_t(x) * 4;
+                        for (int c = 0; c < 3; ++c) {
+                            pixel[c] = halfFromFloat(totalWeight > 0 ? sum[c] / totalWeight : fallback[c]);
+                        }
+                        pixel[3] = one;
+                    }
+                }
+            }
+        });
+
+        if (progress) progress(double(bandY + bandHeight) / double(height));
+    }
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,34 @@
+//
+//  HDRMerge.hpp
+//  Dirty RAW
+//
+//  Exposure-bracket merge into a linear radiance frame. Each output pixel is the exposure-
+//  normalized average of the bracket's samples, weighted by exposure (longer exposures have
+//  proportionally less shot noise relative to signal) and faded out as a sample nears clipping.
+//  Frames come from the same spill files and alignment as stacking (Stacking.hpp); the merge
+//  walks the output in tiles on the job system, so memory stays at a few tiles per frame.
+//
+
+#pragma once
+
+#include "Stacking.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Brightness of `frame` relative to `reference` (2 = one stop brighter), measured as the
+/// median ratio over pixels well exposed in both. Returns `fallback` (usually the EXIF ratio)
+/// when too few pixels qualify.
+float estimateExposureRatio(const StackFrame& reference, const StackFrame& frame, float fallback);
+
+/// Merges `frames` (each with its offset; the first frame's geometry is the output's) into
+/// half-float RGBA `destination` scaled to the first frame's exposure, so values above 1 are
+/// highlights the first frame clipped. `exposures[i]` is the brightness of frame i relative to
+/// the first (see `estimateExposureRatio`). Progress and cancellation work as in `stackFrames`.
+void mergeExposures(const std::vector<StackFrame>& frames, const std::vector<float>& exposures,
+                    uint16_t* destination, size_t destinationStride,
+                    const std::function<void(double)>& progress);
+
+} // namespace dirtyraw
@@ -0,0 +1,94 @@
+//
+//  ImageEncoder.cpp
+//  Dirty RAW
+//
+
+#include "ImageEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace dirtyraw {
+
+// MARK: - File writer
+
+std::unique_ptr<FileWriter> FileWriter::create(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return nullptr;
+    return std::unique_ptr<FileWriter>(new FileWriter(fd));
+}
+
+FileWriter::~FileWriter() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool FileWriter::write(const void* bytes, size_t count) {
+    const uint8_t* cursor = static_cast<const uint8_t*>(bytes);
+    while (ok_ && count > 0) {
+        ssize_t written = ::write(fd_, cursor, count);
+        if (written <= 0) {
+            ok_ = false;
+            break;
+        }
+        cursor += written;
+        count -= size_t(written);
+        position_ += uint64_t(written);
+    }
+    return ok_;
+}
+
+bool FileWriter::writeAt(uint64_t offset, const void* bytes, size_t count) {
+    if (ok_ && ::pwrite(fd_, bytes, count, off_t(offset)) != ssize_t(count)) ok_ = false;
+    return ok_;
+}
+
+bool FileWriter::close() {
+    if (fd_ >= 0 && ::close(fd_) != 0) ok_ = false;
+    fd_ = -1;
+    return ok_;
+}
+
+// MARK: - Encoder
+
+ImageEncoder::ImageEncoder(FileWriter& writer, const EncoderSettings& settings, int chunkRows)
+    : writer_(writer), settings_(settings), chunkRows_(chunkRows) {}
+
+bool ImageEncoder::writeRows(const void* rows, size_t stride, int rowCount) {
+    if (failed_) return false;
+    if (!started_) {
+        started_ = true;
+        chunk_.resize(rowBytes() * chunkRows_);
+        if (!writeHeader()) failed_ = true;
+    }
+
+    size_t sampleBytes = bytesPerSample();
+    if (chunkFirstRow_ + chunkRowCount_ + rowCount > settings_.height) failed_ = true;
+    for (int row = 0; row < rowCount && !failed_; ++row) {
+        // Drop alpha while copying into the chunk
+        const uint8_t* in = static_cast<const uint8_t*>(rows) + stride * row;
+        uint8_t* out = chunk_.data() + rowBytes() * chunkRowCount_;
+        for (int x = 0; x < settings_.width; ++x) {
+            std::memcpy(out + size_t(x) * 3 * sampleBytes, in + size_t(x) * 4 * sampleBytes, 3 * sampleBytes);
+        }
+        if (++chunkRowCount_ == chunkRows_) flushChunk();
+    }
+    return !failed_;
+}
+
+bool ImageEncoder::finish() {
+    if (!started_ || failed_) return false;
+    if (chunkRowCount_ > 0) flushChunk();
+    if (failed_ || chunkFirstRow_ != settings_.height) return false;
+    return writeTrailer() && writer_.ok();
+}
+
+bool ImageEncoder::flushChunk() {
+    if (!encodeChunk(chunk_.data(), chunkFirstRow_, chunkRowCount_) || !writer_.ok()) failed_ = true;
+    chunkFirstRow_ += chunkRowCount_;
+    chunkRowCount_ = 0;
+    return !failed_;
+}
+
+} // namespace dirtyraw
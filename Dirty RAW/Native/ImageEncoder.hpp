@@ -0,0 +1,116 @@
+//
+//  ImageEncoder.hpp
+//  Dirty RAW
+//
+//  Row-streaming encoders for export: baseline JPEG, PNG and TIFF (uncompressed or Deflate).
+//  Rows arrive top to bottom as the export stream renders them. Each encoder buffers a chunk of
+//  rows, splits it into pieces the format lets it compress independently (JPEG restart
+//  intervals, PNG deflate row groups, TIFF strips), compresses the pieces in parallel on the
+//  job system and appends them to the file in order. Memory stays at one chunk of rows.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Output file written front to back, with patching of already written bytes (TIFF offsets).
+/// Remembers the first failure; later writes are ignored.
+class FileWriter {
+public:
+    /// Creates or truncates `path`; null if it can't be opened for writing.
+    static std::unique_ptr<FileWriter> create(const std::string& path);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool write(const void* bytes, size_t count);
+    bool write(const std::vector<uint8_t>& bytes) { return write(bytes.data(), bytes.size()); }
+    bool writeAt(uint64_t offset, const void* bytes, size_t count);
+    uint64_t position() const { return position_; }
+    bool ok() const { return ok_; }
+    /// Closes the file; false if any write (or the close) failed.
+    bool close();
+
+private:
+    explicit FileWriter(int fd) : fd_(fd) {}
+
+    int fd_;
+    uint64_t position_ = 0;
+    bool ok_ = true;
+};
+
+enum class ChromaSubsampling : int {
+    /// 4:4:4
+    none = 0,
+    /// 4:2:2
+    horizontal = 1,
+    /// 4:2:0
+    both = 2,
+};
+
+struct EncoderSettings {
+    int width = 0;
+    int height = 0;
+    /// 8 or 16 bits per sample; JPEG takes 8 only.
+    int bitsPerSample = 8;
+    /// ICC profile to embed; may be empty.
+    std::vector<uint8_t> iccProfile;
+
+    /// JPEG quality, 1...100 on the libjpeg scale.
+    int jpegQuality = 90;
+    ChromaSubsampling jpegSubsampling = ChromaSubsampling::both;
+    /// TIFF: Deflate with horizontal prediction instead of uncompressed strips.
+    bool tiffDeflate = true;
+};
+
+class ImageEncoder {
+public:
+    virtual ~ImageEncoder() = default;
+
+    /// Appends `rowCount` rows of interleaved RGBA, `bitsPerSample` per sample in host order
+    /// (alpha is dropped); `stride` is in bytes.
+    bool writeRows(const void* rows, size_t stride, int rowCount);
+    /// Encodes the remaining rows and completes the file. All rows must have been written.
+    bool finish();
+
+protected:
+    ImageEncoder(FileWriter& writer, const EncoderSettings& settings, int chunkRows);
+
+    virtual bool writeHeader() = 0;
+    /// Encodes packed RGB rows [firstRow, firstRow + rowCount), `rowBytes()` apart. Chunks
+    /// arrive in order and hold `chunkRows` rows except for the last.
+    virtual bool encodeChunk(const uint8_t* rows, int firstRow, int rowCount) = 0;
+    virtual bool writeTrailer() = 0;
+
+    size_t bytesPerSample() const { return settings_.bitsPerSample / 8; }
+    size_t rowBytes() const { return size_t(settings_.width) * 3 * bytesPerSample(); }
+
+    FileWriter& writer_;
+    const EncoderSettings settings_;
+
+private:
+    bool flushChunk();
+
+    const int chunkRows_;
+    std::vector<uint8_t> chunk_;
+    int chunkFirstRow_ = 0;
+    int chunkRowCount_ = 0;
+    bool started_ = false;
+    bool failed_ = false;
+};
+
+/// Baseline JPEG with a restart interval per MCU row; null if the size exceeds 65535.
+std::unique_ptr<ImageEncoder> makeJPEGEncoder(FileWriter& writer, const EncoderSettings& settings);
+/// RGB PNG, 8 or 16 bits per sample, adaptive row filters.
+std::unique_ptr<ImageEncoder> makePNGEncoder(FileWriter& writer, const EncoderSettings& settings);
+/// Little-endian RGB TIFF in strips; null if the file could exceed 4 GB.
+std::unique_ptr<ImageEncoder> makeTIFFEncoder(FileWriter& writer, const EncoderSettings& settings);
+
+} // namespace dirtyraw
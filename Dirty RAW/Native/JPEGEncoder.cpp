@@ -0,0 +1,402 @@
+//
+//  JPEGEncoder.cpp
+//  Dirty RAW
+//
+//  Baseline JPEG (JFIF, YCbCr, standard Huffman tables). Every MCU row is its own restart
+//  interval: the DC predictors reset at each RST marker, so the rows entropy-code
+//  independently and in parallel, and the results are concatenated between markers.
+//
+
+#include "ImageEncoder.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace dirtyraw {
+
+namespace {
+
+/// Rows buffered per chunk; a multiple of every MCU height.
+constexpr int kChunkRows = 256;
+/// Largest ICC payload per APP2 marker (65535 minus the length, signature and sequence bytes).
+constexpr size_t kICCChunkBytes = 65519;
+
+/// Zigzag position -> natural (row-major) index.
+constexpr int kZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Quantization tables from Annex K of the JPEG standard, in natural order.
+constexpr uint8_t kLuminanceQuantization[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+constexpr uint8_t kChrominanceQuantization[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Huffman tables from Annex K: code counts per length (1...16 bits), then symbols.
+constexpr uint8_t kDCLuminanceBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+constexpr uint8_t kDCChrominanceBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+constexpr uint8_t kDCSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+constexpr uint8_t kACLuminanceBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+constexpr uint8_t kACLuminanceSymbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+constexpr uint8_t kACChrominanceBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+constexpr uint8_t kACChrominanceSymbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+/// Scale factors of the AAN DCT outputs, folded into the quantization divisors.
+constexpr float kAANScale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+struct HuffmanTable {
+    uint16_t code[256] = {};
+    uint8_t length[256] = {};
+
+    HuffmanTable(const uint8_t* bits, const uint8_t* symbols) {
+        // Canonical codes: consecutive values within a length, doubling between lengths
+        uint16_t next = 0;
+        int index = 0;
+        for (int size = 1; size <= 16; ++size) {
+            for (int count = 0; count < bits[size - 1]; ++count) {
+                code[symbols[index]] = next++;
+                length[symbols[index]] = uint8_t(size);
+                ++index;
+            }
+            next <<= 1;
+        }
+    }
+};
+
+/// Entropy-coded bytes of one restart interval, with 0xFF stuffing.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(uint32_t bits, int count) {
+        buffer_ = (buffer_ << count) | (bits & ((1u << count) - 1));
+        filled_ += count;
+        while (filled_ >= 8) {
+            filled_ -= 8;
+            uint8_t byte = uint8_t(buffer_ >> filled_);
+            out_.push_back(byte);
+            if (byte == 0xFF) out_.push_back(0x00);
+        }
+    }
+
+    /// Pads the last byte with one bits, as required before a marker.
+    void flush() {
+        if (filled_ > 0) put(0x7F, 8 - filled_);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t buffer_ = 0;
+    int filled_ = 0;
+};
+
+/// Float AAN forward DCT of an 8x8 block in place (as in libjpeg's jfdctflt).
+void forwardDCT(float* block) {
+    auto pass = [](float* data, int step) {
+        for (int i = 0; i < 8; ++i) {
+            float* d = data + i * (step == 1 ? 8 : 1);
+            float tmp0 = d[0 * step] + d[7 * step], tmp7 = d[0 * step] - d[7 * step];
+            float tmp1 = d[1 * step] + d[6 * step], tmp6 = d[1 * step] - d[6 * step];
+            float tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+            float tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+            float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+            float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+            d[0 * step] = tmp10 + tmp11;
+            d[4 * step] = tmp10 - tmp11;
+            float z1 = (tmp12 + tmp13) * 0.707106781f;
+            d[2 * step] = tmp13 + z1;
+            d[6 * step] = tmp13 - z1;
+
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            float z5 = (tmp10 - tmp12) * 0.382683433f;
+            float z2 = 0.541196100f * tmp10 + z5;
+            float z4 = 1.306562965f * tmp12 + z5;
+            float z3 = tmp11 * 0.707106781f;
+            float z11 = tmp7 + z3, z13 = tmp7 - z3;
+            d[5 * step] = z13 + z2;
+            d[3 * step] = z13 - z2;
+            d[1 * step] = z11 + z4;
+            d[7 * step] = z11 - z4;
+        }
+    };
+    pass(block, 1);
+    pass(block, 8);
+}
+
+/// Bits needed for the magnitude of `value`, and its JPEG bit pattern.
+inline int magnitudeBits(int value) {
+    int magnitude = value < 0 ? -value : value;
+    int bits = 0;
+    while (magnitude) {
+        ++bits;
+        magnitude >>= 1;
+    }
+    return bits;
+}
+
+class JPEGEncoder final : public ImageEncoder {
+public:
+    JPEGEncoder(FileWriter& writer, const EncoderSettings& settings)
+        : ImageEncoder(writer, settings, kChunkRows),
+          dcLuminance_(kDCLuminanceBits, kDCSymbols),
+          acLuminance_(kACLuminanceBits, kACLuminanceSymbols),
+          dcChrominance_(kDCChrominanceBits, kDCSymbols),
+          acChrominance_(kACChrominanceBits, kACChrominanceSymbols) {
+        horizontalFactor_ = settings.jpegSubsampling == ChromaSubsampling::none ? 1 : 2;
+        verticalFactor_ = settings.jpegSubsampling == ChromaSubsampling::both ? 2 : 1;
+        mcuColumns_ = (settings.width + 8 * horizontalFactor_ - 1) / (8 * horizontalFactor_);
+
+        // libjpeg's quality scaling, then the AAN output scale folded in
+        int quality = std::clamp(settings.jpegQuality, 1, 100);
+        int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        for (int i = 0; i < 64; ++i) {
+            luminanceTable_[i] = uint8_t(std::clamp((kLuminanceQuantization[i] * scale + 50) / 100, 1, 255));
+            chrominanceTable_[i] = uint8_t(std::clamp((kChrominanceQuantization[i] * scale + 50) / 100, 1, 255));
+            float aan = kAANScale[i / 8] * kAANScale[i % 8] * 8.0f;
+            luminanceDivisors_[i] = 1.0f / (luminanceTable_[i] * aan);
+            chrominanceDivisors_[i] = 1.0f / (chrominanceTable_[i] * aan);
+        }
+    }
+
+protected:
+    bool writeHeader() override {
+        std::vector<uint8_t> header = { 0xFF, 0xD8 };
+        auto marker = [&](uint8_t type, const std::vector<uint8_t>& payload) {
+            size_t length = payload.size() + 2;
+            header.insert(header.end(), { 0xFF, type, uint8_t(length >> 8), uint8_t(length) });
+            header.insert(header.end(), payload.begin(), payload.end());
+        };
+
+        marker(0xE0, { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+
+        const std::vector<uint8_t>& icc = settings_.iccProfile;
+        size_t iccMarkers = (icc.size() + kICCChunkBytes - 1) / kICCChunkBytes;
+        for (size_t index = 0; index < iccMarkers && iccMarkers < 256; ++index) {
+            std::vector<uint8_t> payload = { 'I', 'C', 'C', '_', 'P', 'R', 'O', 'F', 'I', 'L', 'E', 0,
+                                             uint8_t(index + 1), uint8_t(iccMarkers) };
+            size_t begin = index * kICCChunkBytes;
+            payload.insert(payload.end(), icc.begin() + begin, icc.begin() + std::min(begin + kICCChunkBytes, icc.size()));
+            marker(0xE2, payload);
+        }
+
+        std::vector<uint8_t> quantization;
+        for (int table = 0; table < 2; ++table) {
+            quantization.push_back(uint8_t(table));
+            const uint8_t* values = table == 0 ? luminanceTable_ : chrominanceTable_;
+            for (int k = 0; k < 64; ++k) quantization.push_back(values[kZigzag[k]]);
+        }
+        marker(0xDB, quantization);
+
+        int width = settings_.width, height = settings_.height;
+        marker(0xC0, { 8, uint8_t(height >> 8), uint8_t(height), uint8_t(width >> 8), uint8_t(width), 3,
+                       1, uint8_t(horizontalFactor_ << 4 | verticalFactor_), 0,
+                       2, 0x11, 1,
+                       3, 0x11, 1 });
+
+        std::vector<uint8_t> huffman;
+        auto addTable = [&](uint8_t classAndID, const uint8_t* bits, const uint8_t* symbols) {
+            huffman.push_back(classAndID);
+            int count = 0;
+            for (int i = 0; i < 16; ++i) {
+                huffman.push_back(bits[i]);
+                count += bits[i];
+            }
+            huffman.insert(huffman.end(), symbols, symbols + count);
+        };
+        addTable(0x00, kDCLuminanceBits, kDCSymbols);
+        addTable(0x10, kACLuminanceBits, kACLuminanceSymbols);
+        addTable(0x01, kDCChrominanceBits, kDCSymbols);
+        addTable(0x11, kACChrominanceBits, kACChrominanceSymbols);
+        marker(0xC4, huffman);
+
+        marker(0xDD, { uint8_t(mcuColumns_ >> 8), uint8_t(mcuColumns_) });
+        marker(0xDA, { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 });
+        return writer_.write(header);
+    }
+
+    bool encodeChunk(const uint8_t* rows, int /*firstRow*/, int rowCount) override {
+        int mcuHeight = 8 * verticalFactor_;
+        int mcuRows = (rowCount + mcuHeight - 1) / mcuHeight;
+        std::vector<std::vector<uint8_t>> intervals(mcuRows);
+        parallelFor(0, mcuRows, [&](int begin, int end) {
+            for (int mcuRow = begin; mcuRow < end; ++mcuRow) {
+                encodeMCURow(rows, rowCount, mcuRow * mcuHeight, intervals[mcuRow]);
+            }
+        });
+
+        for (const std::vector<uint8_t>& interval : intervals) {
+            if (intervalCount_ > 0) {
+                uint8_t restart[2] = { 0xFF, uint8_t(0xD0 + ((intervalCount_ - 1) & 7)) };
+                writer_.write(restart, 2);
+            }
+            writer_.write(interval);
+            ++intervalCount_;
+        }
+        return writer_.ok();
+    }
+
+    bool writeTrailer() override {
+        uint8_t end[2] = { 0xFF, 0xD9 };
+        return writer_.write(end, 2);
+    }
+
+private:
+    /// Encodes the MCU row whose top is `top` within the chunk. Pixels past the right and
+    /// bottom edges repeat the edge pixels.
+    void encodeMCURow(const uint8_t* rows, int rowCount, int top, std::vector<uint8_t>& out) const {
+        int width = settings_.width;
+        int mcuWidth = 8 * horizontalFactor_;
+        int mcuHeight = 8 * verticalFactor_;
+        size_t stride = rowBytes();
+        out.reserve(size_t(mcuColumns_) * 64 * horizontalFactor_ * verticalFactor_);
+        BitWriter bits(out);
+        int previousDC[3] = { 0, 0, 0 };
+
+        // Colour converted MCU: full-resolution Y, then Cb and Cr before subsampling
+        float y[16 * 16], cb[16 * 16], cr[16 * 16];
+        float block[64];
+        for (int column = 0; column < mcuColumns_; ++column) {
+            int left = column * mcuWidth;
+            for (int py = 0; py < mcuHeight; ++py) {
+                const uint8_t* row = rows + stride * std::min(top + py, rowCount - 1);
+                for (int px = 0; px < mcuWidth; ++px) {
+                    const uint8_t* pixel = row + size_t(std::min(left + px, width - 1)) * 3;
+                    float r = pixel[0], g = pixel[1], b = pixel[2];
+                    int index = py * mcuWidth + px;
+                    y[index] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+                    cb[index] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                    cr[index] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+                }
+            }
+
+            for (int by = 0; by < verticalFactor_; ++by) {
+                for (int bx = 0; bx < horizontalFactor_; ++bx) {
+                    for (int i = 0; i < 64; ++i) block[i] = y[(by * 8 + i / 8) * mcuWidth + bx * 8 + i % 8];
+                    encodeBlock(block, luminanceDivisors_, dcLuminance_, acLuminance_, previousDC[0], bits);
+                }
+            }
+            for (int component = 1; component < 3; ++component) {
+                const float* plane = component == 1 ? cb : cr;
+                float weight = 1.0f / float(horizontalFactor_ * verticalFactor_);
+                for (int i = 0; i < 64; ++i) {
+                    int sy = (i / 8) * verticalFactor_, sx = (i % 8) * horizontalFactor_;
+                    float sum = 0;
+                    for (int dy = 0; dy < verticalFactor_; ++dy) {
+                        for (int dx = 0; dx < horizontalFactor_; ++dx) sum += plane[(sy + dy) * mcuWidth + sx + dx];
+                    }
+                    block[i] = sum * weight;
+                }
+                encodeBlock(block, chrominanceDivisors_, dcChrominance_, acChrominance_, previousDC[component], bits);
+            }
+        }
+        bits.flush();
+    }
+
+    static void encodeBlock(float* block, const float* divisors, const HuffmanTable& dc, const HuffmanTable& ac,
+                            int& previousDC, BitWriter& bits) {
+        forwardDCT(block);
+        int coefficients[64];
+        for (int k = 0; k < 64; ++k) {
+            int index = kZigzag[k];
+            coefficients[k] = int(std::lround(block[index] * divisors[index]));
+        }
+
+        auto putValue = [&](const HuffmanTable& table, int symbol, int value, int size) {
+            bits.put(table.code[symbol], table.length[symbol]);
+            // Negative values are sent as value - 1 in `size` bits
+            if (size) bits.put(uint32_t(value < 0 ? value - 1 : value), size);
+        };
+
+        int difference = coefficients[0] - previousDC;
+        previousDC = coefficients[0];
+        int size = magnitudeBits(difference);
+        putValue(dc, size, difference, size);
+
+        int run = 0;
+        for (int k = 1; k < 64; ++k) {
+            int value = coefficients[k];
+            if (value == 0) {
+                ++run;
+                continue;
+            }
+            while (run >= 16) {
+                bits.put(ac.code[0xF0], ac.length[0xF0]);
+                run -= 16;
+            }
+            size = magnitudeBits(value);
+            putValue(ac, (run << 4) | size, value, size);
+            run = 0;
+        }
+        if (run > 0) bits.put(ac.code[0x00], ac.length[0x00]);
+    }
+
+    HuffmanTable dcLuminance_, acLuminance_, dcChrominance_, acChrominance_;
+    uint8_t luminanceTable_[64];
+    uint8_t chrominanceTable_[64];
+    float luminanceDivisors_[64];
+    float chrominanceDivisors_[64];
+    int horizontalFactor_ = 1;
+    int verticalFactor_ = 1;
+    int mcuColumns_ = 0;
+    int intervalCount_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<ImageEncoder> makeJPEGEncoder(FileWriter& writer, const EncoderSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0 || settings.width > 65535 || settings.height > 65535) return nullptr;
+    if (settings.bitsPerSample != 8) return nullptr;
+    return std::make_unique<JPEGEncoder>(writer, settings);
+}
+
+} // namespace dirtyraw
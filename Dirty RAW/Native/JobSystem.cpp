@@ -0,0 +1,280 @@
+//
+//  JobSystem.cpp
+//  Dirty RAW
+//
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kPriorityCount = 2;
+
+thread_local JobContext currentContext;
+/// Index of the worker running on this thread, or -1 for threads outside the pool.
+thread_local int currentWorker = -1;
+
+} // namespace
+
+// MARK: - Context
+
+const JobContext& currentJobContext() {
+    return currentContext;
+}
+
+JobScope::JobScope(JobContext context) : previous_(currentContext) {
+    currentContext = std::move(context);
+}
+
+JobScope::~JobScope() {
+    currentContext = previous_;
+}
+
+// MARK: - Graph
+
+int JobGraph::add(Job job) {
+    nodes_.push_back({ std::move(job), {}, 0 });
+    return int(nodes_.size()) - 1;
+}
+
+void JobGraph::precede(int before, int after) {
+    nodes_[before].successors.push_back(after);
+    ++nodes_[after].dependencies;
+}
+
+void BlockJobs::precede(JobGraph& graph, int job, int from, int to) const {
+    int first = std::max(from, begin);
+    int last = std::min(to, end);
+    if (first >= last) return;
+    for (int block = (first - begin) / blockSize; block <= (last - 1 - begin) / blockSize; ++block) {
+        graph.precede(jobs[block], job);
+    }
+}
+
+BlockJobs addBlockJobs(JobGraph& graph, int begin, int end, int blockSize,
+                       std::function<void(int blockBegin, int blockEnd)> body) {
+    BlockJobs blocks { begin, end, std::max(blockSize, 1), {} };
+    auto shared = std::make_shared<std::function<void(int, int)>>(std::move(body));
+    for (int start = begin; start < end; start += blocks.blockSize) {
+        int stop = std::min(start + blocks.blockSize, end);
+        blocks.jobs.push_back(graph.add([shared, start, stop] { (*shared)(start, stop); }));
+    }
+    return blocks;
+}
+
+// MARK: - Scheduler
+
+/// One `run` call: the graph, its context and what is left to do.
+struct JobSystem::Run {
+    JobGraph* graph;
+    JobContext context;
+    std::unique_ptr<std::atomic<int>[]> pending;
+    std::atomic<int> remaining;
+    /// Set under `mutex` by the job that finishes last.
+    std::atomic<bool> done { false };
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+struct JobSystem::Task {
+    Run* run = nullptr;
+    int node = 0;
+};
+
+struct JobSystem::Worker {
+    std::mutex mutex;
+    std::deque<Task> queues[kPriorityCount];
+
+    std::atomic<uint64_t> busyNanoseconds { 0 };
+    std::atomic<uint64_t> jobs { 0 };
+    std::atomic<uint64_t> steals { 0 };
+};
+
+/// Where idle workers park until work is queued.
+struct JobSystem::Wake {
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+JobSystem& JobSystem::shared() {
+    // Never destroyed: workers are still parked on it when static destructors run at exit
+    static JobSystem* system = new JobSystem();
+    return *system;
+}
+
+JobSystem::JobSystem() : injection_(std::make_unique<Worker>()), wake_(std::make_unique<Wake>()) {
+    // The thread that submits work runs jobs too
+    int count = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+    for (int index = 0; index < count; ++index) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (int index = 0; index < count; ++index) {
+        std::thread([this, index] { workerLoop(index); }).detach();
+    }
+}
+
+uint64_t JobSystem::now() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::vector<WorkerStats> JobSystem::stats() const {
+    std::vector<WorkerStats> result;
+    result.reserve(workers_.size());
+    for (const auto& worker : workers_) {
+        result.push_back({ worker->busyNanoseconds.load(std::memory_order_relaxed),
+                           worker->jobs.load(std::memory_order_relaxed),
+                           worker->steals.load(std::memory_order_relaxed) });
+    }
+    return result;
+}
+
+void JobSystem::run(JobGraph& graph) {
+    if (graph.nodes_.empty()) return;
+
+    const JobContext& context = currentJobContext();
+    if (graph.nodes_.size() == 1) {
+        if (!context.token.isCancelled() && graph.nodes_[0].job) graph.nodes_[0].job();
+        return;
+    }
+
+    Run run;
+    run.graph = &graph;
+    run.context = context;
+    run.pending = std::make_unique<std::atomic<int>[]>(graph.nodes_.size());
+    run.remaining = int(graph.nodes_.size());
+    for (size_t node = 0; node < graph.nodes_.size(); ++node) {
+        run.pending[node] = graph.nodes_[node].dependencies;
+    }
+    for (size_t node = 0; node < graph.nodes_.size(); ++node) {
+        if (graph.nodes_[node].dependencies == 0) push({ &run, int(node) });
+    }
+
+    // Help until the graph is done. Only jobs at least as urgent as this one are taken, so an
+    // interactive caller is never held up behind a batch job.
+    Task task;
+    while (!run.done.load(std::memory_order_acquire)) {
+        if (take(currentWorker, context.priority, task)) {
+            execute(task, currentWorker);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(run.mutex);
+        run.finished.wait_for(lock, std::chrono::microseconds(200),
+                              [&] { return run.done.load(std::memory_order_acquire); });
+    }
+    // The last job may still be signalling; taking the lock waits for it to let go of `run`
+    std::lock_guard<std::mutex> lock(run.mutex);
+}
+
+void JobSystem::push(const Task& task) {
+    Worker& target = currentWorker >= 0 ? *workers_[currentWorker] : *injection_;
+    int priority = int(task.run->context.priority);
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.queues[priority].push_back(task);
+    }
+    queued_.fetch_add(1, std::memory_order_release);
+    {
+        // Pairs with the predicate check in `workerLoop`, so a wakeup can't be missed
+        std::lock_guard<std::mutex> lock(wake_->mutex);
+    }
+    wake_->condition.notify_one();
+}
+
+bool JobSystem::take(int self, JobPriority lowest, Task& task) {
+    if (queued_.load(std::memory_order_acquire) == 0) return false;
+
+    for (int priority = 0; priority <= int(lowest); ++priority) {
+        // Own deque, newest first: its data is most likely still in cache
+        if (self >= 0) {
+            Worker& worker = *workers_[self];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            auto& queue = worker.queues[priority];
+            if (!queue.empty()) {
+                task = queue.back();
+                queue.pop_back();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(injection_->mutex);
+            auto& queue = injection_->queues[priority];
+            if (!queue.empty()) {
+                task = queue.front();
+                queue.pop_front();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        // Steal the oldest job of another worker, starting after our own index
+        int count = int(workers_.size());
+        for (int offset = 1; offset <= count; ++offset) {
+            int victim = ((self < 0 ? 0 : self) + offset) % count;
+            if (victim == self) continue;
+            Worker& worker = *workers_[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            auto& queue = worker.queues[priority];
+            if (!queue.empty()) {
+                task = queue.front();
+                queue.pop_front();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                if (self >= 0) workers_[self]->steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(const Task& task, int self) {
+    Run& run = *task.run;
+    JobGraph::Node& node = run.graph->nodes_[task.node];
+
+    if (!run.context.token.isCancelled() && node.job) {
+        uint64_t start = self >= 0 ? now() : 0;
+        {
+            JobScope scope(run.context);
+            node.job();
+        }
+        if (self >= 0) {
+            workers_[self]->busyNanoseconds.fetch_add(now() - start, std::memory_order_relaxed);
+            workers_[self]->jobs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Skipped jobs still release their successors, which skip in turn
+    for (int successor : node.successors) {
+        if (run.pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            push({ &run, successor });
+        }
+    }
+    if (run.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(run.mutex);
+        run.done.store(true, std::memory_order_release);
+        run.finished.notify_all();
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    currentWorker = index;
+    Task task;
+    for (;;) {
+        if (take(index, JobPriority::batch, task)) {
+            execute(task, index);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_->mutex);
+        wake_->condition.wait(lock, [&] { return queued_.load(std::memory_order_acquire) > 0; });
+    }
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,159 @@
+//
+//  JobSystem.hpp
+//  Dirty RAW
+//
+//  Shared CPU job system for the native image kernels. One worker per core (less one for the
+//  thread that submits) keeps a work-stealing deque per priority class: owners push and pop at
+//  the back, idle workers steal from the front of others. Every worker looks for interactive
+//  work before batch work, so a preview render that arrives during an export is picked up at
+//  the next job boundary instead of competing with it for cores.
+//
+//  Work is submitted as a graph of jobs with dependency edges and run to completion; the
+//  submitting thread executes jobs while it waits. Priority and cancellation travel with the
+//  work: a graph runs with the `JobContext` of the thread that submits it, and its jobs run with
+//  that context in turn, so nested work inherits it.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace dirtyraw {
+
+enum class JobPriority : int {
+    /// Previews and anything the user is waiting on.
+    interactive = 0,
+    /// Exports and background work; runs only when no interactive job is queued.
+    batch = 1,
+};
+
+/// Cancellation flag shared by every copy of the token.
+class CancellationToken {
+public:
+    CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { cancelled_->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+struct JobContext {
+    JobPriority priority = JobPriority::interactive;
+    /// Once cancelled, jobs that haven't started are skipped; callers discard partial output.
+    CancellationToken token;
+};
+
+/// Context for work started on this thread: interactive and never cancelled unless a
+/// `JobScope` (or the job being run) says otherwise.
+const JobContext& currentJobContext();
+
+/// Sets the context for work started on this thread until the scope ends.
+class JobScope {
+public:
+    explicit JobScope(JobContext context);
+    explicit JobScope(JobPriority priority) : JobScope(JobContext { priority, CancellationToken() }) {}
+    ~JobScope();
+
+    JobScope(const JobScope&) = delete;
+    JobScope& operator=(const JobScope&) = delete;
+
+private:
+    JobContext previous_;
+};
+
+/// Jobs and the order they must run in. A graph is run once.
+class JobGraph {
+public:
+    using Job = std::function<void()>;
+
+    /// Adds a job; returns its index for `precede`.
+    int add(Job job);
+    /// `after` starts only once `before` has finished.
+    void precede(int before, int after);
+
+    size_t size() const { return nodes_.size(); }
+
+private:
+    friend class JobSystem;
+
+    struct Node {
+        Job job;
+        std::vector<int> successors;
+        int dependencies = 0;
+    };
+
+    std::vector<Node> nodes_;
+};
+
+/// Jobs over [begin, end) of one axis in blocks of `blockSize` (row bands, tile rows...).
+struct BlockJobs {
+    int begin = 0;
+    int end = 0;
+    int blockSize = 1;
+    std::vector<int> jobs;
+
+    /// Makes `job` wait only for the blocks overlapping [from, to), the halo-extended range it
+    /// reads, so a later pass starts on a block as soon as its neighbourhood is done rather than
+    /// after the whole earlier pass.
+    void precede(JobGraph& graph, int job, int from, int to) const;
+};
+
+BlockJobs addBlockJobs(JobGraph& graph, int begin, int end, int blockSize,
+                       std::function<void(int blockBegin, int blockEnd)> body);
+
+struct WorkerStats {
+    /// Time spent running jobs.
+    uint64_t busyNanoseconds = 0;
+    uint64_t jobs = 0;
+    /// Jobs taken from another worker's deque.
+    uint64_t steals = 0;
+};
+
+class JobSystem {
+public:
+    static JobSystem& shared();
+
+    int workerCount() const { return int(workers_.size()); }
+
+    /// Runs every job of `graph` in dependency order with the current context and returns once
+    /// all of them have finished or been skipped by cancellation. While waiting, the calling
+    /// thread runs queued jobs of the same or higher priority.
+    void run(JobGraph& graph);
+
+    /// Counters per worker since launch. Jobs run by submitting threads are not counted.
+    std::vector<WorkerStats> stats() const;
+
+    /// Monotonic clock the stats are measured with.
+    static uint64_t now();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+private:
+    struct Run;
+    struct Task;
+    struct Worker;
+    struct Wake;
+
+    JobSystem();
+
+    void workerLoop(int index);
+    void push(const Task& task);
+    /// Next task of at most `lowest` priority class, preferring interactive work, then the
+    /// caller's own deque, the shared queue and finally other workers' deques.
+    bool take(int self, JobPriority lowest, Task& task);
+    void execute(const Task& task, int self);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Worker> injection_;
+    std::unique_ptr<Wake> wake_;
+    std::atomic<int> queued_ { 0 };
+};
+
+} // namespace dirtyraw
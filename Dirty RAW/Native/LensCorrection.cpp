@@ -0,0 +1,208 @@
+//
+//  LensCorrection.cpp
+//  Dirty RAW
+//
+
+#include "LensCorrection.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+namespace dirtyraw {
+
+namespace {
+
+/// Distance between table nodes, in output pixels.
+constexpr int kNodeSpacing = 32;
+/// Output tiles processed per task; sized so a tile's source footprint stays in cache.
+constexpr int kTileSize = 128;
+/// Cached tables are dropped least recently used first beyond this many bytes.
+constexpr size_t kCacheBudget = size_t(32) << 20;
+/// Vignetting gain is capped where a profile's falloff polynomial approaches zero.
+constexpr float kMinimumIllumination = 0.05f;
+
+/// Bilinear sample of channel `channel` at continuous frame position (x, y), clamped to the
+/// source rect.
+inline float sample(const float* source, size_t stride, int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                    float x, float y, int channel) {
+    float px = std::clamp(x - 0.5f - sourceX, 0.0f, float(sourceWidth - 1));
+    float py = std::clamp(y - 0.5f - sourceY, 0.0f, float(sourceHeight - 1));
+    int x0 = std::min(int(px), sourceWidth - 1);
+    int y0 = std::min(int(py), sourceHeight - 1);
+    int x1 = std::min(x0 + 1, sourceWidth - 1);
+    int y1 = std::min(y0 + 1, sourceHeight - 1);
+    float fx = px - x0;
+    float fy = py - y0;
+
+    const float* top = source + size_t(y0) * stride;
+    const float* bottom = source + size_t(y1) * stride;
+    float a = top[x0 * 4 + channel] + (top[x1 * 4 + channel] - top[x0 * 4 + channel]) * fx;
+    float b = bottom[x0 * 4 + channel] + (bottom[x1 * 4 + channel] - bottom[x0 * 4 + channel]) * fx;
+    return a + (b - a) * fy;
+}
+
+struct CacheEntry {
+    LensModel model;
+    int width;
+    int height;
+    std::shared_ptr<const RemapTable> table;
+};
+
+} // namespace
+
+RemapTable::RemapTable(const LensModel& model, int width, int height)
+    : width_(std::max(width, 1)),
+      height_(std::max(height, 1)),
+      columns_((width_ + kNodeSpacing - 1) / kNodeSpacing + 1),
+      rows_((height_ + kNodeSpacing - 1) / kNodeSpacing + 1),
+      nodes_(size_t(columns_) * rows_) {
+    double centerX = width_ * 0.5;
+    double centerY = height_ * 0.5;
+    double halfDiagonal = 0.5 * std::sqrt(double(width_) * width_ + double(height_) * height_);
+
+    for (int row = 0; row < rows_; ++row) {
+        for (int column = 0; column < columns_; ++column) {
+            double x = double(column) * kNodeSpacing;
+            double y = double(row) * kNodeSpacing;
+            double dx = x - centerX;
+            double dy = y - centerY;
+            double r2 = (dx * dx + dy * dy) / (halfDiagonal * halfDiagonal);
+
+            double scale = 1 + r2 * (model.k1 + r2 * (model.k2 + r2 * model.k3));
+            double sourceR2 = r2 * scale * scale;
+            double illumination = 1 + sourceR2 * (model.v1 + sourceR2 * (model.v2 + sourceR2 * model.v3));
+
+            Node& node = nodes_[size_t(row) * columns_ + column];
+            node.greenX = float(centerX + dx * scale);
+            node.greenY = float(centerY + dy * scale);
+            node.redX = float(centerX + dx * scale * model.caRed);
+            node.redY = float(centerY + dy * scale * model.caRed);
+            node.blueX = float(centerX + dx * scale * model.caBlue);
+            node.blueY = float(centerY + dy * scale * model.caBlue);
+            node.gain = 1.0f / std::max(float(illumination), kMinimumIllumination);
+
+            for (auto [sx, sy] : { std::pair(node.redX, node.redY), std::pair(node.greenX, node.greenY),
+                                   std::pair(node.blueX, node.blueY) }) {
+                maxDisplacement_ = std::max(maxDisplacement_, float(std::hypot(sx - x, sy - y)));
+            }
+        }
+    }
+}
+
+void RemapTable::sourceBounds(int x, int y, int w, int h, int& sourceX, int& sourceY, int& sourceW, int& sourceH) const {
+    // Nodes whose cells contain the pixel centres of the rect; interpolated positions are convex
+    // combinations of them, so their bounding box bounds every sample.
+    int firstColumn = std::clamp(int(std::floor((x + 0.5) / kNodeSpacing)), 0, columns_ - 1);
+    int lastColumn = std::clamp(int(std::floor((x + w - 0.5) / kNodeSpacing)) + 1, 0, columns_ - 1);
+    int firstRow = std::clamp(int(std::floor((y + 0.5) / kNodeSpacing)), 0, rows_ - 1);
+    int lastRow = std::clamp(int(std::floor((y + h - 0.5) / kNodeSpacing)) + 1, 0, rows_ - 1);
+
+    float minX = float(x), minY = float(y), maxX = float(x + w), maxY = float(y + h);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const Node& node = nodes_[size_t(row) * columns_ + column];
+            minX = std::min({ minX, node.redX, node.greenX, node.blueX });
+            maxX = std::max({ maxX, node.redX, node.greenX, node.blueX });
+            minY = std::min({ minY, node.redY, node.greenY, node.blueY });
+            maxY = std::max({ maxY, node.redY, node.greenY, node.blueY });
+        }
+    }
+
+    // One extra pixel each side for the bilinear footprint
+    sourceX = int(std::floor(minX)) - 1;
+    sourceY = int(std::floor(minY)) - 1;
+    sourceW = int(std::ceil(maxX)) + 1 - sourceX;
+    sourceH = int(std::ceil(maxY)) + 1 - sourceY;
+}
+
+void RemapTable::apply(const float* source, size_t sourceStride, int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                       float* destination, size_t destinationStride,
+                       int outputX, int outputY, int outputWidth, int outputHeight) const {
+    if (outputWidth <= 0 || outputHeight <= 0 || sourceWidth <= 0 || sourceHeight <= 0) return;
+
+    int tileColumns = (outputWidth + kTileSize - 1) / kTileSize;
+    int tileRows = (outputHeight + kTileSize - 1) / kTileSize;
+    constexpr float kInverseSpacing = 1.0f / kNodeSpacing;
+
+    parallelFor(0, tileColumns * tileRows, [&](int begin, int end) {
+        for (int tile = begin; tile < end; ++tile) {
+            int tileX = (tile % tileColumns) * kTileSize;
+            int tileY = (tile / tileColumns) * kTileSize;
+            int tileWidth = std::min(kTileSize, outputWidth - tileX);
+            int tileHeight = std::min(kTileSize, outputHeight - tileY);
+
+            for (int y = tileY; y < tileY + tileHeight; ++y) {
+                float v = (outputY + y + 0.5f) * kInverseSpacing;
+                int row = std::clamp(int(v), 0, rows_ - 2);
+                float fy = v - row;
+                const Node* above = nodes_.data() + size_t(row) * columns_;
+                const Node* below = above + columns_;
+                float* out = destination + size_t(y) * destinationStride;
+
+                for (int x = tileX; x < tileX + tileWidth; ++x) {
+                    float u = (outputX + x + 0.5f) * kInverseSpacing;
+                    int column = std::clamp(int(u), 0, columns_ - 2);
+                    float fx = u - column;
+
+                    // Bilinear blend of the four surrounding nodes
+                    float w00 = (1 - fx) * (1 - fy), w10 = fx * (1 - fy), w01 = (1 - fx) * fy, w11 = fx * fy;
+                    const Node& n00 = above[column];
+                    const Node& n10 = above[column + 1];
+                    const Node& n01 = below[column];
+                    const Node& n11 = below[column + 1];
+                    auto blend = [&](float Node::*field) {
+                        return w00 * n00.*field + w10 * n10.*field + w01 * n01.*field + w11 * n11.*field;
+                    };
+
+                    float gain = blend(&Node::gain);
+                    float greenX = blend(&Node::greenX), greenY = blend(&Node::greenY);
+                    out[x * 4] = gain * sample(source, sourceStride, sourceX, sourceY, sourceWidth, sourceHeight,
+                                               blend(&Node::redX), blend(&Node::redY), 0);
+                    out[x * 4 + 1] = gain * sample(source, sourceStride, sourceX, sourceY, sourceWidth, sourceHeight,
+                                                   greenX, greenY, 1);
+                    out[x * 4 + 2] = gain * sample(source, sourceStride, sourceX, sourceY, sourceWidth, sourceHeight,
+                                                   blend(&Node::blueX), blend(&Node::blueY), 2);
+                    out[x * 4 + 3] = sample(source, sourceStride, sourceX, sourceY, sourceWidth, sourceHeight,
+                                            greenX, greenY, 3);
+                }
+            }
+        }
+    });
+}
+
+std::shared_ptr<const RemapTable> cachedRemapTable(const LensModel& model, int width, int height) {
+    static std::mutex mutex;
+    // Most recently used first
+    static std::list<CacheEntry> entries;
+    static size_t cachedBytes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->model == model && it->width == width && it->height == height) {
+                entries.splice(entries.begin(), entries, it);
+                return it->table;
+            }
+        }
+    }
+
+    // Built outside the lock; a concurrent build of the same table just loses the insert
+    auto table = std::make_shared<const RemapTable>(model, width, height);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const CacheEntry& entry : entries) {
+        if (entry.model == model && entry.width == width && entry.height == height) return entry.table;
+    }
+    entries.push_front({ model, width, height, table });
+    cachedBytes += table->byteSize();
+    while (cachedBytes > kCacheBudget && entries.size() > 1) {
+        cachedBytes -= entries.back().table->byteSize();
+        entries.pop_back();
+    }
+    return table;
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,78 @@
+//
+//  LensCorrection.hpp
+//  Dirty RAW
+//
+//  Optical corrections (distortion, vignetting, lateral chromatic aberration) applied as one
+//  resampling pass. The per-pixel geometry is precomputed into a coarse remap table: every
+//  node holds the source position of each colour channel and the vignetting gain, and pixels
+//  between nodes interpolate bilinearly. The radial models are smooth, so a 32-pixel grid is
+//  accurate to well under a hundredth of a pixel while keeping a 45 MP table near 1 MB.
+//
+//  Coordinates are in pixels relative to the frame's top-left corner, rows growing downwards,
+//  with pixel centres at integer + 0.5.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Coefficients of one lens at one focal length and aperture. Radii are normalized to the
+/// half-diagonal of the frame.
+struct LensModel {
+    /// Distortion: a corrected pixel at radius r samples the source at r * (1 + k1 r^2 + k2 r^4 + k3 r^6).
+    float k1 = 0, k2 = 0, k3 = 0;
+    /// Vignetting: relative illumination at source radius r is 1 + v1 r^2 + v2 r^4 + v3 r^6.
+    float v1 = 0, v2 = 0, v3 = 0;
+    /// Lateral CA: red and blue source radii relative to green.
+    float caRed = 1, caBlue = 1;
+
+    bool operator==(const LensModel&) const = default;
+};
+
+class RemapTable {
+public:
+    RemapTable(const LensModel& model, int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t byteSize() const { return nodes_.size() * sizeof(Node); }
+
+    /// Largest distance between an output pixel and any channel's source position.
+    float maxDisplacement() const { return maxDisplacement_; }
+
+    /// Source pixels read for output pixels [x, x + w) x [y, y + h), including the bilinear
+    /// footprint. Not clipped to the frame.
+    void sourceBounds(int x, int y, int w, int h, int& sourceX, int& sourceY, int& sourceW, int& sourceH) const;
+
+    /// Resamples output pixels [outputX, outputX + outputWidth) x [outputY, outputY + outputHeight)
+    /// from RGBA float `source`, whose first pixel is frame pixel (sourceX, sourceY). Reads outside
+    /// the source rect are clamped to its edge. Strides are in floats; tiles run in parallel.
+    void apply(const float* source, size_t sourceStride, int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+               float* destination, size_t destinationStride,
+               int outputX, int outputY, int outputWidth, int outputHeight) const;
+
+private:
+    struct Node {
+        float redX, redY, greenX, greenY, blueX, blueY;
+        float gain;
+    };
+
+    int width_;
+    int height_;
+    int columns_;
+    int rows_;
+    float maxDisplacement_ = 0;
+    std::vector<Node> nodes_;
+};
+
+/// Table for `model` at `width` x `height`, built on first request and kept in a small LRU
+/// cache shared by every caller, so all frames shot with the same lens settings and rendered at
+/// the same size reuse one table.
+std::shared_ptr<const RemapTable> cachedRemapTable(const LensModel& model, int width, int height);
+
+} // namespace dirtyraw
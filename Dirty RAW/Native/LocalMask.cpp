@@ -0,0 +1,431 @@
+//
+//  LocalMask.cpp
+//  Dirty RAW
+//
+
+#include "LocalMask.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dirtyraw {
+
+namespace {
+
+/// Rasterized tiles are dropped least recently used first beyond this many bytes.
+constexpr size_t kTileCacheBudget = size_t(64) << 20;
+/// Parsed masks kept for reuse across renders of the same edit.
+constexpr size_t kParsedMaskLimit = 32;
+constexpr size_t kTilePixels = size_t(kMaskTileSize) * kMaskTileSize;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 1469598103934665603ull) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline float smoothstep(float t) {
+    t = std::clamp(t, 0.0f, 1.0f);
+    return t * t * (3 - 2 * t);
+}
+
+/// Distance from (x, y) to segment (ax, ay)-(bx, by).
+inline float segmentDistance(float x, float y, float ax, float ay, float bx, float by) {
+    float dx = bx - ax, dy = by - ay;
+    float lengthSquared = dx * dx + dy * dy;
+    float t = lengthSquared > 0 ? std::clamp(((x - ax) * dx + (y - ay) * dy) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    float px = ax + t * dx - x, py = ay + t * dy - y;
+    return std::sqrt(px * px + py * py);
+}
+
+struct TileKey {
+    uint64_t shape;
+    int frameWidth, frameHeight, tileX, tileY;
+
+    bool operator==(const TileKey&) const = default;
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const { return size_t(hashBytes(&key, sizeof(key))); }
+};
+
+/// LRU cache of rasterized tiles shared by every mask.
+class TileCache {
+public:
+    bool find(const TileKey& key, MaskTile& tile) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) return false;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        tile = it->second->second;
+        return true;
+    }
+
+    void insert(const TileKey& key, MaskTile tile) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.count(key)) return;
+        entries_.emplace_front(key, tile);
+        index_[key] = entries_.begin();
+        bytes_ += cost(tile);
+        while (bytes_ > kTileCacheBudget && entries_.size() > 1) {
+            bytes_ -= cost(entries_.back().second);
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+private:
+    /// Empty tiles are cached too, at the cost of their bookkeeping.
+    static size_t cost(const MaskTile& tile) { return tile ? tile->size() * sizeof(uint16_t) : 64; }
+
+    std::mutex mutex_;
+    std::list<std::pair<TileKey, MaskTile>> entries_;
+    std::unordered_map<TileKey, std::list<std::pair<TileKey, MaskTile>>::iterator, TileKeyHash> index_;
+    size_t bytes_ = 0;
+};
+
+TileCache& tileCache() {
+    static TileCache cache;
+    return cache;
+}
+
+} // namespace
+
+std::shared_ptr<const LocalMask> LocalMask::parse(const float* data, size_t count) {
+    static std::mutex mutex;
+    static std::list<std::pair<std::vector<float>, std::shared_ptr<const LocalMask>>> parsed;
+
+    if (!data || count == 0) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = parsed.begin(); it != parsed.end(); ++it) {
+            if (it->first.size() == count && std::equal(data, data + count, it->first.begin())) {
+                parsed.splice(parsed.begin(), parsed, it);
+                return it->second;
+            }
+        }
+    }
+
+    auto mask = std::make_shared<LocalMask>();
+    size_t cursor = 0;
+    auto take = [&](float& value) {
+        if (cursor >= count || !std::isfinite(data[cursor])) return false;
+        value = data[cursor++];
+        return true;
+    };
+    // Counts are whole numbers no larger than `limit`, checked before they are converted
+    auto takeCount = [&](size_t& value, size_t limit) {
+        float raw;
+        if (!take(raw) || raw < 0 || double(raw) > double(limit) || raw != std::floor(raw)) return false;
+        value = size_t(raw);
+        return true;
+    };
+
+    size_t kind;
+    if (!takeCount(kind, 2)) return nullptr;
+    switch (kind) {
+    case 0:
+        mask->kind_ = Kind::linear;
+        for (int i = 0; i < 4; ++i) if (!take(mask->parameters_[i])) return nullptr;
+        break;
+    case 1:
+        mask->kind_ = Kind::radial;
+        for (int i = 0; i < 6; ++i) if (!take(mask->parameters_[i])) return nullptr;
+        if (mask->parameters_[2] <= 0 || mask->parameters_[3] <= 0) return nullptr;
+        break;
+    case 2: {
+        mask->kind_ = Kind::brush;
+        // A stroke takes at least 6 values: point count, radius, hardness, erase and one point
+        size_t strokeCount;
+        if (!takeCount(strokeCount, (count - cursor) / 6)) return nullptr;
+        mask->strokes_.resize(strokeCount);
+        for (Stroke& stroke : mask->strokes_) {
+            size_t pointCount;
+            float erase;
+            if (!takeCount(pointCount, count - cursor) || !take(stroke.radius) || !take(stroke.hardness) || !take(erase)) return nullptr;
+            if (pointCount < 1 || pointCount > (count - cursor) / 2) return nullptr;
+            if (!std::all_of(data + cursor, data + cursor + pointCount * 2, [](float v) { return std::isfinite(v); })) return nullptr;
+            stroke.erase = erase != 0;
+            stroke.points.assign(data + cursor, data + cursor + pointCount * 2);
+            cursor += pointCount * 2;
+
+            stroke.minX = stroke.maxX = stroke.points[0];
+            stroke.minY = stroke.maxY = stroke.points[1];
+            for (size_t i = 0; i < stroke.points.size(); i += 2) {
+                stroke.minX = std::min(stroke.minX, stroke.points[i]);
+                stroke.maxX = std::max(stroke.maxX, stroke.points[i]);
+                stroke.minY = std::min(stroke.minY, stroke.points[i + 1]);
+                stroke.maxY = std::max(stroke.maxY, stroke.points[i + 1]);
+            }
+            stroke.hash = hashBytes(data + cursor - pointCount * 2 - 4, (pointCount * 2 + 4) * sizeof(float));
+        }
+        break;
+    }
+    default:
+        return nullptr;
+    }
+    mask->shapeHash_ = hashBytes(data, cursor * sizeof(float));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    parsed.emplace_front(std::vector<float>(data, data + count), mask);
+    if (parsed.size() > kParsedMaskLimit) parsed.pop_back();
+    return mask;
+}
+
+std::vector<LocalMask::PixelStroke> LocalMask::pixelStrokes(int frameWidth, int frameHeight) const {
+    std::vector<PixelStroke> result;
+    result.reserve(strokes_.size());
+    float longSide = float(std::max(frameWidth, frameHeight));
+    for (const Stroke& stroke : strokes_) {
+        float radius = std::max(stroke.radius * longSide, 0.5f);
+        result.push_back({ &stroke, radius,
+                           stroke.minX * frameWidth - radius, stroke.minY * frameHeight - radius,
+                           stroke.maxX * frameWidth + radius, stroke.maxY * frameHeight + radius });
+    }
+    return result;
+}
+
+void LocalMask::bounds(int frameWidth, int frameHeight, int& x, int& y, int& width, int& height) const {
+    float minX = 0, minY = 0, maxX = float(frameWidth), maxY = float(frameHeight);
+
+    if (kind_ == Kind::radial && parameters_[5] == 0) {
+        float cx = parameters_[0] * frameWidth, cy = parameters_[1] * frameHeight;
+        float rx = parameters_[2] * frameWidth, ry = parameters_[3] * frameHeight;
+        minX = cx - rx;
+        maxX = cx + rx;
+        minY = cy - ry;
+        maxY = cy + ry;
+    } else if (kind_ == Kind::brush) {
+        minX = minY = INFINITY;
+        maxX = maxY = -INFINITY;
+        for (const PixelStroke& stroke : pixelStrokes(frameWidth, frameHeight)) {
+            if (stroke.stroke->erase) continue;
+            minX = std::min(minX, stroke.minX);
+            minY = std::min(minY, stroke.minY);
+            maxX = std::max(maxX, stroke.maxX);
+            maxY = std::max(maxY, stroke.maxY);
+        }
+    }
+
+    x = std::clamp(int(std::floor(minX)), 0, frameWidth);
+    y = std::clamp(int(std::floor(minY)), 0, frameHeight);
+    width = std::max(0, std::clamp(int(std::ceil(maxX)), 0, frameWidth) - x);
+    height = std::max(0, std::clamp(int(std::ceil(maxY)), 0, frameHeight) - y);
+}
+
+bool LocalMask::tileIsEmpty(int frameWidth, int frameHeight, int x0, int y0, int x1, int y1,
+                            std::vector<PixelStroke>& strokes) const {
+    switch (kind_) {
+    case Kind::linear: {
+        // Coverage falls linearly along the gradient axis, so the corners bound the tile
+        float ax = parameters_[0] * frameWidth, ay = parameters_[1] * frameHeight;
+        float dx = parameters_[2] * frameWidth - ax, dy = parameters_[3] * frameHeight - ay;
+        float lengthSquared = std::max(dx * dx + dy * dy, 1e-6f);
+        float minT = INFINITY;
+        for (float cx : { float(x0), float(x1) }) {
+            for (float cy : { float(y0), float(y1) }) {
+                minT = std::min(minT, ((cx - ax) * dx + (cy - ay) * dy) / lengthSquared);
+            }
+        }
+        return minT >= 1;
+    }
+    case Kind::radial: {
+        float cx = parameters_[0] * frameWidth, cy = parameters_[1] * frameHeight;
+        float rx = parameters_[2] * frameWidth, ry = parameters_[3] * frameHeight;
+        if (parameters_[5] == 0) {
+            // Nearest point of the tile to the centre (axis-aligned scaling keeps it nearest)
+            float nx = (std::clamp(cx, float(x0), float(x1)) - cx) / rx;
+            float ny = (std::clamp(cy, float(y0), float(y1)) - cy) / ry;
+            return nx * nx + ny * ny >= 1;
+        }
+        // Inverted: empty when the farthest corner is inside the unfeathered core
+        float fx = std::max(std::abs(x0 - cx), std::abs(x1 - cx)) / rx;
+        float fy = std::max(std::abs(y0 - cy), std::abs(y1 - cy)) / ry;
+        float core = 1 - std::clamp(parameters_[4], 0.0f, 1.0f);
+        return std::sqrt(fx * fx + fy * fy) <= core;
+    }
+    case Kind::brush: {
+        bool painted = false;
+        for (const PixelStroke& stroke : pixelStrokes(frameWidth, frameHeight)) {
+            if (stroke.maxX < x0 || stroke.minX > x1 || stroke.maxY < y0 || stroke.minY > y1) continue;
+            strokes.push_back(stroke);
+            painted = painted || !stroke.stroke->erase;
+        }
+        return !painted;
+    }
+    }
+    return true;
+}
+
+void LocalMask::rasterize(int frameWidth, int frameHeight, int x0, int y0, int x1, int y1,
+                          const std::vector<PixelStroke>& strokes, uint16_t* coverage) const {
+    int width = x1 - x0;
+
+    if (kind_ == Kind::linear) {
+        float ax = parameters_[0] * frameWidth, ay = parameters_[1] * frameHeight;
+        float dx = parameters_[2] * frameWidth - ax, dy = parameters_[3] * frameHeight - ay;
+        float lengthSquared = std::max(dx * dx + dy * dy, 1e-6f);
+        for (int y = y0; y < y1; ++y) {
+            uint16_t* out = coverage + size_t(y - y0) * width;
+            for (int x = x0; x < x1; ++x) {
+                float t = ((x + 0.5f - ax) * dx + (y + 0.5f - ay) * dy) / lengthSquared;
+                out[x - x0] = uint16_t((1 - smoothstep(t)) * 65535.0f + 0.5f);
+            }
+        }
+        return;
+    }
+
+    if (kind_ == Kind::radial) {
+        float cx = parameters_[0] * frameWidth, cy = parameters_[1] * frameHeight;
+        float rx = parameters_[2] * frameWidth, ry = parameters_[3] * frameHeight;
+        float feather = std::clamp(parameters_[4], 1e-3f, 1.0f);
+        bool inverted = parameters_[5] != 0;
+        for (int y = y0; y < y1; ++y) {
+            uint16_t* out = coverage + size_t(y - y0) * width;
+            float ny = (y + 0.5f - cy) / ry;
+            for (int x = x0; x < x1; ++x) {
+                float nx = (x + 0.5f - cx) / rx;
+                float distance = std::sqrt(nx * nx + ny * ny);
+                float value = 1 - smoothstep((distance - (1 - feather)) / feather);
+                if (inverted) value = 1 - value;
+                out[x - x0] = uint16_t(value * 65535.0f + 0.5f);
+            }
+        }
+        return;
+    }
+
+    // Brush: strokes in order, painting with max() and erasing multiplicatively
+    std::vector<float> values(size_t(width) * (y1 - y0), 0.0f);
+    std::vector<int> segments;
+    for (const PixelStroke& pixelStroke : strokes) {
+        const Stroke& stroke = *pixelStroke.stroke;
+        float radius = pixelStroke.radius;
+        float core = radius * std::clamp(stroke.hardness, 0.0f, 1.0f);
+        float falloff = std::max(radius - core, 1e-3f);
+
+        // Segments whose capsule reaches the tile
+        segments.clear();
+        size_t pointCount = stroke.points.size() / 2;
+        for (size_t i = 0; i < std::max<size_t>(pointCount - 1, 1); ++i) {
+            size_t j = std::min(i + 1, pointCount - 1);
+            float ax = stroke.points[i * 2] * frameWidth, ay = stroke.points[i * 2 + 1] * frameHeight;
+            float bx = stroke.points[j * 2] * frameWidth, by = stroke.points[j * 2 + 1] * frameHeight;
+            if (std::max(ax, bx) + radius < x0 || std::min(ax, bx) - radius > x1
+                || std::max(ay, by) + radius < y0 || std::min(ay, by) - radius > y1) {
+                continue;
+            }
+            segments.push_back(int(i));
+        }
+        if (segments.empty()) continue;
+
+        for (int y = y0; y < y1; ++y) {
+            float* row = values.data() + size_t(y - y0) * width;
+            for (int x = x0; x < x1; ++x) {
+                float distance = INFINITY;
+                for (int i : segments) {
+                    size_t j = std::min(size_t(i) + 1, pointCount - 1);
+                    distance = std::min(distance, segmentDistance(
+                        x + 0.5f, y + 0.5f,
+                        stroke.points[i * 2] * frameWidth, stroke.points[i * 2 + 1] * frameHeight,
+                        stroke.points[j * 2] * frameWidth, stroke.points[j * 2 + 1] * frameHeight));
+                }
+                float value = 1 - smoothstep((distance - core) / falloff);
+                float& target = row[x - x0];
+                target = stroke.erase ? target * (1 - value) : std::max(target, value);
+            }
+        }
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        coverage[i] = uint16_t(values[i] * 65535.0f + 0.5f);
+    }
+}
+
+MaskTile LocalMask::tile(int frameWidth, int frameHeight, int tileX, int tileY) const {
+    int x0 = tileX * kMaskTileSize;
+    int y0 = tileY * kMaskTileSize;
+    int x1 = std::min(x0 + kMaskTileSize, frameWidth);
+    int y1 = std::min(y0 + kMaskTileSize, frameHeight);
+    if (x0 >= x1 || y0 >= y1) return nullptr;
+
+    std::vector<PixelStroke> strokes;
+    if (tileIsEmpty(frameWidth, frameHeight, x0, y0, x1, y1, strokes)) return nullptr;
+
+    // Brush tiles are keyed by the strokes that reach them, so other strokes don't invalidate them
+    uint64_t shape = shapeHash_;
+    if (kind_ == Kind::brush) {
+        shape = hashBytes("brush", 5);
+        for (const PixelStroke& stroke : strokes) shape = hashBytes(&stroke.stroke->hash, sizeof(uint64_t), shape);
+    }
+    TileKey key { shape, frameWidth, frameHeight, tileX, tileY };
+
+    MaskTile cached;
+    if (tileCache().find(key, cached)) return cached;
+
+    auto coverage = std::make_shared<std::vector<uint16_t>>(size_t(x1 - x0) * (y1 - y0));
+    rasterize(frameWidth, frameHeight, x0, y0, x1, y1, strokes, coverage->data());
+    bool empty = std::all_of(coverage->begin(), coverage->end(), [](uint16_t value) { return value == 0; });
+
+    MaskTile result = empty ? nullptr : MaskTile(std::move(coverage));
+    tileCache().insert(key, result);
+    return result;
+}
+
+void LocalMask::blend(const float* background, size_t backgroundStride,
+                      const float* adjusted, size_t adjustedStride,
+                      float* destination, size_t destinationStride,
+                      int frameWidth, int frameHeight, int x, int y, int width, int height) const {
+    if (width <= 0 || height <= 0) return;
+
+    int firstTileX = std::max(x, 0) / kMaskTileSize;
+    int firstTileY = std::max(y, 0) / kMaskTileSize;
+    int lastTileX = std::max(x + width - 1, 0) / kMaskTileSize;
+    int lastTileY = std::max(y + height - 1, 0) / kMaskTileSize;
+    int tileColumns = lastTileX - firstTileX + 1;
+    int tileCount = tileColumns * (lastTileY - firstTileY + 1);
+
+    parallelFor(0, tileCount, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            int tileX = firstTileX + index % tileColumns;
+            int tileY = firstTileY + index / tileColumns;
+            int tileLeft = tileX * kMaskTileSize;
+            int tileTop = tileY * kMaskTileSize;
+            int tileWidth = std::min(kMaskTileSize, frameWidth - tileLeft);
+
+            // Part of the tile inside the output
+            int left = std::max(x, tileLeft);
+            int right = std::min(x + width, tileLeft + kMaskTileSize);
+            int top = std::max(y, tileTop);
+            int bottom = std::min(y + height, tileTop + kMaskTileSize);
+            if (left >= right || top >= bottom) continue;
+
+            MaskTile coverage = tile(frameWidth, frameHeight, tileX, tileY);
+            for (int row = top; row < bottom; ++row) {
+                const float* under = background + size_t(row - y) * backgroundStride + size_t(left - x) * 4;
+                float* out = destination + size_t(row - y) * destinationStride + size_t(left - x) * 4;
+                if (!coverage || row >= frameHeight) {
+                    std::memcpy(out, under, size_t(right - left) * 4 * sizeof(float));
+                    continue;
+                }
+
+                const float* over = adjusted + size_t(row - y) * adjustedStride + size_t(left - x) * 4;
+                const uint16_t* weights = coverage->data() + size_t(row - tileTop) * tileWidth + (left - tileLeft);
+                for (int i = 0; i < right - left; ++i) {
+                    float weight = (left + i < frameWidth ? weights[i] : 0) * (1.0f / 65535.0f);
+                    for (int c = 0; c < 4; ++c) {
+                        out[i * 4 + c] = under[i * 4 + c] + (over[i * 4 + c] - under[i * 4 + c]) * weight;
+                    }
+                }
+            }
+        }
+    });
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,86 @@
+//
+//  LocalMask.hpp
+//  Dirty RAW
+//
+//  Masks for local adjustments. A mask is stored as resolution-independent shape data and
+//  rasterized lazily in 64-pixel tiles at whatever frame size is being rendered (each preview
+//  level is its own frame size). Tiles the shape can't reach are never rasterized, and
+//  rasterized tiles are cached under a key built from the shape data that reaches them, so a new
+//  brush stroke only invalidates the tiles it crosses.
+//
+//  Shape data is a flat float array; positions are fractions of the frame (top-left origin):
+//
+//      linear:  0, x0, y0, x1, y1                      full effect before (x0, y0), none past (x1, y1)
+//      radial:  1, cx, cy, rx, ry, feather, inverted   radii as fractions of width / height
+//      brush:   2, strokeCount, strokes...
+//               stroke: pointCount, radius, hardness, erase, x, y, x, y, ...
+//               radius is a fraction of the frame's long side
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dirtyraw {
+
+constexpr int kMaskTileSize = 64;
+
+/// Coverage of one tile, 0...65535 row-major; null when the tile is empty.
+using MaskTile = std::shared_ptr<const std::vector<uint16_t>>;
+
+class LocalMask {
+public:
+    /// Parses shape data; returns null if it is malformed. Parsed masks are cached by content.
+    static std::shared_ptr<const LocalMask> parse(const float* data, size_t count);
+
+    /// Pixel rect that can have non-zero coverage on a `frameWidth` x `frameHeight` frame,
+    /// clipped to the frame. Empty (zero size) when nothing is covered.
+    void bounds(int frameWidth, int frameHeight, int& x, int& y, int& width, int& height) const;
+
+    /// Coverage of tile (`tileX`, `tileY`) on the frame, from the shared tile cache.
+    MaskTile tile(int frameWidth, int frameHeight, int tileX, int tileY) const;
+
+    /// Blends `adjusted` over `background` (RGBA float, same layout) by coverage for output
+    /// pixels [x, x + width) x [y, y + height) of the frame. All three buffers start at frame
+    /// pixel (x, y); strides are in floats. Tiles run in parallel; empty tiles are copied.
+    void blend(const float* background, size_t backgroundStride,
+               const float* adjusted, size_t adjustedStride,
+               float* destination, size_t destinationStride,
+               int frameWidth, int frameHeight, int x, int y, int width, int height) const;
+
+private:
+    enum class Kind { linear, radial, brush };
+
+    struct Stroke {
+        std::vector<float> points;
+        float radius = 0;
+        float hardness = 0;
+        bool erase = false;
+        /// Bounding box of the points in frame fractions, before adding the radius.
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+        uint64_t hash = 0;
+    };
+
+    /// Frame-pixel geometry of one brush stroke.
+    struct PixelStroke {
+        const Stroke* stroke;
+        float radius;
+        float minX, minY, maxX, maxY;
+    };
+
+    bool tileIsEmpty(int frameWidth, int frameHeight, int x0, int y0, int x1, int y1,
+                     std::vector<PixelStroke>& strokes) const;
+    void rasterize(int frameWidth, int frameHeight, int x0, int y0, int x1, int y1,
+                   const std::vector<PixelStroke>& strokes, uint16_t* coverage) const;
+    std::vector<PixelStroke> pixelStrokes(int frameWidth, int frameHeight) const;
+
+    Kind kind_ = Kind::linear;
+    float parameters_[6] = {};
+    std::vector<Stroke> strokes_;
+    uint64_t shapeHash_ = 0;
+};
+
+} // namespace dirtyraw
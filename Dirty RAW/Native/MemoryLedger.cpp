@@ -0,0 +1,134 @@
+//
+//  MemoryLedger.cpp
+//  Dirty RAW
+//
+
+#include "MemoryLedger.hpp"
+
+#include <algorithm>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+namespace dirtyraw {
+
+namespace {
+
+void update(MemoryUsage& usage, int64_t delta) {
+    usage.current += delta;
+    usage.peak = std::max(usage.peak, usage.current);
+    ++usage.changes;
+}
+
+} // namespace
+
+const char* memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::sourceBitmaps: return "sourceBitmaps";
+        case MemoryCategory::processedBitmaps: return "processedBitmaps";
+        case MemoryCategory::previewBitmaps: return "previewBitmaps";
+        case MemoryCategory::thumbnails: return "thumbnails";
+        case MemoryCategory::decodeBuffers: return "decodeBuffers";
+        case MemoryCategory::sdkSessions: return "sdkSessions";
+        case MemoryCategory::renderIntermediates: return "renderIntermediates";
+        case MemoryCategory::renderCache: return "renderCache";
+        case MemoryCategory::viewportTiles: return "viewportTiles";
+        case MemoryCategory::lutTables: return "lutTables";
+        case MemoryCategory::lutTextures: return "lutTextures";
+    }
+    return "unknown";
+}
+
+int64_t processFootprint() {
+#if defined(__APPLE__)
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return int64_t(info.phys_footprint);
+#else
+    return 0;
+#endif
+}
+
+MemoryLedger& MemoryLedger::shared() {
+    static MemoryLedger ledger;
+    return ledger;
+}
+
+uint64_t MemoryLedger::registerOwner(std::string name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t owner = nextOwner_++;
+    owners_[owner].name = std::move(name);
+    return owner;
+}
+
+void MemoryLedger::releaseOwner(uint64_t owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = owners_.find(owner);
+    if (found == owners_.end()) return;
+    for (int c = 0; c < kMemoryCategoryCount; ++c) {
+        if (found->second.bytes[c] != 0) applyLocked(MemoryCategory(c), -found->second.bytes[c], &found->second);
+    }
+    owners_.erase(found);
+}
+
+void MemoryLedger::add(MemoryCategory category, int64_t delta, uint64_t owner) {
+    if (delta == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = owners_.find(owner);
+    if (owner && found == owners_.end()) return;
+    applyLocked(category, delta, owner ? &found->second : nullptr);
+}
+
+void MemoryLedger::set(MemoryCategory category, int64_t bytes, uint64_t owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = owners_.find(owner);
+    if (owner && found == owners_.end()) return;
+    Owner* record = owner ? &found->second : nullptr;
+    int64_t held = record ? record->bytes[int(category)] : unowned_[int(category)];
+    if (bytes != held) applyLocked(category, bytes - held, record);
+}
+
+void MemoryLedger::applyLocked(MemoryCategory category, int64_t delta, Owner* owner) {
+    int index = int(category);
+    if (owner) {
+        owner->bytes[index] += delta;
+        update(owner->total, delta);
+    } else {
+        unowned_[index] += delta;
+    }
+    update(categories_[index], delta);
+    update(total_, delta);
+}
+
+MemorySnapshot MemoryLedger::snapshot() const {
+    MemorySnapshot snapshot;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::copy(categories_, categories_ + kMemoryCategoryCount, snapshot.categories);
+    snapshot.total = total_;
+    snapshot.owners.reserve(owners_.size());
+    for (const auto& [id, owner] : owners_) {
+        MemoryOwnerUsage usage;
+        usage.owner = id;
+        usage.name = owner.name;
+        std::copy(owner.bytes, owner.bytes + kMemoryCategoryCount, usage.bytes);
+        usage.total = owner.total;
+        snapshot.owners.push_back(std::move(usage));
+    }
+    std::sort(snapshot.owners.begin(), snapshot.owners.end(), [](const MemoryOwnerUsage& a, const MemoryOwnerUsage& b) {
+        return a.total.current != b.total.current ? a.total.current > b.total.current : a.owner < b.owner;
+    });
+    return snapshot;
+}
+
+void MemoryLedger::resetPeaks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (MemoryUsage& usage : categories_) usage.peak = usage.current;
+    total_.peak = total_.current;
+    for (auto& [id, owner] : owners_) owner.total.peak = owner.total.current;
+}
+
+} // namespace dirtyraw
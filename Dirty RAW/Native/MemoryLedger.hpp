@@ -0,0 +1,119 @@
+//
+//  MemoryLedger.hpp
+//  Dirty RAW
+//
+//  Memory accounting. Owners of large allocations (decoded bitmaps, render caches, LUTs, SDK
+//  sessions, decode buffers) report tagged byte counts here, per category and optionally per
+//  owner (an open image), and the ledger keeps current and peak usage of each. It only knows
+//  what it is told: the difference to the process footprint is memory nobody reports, and an
+//  owner still holding bytes after its image was closed points at a leak.
+//
+//  Reports are cheap (one uncontended lock) but not free, so they are made when an owner's
+//  holdings change, not per pixel or per tile row.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dirtyraw {
+
+enum class MemoryCategory : int {
+    /// Decoded full-resolution images.
+    sourceBitmaps = 0,
+    /// Full-resolution renders with the current edits, made for export.
+    processedBitmaps,
+    /// Fit-to-view and zoomed detail renders on screen.
+    previewBitmaps,
+    thumbnails,
+    /// Transient buffers of decoded pixels (SDK output before conversion, native decodes).
+    decodeBuffers,
+    /// Footprint growth of opening Nikon SDK sessions, which load and unpack the raw data.
+    sdkSessions,
+    /// Materialised stage outputs of the render graph (GPU textures when Metal is available).
+    renderIntermediates,
+    /// Finished renders kept by content and edit.
+    renderCache,
+    /// Display-resolution tiles of the viewport renderer.
+    viewportTiles,
+    /// Parsed LUT cubes.
+    lutTables,
+    /// LUT 3D textures sampled by the Metal LUT kernel.
+    lutTextures,
+};
+
+constexpr int kMemoryCategoryCount = int(MemoryCategory::lutTextures) + 1;
+
+/// Short stable name, used as the JSON key.
+const char* memoryCategoryName(MemoryCategory category);
+
+struct MemoryUsage {
+    int64_t current = 0;
+    int64_t peak = 0;
+    /// Reports that changed the count.
+    uint64_t changes = 0;
+};
+
+struct MemoryOwnerUsage {
+    uint64_t owner = 0;
+    std::string name;
+    int64_t bytes[kMemoryCategoryCount] = {};
+    /// Sum over categories, and its peak.
+    MemoryUsage total;
+};
+
+struct MemorySnapshot {
+    MemoryUsage categories[kMemoryCategoryCount];
+    /// Sum over categories; its peak is the highest the sum has been, not the sum of peaks.
+    MemoryUsage total;
+    /// Registered owners, largest first.
+    std::vector<MemoryOwnerUsage> owners;
+};
+
+/// Physical footprint of the process (what Activity Monitor shows as its memory), or 0 where
+/// the platform doesn't report it.
+int64_t processFootprint();
+
+class MemoryLedger {
+public:
+    static MemoryLedger& shared();
+
+    /// Returns a new owner id (never 0) for `name`.
+    uint64_t registerOwner(std::string name);
+    /// Forgets `owner`; whatever it still holds is taken off the books, as its allocations go
+    /// with it.
+    void releaseOwner(uint64_t owner);
+
+    /// Adds `delta` bytes (negative to release) to `category`, attributed to `owner` (0: none).
+    /// Reports for a released owner are ignored; its holdings already came off the books.
+    void add(MemoryCategory category, int64_t delta, uint64_t owner = 0);
+    /// Sets the bytes `owner` (0: none) holds in `category`, for owners that track a total.
+    void set(MemoryCategory category, int64_t bytes, uint64_t owner = 0);
+
+    MemorySnapshot snapshot() const;
+    /// Starts peaks over from current usage, e.g. before reproducing a regression.
+    void resetPeaks();
+
+private:
+    struct Owner {
+        std::string name;
+        int64_t bytes[kMemoryCategoryCount] = {};
+        MemoryUsage total;
+    };
+
+    MemoryLedger() = default;
+    void applyLocked(MemoryCategory category, int64_t delta, Owner* owner);
+
+    mutable std::mutex mutex_;
+    MemoryUsage categories_[kMemoryCategoryCount];
+    MemoryUsage total_;
+    int64_t unowned_[kMemoryCategoryCount] = {};
+    std::unordered_map<uint64_t, Owner> owners_;
+    uint64_t nextOwner_ = 1;
+};
+
+} // namespace dirtyraw
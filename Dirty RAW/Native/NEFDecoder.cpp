@@ -0,0 +1,452 @@
+//
+//  NEFDecoder.cpp
+//  Dirty RAW
+//
+
+#include "NEFDecoder.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+namespace dirtyraw {
+
+namespace {
+
+// MARK: - Bit Reader
+
+/// MSB-first bit reader over a bounded buffer. Reads past the end yield zero bits and are counted,
+/// so a truncated stream decodes to the end without touching memory outside the buffer.
+class BitReader {
+public:
+    explicit BitReader(std::span<const uint8_t> data) : position_(data.data()), end_(data.data() + data.size()) {}
+
+    uint32_t peek(int count) {
+        if (bits_ < count) refill();
+        return count == 0 ? 0 : uint32_t(buffer_ >> (64 - count));
+    }
+
+    void skip(int count) {
+        buffer_ <<= count;
+        bits_ -= count;
+    }
+
+    uint32_t get(int count) {
+        uint32_t value = peek(count);
+        skip(count);
+        return value;
+    }
+
+    size_t overrunBytes() const { return overrun_; }
+
+private:
+    void refill() {
+        while (bits_ <= 56) {
+            uint8_t byte = 0;
+            if (position_ < end_) {
+                byte = *position_++;
+            } else {
+                ++overrun_;
+            }
+            buffer_ |= uint64_t(byte) << (56 - bits_);
+            bits_ += 8;
+        }
+    }
+
+    const uint8_t* position_;
+    const uint8_t* end_;
+    uint64_t buffer_ = 0;
+    int bits_ = 0;
+    size_t overrun_ = 0;
+};
+
+// MARK: - Huffman
+
+// Code-length counts (16 entries) followed by symbols. A symbol's low nibble is the length of
+// the difference; the high nibble is a left shift used by the lossy "after split" tables.
+constexpr uint8_t kNikonTrees[6][32] = {
+    { 0,1,5,1,1,1,1,1,1,2,0,0,0,0,0,0,  // 12-bit lossy
+      5,4,3,6,2,7,1,0,8,9,11,10,12 },
+    { 0,1,5,1,1,1,1,1,1,2,0,0,0,0,0,0,  // 12-bit lossy after split
+      0x39,0x5a,0x38,0x27,0x16,5,4,3,2,1,0,11,12,12 },
+    { 0,1,4,2,3,1,2,0,0,0,0,0,0,0,0,0,  // 12-bit lossless
+      5,4,6,3,7,2,8,1,9,0,10,11,12 },
+    { 0,1,4,3,1,1,1,1,1,2,0,0,0,0,0,0,  // 14-bit lossy
+      5,6,4,7,8,3,9,2,1,0,10,11,12,13,14 },
+    { 0,1,5,1,1,1,1,1,1,1,2,0,0,0,0,0,  // 14-bit lossy after split
+      8,0x5c,0x4b,0x3a,0x29,7,6,5,4,3,2,1,0,13,14 },
+    { 0,1,4,2,2,3,1,2,0,0,0,0,0,0,0,0,  // 14-bit lossless
+      7,6,8,5,9,4,10,3,11,12,2,0,1,13,14 },
+};
+
+/// Direct lookup table: peek `maxLength` bits, index the table, get (code length, symbol).
+class HuffmanTable {
+public:
+    explicit HuffmanTable(const uint8_t* tree) {
+        const uint8_t* counts = tree;
+        const uint8_t* symbols = tree + 16;
+
+        maxLength_ = 16;
+        while (maxLength_ > 0 && counts[maxLength_ - 1] == 0) --maxLength_;
+
+        entries_.assign(size_t(1) << maxLength_, 0);
+        size_t next = 0;
+        for (int length = 1; length <= maxLength_; ++length) {
+            for (int code = 0; code < counts[length - 1]; ++code, ++symbols) {
+                size_t span = size_t(1) << (maxLength_ - length);
+                for (size_t fill = 0; fill < span && next < entries_.size(); ++fill) {
+                    entries_[next++] = uint16_t(length << 8 | *symbols);
+                }
+            }
+        }
+    }
+
+    /// Returns the next symbol, or -1 for a code that is not in the table.
+    int decode(BitReader& bits) const {
+        uint16_t entry = entries_[bits.peek(maxLength_)];
+        int length = entry >> 8;
+        if (length == 0) return -1;
+        bits.skip(length);
+        return entry & 0xFF;
+    }
+
+private:
+    int maxLength_ = 0;
+    std::vector<uint16_t> entries_;
+};
+
+// MARK: - Linearization Metadata
+
+/// Bounds-checked reader for the MakerNote 0x0096 blob, which uses the MakerNote byte order.
+class MetaReader {
+public:
+    MetaReader(std::span<const uint8_t> data, bool littleEndian) : data_(data), littleEndian_(littleEndian) {}
+
+    bool u8(size_t offset, uint8_t& out) const {
+        if (offset >= data_.size()) return false;
+        out = data_[offset];
+        return true;
+    }
+
+    bool u16(size_t offset, uint16_t& out) const {
+        if (offset > data_.size() || data_.size() - offset < 2) return false;
+        out = littleEndian_ ? uint16_t(data_[offset] | (data_[offset + 1] << 8))
+                            : uint16_t((data_[offset] << 8) | data_[offset + 1]);
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> data_;
+    bool littleEndian_;
+};
+
+struct CompressionParams {
+    int tree = 0;
+    int split = 0;
+    uint16_t verticalPredictor[2][2] = {};
+    std::vector<uint16_t> curve;
+    int curveMax = 0;
+};
+
+std::optional<CompressionParams> readCompressionParams(const NEFRawInfo& info) {
+    MetaReader meta(info.linearization, info.makerNoteLittleEndian);
+    CompressionParams params;
+
+    uint8_t version0 = 0, version1 = 0;
+    if (!meta.u8(0, version0) || !meta.u8(1, version1)) return std::nullopt;
+
+    size_t offset = 2;
+    if (version0 == 0x49 || version1 == 0x58) offset += 2110;
+    if (version0 == 0x46) params.tree = 2;
+    if (info.bitsPerSample == 14) params.tree += 3;
+
+    for (int index = 0; index < 4; ++index, offset += 2) {
+        if (!meta.u16(offset, params.verticalPredictor[index >> 1][index & 1])) return std::nullopt;
+    }
+
+    params.curve.resize(0x10000);
+    for (size_t value = 0; value < params.curve.size(); ++value) {
+        params.curve[value] = uint16_t(value);
+    }
+
+    int max = (1 << info.bitsPerSample) & 0x7FFF;
+    uint16_t curveSize = 0;
+    if (!meta.u16(offset, curveSize)) return std::nullopt;
+    offset += 2;
+
+    int step = curveSize > 1 ? max / (curveSize - 1) : 0;
+    if (version0 == 0x44 && version1 == 0x20 && step > 0) {
+        // Lossy: sparse curve points, linearly interpolated
+        for (int point = 0; point < curveSize && point * step < int(params.curve.size()); ++point) {
+            if (!meta.u16(offset + size_t(point) * 2, params.curve[point * step])) return std::nullopt;
+        }
+        for (int value = 0; value < max; ++value) {
+            int base = value - value % step;
+            int next = std::min(base + step, int(params.curve.size()) - 1);
+            params.curve[value] = uint16_t(
+                (params.curve[base] * (step - value % step) + params.curve[next] * (value % step)) / step
+            );
+        }
+        uint16_t split = 0;
+        if (meta.u16(562, split)) params.split = split;
+    } else if (version0 != 0x46 && curveSize <= 0x4001) {
+        for (int point = 0; point < curveSize; ++point) {
+            if (!meta.u16(offset + size_t(point) * 2, params.curve[point])) return std::nullopt;
+        }
+        if (curveSize >= 2) max = curveSize;
+    }
+
+    // Trim the flat tail so the white level reflects the last distinct curve value
+    while (max > 2 && params.curve[max - 2] == params.curve[max - 1]) --max;
+    params.curveMax = max;
+    return params;
+}
+
+// MARK: - Decoders
+
+/// Widest or tallest raw image accepted; current sensors are under 10000 photosites a side.
+constexpr uint32_t kMaxDimension = 1 << 15;
+/// Bytes the bit reader may run past the end of the strip with its look-ahead.
+constexpr size_t kOverrunSlack = 16;
+/// Every Nikon tree's shortest code is 2 bits, so a byte holds at most 4 samples.
+constexpr size_t kMaxSamplesPerByte = 4;
+
+std::optional<RawImage> decodeCompressed(const NEFRawInfo& info) {
+    // Dimensions come from the file: reject any the strip is too short to encode before allocating
+    size_t count = size_t(info.width) * info.height;
+    if (count > (info.data.size() + kOverrunSlack) * kMaxSamplesPerByte) return std::nullopt;
+
+    auto params = readCompressionParams(info);
+    if (!params) return std::nullopt;
+
+    RawImage raw;
+    raw.width = info.width;
+    raw.height = info.height;
+    raw.samples.resize(count);
+
+    auto table = std::make_unique<HuffmanTable>(kNikonTrees[params->tree]);
+    BitReader bits(info.data);
+    uint16_t horizontalPredictor[2] = {};
+
+    // The stream has no restart markers, so rows depend on each other and decode serially
+    for (uint32_t row = 0; row < info.height; ++row) {
+        if (params->split != 0 && int(row) == params->split) {
+            table = std::make_unique<HuffmanTable>(kNikonTrees[params->tree + 1]);
+        }
+
+        uint16_t* output = raw.samples.data() + size_t(row) * info.width;
+        for (uint32_t column = 0; column < info.width; ++column) {
+            int symbol = table->decode(bits);
+            if (symbol < 0) return std::nullopt;
+
+            int length = symbol & 15;
+            int shift = symbol >> 4;
+            int difference = 0;
+            if (length > 0) {
+                if (shift >= length) return std::nullopt;
+                difference = int(((bits.get(length - shift) << 1) + 1) << shift >> 1);
+                if ((difference & (1 << (length - 1))) == 0) {
+                    difference -= (1 << length) - (shift == 0 ? 1 : 0);
+                }
+            }
+
+            uint16_t& predictor = horizontalPredictor[column & 1];
+            if (column < 2) {
+                params->verticalPredictor[row & 1][column] += uint16_t(difference);
+                predictor = params->verticalPredictor[row & 1][column];
+            } else {
+                predictor += uint16_t(difference);
+            }
+
+            int value = std::clamp(int(int16_t(predictor)), 0, 0x3FFF);
+            output[column] = params->curve[value];
+        }
+
+        if (bits.overrunBytes() > kOverrunSlack) return std::nullopt;
+    }
+
+    uint16_t white = 0;
+    for (int value = 0; value < params->curveMax; ++value) {
+        white = std::max(white, params->curve[value]);
+    }
+    raw.whiteLevel = white;
+    return raw;
+}
+
+std::optional<RawImage> decodeUncompressed(const NEFRawInfo& info) {
+    // Nikon stores uncompressed samples in little-endian 16-bit words
+    size_t count = size_t(info.width) * info.height;
+    if (info.data.size() < count * 2) return std::nullopt;
+
+    RawImage raw;
+    raw.width = info.width;
+    raw.height = info.height;
+    raw.whiteLevel = uint16_t((1u << std::min(info.bitsPerSample, 16u)) - 1);
+    raw.samples.resize(count);
+
+    const uint8_t* source = info.data.data();
+    parallelFor(0, int(info.height), [&](int begin, int end) {
+        for (size_t index = size_t(begin) * info.width; index < size_t(end) * info.width; ++index) {
+            raw.samples[index] = uint16_t(source[index * 2] | (source[index * 2 + 1] << 8));
+        }
+    });
+    return raw;
+}
+
+// MARK: - Colour
+
+using Matrix3 = std::array<std::array<double, 3>, 3>;
+
+Matrix3 multiply(const Matrix3& a, const Matrix3& b) {
+    Matrix3 result{};
+    for (int row = 0; row < 3; ++row)
+        for (int column = 0; column < 3; ++column)
+            for (int k = 0; k < 3; ++k)
+                result[row][column] += a[row][k] * b[k][column];
+    return result;
+}
+
+Matrix3 invert(const Matrix3& m) {
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+               - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+               + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (std::fabs(det) < 1e-12) {
+        return {{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+    }
+    Matrix3 result;
+    result[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+    result[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+    result[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+    result[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+    result[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+    result[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+    result[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+    result[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+    result[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+    return result;
+}
+
+/// Camera RGB -> linear sRGB. Uses one representative Nikon XYZ->camera matrix for every body;
+/// good enough for a preview, while the SDK applies the exact per-model colour.
+const Matrix3& cameraToSRGB() {
+    static const Matrix3 matrix = [] {
+        const Matrix3 xyzToCamera = {{
+            {  1.0405, -0.3755, -0.1270 },
+            { -0.5461,  1.3787,  0.1793 },
+            { -0.1040,  0.2015,  0.6785 },
+        }};
+        const Matrix3 srgbToXYZ = {{
+            { 0.412453, 0.357580, 0.180423 },
+            { 0.212671, 0.715160, 0.072169 },
+            { 0.019334, 0.119193, 0.950227 },
+        }};
+        Matrix3 srgbToCamera = multiply(xyzToCamera, srgbToXYZ);
+        // Normalize so that sRGB white maps to camera white (unit multipliers)
+        for (auto& row : srgbToCamera) {
+            double sum = row[0] + row[1] + row[2];
+            if (sum != 0) for (auto& value : row) value /= sum;
+        }
+        return invert(srgbToCamera);
+    }();
+    return matrix;
+}
+
+/// Linear [0, 1] -> 8-bit sRGB, indexed by value * 4095.
+const std::array<uint8_t, 4096>& srgbEncodeTable() {
+    static const std::array<uint8_t, 4096> table = [] {
+        std::array<uint8_t, 4096> values{};
+        for (size_t index = 0; index < values.size(); ++index) {
+            double linear = double(index) / double(values.size() - 1);
+            double encoded = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            values[index] = uint8_t(std::lround(std::clamp(encoded, 0.0, 1.0) * 255.0));
+        }
+        return values;
+    }();
+    return table;
+}
+
+} // namespace
+
+// MARK: - Public API
+
+std::optional<RawImage> decodeNikonRaw(const NEFRawInfo& info) {
+    if (info.width < 2 || info.height < 2 || info.data.empty()) return std::nullopt;
+    if (info.width > kMaxDimension || info.height > kMaxDimension) return std::nullopt;
+    if (info.bitsPerSample != 12 && info.bitsPerSample != 14) return std::nullopt;
+
+    switch (info.compression) {
+    case 34713:
+        if (info.linearization.empty()) return std::nullopt;
+        return decodeCompressed(info);
+    case 1:
+        return decodeUncompressed(info);
+    default:
+        return std::nullopt;
+    }
+}
+
+RGB8Image quickDevelop(const RawImage& raw, const NEFRawInfo& info, uint32_t orientation) {
+    uint32_t halfWidth = raw.width / 2;
+    uint32_t halfHeight = raw.height / 2;
+    bool swapAxes = orientation == 6 || orientation == 8;
+
+    RGB8Image image;
+    image.width = swapAxes ? halfHeight : halfWidth;
+    image.height = swapAxes ? halfWidth : halfHeight;
+    image.pixels.resize(size_t(image.width) * image.height * 3);
+
+    // Per CFA position: colour index, black level and scale to [0, 1] including white balance
+    double redGain = info.redMultiplier > 0 ? info.redMultiplier : 2.0;
+    double blueGain = info.blueMultiplier > 0 ? info.blueMultiplier : 1.5;
+    std::array<double, 4> scale{};
+    for (int position = 0; position < 4; ++position) {
+        double range = std::max(1.0, double(raw.whiteLevel) - double(info.blackLevel[position]));
+        double gain = info.cfaPattern[position] == 0 ? redGain : info.cfaPattern[position] == 2 ? blueGain : 1.0;
+        scale[position] = gain / range;
+    }
+
+    const Matrix3& matrix = cameraToSRGB();
+    const auto& encode = srgbEncodeTable();
+
+    parallelFor(0, int(halfHeight), [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint16_t* top = raw.samples.data() + size_t(y) * 2 * raw.width;
+            const uint16_t* bottom = top + raw.width;
+
+            for (uint32_t x = 0; x < halfWidth; ++x) {
+                const uint16_t quad[4] = { top[x * 2], top[x * 2 + 1], bottom[x * 2], bottom[x * 2 + 1] };
+                double camera[3] = {0, 0, 0};
+                int greens = 0;
+                for (int position = 0; position < 4; ++position) {
+                    double value = std::max(0.0, double(quad[position]) - info.blackLevel[position]) * scale[position];
+                    // Clip after white balance so blown highlights stay neutral
+                    value = std::min(value, 1.0);
+                    int colour = info.cfaPattern[position];
+                    camera[colour] += value;
+                    if (colour == 1) ++greens;
+                }
+                if (greens > 1) camera[1] /= greens;
+
+                uint32_t outX = x, outY = uint32_t(y);
+                switch (orientation) {
+                case 3: outX = halfWidth - 1 - x; outY = halfHeight - 1 - uint32_t(y); break;
+                case 6: outX = halfHeight - 1 - uint32_t(y); outY = x; break;
+                case 8: outX = uint32_t(y); outY = halfWidth - 1 - x; break;
+                default: break;
+                }
+
+                uint8_t* pixel = image.pixels.data() + (size_t(outY) * image.width + outX) * 3;
+                for (int channel = 0; channel < 3; ++channel) {
+                    double linear = matrix[channel][0] * camera[0] + matrix[channel][1] * camera[1] + matrix[channel][2] * camera[2];
+                    pixel[channel] = encode[size_t(std::clamp(linear, 0.0, 1.0) * 4095.0 + 0.5)];
+                }
+            }
+        }
+    });
+
+    return image;
+}
+
+} // namespace dirtyraw
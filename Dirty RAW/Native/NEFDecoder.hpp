@@ -0,0 +1,43 @@
+//
+//  NEFDecoder.hpp
+//  Dirty RAW
+//
+//  Native decoder for Nikon raw data (uncompressed, lossless and lossy compressed NEF) and a
+//  "quick develop" path: half-size demosaic, white balance and a generic camera matrix.
+//  Intended for a fast first look; final output still goes through the Nikon SDK.
+//
+
+#pragma once
+
+#include "NEFParser.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Decoded CFA samples after linearization, one per photosite.
+struct RawImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    /// Largest value produced by the linearization curve.
+    uint16_t whiteLevel = 0;
+    std::vector<uint16_t> samples;
+};
+
+/// 8-bit sRGB image, tightly packed RGB.
+struct RGB8Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/// Decodes the raw CFA data. Returns nullopt for unsupported compressions or corrupt streams.
+std::optional<RawImage> decodeNikonRaw(const NEFRawInfo& info);
+
+/// Half-size develop: each 2x2 CFA quad becomes one RGB pixel. Rows are processed in parallel.
+/// `orientation` is the EXIF orientation; 3, 6 and 8 are applied to the output.
+RGB8Image quickDevelop(const RawImage& raw, const NEFRawInfo& info, uint32_t orientation);
+
+} // namespace dirtyraw
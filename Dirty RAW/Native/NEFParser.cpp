@@ -0,0 +1,553 @@
+//
+//  NEFParser.cpp
+//  Dirty RAW
+//
+
+#include "NEFParser.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace dirtyraw {
+
+// MARK: - MappedFile
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // IFDs are scattered small reads; avoid pulling megabytes of raw data in via read-ahead
+    madvise(mapping, size, MADV_RANDOM);
+
+    return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const uint8_t*>(mapping), size));
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+void MappedFile::willNeed(std::span<const uint8_t> range) const {
+    if (range.empty() || range.data() < data_ || range.data() + range.size() > data_ + size_) {
+        return;
+    }
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0) {
+        return;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(range.data()) & ~static_cast<uintptr_t>(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(range.data() + range.size());
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+}
+
+// MARK: - TIFF Reader
+
+namespace {
+
+enum TiffType : uint16_t {
+    kByte = 1, kAscii = 2, kShort = 3, kLong = 4, kRational = 5,
+    kSByte = 6, kUndefined = 7, kSShort = 8, kSLong = 9, kSRational = 10,
+    kFloat = 11, kDouble = 12, kIFD = 13,
+};
+
+// Structural limits; real NEFs stay far below these
+constexpr int kMaxDepth = 6;
+constexpr size_t kMaxIFDs = 64;
+constexpr uint16_t kMaxEntries = 1024;
+constexpr uint32_t kMaxSubIFDs = 16;
+
+size_t typeSize(uint16_t type) {
+    switch (type) {
+    case kByte: case kAscii: case kSByte: case kUndefined: return 1;
+    case kShort: case kSShort: return 2;
+    case kLong: case kSLong: case kFloat: case kIFD: return 4;
+    case kRational: case kSRational: case kDouble: return 8;
+    default: return 0;
+    }
+}
+
+/// Bounds-checked view of a TIFF structure. Offsets are relative to `base` (the TIFF header),
+/// which differs between the main file and the Nikon MakerNote's embedded TIFF.
+class TiffReader {
+public:
+    TiffReader(std::span<const uint8_t> data, size_t base, bool littleEndian)
+        : data_(data), base_(base), littleEndian_(littleEndian) {}
+
+    size_t base() const { return base_; }
+
+    bool contains(uint64_t offset, uint64_t length) const {
+        if (base_ > data_.size()) return false;
+        uint64_t available = data_.size() - base_;
+        return offset <= available && length <= available - offset;
+    }
+
+    /// Bytes available from `offset` to the end of the buffer (0 if out of range).
+    uint64_t remaining(uint64_t offset) const {
+        if (base_ > data_.size()) return 0;
+        uint64_t available = data_.size() - base_;
+        return offset < available ? available - offset : 0;
+    }
+
+    std::span<const uint8_t> bytes(uint64_t offset, uint64_t length) const {
+        if (!contains(offset, length)) return {};
+        return data_.subspan(base_ + static_cast<size_t>(offset), static_cast<size_t>(length));
+    }
+
+    bool u8(uint64_t offset, uint8_t& out) const {
+        if (!contains(offset, 1)) return false;
+        out = data_[base_ + offset];
+        return true;
+    }
+
+    bool u16(uint64_t offset, uint16_t& out) const {
+        if (!contains(offset, 2)) return false;
+        const uint8_t* p = data_.data() + base_ + offset;
+        out = littleEndian_ ? uint16_t(p[0] | (p[1] << 8)) : uint16_t((p[0] << 8) | p[1]);
+        return true;
+    }
+
+    bool u32(uint64_t offset, uint32_t& out) const {
+        if (!contains(offset, 4)) return false;
+        const uint8_t* p = data_.data() + base_ + offset;
+        out = littleEndian_
+            ? uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24)
+            : (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> data_;
+    size_t base_;
+    bool littleEndian_;
+};
+
+struct Entry {
+    uint16_t tag = 0;
+    uint16_t type = 0;
+    uint32_t count = 0;
+    /// Offset of the value relative to the reader's base (inline values point into the entry).
+    uint64_t valueOffset = 0;
+};
+
+/// Reads entry `index` of the IFD at `ifdOffset`. Returns false if it does not fit the buffer
+/// or has an unknown type.
+bool readEntry(const TiffReader& reader, uint64_t ifdOffset, uint16_t index, Entry& entry) {
+    uint64_t offset = ifdOffset + 2 + uint64_t(index) * 12;
+    uint32_t inlineOrOffset = 0;
+    if (!reader.u16(offset, entry.tag) ||
+        !reader.u16(offset + 2, entry.type) ||
+        !reader.u32(offset + 4, entry.count) ||
+        !reader.u32(offset + 8, inlineOrOffset)) {
+        return false;
+    }
+    size_t size = typeSize(entry.type);
+    if (size == 0) return false;
+
+    uint64_t byteCount = uint64_t(entry.count) * size;
+    entry.valueOffset = byteCount <= 4 ? offset + 8 : inlineOrOffset;
+    return reader.contains(entry.valueOffset, byteCount);
+}
+
+uint32_t entryUInt(const TiffReader& reader, const Entry& entry, uint32_t index = 0) {
+    if (index >= entry.count) return 0;
+    switch (entry.type) {
+    case kByte: case kUndefined: case kSByte: {
+        uint8_t value = 0;
+        reader.u8(entry.valueOffset + index, value);
+        return value;
+    }
+    case kShort: case kSShort: {
+        uint16_t value = 0;
+        reader.u16(entry.valueOffset + uint64_t(index) * 2, value);
+        return value;
+    }
+    case kLong: case kSLong: case kIFD: {
+        uint32_t value = 0;
+        reader.u32(entry.valueOffset + uint64_t(index) * 4, value);
+        return value;
+    }
+    default:
+        return 0;
+    }
+}
+
+double entryReal(const TiffReader& reader, const Entry& entry, uint32_t index = 0) {
+    if (index >= entry.count) return 0;
+    switch (entry.type) {
+    case kRational: case kSRational: {
+        uint32_t numerator = 0, denominator = 0;
+        uint64_t offset = entry.valueOffset + uint64_t(index) * 8;
+        if (!reader.u32(offset, numerator) || !reader.u32(offset + 4, denominator) || denominator == 0) {
+            return 0;
+        }
+        if (entry.type == kSRational) {
+            return double(int32_t(numerator)) / double(int32_t(denominator));
+        }
+        return double(numerator) / double(denominator);
+    }
+    case kSShort:
+        return double(int16_t(entryUInt(reader, entry, index)));
+    case kSLong:
+        return double(int32_t(entryUInt(reader, entry, index)));
+    default:
+        return double(entryUInt(reader, entry, index));
+    }
+}
+
+std::string entryString(const TiffReader& reader, const Entry& entry) {
+    if (entry.type != kAscii && entry.type != kUndefined && entry.type != kByte) return {};
+    auto bytes = reader.bytes(entry.valueOffset, entry.count);
+    std::string value(bytes.begin(), std::find(bytes.begin(), bytes.end(), uint8_t(0)));
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\0')) {
+        value.pop_back();
+    }
+    return value;
+}
+
+// MARK: - IFD Walker
+
+enum class IFDKind { Image, Exif, MakerNote, NikonPreview };
+
+/// A JPEG located by offset/length tags, before validation.
+struct JPEGCandidate {
+    std::span<const uint8_t> bytes;
+};
+
+class Walker {
+public:
+    explicit Walker(std::span<const uint8_t> data) : data_(data) {}
+
+    void walk(const TiffReader& reader, uint64_t offset, IFDKind kind, int depth, bool followChain);
+
+    NEFParseResult finish();
+
+private:
+    void imageIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth);
+    void exifIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth);
+    void makerNoteIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth);
+    void previewIFD(const TiffReader& reader, uint64_t offset, uint16_t count);
+    void makerNote(const TiffReader& parent, const Entry& entry, int depth);
+
+    std::span<const uint8_t> data_;
+    std::set<std::pair<size_t, uint64_t>> visited_;
+    NEFParseResult result_;
+    NEFRawInfo raw_;
+    std::string ifd0DateTime_;
+    std::vector<JPEGCandidate> candidates_;
+    uint64_t rawPixels_ = 0;
+};
+
+void Walker::walk(const TiffReader& reader, uint64_t offset, IFDKind kind, int depth, bool followChain) {
+    while (offset != 0 && depth <= kMaxDepth && visited_.size() < kMaxIFDs) {
+        // Loops between IFDs are a classic fuzzing crash; visit each IFD once
+        if (!visited_.insert({reader.base(), offset}).second) return;
+
+        uint16_t count = 0;
+        if (!reader.u16(offset, count) || count == 0 || count > kMaxEntries) return;
+        if (!reader.contains(offset + 2, uint64_t(count) * 12 + 4)) return;
+
+        switch (kind) {
+        case IFDKind::Image: imageIFD(reader, offset, count, depth); break;
+        case IFDKind::Exif: exifIFD(reader, offset, count, depth); break;
+        case IFDKind::MakerNote: makerNoteIFD(reader, offset, count, depth); break;
+        case IFDKind::NikonPreview: previewIFD(reader, offset, count); break;
+        }
+
+        if (!followChain) return;
+        uint32_t next = 0;
+        if (!reader.u32(offset + 2 + uint64_t(count) * 12, next)) return;
+        offset = next;
+    }
+}
+
+void Walker::imageIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth) {
+    NEFMetadata& meta = result_.metadata;
+    uint32_t width = 0, height = 0, bits = 0, compression = 0, subfileType = 0;
+    uint32_t jpegOffset = 0, jpegLength = 0, stripOffset = 0, stripLength = 0;
+    uint32_t stripCount = 0;
+    uint64_t stripTotal = 0;
+    uint8_t cfa[4] = {0, 1, 1, 2};
+
+    for (uint16_t index = 0; index < count; ++index) {
+        Entry entry;
+        if (!readEntry(reader, offset, index, entry)) continue;
+
+        switch (entry.tag) {
+        case 0x00FE: subfileType = entryUInt(reader, entry); break;
+        case 0x0100: width = entryUInt(reader, entry); break;
+        case 0x0101: height = entryUInt(reader, entry); break;
+        case 0x0102: bits = entryUInt(reader, entry); break;
+        case 0x0103: compression = entryUInt(reader, entry); break;
+        case 0x010F: if (meta.make.empty()) meta.make = entryString(reader, entry); break;
+        case 0x0110: if (meta.model.empty()) meta.model = entryString(reader, entry); break;
+        case 0x0111: stripOffset = entryUInt(reader, entry); stripCount = entry.count; break;
+        case 0x0112: if (depth == 0) meta.orientation = entryUInt(reader, entry); break;
+        case 0x0117:
+            stripLength = entryUInt(reader, entry);
+            // Multi-strip raw data is stored contiguously after the first strip
+            for (uint32_t strip = 0; strip < entry.count; ++strip) {
+                stripTotal += entryUInt(reader, entry, strip);
+            }
+            break;
+        case 0x828E:
+            if (entry.count == 4) {
+                for (uint32_t position = 0; position < 4; ++position) {
+                    cfa[position] = uint8_t(std::min<uint32_t>(entryUInt(reader, entry, position), 2));
+                }
+            }
+            break;
+        case 0x011A: if (depth == 0) meta.resolution = entryReal(reader, entry); break;
+        case 0x0131: if (meta.software.empty()) meta.software = entryString(reader, entry); break;
+        case 0x0132: if (ifd0DateTime_.empty()) ifd0DateTime_ = entryString(reader, entry); break;
+        case 0x013B: if (meta.artist.empty()) meta.artist = entryString(reader, entry); break;
+        case 0x0201: jpegOffset = entryUInt(reader, entry); break;
+        case 0x0202: jpegLength = entryUInt(reader, entry); break;
+        case 0x8298: if (meta.copyright.empty()) meta.copyright = entryString(reader, entry); break;
+        case 0x014A: {
+            uint32_t subCount = std::min(entry.count, kMaxSubIFDs);
+            for (uint32_t sub = 0; sub < subCount; ++sub) {
+                walk(reader, entryUInt(reader, entry, sub), IFDKind::Image, depth + 1, false);
+            }
+            break;
+        }
+        case 0x8769:
+            walk(reader, entryUInt(reader, entry), IFDKind::Exif, depth + 1, false);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // JPEG previews: JPEGInterchangeFormat, or a single JPEG-compressed strip
+    if (jpegOffset != 0 && jpegLength != 0) {
+        candidates_.push_back({reader.bytes(jpegOffset, jpegLength)});
+    } else if ((compression == 6 || compression == 7) && stripCount == 1 && stripLength != 0) {
+        candidates_.push_back({reader.bytes(stripOffset, stripLength)});
+    }
+
+    // The raw CFA image is the largest full-resolution IFD with more than 8 bits per sample
+    bool isRaw = subfileType == 0 && bits > 8 && (compression == 1 || compression == 34713);
+    uint64_t pixels = uint64_t(width) * height;
+    if (isRaw && pixels > rawPixels_) {
+        rawPixels_ = pixels;
+        meta.width = width;
+        meta.height = height;
+        meta.bitsPerSample = bits;
+
+        // Truncated files keep what is there; the decoder reports how far it got
+        raw_.data = reader.bytes(stripOffset, std::min(stripTotal, reader.remaining(stripOffset)));
+        raw_.width = width;
+        raw_.height = height;
+        raw_.bitsPerSample = bits;
+        raw_.compression = compression;
+        std::copy(std::begin(cfa), std::end(cfa), std::begin(raw_.cfaPattern));
+    }
+}
+
+void Walker::exifIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth) {
+    NEFMetadata& meta = result_.metadata;
+
+    for (uint16_t index = 0; index < count; ++index) {
+        Entry entry;
+        if (!readEntry(reader, offset, index, entry)) continue;
+
+        switch (entry.tag) {
+        case 0x829A: meta.exposureTime = entryReal(reader, entry); break;
+        case 0x829D: meta.fNumber = entryReal(reader, entry); break;
+        case 0x8822: meta.exposureProgram = entryUInt(reader, entry); break;
+        case 0x8827: if (meta.iso == 0) meta.iso = entryUInt(reader, entry); break;
+        case 0x9003: meta.dateTime = entryString(reader, entry); break;
+        case 0x9204: meta.exposureBias = entryReal(reader, entry); break;
+        case 0x9207: meta.meteringMode = entryUInt(reader, entry); break;
+        case 0x9209: meta.flash = entryUInt(reader, entry); break;
+        case 0x920A: meta.focalLength = entryReal(reader, entry); break;
+        case 0xA434: meta.lensModel = entryString(reader, entry); break;
+        case 0x927C: makerNote(reader, entry, depth + 1); break;
+        default: break;
+        }
+    }
+}
+
+void Walker::makerNote(const TiffReader& parent, const Entry& entry, int depth) {
+    auto bytes = parent.bytes(entry.valueOffset, entry.count);
+
+    // Type 3 Nikon MakerNote: "Nikon\0" + version, then a self-contained TIFF header whose
+    // offsets are relative to itself
+    static const uint8_t signature[] = {'N', 'i', 'k', 'o', 'n', 0};
+    if (bytes.size() >= 18 && std::memcmp(bytes.data(), signature, sizeof(signature)) == 0) {
+        size_t base = static_cast<size_t>(bytes.data() - data_.data()) + 10;
+        bool littleEndian = bytes[10] == 'I' && bytes[11] == 'I';
+        if (!littleEndian && !(bytes[10] == 'M' && bytes[11] == 'M')) return;
+
+        TiffReader reader(data_, base, littleEndian);
+        raw_.makerNoteLittleEndian = littleEndian;
+        uint16_t magic = 0;
+        uint32_t first = 0;
+        if (!reader.u16(2, magic) || magic != 42 || !reader.u32(4, first)) return;
+
+        result_.metadata.hasNikonMakerNote = true;
+        walk(reader, first, IFDKind::MakerNote, depth, false);
+        return;
+    }
+
+    // Older bodies: a plain IFD using the parent's offsets
+    walk(parent, entry.valueOffset, IFDKind::MakerNote, depth, false);
+}
+
+void Walker::makerNoteIFD(const TiffReader& reader, uint64_t offset, uint16_t count, int depth) {
+    NEFMetadata& meta = result_.metadata;
+
+    for (uint16_t index = 0; index < count; ++index) {
+        Entry entry;
+        if (!readEntry(reader, offset, index, entry)) continue;
+
+        switch (entry.tag) {
+        case 0x0002: {
+            // ISO as [0, value]; EXIF ISO is 0 or clipped for Hi settings
+            uint32_t iso = entryUInt(reader, entry, 1);
+            if (iso > meta.iso) meta.iso = iso;
+            break;
+        }
+        case 0x0005:
+            meta.whiteBalance = entryString(reader, entry);
+            break;
+        case 0x000C:
+            if (entry.count >= 2) {
+                raw_.redMultiplier = entryReal(reader, entry, 0);
+                raw_.blueMultiplier = entryReal(reader, entry, 1);
+            }
+            break;
+        case 0x003D:
+            if (entry.count == 4) {
+                for (uint32_t position = 0; position < 4; ++position) {
+                    raw_.blackLevel[position] = uint16_t(entryUInt(reader, entry, position));
+                }
+            }
+            break;
+        case 0x0096:
+            raw_.linearization = reader.bytes(entry.valueOffset, entry.count);
+            break;
+        case 0x0011:
+            walk(reader, entryUInt(reader, entry), IFDKind::NikonPreview, depth + 1, false);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Walker::previewIFD(const TiffReader& reader, uint64_t offset, uint16_t count) {
+    uint32_t jpegOffset = 0, jpegLength = 0;
+    for (uint16_t index = 0; index < count; ++index) {
+        Entry entry;
+        if (!readEntry(reader, offset, index, entry)) continue;
+        if (entry.tag == 0x0201) jpegOffset = entryUInt(reader, entry);
+        if (entry.tag == 0x0202) jpegLength = entryUInt(reader, entry);
+    }
+    if (jpegOffset != 0 && jpegLength != 0) {
+        candidates_.push_back({reader.bytes(jpegOffset, jpegLength)});
+    }
+}
+
+NEFParseResult Walker::finish() {
+    NEFMetadata& meta = result_.metadata;
+    if (rawPixels_ != 0 && !raw_.data.empty()) {
+        result_.raw = raw_;
+    }
+    if (meta.dateTime.empty()) {
+        meta.dateTime = ifd0DateTime_;
+    }
+
+    for (const auto& candidate : candidates_) {
+        auto jpeg = candidate.bytes;
+        if (jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) continue;
+
+        bool duplicate = std::any_of(result_.previews.begin(), result_.previews.end(), [&](const NEFPreview& preview) {
+            return preview.jpeg.data() == jpeg.data();
+        });
+        if (duplicate) continue;
+
+        NEFPreview preview;
+        preview.jpeg = jpeg;
+        jpegDimensions(jpeg, preview.width, preview.height);
+        result_.previews.push_back(preview);
+    }
+
+    std::stable_sort(result_.previews.begin(), result_.previews.end(), [](const NEFPreview& a, const NEFPreview& b) {
+        uint64_t areaA = uint64_t(a.width) * a.height;
+        uint64_t areaB = uint64_t(b.width) * b.height;
+        return areaA != areaB ? areaA > areaB : a.jpeg.size() > b.jpeg.size();
+    });
+
+    return std::move(result_);
+}
+
+} // namespace
+
+// MARK: - Public API
+
+std::optional<NEFParseResult> parseNEF(std::span<const uint8_t> data) {
+    if (data.size() < 8) return std::nullopt;
+
+    bool littleEndian = data[0] == 'I' && data[1] == 'I';
+    if (!littleEndian && !(data[0] == 'M' && data[1] == 'M')) return std::nullopt;
+
+    TiffReader reader(data, 0, littleEndian);
+    uint16_t magic = 0;
+    uint32_t first = 0;
+    if (!reader.u16(2, magic) || magic != 42 || !reader.u32(4, first)) return std::nullopt;
+
+    Walker walker(data);
+    walker.walk(reader, first, IFDKind::Image, 0, true);
+    return walker.finish();
+}
+
+bool jpegDimensions(std::span<const uint8_t> jpeg, uint32_t& width, uint32_t& height) {
+    if (jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) return false;
+
+    size_t position = 2;
+    while (position + 4 <= jpeg.size()) {
+        if (jpeg[position] != 0xFF) return false;
+        uint8_t marker = jpeg[position + 1];
+
+        // Fill bytes and parameterless markers
+        if (marker == 0xFF) { position += 1; continue; }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) { position += 2; continue; }
+        if (marker == 0xD9 || marker == 0xDA) return false;
+
+        size_t length = (size_t(jpeg[position + 2]) << 8) | jpeg[position + 3];
+        if (length < 2) return false;
+
+        bool isFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (isFrame) {
+            if (length < 7 || position + 9 > jpeg.size()) return false;
+            height = (uint32_t(jpeg[position + 5]) << 8) | jpeg[position + 6];
+            width = (uint32_t(jpeg[position + 7]) << 8) | jpeg[position + 8];
+            return true;
+        }
+        position += 2 + length;
+    }
+    return false;
+}
+
+} // namespace dirtyraw
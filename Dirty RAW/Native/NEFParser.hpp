@@ -0,0 +1,119 @@
+//
+//  NEFParser.hpp
+//  Dirty RAW
+//
+//  Portable TIFF/IFD walker for Nikon NEF/NRW files. Reads metadata and locates the embedded
+//  JPEG previews without the Nikon SDK. Every read is bounds-checked against the input buffer,
+//  so malformed or truncated files produce partial results instead of undefined behaviour.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace dirtyraw {
+
+/// Read-only memory mapping of a file. Pages are read from disk only when touched, so parsing
+/// metadata costs the few pages holding the IFDs rather than the whole raw file.
+class MappedFile {
+public:
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const uint8_t> bytes() const { return {data_, size_}; }
+
+    /// Hints that `range` is about to be read sequentially (e.g. before decoding a preview).
+    void willNeed(std::span<const uint8_t> range) const;
+
+private:
+    MappedFile(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    const uint8_t* data_;
+    size_t size_;
+};
+
+/// An embedded JPEG preview. `jpeg` points into the parsed buffer (no copy).
+struct NEFPreview {
+    std::span<const uint8_t> jpeg;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+/// The fields `NKEXIFData` / `NKImageInfo` carry, read from IFD0, the EXIF IFD and the
+/// Nikon MakerNote.
+struct NEFMetadata {
+    std::string make;
+    std::string model;
+    std::string software;
+    std::string artist;
+    std::string copyright;
+    std::string lensModel;
+    /// "YYYY:MM:DD HH:MM:SS" (DateTimeOriginal, falling back to IFD0 DateTime)
+    std::string dateTime;
+    /// MakerNote white balance name, e.g. "AUTO", "SUNNY", "CLOUDY"
+    std::string whiteBalance;
+
+    double exposureTime = 0;
+    double fNumber = 0;
+    double focalLength = 0;
+    double exposureBias = 0;
+    double resolution = 0;
+    uint32_t iso = 0;
+    uint32_t meteringMode = 0;
+    uint32_t exposureProgram = 0;
+    uint32_t flash = 0;
+    uint32_t orientation = 1;
+
+    /// Dimensions and sample depth of the raw (CFA) image IFD, when present.
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bitsPerSample = 0;
+
+    bool hasNikonMakerNote = false;
+};
+
+/// Location and layout of the raw CFA data, plus the MakerNote fields needed to decode it.
+struct NEFRawInfo {
+    /// Raw strip data (points into the parsed buffer).
+    std::span<const uint8_t> data;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bitsPerSample = 0;
+    /// 1 = uncompressed, 34713 = Nikon compressed
+    uint32_t compression = 0;
+    /// 2x2 CFA colours in row-major order (0 = red, 1 = green, 2 = blue).
+    uint8_t cfaPattern[4] = {0, 1, 1, 2};
+
+    /// MakerNote 0x0096: compression version, predictors and linearization curve.
+    std::span<const uint8_t> linearization;
+    bool makerNoteLittleEndian = false;
+    /// MakerNote 0x000C: as-shot red and blue multipliers (0 if absent).
+    double redMultiplier = 0;
+    double blueMultiplier = 0;
+    /// MakerNote 0x003D: black level per CFA position.
+    uint16_t blackLevel[4] = {0, 0, 0, 0};
+};
+
+struct NEFParseResult {
+    NEFMetadata metadata;
+    /// Embedded JPEG previews, largest first.
+    std::vector<NEFPreview> previews;
+    std::optional<NEFRawInfo> raw;
+};
+
+/// Parses a NEF/NRW (or any TIFF-based) buffer. Returns nullopt if the buffer is not a TIFF.
+std::optional<NEFParseResult> parseNEF(std::span<const uint8_t> data);
+
+/// Reads the frame dimensions from a JPEG's SOF marker. Returns false if none is found.
+bool jpegDimensions(std::span<const uint8_t> jpeg, uint32_t& width, uint32_t& height);
+
+} // namespace dirtyraw
@@ -0,0 +1,234 @@
+//
+//  PNGEncoder.cpp
+//  Dirty RAW
+//
+//  RGB PNG with adaptive row filters. The zlib stream is built the way pigz builds one: each
+//  group of rows is deflated on its own (ending on a byte boundary with a sync flush), the
+//  groups are concatenated behind a single zlib header, and their Adler-32 checksums are
+//  combined for the trailer. Each group goes out as its own IDAT chunk.
+//
+
+#include "ImageEncoder.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kChunkRows = 256;
+/// Rows deflated per job. Each group restarts the compressor's window, which costs a little
+/// ratio at the top of the group.
+constexpr int kGroupRows = 16;
+constexpr int kCompressionLevel = 6;
+
+void putBigEndian32(uint8_t* out, uint32_t value) {
+    out[0] = uint8_t(value >> 24);
+    out[1] = uint8_t(value >> 16);
+    out[2] = uint8_t(value >> 8);
+    out[3] = uint8_t(value);
+}
+
+inline uint8_t paeth(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int distanceLeft = std::abs(estimate - left);
+    int distanceUp = std::abs(estimate - up);
+    int distanceUpLeft = std::abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) return uint8_t(left);
+    if (distanceUp <= distanceUpLeft) return uint8_t(up);
+    return uint8_t(upLeft);
+}
+
+/// Writes the filter byte and filtered bytes of `row` to `out`, choosing the filter with the
+/// smallest sum of absolute (signed) residuals, as libpng's heuristic does.
+void filterRow(const uint8_t* row, const uint8_t* previous, size_t length, size_t pixelBytes,
+               uint8_t* out, std::vector<uint8_t>& scratch) {
+    scratch.resize(length * 5);
+    uint64_t bestCost = UINT64_MAX;
+    int bestFilter = 0;
+    for (int filter = 0; filter < 5; ++filter) {
+        uint8_t* candidate = scratch.data() + length * filter;
+        uint64_t cost = 0;
+        for (size_t i = 0; i < length; ++i) {
+            int left = i >= pixelBytes ? row[i - pixelBytes] : 0;
+            int up = previous ? previous[i] : 0;
+            int upLeft = previous && i >= pixelBytes ? previous[i - pixelBytes] : 0;
+            uint8_t predicted = 0;
+            switch (filter) {
+                case 1: predicted = uint8_t(left); break;
+                case 2: predicted = uint8_t(up); break;
+                case 3: predicted = uint8_t((left + up) / 2); break;
+                case 4: predicted = paeth(left, up, upLeft); break;
+            }
+            uint8_t residual = uint8_t(row[i] - predicted);
+            candidate[i] = residual;
+            cost += uint64_t(std::abs(int(int8_t(residual))));
+        }
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestFilter = filter;
+        }
+    }
+    out[0] = uint8_t(bestFilter);
+    std::memcpy(out + 1, scratch.data() + length * bestFilter, length);
+}
+
+class PNGEncoder final : public ImageEncoder {
+public:
+    PNGEncoder(FileWriter& writer, const EncoderSettings& settings)
+        : ImageEncoder(writer, settings, kChunkRows) {}
+
+protected:
+    bool writeHeader() override {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        writer_.write(signature, 8);
+
+        uint8_t header[13];
+        putBigEndian32(header, uint32_t(settings_.width));
+        putBigEndian32(header + 4, uint32_t(settings_.height));
+        header[8] = uint8_t(settings_.bitsPerSample);
+        header[9] = 2; // RGB
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+        writeChunk("IHDR", header, sizeof(header));
+
+        if (!settings_.iccProfile.empty()) {
+            uLongf compressedSize = compressBound(uLong(settings_.iccProfile.size()));
+            std::vector<uint8_t> payload(13 + compressedSize);
+            std::memcpy(payload.data(), "ICC Profile\0\0", 13);
+            if (compress2(payload.data() + 13, &compressedSize, settings_.iccProfile.data(),
+                          uLong(settings_.iccProfile.size()), kCompressionLevel) == Z_OK) {
+                writeChunk("iCCP", payload.data(), 13 + compressedSize);
+            }
+        }
+
+        // zlib header (deflate, 32K window, default level); the deflate data follows in the
+        // IDAT chunks of each group
+        static const uint8_t zlibHeader[2] = { 0x78, 0x9C };
+        writeChunk("IDAT", zlibHeader, 2);
+        return writer_.ok();
+    }
+
+    bool encodeChunk(const uint8_t* rows, int firstRow, int rowCount) override {
+        size_t length = rowBytes();
+        size_t pixelBytes = 3 * bytesPerSample();
+        bool lastChunk = firstRow + rowCount == settings_.height;
+        int groups = (rowCount + kGroupRows - 1) / kGroupRows;
+
+        struct Group {
+            std::vector<uint8_t> compressed;
+            uLong adler = 0;
+            size_t filteredBytes = 0;
+            bool ok = false;
+        };
+        std::vector<Group> results(groups);
+
+        parallelFor(0, groups, [&](int begin, int end) {
+            std::vector<uint8_t> current(length), above(length), filtered, scratch;
+            for (int group = begin; group < end; ++group) {
+                int groupFirst = group * kGroupRows;
+                int groupRows = std::min(kGroupRows, rowCount - groupFirst);
+                filtered.resize((length + 1) * groupRows);
+
+                bool hasAbove = groupFirst > 0 || firstRow > 0;
+                if (groupFirst > 0) {
+                    toBigEndian(rows + length * (groupFirst - 1), above.data(), length);
+                } else if (firstRow > 0) {
+                    above = previousRow_;
+                }
+                for (int row = 0; row < groupRows; ++row) {
+                    toBigEndian(rows + length * (groupFirst + row), current.data(), length);
+                    filterRow(current.data(), hasAbove ? above.data() : nullptr, length, pixelBytes,
+                              filtered.data() + (length + 1) * row, scratch);
+                    std::swap(current, above);
+                    hasAbove = true;
+                }
+
+                Group& result = results[group];
+                result.filteredBytes = filtered.size();
+                result.adler = adler32(1, filtered.data(), uInt(filtered.size()));
+                result.ok = deflateGroup(filtered, lastChunk && group == groups - 1, result.compressed);
+            }
+        });
+
+        // The row above the next chunk, for the Up, Average and Paeth filters
+        previousRow_.resize(length);
+        toBigEndian(rows + length * (rowCount - 1), previousRow_.data(), length);
+
+        for (const Group& group : results) {
+            if (!group.ok) return false;
+            adler_ = adler32_combine(adler_, group.adler, z_off_t(group.filteredBytes));
+            writeChunk("IDAT", group.compressed.data(), group.compressed.size());
+        }
+        return writer_.ok();
+    }
+
+    bool writeTrailer() override {
+        uint8_t checksum[4];
+        putBigEndian32(checksum, uint32_t(adler_));
+        writeChunk("IDAT", checksum, 4);
+        writeChunk("IEND", nullptr, 0);
+        return writer_.ok();
+    }
+
+private:
+    /// PNG stores 16-bit samples big-endian.
+    void toBigEndian(const uint8_t* in, uint8_t* out, size_t length) const {
+        if (bytesPerSample() == 1) {
+            std::memcpy(out, in, length);
+            return;
+        }
+        const uint16_t* samples = reinterpret_cast<const uint16_t*>(in);
+        for (size_t i = 0; i < length / 2; ++i) {
+            out[2 * i] = uint8_t(samples[i] >> 8);
+            out[2 * i + 1] = uint8_t(samples[i]);
+        }
+    }
+
+    static bool deflateGroup(const std::vector<uint8_t>& input, bool last, std::vector<uint8_t>& out) {
+        z_stream stream = {};
+        if (deflateInit2(&stream, kCompressionLevel, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK) return false;
+        out.resize(deflateBound(&stream, uLong(input.size())) + 16);
+        stream.next_in = const_cast<Bytef*>(input.data());
+        stream.avail_in = uInt(input.size());
+        stream.next_out = out.data();
+        stream.avail_out = uInt(out.size());
+        int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        bool ok = last ? status == Z_STREAM_END : status == Z_OK && stream.avail_in == 0;
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ok;
+    }
+
+    void writeChunk(const char* type, const uint8_t* data, size_t length) {
+        uint8_t header[8];
+        putBigEndian32(header, uint32_t(length));
+        std::memcpy(header + 4, type, 4);
+        uLong crc = crc32(0, header + 4, 4);
+        if (length) crc = crc32(crc, data, uInt(length));
+        uint8_t trailer[4];
+        putBigEndian32(trailer, uint32_t(crc));
+
+        writer_.write(header, 8);
+        if (length) writer_.write(data, length);
+        writer_.write(trailer, 4);
+    }
+
+    std::vector<uint8_t> previousRow_;
+    uLong adler_ = 1;
+};
+
+} // namespace
+
+std::unique_ptr<ImageEncoder> makePNGEncoder(FileWriter& writer, const EncoderSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0) return nullptr;
+    if (settings.bitsPerSample != 8 && settings.bitsPerSample != 16) return nullptr;
+    return std::make_unique<PNGEncoder>(writer, settings);
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,39 @@
+//
+//  Parallel.hpp
+//  Dirty RAW
+//
+
+#pragma once
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+namespace dirtyraw {
+
+/// Splits [begin, end) into chunks and runs `body(chunkBegin, chunkEnd)` on each through the
+/// shared job system, returning when all chunks are done. There are a few chunks per core so
+/// stealing evens out uneven work and higher-priority renders can cut in between chunks. Runs
+/// with the current `JobContext`; after cancellation, chunks that haven't started are skipped.
+template <typename Body>
+void parallelFor(int begin, int end, Body&& body) {
+    int count = end - begin;
+    if (count <= 0) return;
+
+    JobSystem& system = JobSystem::shared();
+    int chunks = std::min(count, (system.workerCount() + 1) * 4);
+    if (chunks == 1) {
+        if (!currentJobContext().token.isCancelled()) body(begin, end);
+        return;
+    }
+
+    JobGraph graph;
+    int chunk = (count + chunks - 1) / chunks;
+    for (int start = begin; start < end; start += chunk) {
+        int stop = std::min(start + chunk, end);
+        graph.add([&body, start, stop] { body(start, stop); });
+    }
+    system.run(graph);
+}
+
+} // namespace dirtyraw
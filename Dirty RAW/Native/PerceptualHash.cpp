@@ -0,0 +1,251 @@
+//
+//  PerceptualHash.cpp
+//  Dirty RAW
+//
+
+#include "PerceptualHash.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kGrid = 32;
+/// Low-frequency coefficients kept per axis: 8 x 8 = 64 hash bits.
+constexpr int kLow = 8;
+constexpr int kWords = 4;
+constexpr double kPi = 3.14159265358979323846;
+
+/// Four lanes of a grid row in a 128-bit register (NEON on Apple silicon, SSE on Intel).
+typedef float Float4 __attribute__((vector_size(16)));
+
+/// DCT-II basis for the low frequencies: `basis[u]` holds cos((2x + 1)uπ / 64) for x = 0...31.
+struct Basis {
+    alignas(16) float values[kLow][kGrid];
+
+    Basis() {
+        for (int u = 0; u < kLow; ++u) {
+            for (int x = 0; x < kGrid; ++x) {
+                values[u][x] = float(std::cos((2 * x + 1) * u * kPi / (2 * kGrid)));
+            }
+        }
+    }
+};
+
+const Basis& basis() {
+    static const Basis instance;
+    return instance;
+}
+
+inline float horizontalSum(Float4 v) {
+    return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+/// Area average of cell `index` of `cells` along an axis of `size` pixels: [begin, end).
+inline void cellRange(int index, int cells, int size, int& begin, int& end) {
+    begin = int(int64_t(index) * size / cells);
+    end = std::max(begin + 1, int(int64_t(index + 1) * size / cells));
+    end = std::min(end, size);
+    begin = std::min(begin, end - 1);
+}
+
+/// Probes of one 16-bit word: every mask with at most `radius` bits set.
+const std::vector<uint16_t>& probeMasks(int radius) {
+    static std::array<std::vector<uint16_t>, 4> masks;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        for (uint32_t mask = 0; mask < 65536; ++mask) {
+            int bits = std::popcount(mask);
+            for (int r = bits; r < 4; ++r) masks[r].push_back(uint16_t(mask));
+        }
+    });
+    return masks[std::clamp(radius, 0, 3)];
+}
+
+inline uint16_t word(uint64_t hash, int index) {
+    return uint16_t(hash >> (16 * index));
+}
+
+int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+} // namespace
+
+ImageSignature computeSignature(const uint8_t* rgba, size_t stride, int width, int height) {
+    ImageSignature signature;
+    if (width <= 0 || height <= 0) return signature;
+
+    // Area-average to the luma grid, and accumulate the chroma grid from the same cells
+    alignas(16) float luma[kGrid][kGrid];
+    constexpr int kColorGrid = ImageSignature::kColorGrid;
+    double chroma[kColorGrid][kColorGrid][2] = {};
+    double chromaWeight[kColorGrid][kColorGrid] = {};
+    for (int gy = 0; gy < kGrid; ++gy) {
+        int y0, y1;
+        cellRange(gy, kGrid, height, y0, y1);
+        for (int gx = 0; gx < kGrid; ++gx) {
+            int x0, x1;
+            cellRange(gx, kGrid, width, x0, x1);
+            uint32_t sum[3] = { 0, 0, 0 };
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* pixel = rgba + size_t(y) * stride + size_t(x0) * 4;
+                for (int x = x0; x < x1; ++x, pixel += 4) {
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                }
+            }
+            float count = float((y1 - y0) * (x1 - x0));
+            float r = sum[0] / count, g = sum[1] / count, b = sum[2] / count;
+            luma[gy][gx] = 0.299f * r + 0.587f * g + 0.114f * b;
+
+            int cy = gy * kColorGrid / kGrid, cx = gx * kColorGrid / kGrid;
+            chroma[cy][cx][0] += r - g;
+            chroma[cy][cx][1] += 0.5f * (r + g) - b;
+            chromaWeight[cy][cx] += 1;
+        }
+    }
+    for (int cy = 0; cy < kColorGrid; ++cy) {
+        for (int cx = 0; cx < kColorGrid; ++cx) {
+            for (int c = 0; c < 2; ++c) {
+                // Opponent channels span -255...255; halve them into a byte around 128
+                double value = chroma[cy][cx][c] / chromaWeight[cy][cx] * 0.5 + 128;
+                signature.color[(cy * kColorGrid + cx) * 2 + c] = uint8_t(std::clamp(value, 0.0, 255.0) + 0.5);
+            }
+        }
+    }
+
+    // Separable DCT, low frequencies only. Rows first: each row against the 8 basis rows,
+    // four columns at a time.
+    const Basis& dct = basis();
+    float rowCoefficients[kGrid][kLow];
+    for (int y = 0; y < kGrid; ++y) {
+        const Float4* row = reinterpret_cast<const Float4*>(luma[y]);
+        for (int u = 0; u < kLow; ++u) {
+            const Float4* cosines = reinterpret_cast<const Float4*>(dct.values[u]);
+            Float4 sum = {};
+            for (int i = 0; i < kGrid / 4; ++i) sum += row[i] * cosines[i];
+            rowCoefficients[y][u] = horizontalSum(sum);
+        }
+    }
+    // Then columns: coefficient (v, u) for all u at once, two vectors of four
+    float coefficients[kLow * kLow];
+    for (int v = 0; v < kLow; ++v) {
+        Float4 low = {}, high = {};
+        for (int y = 0; y < kGrid; ++y) {
+            float cosine = dct.values[v][y];
+            const float* in = rowCoefficients[y];
+            low += cosine * Float4{ in[0], in[1], in[2], in[3] };
+            high += cosine * Float4{ in[4], in[5], in[6], in[7] };
+        }
+        for (int u = 0; u < 4; ++u) {
+            coefficients[v * kLow + u] = low[u];
+            coefficients[v * kLow + u + 4] = high[u];
+        }
+    }
+
+    float sorted[kLow * kLow];
+    std::copy(coefficients, coefficients + kLow * kLow, sorted);
+    std::nth_element(sorted, sorted + 32, sorted + 64);
+    float median = sorted[32];
+    for (int i = 0; i < kLow * kLow; ++i) {
+        if (coefficients[i] > median) signature.hash |= uint64_t(1) << i;
+    }
+    return signature;
+}
+
+int hashDistance(const ImageSignature& a, const ImageSignature& b) {
+    return std::popcount(a.hash ^ b.hash);
+}
+
+float colorDistance(const ImageSignature& a, const ImageSignature& b) {
+    int sum = 0;
+    for (size_t i = 0; i < sizeof(a.color); ++i) sum += std::abs(int(a.color[i]) - int(b.color[i]));
+    return float(sum) / sizeof(a.color);
+}
+
+std::vector<int> groupSignatures(const std::vector<ImageSignature>& signatures, const std::vector<bool>& valid,
+                                 int maxDistance, float colorTolerance) {
+    int count = int(signatures.size());
+    maxDistance = std::clamp(maxDistance, 0, 15);
+    const std::vector<uint16_t>& masks = probeMasks(maxDistance / kWords);
+
+    // One table per 16-bit word, as offsets into a list of signature indices (counting sort)
+    std::vector<uint32_t> offsets(size_t(kWords) * 65537, 0);
+    std::vector<int> entries(size_t(kWords) * count);
+    for (int t = 0; t < kWords; ++t) {
+        uint32_t* table = offsets.data() + size_t(t) * 65537;
+        for (int i = 0; i < count; ++i) {
+            if (valid[i]) ++table[word(signatures[i].hash, t) + 1];
+        }
+        std::partial_sum(table, table + 65537, table);
+        std::vector<uint32_t> cursor(table, table + 65536);
+        for (int i = 0; i < count; ++i) {
+            if (valid[i]) entries[size_t(t) * count + cursor[word(signatures[i].hash, t)]++] = i;
+        }
+    }
+
+    // Probe in parallel, collecting matching pairs (each reported once, from its lower index)
+    std::vector<std::pair<int, int>> pairs;
+    std::mutex pairsMutex;
+    parallelFor(0, count, [&](int begin, int end) {
+        std::vector<std::pair<int, int>> found;
+        // Last index that checked each candidate, so a pair found in several tables is tested once
+        std::vector<int> checkedBy(count, -1);
+        for (int i = begin; i < end; ++i) {
+            if (!valid[i]) continue;
+            const ImageSignature& signature = signatures[i];
+            for (int t = 0; t < kWords; ++t) {
+                const uint32_t* table = offsets.data() + size_t(t) * 65537;
+                const int* bucketEntries = entries.data() + size_t(t) * count;
+                uint16_t key = word(signature.hash, t);
+                for (uint16_t mask : masks) {
+                    uint16_t probe = key ^ mask;
+                    for (uint32_t e = table[probe]; e < table[probe + 1]; ++e) {
+                        int j = bucketEntries[e];
+                        if (j <= i || checkedBy[j] == i) continue;
+                        checkedBy[j] = i;
+                        if (hashDistance(signature, signatures[j]) <= maxDistance
+                            && colorDistance(signature, signatures[j]) <= colorTolerance) {
+                            found.emplace_back(i, j);
+                        }
+                    }
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(pairsMutex);
+        pairs.insert(pairs.end(), found.begin(), found.end());
+    });
+
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    for (const auto& [a, b] : pairs) {
+        int rootA = findRoot(parent, a), rootB = findRoot(parent, b);
+        if (rootA != rootB) parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+    }
+
+    // Number groups in order of their first member
+    std::vector<int> groups(count, -1);
+    std::vector<int> numberOfRoot(count, -1);
+    int next = 0;
+    for (int i = 0; i < count; ++i) {
+        int root = findRoot(parent, i);
+        if (numberOfRoot[root] < 0) numberOfRoot[root] = next++;
+        groups[i] = numberOfRoot[root];
+    }
+    return groups;
+}
+
+} // namespace dirtyraw
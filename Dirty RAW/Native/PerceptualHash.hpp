@@ -0,0 +1,50 @@
+//
+//  PerceptualHash.hpp
+//  Dirty RAW
+//
+//  Perceptual signatures for finding near-duplicate frames (bursts, re-exports, RAW+JPEG pairs).
+//  The hash is the classic DCT pHash: the image is area-averaged to a 32x32 luma grid, and each
+//  of the 64 lowest-frequency DCT coefficients gives one bit, set when it lies above their
+//  median. It survives resizing, recompression and small exposure changes, but knows nothing of
+//  colour, so a coarse grid of mean chroma rides along to tell apart frames that differ mostly
+//  in colour (white balance, gels, a different jersey in the same spot).
+//
+//  Grouping uses multi-index hashing: the 64 bits are split into four 16-bit words, each indexed
+//  in its own table. Two hashes within `maxDistance` bits agree on at least one word to within
+//  maxDistance / 4 bits (pigeonhole), so probing each table with the few words that close finds
+//  every candidate without comparing all pairs.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dirtyraw {
+
+struct ImageSignature {
+    static constexpr int kColorGrid = 4;
+
+    uint64_t hash = 0;
+    /// Mean red-green and yellow-blue opponent chroma of each cell of a 4x4 grid, offset so
+    /// neutral grey is 128.
+    uint8_t color[kColorGrid * kColorGrid * 2] = {};
+};
+
+/// Computes the signature of an image with 8-bit RGBA (or RGBX) pixels; `stride` is in bytes.
+/// Works from any size, but 64 to 256 pixels on the long side is plenty.
+ImageSignature computeSignature(const uint8_t* rgba, size_t stride, int width, int height);
+
+int hashDistance(const ImageSignature& a, const ImageSignature& b);
+/// Mean absolute chroma difference over the grid, 0...255.
+float colorDistance(const ImageSignature& a, const ImageSignature& b);
+
+/// Groups signatures whose hashes differ in at most `maxDistance` bits (clamped to 0...15) and
+/// whose colours are within `colorTolerance`, transitively, so a slowly drifting burst forms
+/// one group. Returns a group number per signature, numbered in order of first member; entries
+/// with `valid[i] == false` get a group of their own.
+std::vector<int> groupSignatures(const std::vector<ImageSignature>& signatures, const std::vector<bool>& valid,
+                                 int maxDistance, float colorTolerance);
+
+} // namespace dirtyraw
@@ -0,0 +1,352 @@
+//
+//  Stacking.cpp
+//  Dirty RAW
+//
+
+#include "Stacking.hpp"
+#include "ColorManagement.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace dirtyraw {
+
+namespace {
+
+/// Output tile processed per job. Tiles are walked a band of rows at a time, so each frame's
+/// spill file is read front to back.
+constexpr int kTileWidth = 256;
+constexpr int kTileHeight = 32;
+/// Pyramid levels stop before either side drops below this many pixels.
+constexpr int kMinimumLevelSize = 32;
+/// Side of the central patch matched at full resolution.
+constexpr int kRefinePatchSize = 512;
+/// Scale from the median absolute deviation to the standard deviation of a normal distribution.
+constexpr float kMADToSigma = 1.4826f;
+
+struct Plane {
+    int width = 0;
+    int height = 0;
+    std::vector<float> values;
+};
+
+inline float rec709Luma(float r, float g, float b) {
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+Plane downsample(const Plane& plane) {
+    Plane half { plane.width / 2, plane.height / 2, {} };
+    half.values.resize(size_t(half.width) * half.height);
+    for (int y = 0; y < half.height; ++y) {
+        const float* top = plane.values.data() + size_t(y) * 2 * plane.width;
+        const float* bottom = top + plane.width;
+        float* out = half.values.data() + size_t(y) * half.width;
+        for (int x = 0; x < half.width; ++x) {
+            out[x] = 0.25f * (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1]);
+        }
+    }
+    return half;
+}
+
+/// Mean squared difference between `reference` and `frame` shifted by (dx, dy) over their
+/// overlap; infinite when they overlap by less than a quarter of the reference.
+float shiftedDifference(const Plane& reference, const Plane& frame, int dx, int dy) {
+    int x0 = std::max(0, -dx), x1 = std::min(reference.width, frame.width - dx);
+    int y0 = std::max(0, -dy), y1 = std::min(reference.height, frame.height - dy);
+    if (x1 <= x0 || y1 <= y0) return std::numeric_limits<float>::infinity();
+    size_t overlap = size_t(x1 - x0) * size_t(y1 - y0);
+    if (overlap * 4 < size_t(reference.width) * reference.height) return std::numeric_limits<float>::infinity();
+
+    double sum = 0;
+    for (int y = y0; y < y1; ++y) {
+        const float* a = reference.values.data() + size_t(y) * reference.width;
+        const float* b = frame.values.data() + size_t(y + dy) * frame.width + dx;
+        float row = 0;
+        for (int x = x0; x < x1; ++x) {
+            float d = a[x] - b[x];
+            row += d * d;
+        }
+        sum += row;
+    }
+    return float(sum / double(overlap));
+}
+
+/// Best shift within `radius` of (centerX, centerY).
+Translation searchShift(const std::function<float(int, int)>& difference, int centerX, int centerY, int radius) {
+    int side = 2 * radius + 1;
+    std::vector<float> scores(size_t(side) * side);
+    parallelFor(0, side * side, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            scores[index] = difference(centerX + index % side - radius, centerY + index / side - radius);
+        }
+    });
+
+    // Ties go to the smallest shift, so a featureless frame stays put
+    int best = (side * side) / 2;
+    for (int index = 0; index < side * side; ++index) {
+        if (scores[index] < scores[best]) best = index;
+    }
+    return { centerX + best % side - radius, centerY + best / side - radius };
+}
+
+/// Replaces `values` by their rank (0...1), through a histogram of their range.
+void equalizeValues(std::vector<float>& values) {
+    if (values.empty()) return;
+    constexpr int kBins = 4096;
+    auto [low, high] = std::minmax_element(values.begin(), values.end());
+    float minimum = *low;
+    float range = *high - minimum;
+    if (!(range > 0)) return;
+
+    auto bin = [&](float value) { return std::min(int((value - minimum) / range * kBins), kBins - 1); };
+    std::vector<uint32_t> counts(kBins, 0);
+    for (float value : values) ++counts[bin(value)];
+    // Ranks at the middle of each bin, so ties (clipped highlights) all land on one value
+    std::vector<float> ranks(kBins);
+    uint64_t below = 0;
+    for (int index = 0; index < kBins; ++index) {
+        ranks[index] = float((below + counts[index] * 0.5) / double(values.size()));
+        below += counts[index];
+    }
+    for (float& value : values) value = ranks[bin(value)];
+}
+
+/// Median of `values[0..<count]`; reorders them.
+float median(float* values, int count) {
+    int middle = count / 2;
+    std::nth_element(values, values + middle, values + count);
+    float upper = values[middle];
+    if (count % 2) return upper;
+    return 0.5f * (upper + *std::max_element(values, values + middle));
+}
+
+} // namespace
+
+// MARK: - Spill files
+
+std::unique_ptr<SpillFile> SpillFile::create(const std::string& directory, size_t bytes) {
+    if (bytes == 0) return nullptr;
+
+    std::string path = directory + "/DirtyRAW-stack-XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) return nullptr;
+    unlink(path.c_str());
+
+    if (ftruncate(fd, off_t(bytes)) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return nullptr;
+
+    // Written and later read front to back, one band at a time
+    madvise(mapping, bytes, MADV_SEQUENTIAL);
+    return std::unique_ptr<SpillFile>(new SpillFile(static_cast<uint8_t*>(mapping), bytes));
+}
+
+SpillFile::~SpillFile() {
+    munmap(data_, size_);
+}
+
+void SpillFile::flush() const {
+    msync(data_, size_, MS_ASYNC);
+}
+
+// MARK: - Alignment
+
+AlignmentProxy::AlignmentProxy(int width, int height)
+    : sourceWidth_(width),
+      sourceHeight_(height),
+      width_(std::max(width / kFactor, 1)),
+      height_(std::max(height / kFactor, 1)),
+      luma_(size_t(width_) * height_, 0.0f) {}
+
+void AlignmentProxy::addRows(const uint16_t* rows, size_t stride, int firstRow, int rowCount) {
+    const std::vector<float>& half = halfToFloatTable();
+    constexpr float kWeight = 1.0f / (kFactor * kFactor);
+    int firstProxyRow = firstRow / kFactor;
+    int lastProxyRow = std::min((firstRow + rowCount - 1) / kFactor, height_ - 1);
+
+    // One proxy row per job, so no two jobs add into the same row
+    parallelFor(firstProxyRow, lastProxyRow + 1, [&](int begin, int end) {
+        for (int proxyRow = begin; proxyRow < end; ++proxyRow) {
+            int rowBegin = std::max(proxyRow * kFactor, firstRow);
+            int rowEnd = std::min({ (proxyRow + 1) * kFactor, firstRow + rowCount, sourceHeight_ });
+            float* out = luma_.data() + size_t(proxyRow) * width_;
+            for (int row = rowBegin; row < rowEnd; ++row) {
+                const uint16_t* in = rows + size_t(row - firstRow) * stride;
+                for (int x = 0; x < width_ * kFactor && x < sourceWidth_; ++x) {
+                    const uint16_t* pixel = in + size_t(x) * 4;
+                    float value = rec709Luma(half[pixel[0]], half[pixel[1]], half[pixel[2]]);
+                    out[x / kFactor] += std::sqrt(std::max(value, 0.0f)) * kWeight;
+                }
+            }
+        }
+    });
+}
+
+void AlignmentProxy::equalize() {
+    equalizeValues(luma_);
+}
+
+Translation estimateTranslation(const AlignmentProxy& reference, const AlignmentProxy& frame, int maxShift) {
+    std::vector<Plane> referenceLevels { { reference.width(), reference.height(), reference.luma() } };
+    std::vector<Plane> frameLevels { { frame.width(), frame.height(), frame.luma() } };
+    while (std::min(referenceLevels.back().width, referenceLevels.back().height) / 2 >= kMinimumLevelSize &&
+           std::min(frameLevels.back().width, frameLevels.back().height) / 2 >= kMinimumLevelSize) {
+        referenceLevels.push_back(downsample(referenceLevels.back()));
+        frameLevels.push_back(downsample(frameLevels.back()));
+    }
+
+    // Exhaustive search at the coarsest level, then +-2 pixels around the doubled estimate
+    int top = int(referenceLevels.size()) - 1;
+    int scale = AlignmentProxy::kFactor << top;
+    int radius = std::max((maxShift + scale - 1) / scale, 1);
+    Translation shift;
+    for (int level = top; level >= 0; --level) {
+        const Plane& a = referenceLevels[level];
+        const Plane& b = frameLevels[level];
+        shift = searchShift([&](int dx, int dy) { return shiftedDifference(a, b, dx, dy); },
+                            shift.dx, shift.dy, radius);
+        if (level > 0) {
+            shift = { shift.dx * 2, shift.dy * 2 };
+            radius = 2;
+        }
+    }
+    return { shift.dx * AlignmentProxy::kFactor, shift.dy * AlignmentProxy::kFactor };
+}
+
+Translation refineTranslation(const StackFrame& reference, const StackFrame& frame, Translation estimate, int radius,
+                              bool equalize) {
+    const std::vector<float>& half = halfToFloatTable();
+    auto lumaAt = [&](const StackFrame& source, int x, int y) {
+        const uint16_t* pixel = source.pixels + size_t(y) * source.stride + size_t(x) * 4;
+        return std::sqrt(std::max(rec709Luma(half[pixel[0]], half[pixel[1]], half[pixel[2]]), 0.0f));
+    };
+
+    // Central patch of the reference, and the frame around where it should land
+    int patchWidth = std::min(kRefinePatchSize, reference.width);
+    int patchHeight = std::min(kRefinePatchSize, reference.height);
+    Plane patch { patchWidth, patchHeight, std::vector<float>(size_t(patchWidth) * patchHeight) };
+    int patchX = (reference.width - patchWidth) / 2;
+    int patchY = (reference.height - patchHeight) / 2;
+    for (int y = 0; y < patchHeight; ++y) {
+        for (int x = 0; x < patchWidth; ++x) {
+            patch.values[size_t(y) * patchWidth + x] = lumaAt(reference, patchX + x, patchY + y);
+        }
+    }
+
+    int windowX = patchX + estimate.dx - radius;
+    int windowY = patchY + estimate.dy - radius;
+    int x0 = std::max(windowX, 0), x1 = std::min(windowX + patchWidth + 2 * radius, frame.width);
+    int y0 = std::max(windowY, 0), y1 = std::min(windowY + patchHeight + 2 * radius, frame.height);
+    if (x1 <= x0 || y1 <= y0) return estimate;
+    Plane window { x1 - x0, y1 - y0, std::vector<float>(size_t(x1 - x0) * (y1 - y0)) };
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            window.values[size_t(y - y0) * window.width + (x - x0)] = lumaAt(frame, x, y);
+        }
+    }
+
+    if (equalize) {
+        equalizeValues(patch.values);
+        equalizeValues(window.values);
+    }
+
+    // Shifts are relative to the window's origin; convert back to frame offsets
+    Translation best = searchShift([&](int dx, int dy) { return shiftedDifference(patch, window, dx, dy); },
+                                   patchX + estimate.dx - x0, patchY + estimate.dy - y0, radius);
+    return { best.dx + x0 - patchX, best.dy + y0 - patchY };
+}
+
+// MARK: - Combine
+
+void stackFrames(const std::vector<StackFrame>& frames, StackMode mode, float clipSigma,
+                 uint16_t* destination, size_t destinationStride,
+                 const std::function<void(double)>& progress) {
+    if (frames.empty()) return;
+    const StackFrame& reference = frames[0];
+    int width = reference.width;
+    int height = reference.height;
+    int frameCount = int(frames.size());
+    const std::vector<float>& half = halfToFloatTable();
+    const uint16_t one = halfFromFloat(1.0f);
+    int tileColumns = (width + kTileWidth - 1) / kTileWidth;
+
+    for (int bandY = 0; bandY < height; bandY += kTileHeight) {
+        if (currentJobContext().token.isCancelled()) return;
+        int bandHeight = std::min(kTileHeight, height - bandY);
+
+        parallelFor(0, tileColumns, [&](int begin, int end) {
+            // Samples of one output pixel: RGB per frame, plus scratch for the order statistics
+            std::vector<float> samples(size_t(frameCount) * 3);
+            std::vector<float> scratch(frameCount);
+            std::vector<float> lumas(frameCount);
+
+            for (int column = begin; column < end; ++column) {
+                int tileX = column * kTileWidth;
+                int tileWidth = std::min(kTileWidth, width - tileX);
+
+                for (int y = bandY; y < bandY + bandHeight; ++y) {
+                    uint16_t* out = destination + size_t(y) * destinationStride;
+                    for (int x = tileX; x < tileX + tileWidth; ++x) {
+                        int count = 0;
+                        for (const StackFrame& frame : frames) {
+                            int fx = x + frame.offset.dx;
+                            int fy = y + frame.offset.dy;
+                            if (fx < 0 || fy < 0 || fx >= frame.width || fy >= frame.height) continue;
+                            const uint16_t* pixel = frame.pixels + size_t(fy) * frame.stride + size_t(fx) * 4;
+                            for (int c = 0; c < 3; ++c) samples[size_t(count) * 3 + c] = half[pixel[c]];
+                            ++count;
+                        }
+
+                        float result[3] = { 0, 0, 0 };
+                        if (count > 0 && mode == StackMode::median) {
+                            for (int c = 0; c < 3; ++c) {
+                                for (int i = 0; i < count; ++i) scratch[i] = samples[size_t(i) * 3 + c];
+                                result[c] = median(scratch.data(), count);
+                            }
+                        } else if (count > 0) {
+                            // Frames are kept or rejected whole (by luma), so colours never mix
+                            // channels from different frames
+                            float center = 0, limit = std::numeric_limits<float>::infinity();
+                            if (mode == StackMode::sigmaClippedMean && count > 2) {
+                                for (int i = 0; i < count; ++i) {
+                                    lumas[i] = rec709Luma(samples[size_t(i) * 3], samples[size_t(i) * 3 + 1], samples[size_t(i) * 3 + 2]);
+                                    scratch[i] = lumas[i];
+                                }
+                                center = median(scratch.data(), count);
+                                for (int i = 0; i < count; ++i) scratch[i] = std::fabs(lumas[i] - center);
+                                float sigma = kMADToSigma * median(scratch.data(), count);
+                                limit = std::max(clipSigma * sigma, 1e-6f);
+                            }
+
+                            int kept = 0;
+                            for (int i = 0; i < count; ++i) {
+                                if (limit != std::numeric_limits<float>::infinity() && std::fabs(lumas[i] - center) > limit) continue;
+                                for (int c = 0; c < 3; ++c) result[c] += samples[size_t(i) * 3 + c];
+                                ++kept;
+                            }
+                            for (int c = 0; c < 3; ++c) result[c] /= float(std::max(kept, 1));
+                        }
+
+                        uint16_t* pixel = out + size_t(x) * 4;
+                        for (int c = 0; c < 3; ++c) pixel[c] = halfFromFloat(result[c]);
+                        pixel[3] = one;
+                    }
+                }
+            }
+        });
+
+        if (progress) progress(double(bandY + bandHeight) / double(height));
+    }
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,126 @@
+//
+//  Stacking.hpp
+//  Dirty RAW
+//
+//  Multi-frame stacking for bursts: averaging to reduce noise, or rejecting outliers to remove
+//  things that move between frames (people walking through an architecture shot). Frames are
+//  developed one at a time into spill files on disk and read back through memory maps, and the
+//  combine walks the output in tiles, so the resident set is a few tiles of every frame rather
+//  than every frame. A 30-frame 45 MP stack needs about 11 GB of scratch disk and well under
+//  1 GB of memory beyond the output frame.
+//
+//  Frames are half-float RGBA in the renderer's linear working space (as `decodeToImage`
+//  produces them) and are aligned by a whole-pixel translation, which handwheld bursts mostly
+//  need and which keeps every output pixel an unresampled source pixel.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dirtyraw {
+
+enum class StackMode : int {
+    mean = 0,
+    /// Per-channel median; removes anything present in fewer than half the frames.
+    median = 1,
+    /// Mean of the frames whose luma is within `clipSigma` robust standard deviations of the
+    /// median (sigma from the median absolute deviation): nearly the noise reduction of the
+    /// mean, with the outlier rejection of the median.
+    sigmaClippedMean = 2,
+};
+
+/// Scratch file holding one developed frame, mapped for reading and writing. The file is
+/// unlinked as soon as it is mapped, so it disappears with the mapping even after a crash.
+class SpillFile {
+public:
+    /// Creates a `bytes`-long file in `directory`; null if the file or mapping can't be made.
+    static std::unique_ptr<SpillFile> create(const std::string& directory, size_t bytes);
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    /// Starts writing back everything written so far, so those pages can be reclaimed instead
+    /// of accumulating as dirty memory.
+    void flush() const;
+
+private:
+    SpillFile(uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint8_t* data_;
+    size_t size_;
+};
+
+/// Whole-pixel offset of a frame: frame pixel (x + dx, y + dy) shows reference pixel (x, y).
+struct Translation {
+    int dx = 0;
+    int dy = 0;
+};
+
+/// Quarter-resolution luma of a frame (square-rooted, so shadows carry weight), accumulated
+/// band by band while the frame is developed.
+class AlignmentProxy {
+public:
+    static constexpr int kFactor = 4;
+
+    AlignmentProxy(int width, int height);
+
+    /// Adds full-resolution rows [firstRow, firstRow + rowCount) of half-float RGBA;
+    /// `stride` is in elements.
+    void addRows(const uint16_t* rows, size_t stride, int firstRow, int rowCount);
+
+    /// Replaces each value by its rank (0...1) within the frame. Ranks survive any brightness
+    /// mapping that keeps the order of values, so frames of an exposure bracket can be compared.
+    void equalize();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::vector<float>& luma() const { return luma_; }
+
+private:
+    int sourceWidth_;
+    int sourceHeight_;
+    int width_;
+    int height_;
+    std::vector<float> luma_;
+};
+
+/// Translation of `frame` relative to `reference`, searched coarse to fine on a pyramid built
+/// from the proxies up to `maxShift` full-resolution pixels. Accurate to a few pixels; finish
+/// with `refineTranslation`.
+Translation estimateTranslation(const AlignmentProxy& reference, const AlignmentProxy& frame, int maxShift);
+
+/// A developed frame: half-float RGBA rows (`stride` in elements) and its offset to the reference.
+struct StackFrame {
+    const uint16_t* pixels = nullptr;
+    size_t stride = 0;
+    int width = 0;
+    int height = 0;
+    Translation offset;
+};
+
+/// Refines `estimate` to the exact pixel by matching a central patch of the full-resolution
+/// frames within `radius` pixels. With `equalize`, the patches are compared by rank as in
+/// `AlignmentProxy::equalize`.
+Translation refineTranslation(const StackFrame& reference, const StackFrame& frame, Translation estimate, int radius,
+                              bool equalize = false);
+
+/// Combines `frames` (each with its offset; the first frame's geometry is the output's) into
+/// half-float RGBA `destination`. A frame takes no part in pixels its offset moves outside it.
+/// Tiles run in parallel on the job system; `progress` receives the finished fraction after
+/// each band of tiles, on the calling thread. Cancelling the current job context stops it with
+/// the output incomplete.
+void stackFrames(const std::vector<StackFrame>& frames, StackMode mode, float clipSigma,
+                 uint16_t* destination, size_t destinationStride,
+                 const std::function<void(double)>& progress);
+
+} // namespace dirtyraw
@@ -0,0 +1,195 @@
+//
+//  TIFFEncoder.cpp
+//  Dirty RAW
+//
+//  Little-endian baseline RGB TIFF. Strips are written as they are encoded and the IFD goes
+//  at the end of the file, with the header's IFD offset patched last. Deflate strips use
+//  horizontal differencing (predictor 2), which is what makes Deflate worthwhile on photos.
+//
+
+#include "ImageEncoder.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <zlib.h>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kChunkRows = 512;
+constexpr int kRowsPerStrip = 32;
+constexpr int kCompressionLevel = 6;
+
+enum : uint16_t {
+    kShort = 3,
+    kLong = 4,
+    kRational = 5,
+    kUndefined = 7,
+};
+
+void put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(uint8_t(value));
+    out.push_back(uint8_t(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    put16(out, uint16_t(value));
+    put16(out, uint16_t(value >> 16));
+}
+
+class TIFFEncoder final : public ImageEncoder {
+public:
+    TIFFEncoder(FileWriter& writer, const EncoderSettings& settings)
+        : ImageEncoder(writer, settings, kChunkRows) {}
+
+protected:
+    bool writeHeader() override {
+        // The IFD offset is patched in `writeTrailer`
+        static const uint8_t header[8] = { 'I', 'I', 42, 0, 0, 0, 0, 0 };
+        return writer_.write(header, 8);
+    }
+
+    bool encodeChunk(const uint8_t* rows, int /*firstRow*/, int rowCount) override {
+        size_t length = rowBytes();
+        int strips = (rowCount + kRowsPerStrip - 1) / kRowsPerStrip;
+        std::vector<std::vector<uint8_t>> encoded(strips);
+        std::vector<uint8_t> ok(strips, 1);
+
+        parallelFor(0, strips, [&](int begin, int end) {
+            std::vector<uint8_t> differenced;
+            for (int strip = begin; strip < end; ++strip) {
+                int stripRows = std::min(kRowsPerStrip, rowCount - strip * kRowsPerStrip);
+                const uint8_t* input = rows + length * strip * kRowsPerStrip;
+                size_t bytes = length * stripRows;
+                if (!settings_.tiffDeflate) {
+                    encoded[strip].assign(input, input + bytes);
+                    continue;
+                }
+
+                differenced.assign(input, input + bytes);
+                for (int row = 0; row < stripRows; ++row) {
+                    predict(differenced.data() + length * row);
+                }
+                uLongf compressedSize = compressBound(uLong(bytes));
+                encoded[strip].resize(compressedSize);
+                ok[strip] = compress2(encoded[strip].data(), &compressedSize, differenced.data(), uLong(bytes),
+                                      kCompressionLevel) == Z_OK;
+                encoded[strip].resize(compressedSize);
+            }
+        });
+
+        for (int strip = 0; strip < strips; ++strip) {
+            if (!ok[strip]) return false;
+            stripOffsets_.push_back(uint32_t(writer_.position()));
+            stripByteCounts_.push_back(uint32_t(encoded[strip].size()));
+            writer_.write(encoded[strip]);
+        }
+        // Offsets are 32-bit in classic TIFF
+        return writer_.ok() && writer_.position() < (uint64_t(1) << 32) - (1 << 20);
+    }
+
+    bool writeTrailer() override {
+        // Out-of-line values first, then the IFD, both word aligned. Deflate strips have any
+        // length, so the trailer may start on an odd offset
+        if (writer_.position() % 2) {
+            static const uint8_t pad = 0;
+            writer_.write(&pad, 1);
+        }
+        std::vector<uint8_t> data;
+        uint32_t base = uint32_t(writer_.position());
+        auto offsetOf = [&] { return base + uint32_t(data.size()); };
+
+        uint32_t bitsOffset = offsetOf();
+        for (int i = 0; i < 3; ++i) put16(data, uint16_t(settings_.bitsPerSample));
+        uint32_t resolutionOffset = offsetOf();
+        put32(data, 72);
+        put32(data, 1);
+        uint32_t offsetsOffset = offsetOf();
+        for (uint32_t offset : stripOffsets_) put32(data, offset);
+        uint32_t countsOffset = offsetOf();
+        for (uint32_t count : stripByteCounts_) put32(data, count);
+        uint32_t iccOffset = offsetOf();
+        data.insert(data.end(), settings_.iccProfile.begin(), settings_.iccProfile.end());
+        if (data.size() % 2) data.push_back(0);
+        uint32_t ifdOffset = offsetOf();
+
+        struct Entry {
+            uint16_t tag;
+            uint16_t type;
+            uint32_t count;
+            uint32_t value;
+        };
+        uint32_t stripCount = uint32_t(stripOffsets_.size());
+        std::vector<Entry> entries = {
+            { 256, kLong, 1, uint32_t(settings_.width) },
+            { 257, kLong, 1, uint32_t(settings_.height) },
+            { 258, kShort, 3, bitsOffset },
+            { 259, kShort, 1, settings_.tiffDeflate ? 8u : 1u },
+            { 262, kShort, 1, 2 },
+            { 273, kLong, stripCount, stripCount == 1 ? stripOffsets_[0] : offsetsOffset },
+            { 277, kShort, 1, 3 },
+            { 278, kLong, 1, kRowsPerStrip },
+            { 279, kLong, stripCount, stripCount == 1 ? stripByteCounts_[0] : countsOffset },
+            { 282, kRational, 1, resolutionOffset },
+            { 283, kRational, 1, resolutionOffset },
+            { 284, kShort, 1, 1 },
+            { 296, kShort, 1, 2 },
+        };
+        if (settings_.tiffDeflate) entries.push_back({ 317, kShort, 1, 2 });
+        if (!settings_.iccProfile.empty()) {
+            entries.push_back({ 34675, kUndefined, uint32_t(settings_.iccProfile.size()), iccOffset });
+        }
+
+        put16(data, uint16_t(entries.size()));
+        for (const Entry& entry : entries) {
+            put16(data, entry.tag);
+            put16(data, entry.type);
+            put32(data, entry.count);
+            // Inline SHORTs are left-justified in the value field
+            if (entry.type == kShort && entry.count == 1) {
+                put16(data, uint16_t(entry.value));
+                put16(data, 0);
+            } else {
+                put32(data, entry.value);
+            }
+        }
+        put32(data, 0);
+
+        writer_.write(data);
+        uint8_t offset[4] = { uint8_t(ifdOffset), uint8_t(ifdOffset >> 8), uint8_t(ifdOffset >> 16), uint8_t(ifdOffset >> 24) };
+        return writer_.writeAt(4, offset, 4);
+    }
+
+private:
+    /// Horizontal differencing of one row in place, per sample, right to left.
+    void predict(uint8_t* row) const {
+        int samples = settings_.width * 3;
+        if (bytesPerSample() == 1) {
+            for (int i = samples - 1; i >= 3; --i) row[i] = uint8_t(row[i] - row[i - 3]);
+            return;
+        }
+        // 16-bit samples are in host order, which is little-endian on every Mac
+        static_assert(std::endian::native == std::endian::little, "TIFF samples are written in host order");
+        uint16_t* values = reinterpret_cast<uint16_t*>(row);
+        for (int i = samples - 1; i >= 3; --i) values[i] = uint16_t(values[i] - values[i - 3]);
+    }
+
+    std::vector<uint32_t> stripOffsets_;
+    std::vector<uint32_t> stripByteCounts_;
+};
+
+} // namespace
+
+std::unique_ptr<ImageEncoder> makeTIFFEncoder(FileWriter& writer, const EncoderSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0) return nullptr;
+    if (settings.bitsPerSample != 8 && settings.bitsPerSample != 16) return nullptr;
+    // Uncompressed data must fit under the 32-bit offsets; Deflate never grows much past it
+    uint64_t rawBytes = uint64_t(settings.width) * settings.height * 3 * (settings.bitsPerSample / 8);
+    if (rawBytes > (uint64_t(1) << 32) - (64 << 20)) return nullptr;
+    return std::make_unique<TIFFEncoder>(writer, settings);
+}
+
+} // namespace dirtyraw
@@ -0,0 +1,234 @@
+//
+//  Upscale.cpp
+//  Dirty RAW
+//
+
+#include "Upscale.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace dirtyraw {
+
+namespace {
+
+constexpr int kLobes = 3;
+constexpr double kPi = 3.14159265358979323846;
+
+/// Rows per job in each pass.
+constexpr int kRowBlock = 8;
+
+/// Diagonal edges weaker than this (in 0...1 luma) are left to Lanczos.
+constexpr float kEdgeThreshold = 0.04f;
+/// How much more one diagonal must vary than the other before the edge counts as directional.
+constexpr float kAnisotropyThreshold = 0.3f;
+
+double lanczos(double x) {
+    if (x == 0) return 1;
+    if (std::abs(x) >= kLobes) return 0;
+    double px = kPi * x;
+    return kLobes * std::sin(px) * std::sin(px / kLobes) / (px * px);
+}
+
+/// Output pixel centres mapped onto the source grid (pixel centres at integer + 0.5).
+double sourceCoordinate(int output, double factor) {
+    return (output + 0.5) / factor - 0.5;
+}
+
+/// One RGBA pixel in a 128-bit register (NEON on Apple silicon, SSE on Intel).
+typedef float Float4 __attribute__((vector_size(16)));
+typedef uint16_t UShort4 __attribute__((vector_size(8)));
+
+inline Float4 loadPixel(const uint16_t* pixel) {
+    return Float4{ float(pixel[0]), float(pixel[1]), float(pixel[2]), float(pixel[3]) };
+}
+
+inline Float4 load(const float* values) {
+    Float4 v;
+    std::memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+inline Float4 lanesMin(Float4 a, Float4 b) {
+    return a < b ? a : b;
+}
+
+inline Float4 lanesMax(Float4 a, Float4 b) {
+    return a > b ? a : b;
+}
+
+inline float luma(Float4 pixel) {
+    return 0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2];
+}
+
+} // namespace
+
+Upscaler::Upscaler(const uint16_t* source, size_t sourceStride, int sourceWidth, int sourceHeight, double factor)
+    : source_(source),
+      sourceStride_(sourceStride),
+      sourceWidth_(sourceWidth),
+      sourceHeight_(sourceHeight),
+      outputWidth_(std::max(1, int(std::lround(sourceWidth * factor)))),
+      outputHeight_(std::max(1, int(std::lround(sourceHeight * factor)))) {
+    // Use the exact per-axis ratio so the last output pixel lands on the last source pixel
+    double factorX = double(outputWidth_) / sourceWidth;
+    double factorY = double(outputHeight_) / sourceHeight;
+    columnTaps_ = makeTaps(outputWidth_, sourceWidth, factorX);
+    rowTaps_ = makeTaps(outputHeight_, sourceHeight, factorY);
+    columnCells_ = makeCells(outputWidth_, sourceWidth, factorX);
+    rowCells_ = makeCells(outputHeight_, sourceHeight, factorY);
+}
+
+std::vector<Upscaler::Taps> Upscaler::makeTaps(int outputSize, int sourceSize, double factor) {
+    std::vector<Taps> taps(outputSize);
+    for (int i = 0; i < outputSize; ++i) {
+        double center = sourceCoordinate(i, factor);
+        int start = int(std::floor(center)) - kLobes + 1;
+
+        Taps& tap = taps[i];
+        tap.first = std::clamp(start, 0, sourceSize - 1);
+        int last = std::clamp(start + 2 * kLobes - 1, 0, sourceSize - 1);
+        tap.count = last - tap.first + 1;
+
+        // Taps past the edge fold onto the edge pixel (clamp-to-edge)
+        double sum = 0;
+        double weights[8] = {};
+        for (int k = 0; k < 2 * kLobes; ++k) {
+            int index = std::clamp(start + k, 0, sourceSize - 1);
+            double weight = lanczos(center - (start + k));
+            weights[index - tap.first] += weight;
+            sum += weight;
+        }
+        for (int k = 0; k < tap.count; ++k) {
+            tap.weights[k] = float(weights[k] / sum);
+        }
+    }
+    return taps;
+}
+
+std::vector<Upscaler::Cell> Upscaler::makeCells(int outputSize, int sourceSize, double factor) {
+    std::vector<Cell> cells(outputSize);
+    for (int i = 0; i < outputSize; ++i) {
+        double coordinate = std::clamp(sourceCoordinate(i, factor), 0.0, double(sourceSize - 1));
+        int index = std::min(int(coordinate), std::max(0, sourceSize - 2));
+        cells[i] = { index, float(coordinate - index) };
+    }
+    return cells;
+}
+
+void Upscaler::renderRows(int firstRow, int rowCount, uint16_t* destination, size_t destinationStride) const {
+    firstRow = std::clamp(firstRow, 0, outputHeight_);
+    rowCount = std::clamp(rowCount, 0, outputHeight_ - firstRow);
+    if (rowCount == 0) return;
+
+    // Source rows touched by the Lanczos taps and the refinement quads of this band
+    int sourceBegin = sourceHeight_;
+    int sourceEnd = 0;
+    for (int row = firstRow; row < firstRow + rowCount; ++row) {
+        const Taps& tap = rowTaps_[row];
+        sourceBegin = std::min({ sourceBegin, tap.first, rowCells_[row].index });
+        sourceEnd = std::max({ sourceEnd, tap.first + tap.count, std::min(rowCells_[row].index + 2, sourceHeight_) });
+    }
+
+    constexpr float kScale = 1.0f / 65535.0f;
+    size_t outputRowFloats = size_t(outputWidth_) * 4;
+
+    // Both passes run as one job graph in blocks of rows. Each block of output rows waits only
+    // for the horizontal blocks its vertical taps reach, so the passes overlap instead of
+    // meeting at a barrier.
+    JobGraph graph;
+
+    // Horizontal pass: every source row of the band resampled to the output width
+    std::vector<float> horizontal(size_t(sourceEnd - sourceBegin) * outputRowFloats);
+    BlockJobs horizontalBlocks = addBlockJobs(graph, sourceBegin, sourceEnd, kRowBlock, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint16_t* in = source_ + size_t(y) * sourceStride_;
+            float* out = horizontal.data() + size_t(y - sourceBegin) * outputRowFloats;
+            for (int x = 0; x < outputWidth_; ++x) {
+                const Taps& tap = columnTaps_[x];
+                const uint16_t* pixel = in + size_t(tap.first) * 4;
+                Float4 sum = {};
+                for (int k = 0; k < tap.count; ++k) {
+                    sum += tap.weights[k] * kScale * loadPixel(pixel + k * 4);
+                }
+                std::memcpy(out + size_t(x) * 4, &sum, sizeof(sum));
+            }
+        }
+    });
+
+    // Vertical pass and refinement, one output row at a time
+    BlockJobs verticalBlocks = addBlockJobs(graph, firstRow, firstRow + rowCount, kRowBlock, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            const Taps& rowTap = rowTaps_[row];
+            const Cell& rowCell = rowCells_[row];
+            int belowIndex = std::min(rowCell.index + 1, sourceHeight_ - 1);
+            const uint16_t* top = source_ + size_t(rowCell.index) * sourceStride_;
+            const uint16_t* bottom = source_ + size_t(belowIndex) * sourceStride_;
+            uint16_t* out = destination + size_t(row - firstRow) * destinationStride;
+
+            for (int x = 0; x < outputWidth_; ++x) {
+                Float4 value = {};
+                for (int k = 0; k < rowTap.count; ++k) {
+                    const float* in = horizontal.data()
+                        + size_t(rowTap.first + k - sourceBegin) * outputRowFloats + size_t(x) * 4;
+                    value += rowTap.weights[k] * load(in);
+                }
+
+                // Source quad around the output pixel
+                const Cell& columnCell = columnCells_[x];
+                int rightIndex = std::min(columnCell.index + 1, sourceWidth_ - 1);
+                Float4 p00 = loadPixel(top + size_t(columnCell.index) * 4) * kScale;
+                Float4 p10 = loadPixel(top + size_t(rightIndex) * 4) * kScale;
+                Float4 p01 = loadPixel(bottom + size_t(columnCell.index) * 4) * kScale;
+                Float4 p11 = loadPixel(bottom + size_t(rightIndex) * 4) * kScale;
+
+                // Edge-directed refinement: when one diagonal is smooth and the other crosses an
+                // edge, blend towards interpolation along the smooth diagonal.
+                float mainDiagonal = std::abs(luma(p00) - luma(p11));
+                float antiDiagonal = std::abs(luma(p10) - luma(p01));
+                float contrast = std::max(mainDiagonal, antiDiagonal);
+                float anisotropy = std::abs(mainDiagonal - antiDiagonal) / (mainDiagonal + antiDiagonal + 1e-6f);
+                float blend = std::clamp((anisotropy - kAnisotropyThreshold) / (1 - kAnisotropyThreshold), 0.0f, 1.0f)
+                    * std::clamp(contrast / kEdgeThreshold, 0.0f, 1.0f);
+
+                if (blend > 0) {
+                    float fx = columnCell.fraction;
+                    float fy = rowCell.fraction;
+                    Float4 directional;
+                    if (mainDiagonal < antiDiagonal) {
+                        float t = (fx + fy) * 0.5f;
+                        directional = p00 + (p11 - p00) * t;
+                    } else {
+                        float t = (fx + 1 - fy) * 0.5f;
+                        directional = p01 + (p10 - p01) * t;
+                    }
+                    value += (directional - value) * blend;
+                }
+
+                // Anti-ringing: stay within the range of the surrounding source pixels
+                Float4 low = lanesMin(lanesMin(p00, p10), lanesMin(p01, p11));
+                Float4 high = lanesMax(lanesMax(p00, p10), lanesMax(p01, p11));
+                Float4 clamped = lanesMin(lanesMax(value, low), high);
+                UShort4 quantized = __builtin_convertvector(clamped * 65535.0f + 0.5f, UShort4);
+                std::memcpy(out + size_t(x) * 4, &quantized, sizeof(quantized));
+            }
+        }
+    });
+
+    for (size_t block = 0; block < verticalBlocks.jobs.size(); ++block) {
+        int begin = firstRow + int(block) * kRowBlock;
+        int end = std::min(begin + kRowBlock, firstRow + rowCount);
+        int tapsBegin = rowTaps_[begin].first;
+        int tapsEnd = tapsBegin;
+        for (int row = begin; row < end; ++row) {
+            tapsBegin = std::min(tapsBegin, rowTaps_[row].first);
+            tapsEnd = std::max(tapsEnd, rowTaps_[row].first + rowTaps_[row].count);
+        }
+        horizontalBlocks.precede(graph, verticalBlocks.jobs[block], tapsBegin, tapsEnd);
+    }
+    JobSystem::shared().run(graph);
+}
+
+} // namespace dirtyraw
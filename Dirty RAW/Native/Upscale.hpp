@@ -0,0 +1,62 @@
+//
+//  Upscale.hpp
+//  Dirty RAW
+//
+//  CPU upscaler: separable Lanczos-3 followed by an edge-directed refinement that interpolates
+//  along strong diagonal edges (where Lanczos stair-steps) and clamps to the local source range
+//  (where it rings). Output is produced in bands of rows on demand, so callers can stream an
+//  arbitrarily large result to disk while holding only the source and one band in memory.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dirtyraw {
+
+class Upscaler {
+public:
+    /// `source` is premultiplied RGBA with 16-bit channels; `sourceStride` is in elements.
+    /// The caller keeps `source` alive for the upscaler's lifetime.
+    Upscaler(const uint16_t* source, size_t sourceStride, int sourceWidth, int sourceHeight, double factor);
+
+    int outputWidth() const { return outputWidth_; }
+    int outputHeight() const { return outputHeight_; }
+
+    /// Renders output rows [firstRow, firstRow + rowCount) into `destination` (RGBA16,
+    /// `destinationStride` in elements). Rows are split across threads.
+    void renderRows(int firstRow, int rowCount, uint16_t* destination, size_t destinationStride) const;
+
+private:
+    /// Lanczos-3 taps for one output coordinate: `count` weights starting at source `first`.
+    struct Taps {
+        int first = 0;
+        int count = 0;
+        float weights[8] = {};
+    };
+
+    /// Position of an output coordinate in the source grid, split into cell and fraction.
+    struct Cell {
+        int index = 0;
+        float fraction = 0;
+    };
+
+    static std::vector<Taps> makeTaps(int outputSize, int sourceSize, double factor);
+    static std::vector<Cell> makeCells(int outputSize, int sourceSize, double factor);
+
+    const uint16_t* source_;
+    size_t sourceStride_;
+    int sourceWidth_;
+    int sourceHeight_;
+    int outputWidth_;
+    int outputHeight_;
+
+    std::vector<Taps> columnTaps_;
+    std::vector<Taps> rowTaps_;
+    std::vector<Cell> columnCells_;
+    std::vector<Cell> rowCells_;
+};
+
+} // namespace dirtyraw
@@ -8,6 +8,14 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// Encoded RGB spaces the SDK can develop into and exports can target.
+typedef NS_ENUM(NSInteger, NKOutputColorSpace) {
+    NKOutputColorSpaceSRGB NS_SWIFT_NAME(sRGB) = 0,
+    NKOutputColorSpaceDisplayP3 NS_SWIFT_NAME(displayP3) = 1,
+    NKOutputColorSpaceAdobeRGB NS_SWIFT_NAME(adobeRGB) = 2,
+    NKOutputColorSpaceProPhoto NS_SWIFT_NAME(proPhoto) = 3,
+};
+
 @interface NKImageInfo : NSObject
 @property (nonatomic) NSUInteger width;
 @property (nonatomic) NSUInteger height;
@@ -56,17 +64,49 @@ NS_ASSUME_NONNULL_BEGIN
 + (BOOL)initializeLibrary;
 + (void)closeLibrary;
 
+/// Working memory the library was opened with (a quarter of installed RAM); beyond it the SDK
+/// pages to its VM file in the temporary directory. 0 before `initializeLibrary`.
+@property (class, nonatomic, readonly) uint64_t virtualMemoryBytes;
+
 - (nullable instancetype)initWithFilePath:(NSString *)filePath;
 - (void)closeSession;
 
+/// Memory ledger owner (see MemoryLedger.h) the session and its decode buffers are attributed
+/// to; 0 reports them unowned.
+@property (nonatomic) uint64_t memoryOwner;
+
 - (NSUInteger)getFileFormat;
 - (nullable NKImageInfo *)getImageInfo;
 - (nullable NKImageInfo *)getOriginalInfo;
 - (nullable NSData *)getImageDataWithInfo:(NKImageInfo *)info;
+/// Develops only `rows` of the image (full width), so callers can stream a frame in bands.
+- (nullable NSData *)getImageDataWithInfo:(NKImageInfo *)info rows:(NSRange)rows;
 - (nullable NKEXIFData *)getEXIFData;
 - (nullable NKTagData *)getTagData:(NSUInteger)tagID;
+
+/// Space the SDK develops into; sRGB unless changed with `useOutputColorSpace:`.
+@property (nonatomic, readonly) NKOutputColorSpace outputColorSpace;
+
+/// Asks the SDK to develop into `space` (kNkfl_Cmd_SetOutputProfile), so a wide-gamut export
+/// keeps colours the SDK would otherwise clip to sRGB. Call before `decodeToImage`.
+- (BOOL)useOutputColorSpace:(NKOutputColorSpace)space;
+
+/// Develops the image and converts it once into the renderer's working space: linear sRGB
+/// primaries, extended range, 16-bit float. Core Image then reads it without colour matching.
 - (nullable NSImage *)decodeToImage;
 
+/// Develops `rows` of the image described by `info` (from `getImageInfo`) into the same working
+/// space as `decodeToImage`, as half-float RGBA written to `destination` (`stride` in elements).
+- (BOOL)decodeRows:(NSRange)rows
+          ofImage:(NKImageInfo *)info
+         intoRGBA:(uint16_t *)destination
+        rowStride:(NSUInteger)stride NS_SWIFT_UNAVAILABLE("Use decodeToImage");
+
+/// Quick develop without an SDK session: decodes the raw data natively (uncompressed, lossless or
+/// lossy compressed NEF) and develops it at half size with a generic camera matrix. Meant to be
+/// shown while `decodeToImage` runs; the image size is set to the full-resolution dimensions.
++ (nullable NSImage *)quickDevelopImageWithFilePath:(NSString *)filePath;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -13,9 +13,18 @@ extern "C" {
 }
 
 #include "Nkfl_Interface.h"
+#include "Native/NEFParser.hpp"
+#include "Native/NEFDecoder.hpp"
+#include "Native/ColorManagement.hpp"
+#include "Native/MemoryLedger.hpp"
+
+#include <algorithm>
+
+#include <vector>
 
 static NkflPtr s_pNkflPtr = NULL;
 static Nkfl_EntryProcPtr s_entryFunc = NULL;
+static uint64_t s_virtualMemoryBytes = 0;
 
 @implementation NKImageInfo
 @end
@@ -29,9 +38,70 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
 @interface NikonSDKWrapper ()
 {
     unsigned long _sessionID;
+    /// Footprint growth of opening the session, reported as `sdkSessions`.
+    int64_t _sessionBytes;
 }
 @end
 
+static CFStringRef NKColorSpaceName(NKOutputColorSpace space) {
+    switch (space) {
+        case NKOutputColorSpaceDisplayP3: return kCGColorSpaceDisplayP3;
+        case NKOutputColorSpaceAdobeRGB: return kCGColorSpaceAdobeRGB1998;
+        case NKOutputColorSpaceProPhoto: return kCGColorSpaceROMMRGB;
+        case NKOutputColorSpaceSRGB: break;
+    }
+    return kCGColorSpaceSRGB;
+}
+
+/// The SDK takes output profiles as ICC file paths; the system's profile data is written to the
+/// temporary directory once per space.
+static NSString * _Nullable NKProfilePath(NKOutputColorSpace space) {
+    static NSMutableDictionary<NSNumber *, NSString *> *paths;
+    static NSLock *lock;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        paths = [NSMutableDictionary dictionary];
+        lock = [[NSLock alloc] init];
+    });
+
+    [lock lock];
+    NSString *path = paths[@(space)];
+    if (!path) {
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(NKColorSpaceName(space));
+        CFDataRef icc = colorSpace ? CGColorSpaceCopyICCData(colorSpace) : NULL;
+        NSString *candidate = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                               [NSString stringWithFormat:@"DirtyRAW_Output_%ld.icc", (long)space]];
+        if (icc && [(__bridge NSData *)icc writeToFile:candidate atomically:YES]) {
+            path = candidate;
+            paths[@(space)] = path;
+        }
+        if (icc) CFRelease(icc);
+        CGColorSpaceRelease(colorSpace);
+    }
+    [lock unlock];
+    return path;
+}
+
+/// Converts `rowCount` rows of SDK output (RGB, `byteDepth` bytes per sample, encoded in `space`)
+/// into the renderer's working space as half-float RGBA; `stride` is in elements.
+static void NKLinearizeRows(NSData *imageData, NSUInteger byteDepth, NKOutputColorSpace space,
+                            uint16_t *destination, NSUInteger stride, NSUInteger width, NSUInteger rowCount) {
+    // The transfer tables are indexed by 16-bit code values; widen 8-bit output first
+    const uint16_t *encoded = static_cast<const uint16_t *>(imageData.bytes);
+    std::vector<uint16_t> widened;
+    if (byteDepth != 2) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(imageData.bytes);
+        widened.resize(width * rowCount * 3);
+        for (size_t index = 0; index < widened.size(); ++index) {
+            widened[index] = uint16_t(bytes[index] * 257);
+        }
+        encoded = widened.data();
+    }
+
+    dirtyraw::linearizeRGB16(encoded, width * 3, dirtyraw::RGBSpace(space),
+                             destination, stride, int(width), int(rowCount));
+}
+
 @implementation NikonSDKWrapper
 
 + (BOOL)initializeLibrary {
@@ -72,6 +142,7 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
         return NO;
     }
 
+    s_virtualMemoryBytes = installedRAM * 1024 * 1024;
     return YES;
 }
 
@@ -81,6 +152,11 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
         s_pNkflPtr = NULL;
     }
     s_entryFunc = NULL;
+    s_virtualMemoryBytes = 0;
+}
+
++ (uint64_t)virtualMemoryBytes {
+    return s_virtualMemoryBytes;
 }
 
 - (nullable instancetype)initWithFilePath:(NSString *)filePath {
@@ -98,6 +174,9 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
         sessionParam.pFileInfo = (void *)[filePath UTF8String];
         sessionParam.bImageLoadSkip = false;
 
+        // The SDK allocates internally; what opening costs shows up as footprint growth only.
+        // Sessions opened concurrently can blur each other's share, which evens out in the sum.
+        int64_t footprint = dirtyraw::processFootprint();
         unsigned long result = s_entryFunc(kNkfl_Cmd_OpenSession, &sessionParam);
         if (result != kNkfl_Code_None) {
             NSLog(@"NikonSDK: Failed to open session: %lu for file: %@", result, filePath);
@@ -105,6 +184,8 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
         }
 
         _sessionID = sessionParam.ulSessionID;
+        _sessionBytes = std::max<int64_t>(dirtyraw::processFootprint() - footprint, 0);
+        dirtyraw::MemoryLedger::shared().add(dirtyraw::MemoryCategory::sdkSessions, _sessionBytes);
     }
     return self;
 }
@@ -121,7 +202,41 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
 
         s_entryFunc(kNkfl_Cmd_CloseSession, &sessionParam);
         _sessionID = 0;
+
+        dirtyraw::MemoryLedger::shared().add(dirtyraw::MemoryCategory::sdkSessions, -_sessionBytes, _memoryOwner);
+        _sessionBytes = 0;
+    }
+}
+
+- (void)setMemoryOwner:(uint64_t)memoryOwner {
+    if (memoryOwner == _memoryOwner) return;
+    auto &ledger = dirtyraw::MemoryLedger::shared();
+    ledger.add(dirtyraw::MemoryCategory::sdkSessions, -_sessionBytes, _memoryOwner);
+    ledger.add(dirtyraw::MemoryCategory::sdkSessions, _sessionBytes, memoryOwner);
+    _memoryOwner = memoryOwner;
+}
+
+- (BOOL)useOutputColorSpace:(NKOutputColorSpace)space {
+    if (!_sessionID || !s_entryFunc) return NO;
+    if (space == _outputColorSpace) return YES;
+
+    NSString *profilePath = NKProfilePath(space);
+    if (!profilePath) return NO;
+
+    NkflOutputProfileParam param = {0};
+    param.ulSize = sizeof(NkflOutputProfileParam);
+    param.ulSessionID = _sessionID;
+    param.ulRenderingIntent = 0; // Perceptual
+    strncpy((char *)param.OutputProfile, profilePath.fileSystemRepresentation, MAX_PATH - 1);
+
+    unsigned long result = s_entryFunc(kNkfl_Cmd_SetOutputProfile, &param);
+    if (result != kNkfl_Code_None) {
+        NSLog(@"NikonSDK: Failed to set output profile: %lu", result);
+        return NO;
     }
+
+    _outputColorSpace = space;
+    return YES;
 }
 
 - (NSUInteger)getFileFormat {
@@ -186,10 +301,15 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
 }
 
 - (nullable NSData *)getImageDataWithInfo:(NKImageInfo *)info {
+    return [self getImageDataWithInfo:info rows:NSMakeRange(0, info.height)];
+}
+
+- (nullable NSData *)getImageDataWithInfo:(NKImageInfo *)info rows:(NSRange)rows {
     if (!_sessionID || !s_entryFunc || !info) return nil;
+    if (rows.length == 0 || NSMaxRange(rows) > info.height) return nil;
 
     NSUInteger planes = 3; // RGB
-    NSUInteger dataSize = info.width * info.height * info.byteDepth * planes;
+    NSUInteger dataSize = info.width * rows.length * info.byteDepth * planes;
 
     void *buffer = malloc(dataSize);
     if (!buffer) return nil;
@@ -197,9 +317,9 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
     NkflImageParam param = {0};
     param.ulSize = sizeof(NkflImageParam);
     param.ulSessionID = _sessionID;
-    param.rectArea.top = 0;
+    param.rectArea.top = (short)rows.location;
     param.rectArea.left = 0;
-    param.rectArea.bottom = (short)info.height;
+    param.rectArea.bottom = (short)NSMaxRange(rows);
     param.rectArea.right = (short)info.width;
     param.ulDataSize = (unsigned long)dataSize;
     param.pData = buffer;
@@ -210,7 +330,15 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
         return nil;
     }
 
-    return [NSData dataWithBytesNoCopy:buffer length:dataSize freeWhenDone:YES];
+    // Reported until the caller lets go of the data, typically right after converting it
+    uint64_t owner = _memoryOwner;
+    dirtyraw::MemoryLedger::shared().add(dirtyraw::MemoryCategory::decodeBuffers, int64_t(dataSize), owner);
+    return [[NSData alloc] initWithBytesNoCopy:buffer
+                                        length:dataSize
+                                   deallocator:^(void *bytes, NSUInteger length) {
+        free(bytes);
+        dirtyraw::MemoryLedger::shared().add(dirtyraw::MemoryCategory::decodeBuffers, -int64_t(length), owner);
+    }];
 }
 
 - (nullable NKTagData *)getTagData:(NSUInteger)tagID {
@@ -449,57 +577,110 @@ static Nkfl_EntryProcPtr s_entryFunc = NULL;
 
     NSUInteger width = info.width;
     NSUInteger height = info.height;
-    NSUInteger byteDepth = info.byteDepth;
-    
-    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
-    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)imageData);
-    
-    if (!provider) {
-        CGColorSpaceRelease(colorSpace);
+
+    // Hand the linear buffer to Core Graphics without copying it
+    auto *linear = new std::vector<uint16_t>(width * height * 4);
+    NKLinearizeRows(imageData, info.byteDepth, _outputColorSpace, linear->data(), width * 4, width, height);
+    NSData *pixels = [[NSData alloc] initWithBytesNoCopy:linear->data()
+                                                  length:linear->size() * sizeof(uint16_t)
+                                             deallocator:^(void *bytes, NSUInteger length) {
+        delete linear;
+    }];
+
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+    if (!provider) return nil;
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceExtendedLinearSRGB);
+    CGBitmapInfo bitmapInfo = (CGBitmapInfo)kCGImageAlphaNoneSkipLast
+        | kCGBitmapFloatComponents
+        | kCGBitmapByteOrder16Host;
+    CGImageRef cgImage = CGImageCreate(
+        width,
+        height,
+        16,                                          // bits per component (half float)
+        64,                                          // bits per pixel (RGBX)
+        width * 8,
+        colorSpace,
+        bitmapInfo,
+        provider,
+        NULL,
+        false,
+        kCGRenderingIntentDefault
+    );
+
+    CGDataProviderRelease(provider);
+    CGColorSpaceRelease(colorSpace);
+
+    if (!cgImage) return nil;
+
+    NSImage *image = [[NSImage alloc] initWithCGImage:cgImage size:NSMakeSize(width, height)];
+    CGImageRelease(cgImage);
+
+    return image;
+}
+
+- (BOOL)decodeRows:(NSRange)rows
+          ofImage:(NKImageInfo *)info
+         intoRGBA:(uint16_t *)destination
+        rowStride:(NSUInteger)stride {
+    NSData *imageData = [self getImageDataWithInfo:info rows:rows];
+    if (!imageData) return NO;
+
+    NKLinearizeRows(imageData, info.byteDepth, _outputColorSpace, destination, stride, info.width, rows.length);
+    return YES;
+}
+
++ (nullable NSImage *)quickDevelopImageWithFilePath:(NSString *)filePath {
+    auto file = dirtyraw::MappedFile::open(filePath.fileSystemRepresentation);
+    if (!file) return nil;
+
+    auto parsed = dirtyraw::parseNEF(file->bytes());
+    if (!parsed || !parsed->raw) return nil;
+
+    // The raw strip is read front to back
+    file->willNeed(parsed->raw->data);
+
+    auto raw = dirtyraw::decodeNikonRaw(*parsed->raw);
+    if (!raw) {
+        NSLog(@"NikonSDK: Quick develop not supported for: %@", filePath);
         return nil;
     }
-    
-    CGImageRef cgImage = NULL;
-    
-    if (byteDepth == 2) {
-        // 16-bit per channel
-        CGBitmapInfo bitmapInfo = (CGBitmapInfo)kCGImageAlphaNone | (CGBitmapInfo)kCGBitmapByteOrder16Host;
-        cgImage = CGImageCreate(
-            width,
-            height,
-            16,                                          // bits per component
-            48,                                          // bits per pixel (16 * 3)
-            width * 6,                                   // bytes per row (width * 2 bytes * 3 channels)
-            colorSpace,
-            bitmapInfo,
-            provider,
-            NULL,
-            false,
-            kCGRenderingIntentDefault
-        );
-    } else {
-        // 8-bit per channel
-        cgImage = CGImageCreate(
-            width,
-            height,
-            8,
-            24,
-            width * 3,
-            colorSpace,
-            (CGBitmapInfo)(kCGImageAlphaNone | kCGBitmapByteOrderDefault),
-            provider,
-            NULL,
-            false,
-            kCGRenderingIntentDefault
-        );
-    }
-    
+
+    uint32_t orientation = parsed->metadata.orientation;
+    dirtyraw::RGB8Image developed = dirtyraw::quickDevelop(*raw, *parsed->raw, orientation);
+    if (developed.pixels.empty()) return nil;
+
+    // Hand the buffer to Core Graphics without copying it
+    auto *buffer = new std::vector<uint8_t>(std::move(developed.pixels));
+    NSData *pixels = [[NSData alloc] initWithBytesNoCopy:buffer->data()
+                                                  length:buffer->size()
+                                             deallocator:^(void *bytes, NSUInteger length) {
+        delete buffer;
+    }];
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+    if (!provider) return nil;
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGImageRef cgImage = CGImageCreate(
+        developed.width,
+        developed.height,
+        8,
+        24,
+        developed.width * 3,
+        colorSpace,
+        (CGBitmapInfo)(kCGImageAlphaNone | kCGBitmapByteOrderDefault),
+        provider,
+        NULL,
+        false,
+        kCGRenderingIntentDefault
+    );
     CGDataProviderRelease(provider);
     CGColorSpaceRelease(colorSpace);
 
     if (!cgImage) return nil;
 
-    NSImage *image = [[NSImage alloc] initWithCGImage:cgImage size:NSMakeSize(width, height)];
+    // Half-size develop displayed at full-resolution dimensions
+    NSImage *image = [[NSImage alloc] initWithCGImage:cgImage size:NSMakeSize(developed.width * 2, developed.height * 2)];
     CGImageRelease(cgImage);
 
     return image;
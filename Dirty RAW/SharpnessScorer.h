@@ -0,0 +1,50 @@
+//
+//  SharpnessScorer.h
+//  Dirty RAW
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Which part of the frame a sharpness score favours.
+typedef NS_ENUM(NSInteger, NKSharpnessWeighting) {
+    /// The sharpest tenth of the frame, wherever it is: suits shallow focus and off-centre subjects.
+    NKSharpnessWeightingPeak = 0,
+    /// A Gaussian falloff from the centre of the frame.
+    NKSharpnessWeightingCentre = 1,
+    /// Faces found by Vision; frames without faces fall back to the peak score.
+    NKSharpnessWeightingFaces = 2,
+};
+
+/// Focus measures of one image (see Native/Sharpness.hpp).
+@interface NKSharpnessResult : NSObject
+/// RMS Laplacian in 8-bit luma levels under the requested weighting; higher is sharper.
+@property (nonatomic, readonly) double score;
+/// RMS Sobel gradient under the same weighting.
+@property (nonatomic, readonly) double gradientEnergy;
+/// Faces the score was weighted by (0 unless weighting by faces).
+@property (nonatomic, readonly) NSInteger faceCount;
+/// 8x8 floats, the RMS Laplacian of each region, row-major from the top left of the upright frame.
+@property (nonatomic, readonly) NSData *heatmap;
+@end
+
+/// Scores frames by focus for culling.
+@interface NKSharpnessScorer : NSObject
+
+/// Side of the square region grid of `heatmap`.
+@property (class, nonatomic, readonly) NSInteger heatmapGridSize;
+
+/// Scores every file in `paths` from its largest embedded preview (NEF/NRW) or an ImageIO
+/// decode of about 1500 pixels (anything else), so scores of a folder are comparable. Files
+/// are processed in parallel on the job system at batch priority. The result has an entry per
+/// path, NSNull where the file couldn't be read. `progress` gets the finished fraction on the
+/// calling thread and returns NO to cancel, which returns nil. Blocks; call off the main thread.
++ (nullable NSArray *)scoresForPaths:(NSArray<NSString *> *)paths
+                           weighting:(NKSharpnessWeighting)weighting
+                            progress:(BOOL (^)(double fraction))progress
+    NS_SWIFT_NAME(scores(paths:weighting:progress:));
+
+@end
+
+NS_ASSUME_NONNULL_END
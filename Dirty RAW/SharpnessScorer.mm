@@ -0,0 +1,227 @@
+//
+//  SharpnessScorer.mm
+//  Dirty RAW
+//
+
+#import "SharpnessScorer.h"
+#import "NEFFile.h"
+
+#import <ImageIO/ImageIO.h>
+#import <Vision/Vision.h>
+
+#include "Native/JobSystem.hpp"
+#include "Native/Parallel.hpp"
+#include "Native/Sharpness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/// Long side focus is measured at. Large enough to resolve critical focus, small enough that
+/// ImageIO decodes full-size previews at a fraction of their size. Every file is resampled to
+/// it, since the Laplacian's response depends on scale: a smaller preview would score lower.
+constexpr NSUInteger kMeasureSize = 1536;
+/// Files per batch between progress reports.
+constexpr NSUInteger kBatchSize = 64;
+constexpr int kGrid = dirtyraw::SharpnessMap::kGrid;
+
+struct Measurement {
+    dirtyraw::SharpnessScore score;
+    int faceCount = 0;
+    float heatmap[dirtyraw::SharpnessMap::kRegions] = {};
+};
+
+/// Reorders a map measured on stored pixels to the upright frame of EXIF `orientation`.
+dirtyraw::SharpnessMap orientMap(const dirtyraw::SharpnessMap &stored, uint32_t orientation) {
+    dirtyraw::SharpnessMap upright;
+    constexpr int last = kGrid - 1;
+    for (int row = 0; row < kGrid; ++row) {
+        for (int column = 0; column < kGrid; ++column) {
+            int x = column, y = row;
+            switch (orientation) {
+                case 2: x = last - column; break;
+                case 3: x = last - column; y = last - row; break;
+                case 4: y = last - row; break;
+                case 5: x = row; y = column; break;
+                case 6: x = row; y = last - column; break;
+                case 7: x = last - row; y = last - column; break;
+                case 8: x = last - row; y = column; break;
+                default: break;
+            }
+            upright.laplacianVariance[row * kGrid + column] = stored.laplacianVariance[y * kGrid + x];
+            upright.gradientEnergy[row * kGrid + column] = stored.gradientEnergy[y * kGrid + x];
+        }
+    }
+    return upright;
+}
+
+/// Face rectangles in the upright frame, top-left origin.
+std::vector<dirtyraw::RegionRect> detectFaces(CGImageRef image, uint32_t orientation) {
+    std::vector<dirtyraw::RegionRect> faces;
+    CGImagePropertyOrientation imageOrientation =
+        orientation >= 1 && orientation <= 8 ? CGImagePropertyOrientation(orientation) : kCGImagePropertyOrientationUp;
+    VNImageRequestHandler *handler = [[VNImageRequestHandler alloc] initWithCGImage:image
+                                                                        orientation:imageOrientation
+                                                                            options:@{}];
+    VNDetectFaceRectanglesRequest *request = [[VNDetectFaceRectanglesRequest alloc] init];
+    NSError *error = nil;
+    if (![handler performRequests:@[request] error:&error]) {
+        NSLog(@"NKSharpnessScorer: Face detection failed: %@", error.localizedDescription);
+        return faces;
+    }
+    for (VNFaceObservation *face in request.results) {
+        CGRect box = face.boundingBox;  // Normalised, bottom-left origin
+        faces.push_back({ float(box.origin.x), float(1 - box.origin.y - box.size.height),
+                          float(box.size.width), float(box.size.height) });
+    }
+    return faces;
+}
+
+/// Decodes the image at `path`, resamples it to kMeasureSize and measures it.
+bool measure(NSString *path, NKSharpnessWeighting weighting, Measurement &measurement) {
+    CGImageSourceRef source = NULL;
+    uint32_t orientation = 1;
+    NSUInteger longEdge = 0;
+    NSString *extension = path.pathExtension.lowercaseString;
+    if ([extension isEqualToString:@"nef"] || [extension isEqualToString:@"nrw"]) {
+        NKNEFFile *file = [[NKNEFFile alloc] initWithFilePath:path];
+        NKNEFPreview *preview = [file previewWithMinimumDimension:kMeasureSize];
+        if (!preview) return false;
+        // Previews are stored unrotated, like the raw data
+        orientation = uint32_t([file getImageInfo].orientation);
+        longEdge = std::max(preview.width, preview.height);
+        source = CGImageSourceCreateWithData((__bridge CFDataRef)preview.jpegData, NULL);
+    } else {
+        source = CGImageSourceCreateWithURL((__bridge CFURLRef)[NSURL fileURLWithPath:path], NULL);
+        if (source) {
+            NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyPropertiesAtIndex(source, 0, NULL));
+            NSNumber *value = properties[(id)kCGImagePropertyOrientation];
+            if (value) orientation = value.unsignedIntValue;
+            longEdge = std::max([properties[(id)kCGImagePropertyPixelWidth] unsignedIntegerValue],
+                                [properties[(id)kCGImagePropertyPixelHeight] unsignedIntegerValue]);
+        }
+    }
+    if (!source) return false;
+
+    // Measured unrotated; the map is turned upright afterwards. JPEGs are decoded at the
+    // smallest DCT scale still covering kMeasureSize.
+    NSUInteger subsampleFactor = 1;
+    while (subsampleFactor < 8 && longEdge / (subsampleFactor * 2) >= kMeasureSize) subsampleFactor *= 2;
+    NSDictionary *options = @{
+        (id)kCGImageSourceCreateThumbnailFromImageAlways: @YES,
+        (id)kCGImageSourceThumbnailMaxPixelSize: @(kMeasureSize),
+        (id)kCGImageSourceSubsampleFactor: @(subsampleFactor),
+        (id)kCGImageSourceShouldCacheImmediately: @YES,
+    };
+    CGImageRef image = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    if (!image) return false;
+
+    // Fixed analysis size, whatever size the preview or the DCT-scaled decode came out at
+    size_t sourceWidth = CGImageGetWidth(image);
+    size_t sourceHeight = CGImageGetHeight(image);
+    double scale = double(kMeasureSize) / double(std::max<size_t>(std::max(sourceWidth, sourceHeight), 1));
+    size_t width = std::max<size_t>(size_t(std::lround(double(sourceWidth) * scale)), 3);
+    size_t height = std::max<size_t>(size_t(std::lround(double(sourceHeight) * scale)), 3);
+    std::vector<uint8_t> pixels(width * height * 4);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGContextRef context = CGBitmapContextCreate(pixels.data(), width, height, 8, width * 4, colorSpace,
+                                                 kCGImageAlphaNoneSkipLast | kCGBitmapByteOrderDefault);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        CGImageRelease(image);
+        return false;
+    }
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), image);
+    CGContextRelease(context);
+
+    std::vector<dirtyraw::RegionRect> faces;
+    if (weighting == NKSharpnessWeightingFaces) faces = detectFaces(image, orientation);
+    CGImageRelease(image);
+
+    dirtyraw::SharpnessMap map = orientMap(dirtyraw::measureSharpness(pixels.data(), width * 4, int(width), int(height)),
+                                           orientation);
+    float weights[dirtyraw::SharpnessMap::kRegions];
+    const float *activeWeights = nullptr;
+    if (weighting == NKSharpnessWeightingCentre) {
+        dirtyraw::centreWeights(weights);
+        activeWeights = weights;
+    } else if (!faces.empty()) {
+        dirtyraw::coverageWeights(faces.data(), int(faces.size()), weights);
+        activeWeights = weights;
+    }
+
+    measurement.score = dirtyraw::combineSharpness(map, activeWeights);
+    measurement.faceCount = int(faces.size());
+    for (int i = 0; i < dirtyraw::SharpnessMap::kRegions; ++i) {
+        measurement.heatmap[i] = std::sqrt(map.laplacianVariance[i]);
+    }
+    return true;
+}
+
+} // namespace
+
+@interface NKSharpnessResult ()
+- (instancetype)initWithMeasurement:(const Measurement &)measurement;
+@end
+
+@implementation NKSharpnessResult
+
+- (instancetype)initWithMeasurement:(const Measurement &)measurement {
+    if (self = [super init]) {
+        _score = measurement.score.laplacian;
+        _gradientEnergy = measurement.score.gradient;
+        _faceCount = measurement.faceCount;
+        _heatmap = [NSData dataWithBytes:measurement.heatmap length:sizeof(measurement.heatmap)];
+    }
+    return self;
+}
+
+@end
+
+@implementation NKSharpnessScorer
+
++ (NSInteger)heatmapGridSize {
+    return kGrid;
+}
+
++ (NSArray *)scoresForPaths:(NSArray<NSString *> *)paths
+                  weighting:(NKSharpnessWeighting)weighting
+                   progress:(BOOL (^)(double))progress {
+    NSUInteger count = paths.count;
+    std::vector<Measurement> measurements(count);
+    std::vector<uint8_t> valid(count, 0);
+
+    // Keeps the open preview responsive while a folder is scored
+    dirtyraw::JobScope scope(dirtyraw::JobPriority::batch);
+    for (NSUInteger batch = 0; batch < count; batch += kBatchSize) {
+        if (!progress(double(batch) / double(std::max<NSUInteger>(count, 1)))) return nil;
+        NSUInteger batchEnd = std::min(batch + kBatchSize, count);
+        dirtyraw::parallelFor(int(batch), int(batchEnd), [&](int begin, int end) {
+            for (int index = begin; index < end; ++index) @autoreleasepool {
+                valid[index] = measure(paths[NSUInteger(index)], weighting, measurements[index]);
+            }
+        });
+    }
+    if (!progress(1)) return nil;
+
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:count];
+    NSUInteger failures = 0;
+    for (NSUInteger index = 0; index < count; ++index) {
+        if (valid[index]) {
+            [result addObject:[[NKSharpnessResult alloc] initWithMeasurement:measurements[index]]];
+        } else {
+            [result addObject:[NSNull null]];
+            ++failures;
+        }
+    }
+    if (failures > 0) {
+        NSLog(@"NKSharpnessScorer: No preview for %lu of %lu files", (unsigned long)failures, (unsigned long)count);
+    }
+    return result;
+}
+
+@end
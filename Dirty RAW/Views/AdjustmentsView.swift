@@ -13,34 +13,42 @@ struct AdjustmentsView: View {
     var onReset: () -> Void
 
     @State private var localAdjustments: ImageAdjustments = ImageAdjustments()
-    @State private var debounceTask: Task<Void, Never>?
-    @State private var expandedSections: Set<String> = ["Light", "Color", "LUT", "Tone Curve", "Detail", "Noise Reduction", "Upscaling"]
+    @State private var expandedSections: Set<String> = ["Light", "Color", "Color Mixer", "LUT", "Tone Curve", "Local Adjustments", "Detail", "Noise Reduction", "Lens Corrections", "Film Grain", "Upscaling"]
     @State private var lutOptions: [LUTStore.Option] = []
-    @State private var isImportingLUT = false
-    @State private var lutImportError: String?
-    @State private var showLUTError = false
+    @State private var lensProfiles: [LensProfile] = []
+    @State private var isImporting = false
+    @State private var importKind: ImportKind = .lut
+    @State private var importError: String?
+    @State private var showImportError = false
+    @State private var selectedLocalID: UUID?
+    @State private var selectedBand: ColorGrading.Band = .red
+    @ObservedObject private var maskEditor = MaskEditor.shared
+
+    /// What the file importer is picking.
+    private enum ImportKind {
+        case lut
+        case lensProfile
+    }
 
     private var cubeUTType: UTType {
         UTType(filenameExtension: "cube") ?? .data
     }
 
-    private var availableScales: (canScale1_5x: Bool, canScale2x: Bool, canScale3x: Bool) {
-        guard let size = imageSize else {
-            return (true, true, true)
-        }
-        return ImageProcessor.shared.availableUpscaleFactors(for: size)
+    /// Pixel size of the upscaled export, if an image is loaded.
+    private var upscaledSize: NSSize? {
+        guard let size = imageSize else { return nil }
+        let factor = localAdjustments.upscaleFactor
+        return NSSize(width: (size.width * factor).rounded(), height: (size.height * factor).rounded())
     }
 
+    /// Pushes every change immediately; the image renders a coarse frame right away and
+    /// refines once input settles, cancelling any render the new value supersedes.
     private func updateAdjustment() {
-        debounceTask?.cancel()
-        debounceTask = Task {
-            try? await Task.sleep(nanoseconds: 100_000_000)
-            if !Task.isCancelled {
-                await MainActor.run {
-                    adjustments = localAdjustments
-                }
-            }
-        }
+        adjustments = localAdjustments
+    }
+
+    private func refreshLensProfiles() {
+        lensProfiles = LensProfileStore.shared.allProfiles()
     }
 
     private func refreshLUTOptions() {
@@ -163,6 +171,16 @@ struct AdjustmentsView: View {
                     }
                 }
 
+                // Color Mixer Section (compiled into the LUT stage)
+                CollapsibleAdjustmentCard(
+                    title: "Color Mixer",
+                    icon: "paintpalette",
+                    isExpanded: expandedSections.contains("Color Mixer"),
+                    onToggle: { toggleSection("Color Mixer") }
+                ) {
+                    colorMixerCard
+                }
+
                 // Tone Curve Section
                 CollapsibleAdjustmentCard(
                     title: "LUT",
@@ -201,6 +219,12 @@ struct AdjustmentsView: View {
                             .onChange(of: localAdjustments.lutID) { _, _ in
                                 updateAdjustment()
                             }
+                            .onHover { isHovering in
+                                // Load the presets while the pointer heads for the menu
+                                if isHovering && localAdjustments.lutEnabled {
+                                    ImageProcessor.shared.prewarmLUTs(ids: lutOptions.map(\.id))
+                                }
+                            }
                         }
 
                         // Intensity slider
@@ -226,7 +250,8 @@ struct AdjustmentsView: View {
                         // Import button
                         HStack {
                             Button("Import .cube") {
-                                isImportingLUT = true
+                                importKind = .lut
+                                isImporting = true
                             }
                             .controlSize(.small)
 
@@ -278,6 +303,16 @@ struct AdjustmentsView: View {
                     }
                 }
 
+                // Local Adjustments Section
+                CollapsibleAdjustmentCard(
+                    title: "Local Adjustments",
+                    icon: "circle.dashed.inset.filled",
+                    isExpanded: expandedSections.contains("Local Adjustments"),
+                    onToggle: { toggleSection("Local Adjustments") }
+                ) {
+                    localAdjustmentsCard
+                }
+
                 // Detail Section
                 CollapsibleAdjustmentCard(
                     title: "Detail",
@@ -334,71 +369,166 @@ struct AdjustmentsView: View {
                     }
                 }
 
-                // MetalFX Upscaling Section
-                if #available(macOS 13.0, *) {
-                    CollapsibleAdjustmentCard(
-                        title: "Upscaling",
-                        icon: "arrow.up.left.and.arrow.down.right",
-                        isExpanded: expandedSections.contains("Upscaling"),
-                        onToggle: { toggleSection("Upscaling") }
-                    ) {
-                        VStack(spacing: 8) {
-                            // Enable toggle
-                            HStack {
-                                Text("Enable")
-                                    .font(.caption2)
-                                    .foregroundColor(.secondary)
-                                Spacer()
-                                Toggle("", isOn: $localAdjustments.upscalingEnabled)
-                                    .toggleStyle(.checkbox)
-                                    .onChange(of: localAdjustments.upscalingEnabled) { _, _ in
-                                        updateAdjustment()
-                                    }
+                // Lens Corrections Section
+                CollapsibleAdjustmentCard(
+                    title: "Lens Corrections",
+                    icon: "camera.aperture",
+                    isExpanded: expandedSections.contains("Lens Corrections"),
+                    onToggle: { toggleSection("Lens Corrections") }
+                ) {
+                    VStack(spacing: 10) {
+                        // Enable toggle
+                        HStack {
+                            Text("Enable")
+                                .font(.caption2)
+                                .foregroundColor(.secondary)
+                            Spacer()
+                            Toggle("", isOn: $localAdjustments.lensCorrectionEnabled)
+                                .toggleStyle(.checkbox)
+                                .onChange(of: localAdjustments.lensCorrectionEnabled) { _, _ in
+                                    updateAdjustment()
+                                }
+                        }
+
+                        // Profile picker (matched from the EXIF lens name when the image opens)
+                        HStack {
+                            Text("Profile")
+                                .font(.caption2)
+                                .foregroundColor(.secondary)
+                            Spacer()
+                            Picker("", selection: $localAdjustments.lensProfileID) {
+                                Text("None").tag("none")
+                                ForEach(lensProfiles) { profile in
+                                    Text(profile.name).tag(profile.id)
+                                }
+                            }
+                            .labelsHidden()
+                            .frame(maxWidth: 160)
+                            .disabled(!localAdjustments.lensCorrectionEnabled)
+                            .onChange(of: localAdjustments.lensProfileID) { _, _ in
+                                updateAdjustment()
                             }
+                        }
+
+                        if localAdjustments.lensFocalLength > 0 {
+                            Text(String(format: "Shot at %.0f mm, f/%.1f", localAdjustments.lensFocalLength, localAdjustments.lensAperture))
+                                .font(.caption2)
+                                .foregroundColor(.secondary)
+                                .frame(maxWidth: .infinity, alignment: .leading)
+                        }
 
-                            if localAdjustments.upscalingEnabled {
-                                // Scale factor buttons
-                                HStack {
-                                    Text("Scale")
-                                        .font(.caption2)
-                                        .foregroundColor(.secondary)
-                                    Spacer()
-                                    HStack(spacing: 4) {
-                                        ScaleButton(label: "1.5x", tag: 0, selection: $localAdjustments.upscaleMode, enabled: availableScales.canScale1_5x, onChange: updateAdjustment)
-                                        ScaleButton(label: "2x", tag: 1, selection: $localAdjustments.upscaleMode, enabled: availableScales.canScale2x, onChange: updateAdjustment)
-                                        ScaleButton(label: "3x", tag: 2, selection: $localAdjustments.upscaleMode, enabled: availableScales.canScale3x, onChange: updateAdjustment)
-                                    }
+                        if localAdjustments.lensCorrectionEnabled {
+                            amountSlider("Distortion", value: $localAdjustments.lensDistortionAmount)
+                            amountSlider("Vignetting", value: $localAdjustments.lensVignettingAmount)
+                            amountSlider("Chromatic Aberration", value: $localAdjustments.lensCAAmount)
+                        }
+
+                        // Import button
+                        HStack {
+                            Button("Import Profile") {
+                                importKind = .lensProfile
+                                isImporting = true
+                            }
+                            .controlSize(.small)
+
+                            Spacer()
+                        }
+                    }
+                }
+
+                // Film Grain Section
+                CollapsibleAdjustmentCard(
+                    title: "Film Grain",
+                    icon: "aqi.medium",
+                    isExpanded: expandedSections.contains("Film Grain"),
+                    onToggle: { toggleSection("Film Grain") }
+                ) {
+                    VStack(spacing: 8) {
+                        AdjustmentRow(
+                            label: "Amount",
+                            value: $localAdjustments.grainAmount,
+                            range: 0.0...1.0,
+                            onChange: updateAdjustment
+                        )
+                        AdjustmentRow(
+                            label: "Size",
+                            value: $localAdjustments.grainSize,
+                            range: 0.5...4.0,
+                            centerValue: 1.5,
+                            onChange: updateAdjustment
+                        )
+                        AdjustmentRow(
+                            label: "Roughness",
+                            value: $localAdjustments.grainRoughness,
+                            range: 0.0...1.0,
+                            centerValue: 0.5,
+                            onChange: updateAdjustment
+                        )
+                    }
+                }
+
+                // Upscaling Section
+                CollapsibleAdjustmentCard(
+                    title: "Upscaling",
+                    icon: "arrow.up.left.and.arrow.down.right",
+                    isExpanded: expandedSections.contains("Upscaling"),
+                    onToggle: { toggleSection("Upscaling") }
+                ) {
+                    VStack(spacing: 8) {
+                        // Enable toggle
+                        HStack {
+                            Text("Enable")
+                                .font(.caption2)
+                                .foregroundColor(.secondary)
+                            Spacer()
+                            Toggle("", isOn: $localAdjustments.upscalingEnabled)
+                                .toggleStyle(.checkbox)
+                                .onChange(of: localAdjustments.upscalingEnabled) { _, _ in
+                                    updateAdjustment()
                                 }
+                        }
 
-                                // Warning text if options disabled
-                                if !availableScales.canScale3x || !availableScales.canScale2x {
-                                    Text("Some options disabled (image too large)")
-                                        .font(.caption2)
-                                        .foregroundColor(.orange)
-                                        .frame(maxWidth: .infinity, alignment: .leading)
+                        if localAdjustments.upscalingEnabled {
+                            // Scale factor buttons
+                            HStack {
+                                Text("Scale")
+                                    .font(.caption2)
+                                    .foregroundColor(.secondary)
+                                Spacer()
+                                HStack(spacing: 4) {
+                                    ScaleButton(label: "1.5x", tag: 0, selection: $localAdjustments.upscaleMode, enabled: true, onChange: updateAdjustment)
+                                    ScaleButton(label: "2x", tag: 1, selection: $localAdjustments.upscaleMode, enabled: true, onChange: updateAdjustment)
+                                    ScaleButton(label: "3x", tag: 2, selection: $localAdjustments.upscaleMode, enabled: true, onChange: updateAdjustment)
                                 }
                             }
-                            
-                            // MetalFX badge
-                            HStack(spacing: 4) {
-                                Image(systemName: "apple.logo")
+
+                            if let size = upscaledSize {
+                                Text("Export size \(Int(size.width)) × \(Int(size.height))")
                                     .font(.caption2)
-                                Text("MetalFX")
-                                    .font(.system(size: 10, weight: .semibold))
+                                    .foregroundColor(.secondary)
+                                    .frame(maxWidth: .infinity, alignment: .leading)
                             }
-                            .foregroundColor(.white)
-                            .padding(.horizontal, 8)
-                            .padding(.vertical, 4)
-                            .background(
-                                LinearGradient(
-                                    colors: [.blue, .purple],
-                                    startPoint: .leading,
-                                    endPoint: .trailing
-                                )
-                            )
-                            .cornerRadius(4)
-                            .frame(maxWidth: .infinity, alignment: .leading)
                         }
+                        
+                        // Upscaler badge
+                        HStack(spacing: 4) {
+                            Image(systemName: "cpu")
+                                .font(.caption2)
+                            Text("Lanczos")
+                                .font(.system(size: 10, weight: .semibold))
+                        }
+                        .foregroundColor(.white)
+                        .padding(.horizontal, 8)
+                        .padding(.vertical, 4)
+                        .background(
+                            LinearGradient(
+                                colors: [.blue, .purple],
+                                startPoint: .leading,
+                                endPoint: .trailing
+                            )
+                        )
+                        .cornerRadius(4)
+                        .frame(maxWidth: .infinity, alignment: .leading)
                     }
                 }
             }
@@ -407,41 +537,330 @@ struct AdjustmentsView: View {
         .onAppear {
             localAdjustments = adjustments
             refreshLUTOptions()
+            refreshLensProfiles()
         }
         .onReceive(NotificationCenter.default.publisher(for: LUTStore.didChangeNotification)) { _ in
             refreshLUTOptions()
         }
+        .onReceive(NotificationCenter.default.publisher(for: LensProfileStore.didChangeNotification)) { _ in
+            refreshLensProfiles()
+        }
         .onChange(of: adjustments.isDefault) { _, isDefault in
             if isDefault {
                 localAdjustments = adjustments
             }
         }
+        // Brush strokes are painted in the preview straight into the image's adjustments
+        .onChange(of: adjustments.localAdjustments) { _, masks in
+            if localAdjustments.localAdjustments != masks {
+                localAdjustments.localAdjustments = masks
+            }
+            if let id = selectedLocalID, !masks.contains(where: { $0.id == id }) {
+                selectLocal(nil)
+            }
+        }
+        .onDisappear {
+            maskEditor.paintingMaskID = nil
+        }
+        // One importer for both kinds; SwiftUI only honours a single fileImporter per view
         .fileImporter(
-            isPresented: $isImportingLUT,
-            allowedContentTypes: [cubeUTType],
+            isPresented: $isImporting,
+            allowedContentTypes: importKind == .lut ? [cubeUTType] : [.json],
             allowsMultipleSelection: false
         ) { result in
             switch result {
             case .success(let urls):
                 guard let url = urls.first else { return }
                 do {
-                    let newID = try LUTStore.shared.importCubeFile(from: url)
-                    localAdjustments.lutEnabled = true
-                    localAdjustments.lutID = newID
+                    switch importKind {
+                    case .lut:
+                        let newID = try LUTStore.shared.importCubeFile(from: url)
+                        localAdjustments.lutEnabled = true
+                        localAdjustments.lutID = newID
+                    case .lensProfile:
+                        let imported = try LensProfileStore.shared.importProfiles(from: url)
+                        if localAdjustments.lensProfileID == "none", let first = imported.first {
+                            localAdjustments.lensProfileID = first.id
+                        }
+                        localAdjustments.lensCorrectionEnabled = true
+                    }
                     updateAdjustment()
                 } catch {
-                    lutImportError = error.localizedDescription
-                    showLUTError = true
+                    importError = error.localizedDescription
+                    showImportError = true
                 }
             case .failure(let error):
-                lutImportError = error.localizedDescription
-                showLUTError = true
+                importError = error.localizedDescription
+                showImportError = true
             }
         }
-        .alert("LUT Import Error", isPresented: $showLUTError) {
+        .alert(importKind == .lut ? "LUT Import Error" : "Lens Profile Import Error", isPresented: $showImportError) {
             Button("OK") { }
         } message: {
-            Text(lutImportError ?? "Unknown error")
+            Text(importError ?? "Unknown error")
+        }
+    }
+
+    // MARK: - Color Mixer
+
+    @ViewBuilder
+    private var colorMixerCard: some View {
+        VStack(spacing: 10) {
+            // Band picker
+            HStack(spacing: 6) {
+                ForEach(ColorGrading.Band.allCases) { band in
+                    Button {
+                        selectedBand = band
+                    } label: {
+                        Circle()
+                            .fill(Color(hue: Double(ColorGrading.Band.centerHues[band.rawValue]) / 360, saturation: 0.8, brightness: 0.9))
+                            .frame(width: 16, height: 16)
+                            .overlay(Circle().stroke(Color.primary, lineWidth: selectedBand == band ? 2 : 0))
+                    }
+                    .buttonStyle(.plain)
+                    .help(band.displayName)
+                }
+                Spacer()
+            }
+
+            AdjustmentRow(
+                label: "\(selectedBand.displayName) Hue",
+                value: $localAdjustments.colorGrading[selectedBand].hue,
+                range: -1.0...1.0,
+                onChange: updateAdjustment
+            )
+            AdjustmentRow(
+                label: "\(selectedBand.displayName) Saturation",
+                value: $localAdjustments.colorGrading[selectedBand].saturation,
+                range: -1.0...1.0,
+                onChange: updateAdjustment
+            )
+            AdjustmentRow(
+                label: "\(selectedBand.displayName) Luminance",
+                value: $localAdjustments.colorGrading[selectedBand].luminance,
+                range: -1.0...1.0,
+                onChange: updateAdjustment
+            )
+
+            Divider()
+
+            // Black & White
+            HStack {
+                Text("Black & White")
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+                Spacer()
+                Toggle("", isOn: $localAdjustments.colorGrading.isMonochrome)
+                    .toggleStyle(.checkbox)
+                    .onChange(of: localAdjustments.colorGrading.isMonochrome) { _, _ in
+                        updateAdjustment()
+                    }
+            }
+            if localAdjustments.colorGrading.isMonochrome {
+                AdjustmentRow(label: "Red", value: $localAdjustments.colorGrading.mixerRed, range: -2.0...2.0, centerValue: 0.4, onChange: updateAdjustment)
+                AdjustmentRow(label: "Green", value: $localAdjustments.colorGrading.mixerGreen, range: -2.0...2.0, centerValue: 0.4, onChange: updateAdjustment)
+                AdjustmentRow(label: "Blue", value: $localAdjustments.colorGrading.mixerBlue, range: -2.0...2.0, centerValue: 0.2, onChange: updateAdjustment)
+            }
+
+            Divider()
+
+            // Split Toning
+            AdjustmentRow(label: "Shadow Hue", value: $localAdjustments.colorGrading.shadowHue, range: 0...360, centerValue: 220, onChange: updateAdjustment)
+            AdjustmentRow(label: "Shadow Saturation", value: $localAdjustments.colorGrading.shadowSaturation, range: 0.0...1.0, onChange: updateAdjustment)
+            AdjustmentRow(label: "Highlight Hue", value: $localAdjustments.colorGrading.highlightHue, range: 0...360, centerValue: 40, onChange: updateAdjustment)
+            AdjustmentRow(label: "Highlight Saturation", value: $localAdjustments.colorGrading.highlightSaturation, range: 0.0...1.0, onChange: updateAdjustment)
+            AdjustmentRow(label: "Balance", value: $localAdjustments.colorGrading.splitBalance, range: -1.0...1.0, onChange: updateAdjustment)
+        }
+    }
+
+    // MARK: - Local Adjustments
+
+    @ViewBuilder
+    private var localAdjustmentsCard: some View {
+        VStack(spacing: 10) {
+            HStack(spacing: 6) {
+                Button("Linear") { addLocal(.linear()) }
+                Button("Radial") { addLocal(.radial()) }
+                Button("Brush") { addLocal(.brush()) }
+                Spacer()
+            }
+            .controlSize(.small)
+
+            ForEach(localAdjustments.localAdjustments) { local in
+                HStack {
+                    Toggle("", isOn: localBinding(local, \.isEnabled))
+                        .toggleStyle(.checkbox)
+                        .labelsHidden()
+                        .onChange(of: local.isEnabled) { _, _ in
+                            updateAdjustment()
+                        }
+                    Text(local.name)
+                        .font(.caption)
+                        .fontWeight(local.id == selectedLocalID ? .semibold : .regular)
+                    Spacer()
+                    Button {
+                        removeLocal(id: local.id)
+                    } label: {
+                        Image(systemName: "minus.circle")
+                    }
+                    .buttonStyle(.plain)
+                    .foregroundColor(.secondary)
+                }
+                .padding(.horizontal, 6)
+                .padding(.vertical, 4)
+                .background(local.id == selectedLocalID ? Color.accentColor.opacity(0.15) : Color.clear)
+                .cornerRadius(4)
+                .contentShape(Rectangle())
+                .onTapGesture {
+                    selectLocal(local.id == selectedLocalID ? nil : local.id)
+                }
+            }
+
+            if let local = localAdjustments.localAdjustments.first(where: { $0.id == selectedLocalID }) {
+                Divider()
+                localMaskControls(for: local)
+                AdjustmentRow(label: "Exposure", value: localBinding(local, \.exposure), range: -2.0...2.0, onChange: updateAdjustment)
+                AdjustmentRow(label: "Contrast", value: localBinding(local, \.contrast), range: -0.5...0.5, onChange: updateAdjustment)
+                AdjustmentRow(label: "Saturation", value: localBinding(local, \.saturation), range: -1.0...1.0, onChange: updateAdjustment)
+                AdjustmentRow(label: "Warmth", value: localBinding(local, \.warmth), range: -1.0...1.0, onChange: updateAdjustment)
+            } else if localAdjustments.localAdjustments.isEmpty {
+                Text("Add a mask to adjust part of the image")
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+                    .frame(maxWidth: .infinity, alignment: .leading)
+            }
+        }
+    }
+
+    /// Geometry controls for the selected mask. Brushes are painted in the preview.
+    @ViewBuilder
+    private func localMaskControls(for local: LocalAdjustment) -> some View {
+        switch local.mask {
+        case .linear:
+            AdjustmentRow(label: "Start X", value: maskBinding(id: local.id, \.startX), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            AdjustmentRow(label: "Start Y", value: maskBinding(id: local.id, \.startY), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            AdjustmentRow(label: "End X", value: maskBinding(id: local.id, \.endX), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            AdjustmentRow(label: "End Y", value: maskBinding(id: local.id, \.endY), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+        case .radial(_, _, _, let inverted):
+            AdjustmentRow(label: "Center X", value: maskBinding(id: local.id, \.startX), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            AdjustmentRow(label: "Center Y", value: maskBinding(id: local.id, \.startY), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            AdjustmentRow(label: "Width", value: maskBinding(id: local.id, \.endX), range: 0.01...1.0, centerValue: 0.25, onChange: updateAdjustment)
+            AdjustmentRow(label: "Height", value: maskBinding(id: local.id, \.endY), range: 0.01...1.0, centerValue: 0.25, onChange: updateAdjustment)
+            AdjustmentRow(label: "Feather", value: maskBinding(id: local.id, \.feather), range: 0.0...1.0, centerValue: 0.5, onChange: updateAdjustment)
+            HStack {
+                Text("Invert")
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+                Spacer()
+                Toggle("", isOn: Binding(
+                    get: { inverted },
+                    set: { newValue in
+                        updateLocal(id: local.id) { local in
+                            if case .radial(let center, let radius, let feather, _) = local.mask {
+                                local.mask = .radial(center: center, radius: radius, feather: feather, inverted: newValue)
+                            }
+                        }
+                        updateAdjustment()
+                    }
+                ))
+                .toggleStyle(.checkbox)
+            }
+        case .brush:
+            HStack {
+                Text("Paint in the preview")
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+                Spacer()
+                Picker("", selection: $maskEditor.isErasing) {
+                    Text("Paint").tag(false)
+                    Text("Erase").tag(true)
+                }
+                .pickerStyle(.segmented)
+                .labelsHidden()
+                .frame(maxWidth: 120)
+            }
+            AdjustmentRow(label: "Brush Size", value: $maskEditor.brushRadius, range: 0.005...0.2, centerValue: 0.03)
+            AdjustmentRow(label: "Hardness", value: $maskEditor.brushHardness, range: 0.0...1.0, centerValue: 0.5)
+        }
+    }
+
+    private func addLocal(_ local: LocalAdjustment) {
+        var local = local
+        let count = localAdjustments.localAdjustments.filter { $0.mask.displayName == local.mask.displayName }.count
+        if count > 0 {
+            local.name = "\(local.mask.displayName) \(count + 1)"
+        }
+        localAdjustments.localAdjustments.append(local)
+        selectLocal(local.id)
+        updateAdjustment()
+    }
+
+    private func removeLocal(id: UUID) {
+        localAdjustments.localAdjustments.removeAll { $0.id == id }
+        if selectedLocalID == id {
+            selectLocal(nil)
+        }
+        updateAdjustment()
+    }
+
+    /// Selecting a brush mask arms the preview for painting into it.
+    private func selectLocal(_ id: UUID?) {
+        selectedLocalID = id
+        let local = localAdjustments.localAdjustments.first { $0.id == id }
+        if case .brush = local?.mask {
+            maskEditor.paintingMaskID = id
+        } else {
+            maskEditor.paintingMaskID = nil
+        }
+    }
+
+    private func updateLocal(id: UUID, _ body: (inout LocalAdjustment) -> Void) {
+        guard let index = localAdjustments.localAdjustments.firstIndex(where: { $0.id == id }) else { return }
+        body(&localAdjustments.localAdjustments[index])
+    }
+
+    private func localBinding<Value>(_ local: LocalAdjustment, _ keyPath: WritableKeyPath<LocalAdjustment, Value>) -> Binding<Value> {
+        Binding(
+            get: { localAdjustments.localAdjustments.first { $0.id == local.id }?[keyPath: keyPath] ?? local[keyPath: keyPath] },
+            set: { newValue in updateLocal(id: local.id) { $0[keyPath: keyPath] = newValue } }
+        )
+    }
+
+    private func maskBinding(id: UUID, _ keyPath: WritableKeyPath<MaskGeometry, Double>) -> Binding<Double> {
+        Binding(
+            get: {
+                guard let mask = localAdjustments.localAdjustments.first(where: { $0.id == id })?.mask else { return 0 }
+                return MaskGeometry(mask)[keyPath: keyPath]
+            },
+            set: { newValue in
+                updateLocal(id: id) { local in
+                    var geometry = MaskGeometry(local.mask)
+                    geometry[keyPath: keyPath] = newValue
+                    local.mask = geometry.applied(to: local.mask)
+                }
+            }
+        )
+    }
+
+    /// 0...100% slider for scaling a correction.
+    private func amountSlider(_ label: String, value: Binding<Double>) -> some View {
+        VStack(spacing: 6) {
+            HStack {
+                Text(label)
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+                Spacer()
+                Text(String(format: "%.0f%%", value.wrappedValue * 100))
+                    .font(.caption2)
+                    .foregroundColor(.secondary)
+            }
+            Slider(value: value, in: 0.0...1.0) {
+                Text(label)
+            }
+            .controlSize(.small)
+            .onChange(of: value.wrappedValue) { _, _ in
+                updateAdjustment()
+            }
         }
     }
 
@@ -456,6 +875,38 @@ struct AdjustmentsView: View {
     }
 }
 
+// MARK: - Mask Geometry
+
+/// Slider-friendly view of a linear or radial mask: start is the linear start point or the
+/// radial centre, end is the linear end point or the radial radii.
+private struct MaskGeometry {
+    var startX = 0.0, startY = 0.0, endX = 0.0, endY = 0.0, feather = 0.0
+
+    init(_ mask: LocalAdjustment.Mask) {
+        switch mask {
+        case .linear(let start, let end):
+            (startX, startY, endX, endY) = (start.x, start.y, end.x, end.y)
+        case .radial(let center, let radius, let feather, _):
+            (startX, startY, endX, endY) = (center.x, center.y, radius.width, radius.height)
+            self.feather = feather
+        case .brush:
+            break
+        }
+    }
+
+    func applied(to mask: LocalAdjustment.Mask) -> LocalAdjustment.Mask {
+        switch mask {
+        case .linear:
+            return .linear(start: CGPoint(x: startX, y: startY), end: CGPoint(x: endX, y: endY))
+        case .radial(_, _, _, let inverted):
+            return .radial(center: CGPoint(x: startX, y: startY), radius: CGSize(width: endX, height: endY),
+                           feather: feather, inverted: inverted)
+        case .brush:
+            return mask
+        }
+    }
+}
+
 // MARK: - Collapsible Card
 
 struct CollapsibleAdjustmentCard<Content: View>: View {
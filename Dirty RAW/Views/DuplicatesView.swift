@@ -0,0 +1,132 @@
+//
+//  DuplicatesView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+
+/// Sheet that groups near-duplicate frames by perceptual hash (see `DuplicateGrouping`) so a
+/// burst can be collapsed to one frame in the image list.
+struct DuplicatesView: View {
+    /// Images to search, in list order.
+    let images: [RAWImage]
+    /// Called with the groups to collapse.
+    let onCollapse: ([DuplicateGrouping.Group]) -> Void
+
+    @Environment(\.dismiss) private var dismiss
+    @State private var groups: [DuplicateGrouping.Group]?
+    @State private var maxDistance = Double(DuplicateGrouping.defaultMaxDistance)
+    @State private var progress: Double = 0
+    @State private var cancellation = StackCancellation()
+
+    private var imagesByURL: [URL: RAWImage] {
+        Dictionary(images.map { ($0.url, $0) }, uniquingKeysWith: { first, _ in first })
+    }
+
+    var body: some View {
+        VStack(alignment: .leading, spacing: 12) {
+            Text("Find Duplicates")
+                .font(.headline)
+
+            if let groups {
+                if groups.isEmpty {
+                    Text("No near-duplicates found. Try a looser match.")
+                        .foregroundColor(.secondary)
+                        .frame(maxWidth: .infinity, minHeight: 200)
+                } else {
+                    let lookup = imagesByURL
+                    List(groups) { group in
+                        VStack(alignment: .leading, spacing: 4) {
+                            Text("\(group.urls.count) frames: \(group.urls[0].lastPathComponent)")
+                                .lineLimit(1)
+                                .truncationMode(.middle)
+                            ScrollView(.horizontal) {
+                                HStack(spacing: 4) {
+                                    ForEach(group.urls, id: \.self) { url in
+                                        thumbnail(for: lookup[url])
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    .frame(minHeight: 260)
+                }
+            } else {
+                ProgressView("Hashing previews…", value: progress)
+                    .frame(maxWidth: .infinity, minHeight: 200)
+            }
+
+            HStack {
+                Text("Match")
+                Slider(value: $maxDistance, in: 2...14, step: 1)
+                Text(maxDistance <= 4 ? "Exact" : maxDistance <= 10 ? "Similar" : "Loose")
+                    .frame(width: 56, alignment: .trailing)
+                    .foregroundColor(.secondary)
+            }
+            .disabled(groups == nil)
+
+            Text("Frames are compared by a perceptual hash of their embedded previews and a coarse colour signature, so copies at other sizes or qualities and burst frames with little movement are grouped. Collapsing keeps the sharpest frame of each group if the folder has been ranked by sharpness, else the first.")
+                .font(.caption)
+                .foregroundColor(.secondary)
+                .fixedSize(horizontal: false, vertical: true)
+
+            HStack {
+                if let groups, !groups.isEmpty {
+                    Text("\(groups.reduce(0) { $0 + $1.urls.count - 1 }) frames to hide")
+                        .foregroundColor(.secondary)
+                }
+                Spacer()
+                Button("Cancel") {
+                    cancellation.cancel()
+                    dismiss()
+                }
+                .keyboardShortcut(.cancelAction)
+                Button("Collapse Groups") {
+                    onCollapse(groups ?? [])
+                    dismiss()
+                }
+                .keyboardShortcut(.defaultAction)
+                .disabled(groups?.isEmpty ?? true)
+            }
+        }
+        .padding()
+        .frame(width: 520)
+        .task(id: maxDistance) {
+            await regroup()
+        }
+    }
+
+    @ViewBuilder
+    private func thumbnail(for image: RAWImage?) -> some View {
+        if let thumb = image?.thumbnail {
+            Image(nsImage: thumb)
+                .resizable()
+                .aspectRatio(contentMode: .fill)
+                .frame(width: 56, height: 56)
+                .clipped()
+                .cornerRadius(4)
+        } else {
+            Rectangle()
+                .fill(Color.gray.opacity(0.3))
+                .frame(width: 56, height: 56)
+                .cornerRadius(4)
+        }
+    }
+
+    private func regroup() async {
+        let urls = images.map(\.url)
+        let maxDistance = Int(maxDistance)
+        let cancellation = cancellation
+        let found = await Task.detached(priority: .userInitiated) {
+            DuplicateGrouping.shared.groups(in: urls, maxDistance: maxDistance) { fraction in
+                Task { @MainActor in
+                    self.progress = fraction
+                }
+                return !cancellation.isCancelled
+            }
+        }.value
+        if let found {
+            groups = found
+        }
+    }
+}
@@ -0,0 +1,159 @@
+//
+//  HDRMergeView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+import UniformTypeIdentifiers
+
+/// Sheet that merges an exposure bracket, found from EXIF, into one linear HDR TIFF
+/// (see `NKFrameStacker`).
+struct HDRMergeView: View {
+    /// Candidate files; brackets are looked for among the Nikon RAW files.
+    let urls: [URL]
+    /// Called with the written TIFF so it can be opened and tone-mapped like any other image.
+    let onMerged: (URL) -> Void
+
+    @Environment(\.dismiss) private var dismiss
+    @State private var brackets: [BracketGrouping.Bracket]?
+    @State private var selection: URL?
+    @State private var progress: Double?
+    @State private var cancellation: StackCancellation?
+    @State private var errorMessage: String?
+
+    var body: some View {
+        VStack(alignment: .leading, spacing: 12) {
+            Text("Merge to HDR")
+                .font(.headline)
+
+            if let brackets {
+                if brackets.isEmpty {
+                    Text("No exposure brackets found. Brackets are frames shot back to back with the same camera and focal length at different exposures.")
+                        .foregroundColor(.secondary)
+                        .fixedSize(horizontal: false, vertical: true)
+                } else {
+                    List(brackets, selection: $selection) { bracket in
+                        VStack(alignment: .leading, spacing: 2) {
+                            Text(bracket.urls.map(\.lastPathComponent).sorted().joined(separator: ", "))
+                                .lineLimit(1)
+                                .truncationMode(.middle)
+                            Text(String(format: "%d frames, %+.1f to %+.1f EV", bracket.urls.count, bracket.stops.lowerBound, bracket.stops.upperBound))
+                                .font(.caption)
+                                .foregroundColor(.secondary)
+                        }
+                        .tag(bracket.id)
+                    }
+                    .frame(minHeight: 200)
+                    .disabled(progress != nil)
+                }
+            } else {
+                ProgressView("Reading EXIF…")
+                    .frame(maxWidth: .infinity, minHeight: 200)
+            }
+
+            Text("Frames are aligned to the middle exposure and merged into linear radiance at that exposure; the result opens with highlights and shadows set as a starting tone map. Developed frames are spilled to the temporary folder while merging.")
+                .font(.caption)
+                .foregroundColor(.secondary)
+                .fixedSize(horizontal: false, vertical: true)
+
+            if let progress {
+                ProgressView(value: progress)
+            }
+            if let errorMessage {
+                Text(errorMessage)
+                    .font(.caption)
+                    .foregroundColor(.red)
+            }
+
+            HStack {
+                Spacer()
+                Button("Cancel") {
+                    if let cancellation {
+                        cancellation.cancel()
+                    } else {
+                        dismiss()
+                    }
+                }
+                .keyboardShortcut(.cancelAction)
+                Button("Merge…") { chooseDestination() }
+                    .keyboardShortcut(.defaultAction)
+                    .disabled(selection == nil || progress != nil)
+            }
+        }
+        .padding()
+        .frame(width: 440)
+        .task {
+            let urls = urls
+            let found = await Task.detached(priority: .userInitiated) {
+                BracketGrouping.brackets(in: urls)
+            }.value
+            brackets = found
+            selection = found.first?.id
+        }
+    }
+
+    // MARK: - Merging
+
+    private func chooseDestination() {
+        guard let bracket = brackets?.first(where: { $0.id == selection }) else { return }
+
+        let panel = NSSavePanel()
+        panel.allowedContentTypes = [.tiff]
+        panel.nameFieldStringValue = bracket.urls[0].deletingPathExtension().lastPathComponent + " HDR"
+        panel.canCreateDirectories = true
+        panel.begin { response in
+            guard response == .OK, let url = panel.url else { return }
+            merge(bracket, to: url)
+        }
+    }
+
+    private func merge(_ bracket: BracketGrouping.Bracket, to url: URL) {
+        let paths = bracket.urls.map(\.path)
+        let exposures = bracket.exposures.map { NSNumber(value: $0) }
+        let colorSpace = ImageProcessor.shared.outputColorSpace
+        let cancellation = StackCancellation()
+        self.cancellation = cancellation
+        progress = 0
+        errorMessage = nil
+
+        Task.detached(priority: .userInitiated) {
+            let merged = NKFrameStacker.makeMergedHDRImage(
+                paths: paths,
+                exposures: exposures,
+                colorSpace: colorSpace
+            ) { fraction in
+                Task { @MainActor in
+                    if self.progress != nil {
+                        self.progress = fraction
+                    }
+                }
+                return !cancellation.isCancelled
+            }
+
+            var failure: String?
+            if let merged {
+                // Half float keeps the radiance above 1.0 for the tone map
+                let image = NSImage(cgImage: merged, size: NSSize(width: merged.width, height: merged.height))
+                do {
+                    try TIFFExporter.export(image: image, to: url, bitDepth: 16)
+                } catch {
+                    failure = "Failed to write TIFF: \(error.localizedDescription)"
+                }
+            } else if !cancellation.isCancelled {
+                failure = "Merging failed. The frames must be NEF or NRW files of the same size."
+            }
+
+            let cancelled = cancellation.isCancelled
+            await MainActor.run {
+                self.progress = nil
+                self.cancellation = nil
+                if let failure {
+                    self.errorMessage = failure
+                } else if !cancelled {
+                    self.onMerged(url)
+                    self.dismiss()
+                }
+            }
+        }
+    }
+}
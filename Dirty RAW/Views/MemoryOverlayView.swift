@@ -0,0 +1,59 @@
+//
+//  MemoryOverlayView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+
+/// Debug overlay on the preview listing what the memory ledger holds: totals against the process
+/// footprint, each category with its peak, and the images holding the most.
+struct MemoryOverlayView: View {
+    @ObservedObject private var monitor = MemoryMonitor.shared
+
+    var body: some View {
+        let snapshot = monitor.snapshot
+        VStack(alignment: .leading, spacing: 2) {
+            row("Footprint", snapshot.footprintBytes)
+            row("Tagged", snapshot.total.currentBytes, peak: snapshot.total.peakBytes)
+            row("Untracked", monitor.untrackedBytes)
+            row("Metal", Int64(monitor.metalAllocatedBytes))
+
+            Divider()
+                .padding(.vertical, 2)
+
+            ForEach(MemoryMonitor.categories.filter { snapshot.usage(for: $0).peakBytes > 0 }, id: \.self) { category in
+                let usage = snapshot.usage(for: category)
+                row(NKMemoryLedger.key(for: category), usage.currentBytes, peak: usage.peakBytes)
+            }
+
+            let owners = snapshot.owners.prefix(3).filter { $0.total.currentBytes > 0 }
+            if !owners.isEmpty {
+                Divider()
+                    .padding(.vertical, 2)
+                ForEach(owners, id: \.ownerID) { owner in
+                    row(owner.name, owner.total.currentBytes)
+                }
+            }
+        }
+        .font(.system(.caption2, design: .monospaced))
+        .padding(8)
+        .frame(width: 260)
+        .background(.regularMaterial)
+        .clipShape(RoundedRectangle(cornerRadius: 8))
+        .shadow(color: .black.opacity(0.1), radius: 4, y: 2)
+    }
+
+    private func row(_ label: String, _ bytes: Int64, peak: Int64? = nil) -> some View {
+        HStack {
+            Text(label)
+                .lineLimit(1)
+                .truncationMode(.middle)
+            Spacer()
+            Text(MemoryMonitor.megabytes(bytes))
+            if let peak {
+                Text("↑" + MemoryMonitor.megabytes(peak))
+                    .foregroundColor(.secondary)
+            }
+        }
+    }
+}
@@ -0,0 +1,229 @@
+//
+//  SettingsView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+
+struct SettingsView: View {
+    @State private var imageCacheGB: Double = Double(ImageCache.shared.byteBudget) / Double(1 << 30)
+    @State private var intermediateCacheGB: Double = Double(ImageProcessor.shared.intermediateCacheBudget) / Double(1 << 30)
+    @State private var lutCacheMB: Int = LUTResidency.shared.byteBudget >> 20
+    @State private var renderCacheMB: Int = RenderCache.shared.byteBudget >> 20
+    @State private var renderDiskCacheGB: Double = Double(RenderCache.shared.diskBudget) / Double(1 << 30)
+    @State private var intermediatePrecision: IntermediatePrecision = ImageProcessor.shared.intermediatePrecision
+    @State private var outputColorSpace: NKOutputColorSpace = ImageProcessor.shared.outputColorSpace
+    @State private var exportFormat: ImageExporter.Format = ImageExporter.format
+    @State private var exportBitDepth: Int = ImageExporter.bitDepth
+    @State private var tiffCompression: NKTIFFCompression = ImageExporter.tiffCompression
+    @State private var jpegQuality: Int = ImageExporter.jpegQuality
+    @State private var jpegSubsampling: NKChromaSubsampling = ImageExporter.jpegSubsampling
+    @State private var exportLongEdge: Int = ImageExporter.longEdge
+    @ObservedObject private var exportThroughput = ExportThroughput.shared
+    @ObservedObject private var memoryMonitor = MemoryMonitor.shared
+
+    var body: some View {
+        Form {
+            Section("Memory") {
+                HStack {
+                    Text("Image cache budget")
+                    Spacer()
+                    Text(String(format: "%.1f GB", imageCacheGB))
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                    Stepper("", value: $imageCacheGB, in: 0.5...64, step: 0.5)
+                        .labelsHidden()
+                }
+                Text("Decoded and edited images beyond this budget are released and re-decoded when revisited. The selected and pinned images are always kept.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+                HStack {
+                    Text("LUT cache budget")
+                    Spacer()
+                    Text("\(lutCacheMB) MB")
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                    Stepper("", value: $lutCacheMB, in: 16...1024, step: 16)
+                        .labelsHidden()
+                }
+            }
+
+            Section("Rendering") {
+                Picker("Intermediate precision", selection: $intermediatePrecision) {
+                    ForEach(IntermediatePrecision.allCases) { precision in
+                        Text(precision.displayName).tag(precision)
+                    }
+                }
+                HStack {
+                    Text("Intermediate cache budget")
+                    Spacer()
+                    Text(String(format: "%.1f GB", intermediateCacheGB))
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                    Stepper("", value: $intermediateCacheGB, in: 0...16, step: 0.5)
+                        .labelsHidden()
+                }
+                Text("Outputs of expensive stages (highlights/shadows, sharpening, noise reduction, LUT) are kept so edits further down the pipeline don't re-run them.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+                HStack {
+                    Text("Render cache budget")
+                    Spacer()
+                    Text("\(renderCacheMB) MB")
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                    Stepper("", value: $renderCacheMB, in: 64...4096, step: 64)
+                        .labelsHidden()
+                }
+                HStack {
+                    Text("Render disk cache")
+                    Spacer()
+                    Text(renderDiskCacheGB > 0 ? String(format: "%.1f GB", renderDiskCacheGB) : "Off")
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                    Stepper("", value: $renderDiskCacheGB, in: 0...32, step: 0.5)
+                        .labelsHidden()
+                    Button("Clear") {
+                        RenderCache.shared.removeAll()
+                    }
+                }
+                Text("Finished renders are kept by image content and edit, so undoing a change, toggling an adjustment or revisiting an image shows the earlier result at once. The disk cache is compressed and also keeps export renders across launches.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+            }
+
+            Section("Color") {
+                Picker("Export color space", selection: $outputColorSpace) {
+                    ForEach(NKOutputColorSpace.allSpaces, id: \.self) { space in
+                        Text(space.displayName).tag(space)
+                    }
+                }
+                Text("Edits are made in linear light. NEF files are developed by the Nikon SDK straight into this space, so wide-gamut exports keep colors outside sRGB. Takes effect for images opened afterwards.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+            }
+
+            Section("Export") {
+                Picker("Format", selection: $exportFormat) {
+                    ForEach(ImageExporter.Format.allCases) { format in
+                        Text(format.displayName).tag(format)
+                    }
+                }
+                switch exportFormat {
+                case .tiff:
+                    Picker("Compression", selection: $tiffCompression) {
+                        Text("Deflate").tag(NKTIFFCompression.deflate)
+                        Text("None").tag(NKTIFFCompression.uncompressed)
+                    }
+                case .jpeg:
+                    HStack {
+                        Text("Quality")
+                        Spacer()
+                        Text("\(jpegQuality)")
+                            .font(.system(.body, design: .monospaced))
+                            .foregroundColor(.secondary)
+                        Stepper("", value: $jpegQuality, in: 50...100, step: 1)
+                            .labelsHidden()
+                    }
+                    Picker("Chroma subsampling", selection: $jpegSubsampling) {
+                        Text("4:4:4").tag(NKChromaSubsampling.full)
+                        Text("4:2:2").tag(NKChromaSubsampling.horizontal)
+                        Text("4:2:0").tag(NKChromaSubsampling.both)
+                    }
+                case .png:
+                    EmptyView()
+                }
+                if exportFormat != .jpeg {
+                    Picker("Bit depth", selection: $exportBitDepth) {
+                        Text("16-bit").tag(16)
+                        Text("8-bit").tag(8)
+                    }
+                }
+                Picker("Long edge", selection: $exportLongEdge) {
+                    Text("Full size").tag(0)
+                    ForEach([6000, 4096, 3000, 2048, 1600], id: \.self) { pixels in
+                        Text("\(pixels) px").tag(pixels)
+                    }
+                }
+                Text("8-bit files are half the size and quicker to write. They are dithered from the 16-bit render, so smooth gradients don't band. Larger renders are downscaled with a Lanczos filter while they are written.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+                ForEach(ImageExporter.Format.allCases) { format in
+                    if let record = exportThroughput.records[format] {
+                        HStack {
+                            Text("\(format.displayName) throughput")
+                            Spacer()
+                            Text(String(format: "%.0f MP/s, %.0f MB/s", record.megapixelsPerSecond, record.megabytesPerSecond))
+                                .font(.system(.body, design: .monospaced))
+                                .foregroundColor(.secondary)
+                        }
+                    }
+                }
+            }
+
+            Section("Diagnostics") {
+                Toggle("Show memory overlay", isOn: $memoryMonitor.isOverlayVisible)
+                HStack {
+                    Button("Save Memory Report…") {
+                        memoryMonitor.saveReport()
+                    }
+                    Button("Log Snapshot") {
+                        memoryMonitor.logSnapshot()
+                    }
+                    Spacer()
+                    Button("Reset Peaks") {
+                        memoryMonitor.resetPeaks()
+                    }
+                }
+                Text("Decoded images, caches, LUTs, SDK sessions and decode buffers report what they hold, per category and per image. Untracked memory is the rest of the app's footprint, such as Core Image's own buffers; an image still listed after it was closed points at a leak.")
+                    .font(.caption)
+                    .foregroundColor(.secondary)
+            }
+        }
+        .formStyle(.grouped)
+        .frame(width: 420)
+        .onChange(of: imageCacheGB) { _, newValue in
+            ImageCache.shared.byteBudget = Int(newValue * Double(1 << 30))
+        }
+        .onChange(of: lutCacheMB) { _, newValue in
+            LUTResidency.shared.byteBudget = newValue << 20
+        }
+        .onChange(of: renderCacheMB) { _, newValue in
+            RenderCache.shared.byteBudget = newValue << 20
+        }
+        .onChange(of: renderDiskCacheGB) { _, newValue in
+            RenderCache.shared.diskBudget = Int(newValue * Double(1 << 30))
+        }
+        .onChange(of: intermediateCacheGB) { _, newValue in
+            ImageProcessor.shared.intermediateCacheBudget = Int(newValue * Double(1 << 30))
+        }
+        .onChange(of: intermediatePrecision) { _, newValue in
+            ImageProcessor.shared.intermediatePrecision = newValue
+        }
+        .onChange(of: outputColorSpace) { _, newValue in
+            ImageProcessor.shared.outputColorSpace = newValue
+        }
+        .onChange(of: exportFormat) { _, newValue in
+            ImageExporter.format = newValue
+        }
+        .onChange(of: exportBitDepth) { _, newValue in
+            ImageExporter.bitDepth = newValue
+        }
+        .onChange(of: tiffCompression) { _, newValue in
+            ImageExporter.tiffCompression = newValue
+        }
+        .onChange(of: jpegQuality) { _, newValue in
+            ImageExporter.jpegQuality = newValue
+        }
+        .onChange(of: jpegSubsampling) { _, newValue in
+            ImageExporter.jpegSubsampling = newValue
+        }
+        .onChange(of: exportLongEdge) { _, newValue in
+            ImageExporter.longEdge = newValue
+        }
+    }
+}
+
+#Preview {
+    SettingsView()
+}
@@ -0,0 +1,156 @@
+//
+//  SharpnessView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+
+/// Sheet that scores every frame by focus (see `SharpnessScoring`) and lists them sharpest
+/// first, with a heatmap of where each frame is sharp, so soft frames can be culled.
+struct SharpnessView: View {
+    private struct RankedImage: Identifiable {
+        let image: RAWImage
+        let score: SharpnessScoring.Score
+
+        var id: URL { image.url }
+    }
+
+    let images: [RAWImage]
+    /// Called to sort the image list by the new scores, sharpest first.
+    let onSortBySharpness: () -> Void
+
+    @Environment(\.dismiss) private var dismiss
+    @State private var weighting = SharpnessScoring.weighting
+    @State private var ranked: [RankedImage]?
+    @State private var showHeatmap = true
+    @State private var progress: Double = 0
+    @State private var cancellation = StackCancellation()
+
+    var body: some View {
+        VStack(alignment: .leading, spacing: 12) {
+            Text("Rank by Sharpness")
+                .font(.headline)
+
+            Picker("Weighting", selection: $weighting) {
+                ForEach(SharpnessScoring.Weighting.allCases) { weighting in
+                    Text(weighting.displayName).tag(weighting)
+                }
+            }
+            .pickerStyle(.segmented)
+            .disabled(ranked == nil)
+
+            if let ranked {
+                if ranked.isEmpty {
+                    Text("No previews could be read.")
+                        .foregroundColor(.secondary)
+                        .frame(maxWidth: .infinity, minHeight: 200)
+                } else {
+                    let best = ranked[0].score.value
+                    List(ranked) { entry in
+                        HStack(spacing: 8) {
+                            thumbnail(for: entry.image, heatmap: showHeatmap ? entry.score.heatmap : [], reference: best)
+                            VStack(alignment: .leading, spacing: 4) {
+                                Text(entry.image.url.lastPathComponent)
+                                    .lineLimit(1)
+                                    .truncationMode(.middle)
+                                ProgressView(value: best > 0 ? min(entry.score.value / best, 1) : 0)
+                                    .tint(entry.score.value >= best * 0.6 ? .green : entry.score.value >= best * 0.3 ? .orange : .red)
+                            }
+                            Text(String(format: "%.1f", entry.score.value))
+                                .monospacedDigit()
+                                .foregroundColor(.secondary)
+                                .frame(width: 48, alignment: .trailing)
+                        }
+                    }
+                    .frame(minHeight: 300)
+                }
+            } else {
+                ProgressView("Measuring focus…", value: progress)
+                    .frame(maxWidth: .infinity, minHeight: 200)
+            }
+
+            Toggle("Show heatmap", isOn: $showHeatmap)
+                .disabled(ranked?.isEmpty ?? true)
+
+            Text("Focus is measured on the embedded previews as the variance of the Laplacian, region by region; green areas on the heatmap are the sharpest in the folder. Scores compare frames of similar content, such as a burst, rather than grade a single frame.")
+                .font(.caption)
+                .foregroundColor(.secondary)
+                .fixedSize(horizontal: false, vertical: true)
+
+            HStack {
+                Spacer()
+                Button("Close") {
+                    cancellation.cancel()
+                    dismiss()
+                }
+                .keyboardShortcut(.cancelAction)
+                Button("Sort List by Sharpness") {
+                    onSortBySharpness()
+                    dismiss()
+                }
+                .keyboardShortcut(.defaultAction)
+                .disabled(ranked?.isEmpty ?? true)
+            }
+        }
+        .padding()
+        .frame(width: 520)
+        .task(id: weighting) {
+            SharpnessScoring.weighting = weighting
+            await rescore()
+        }
+    }
+
+    @ViewBuilder
+    private func thumbnail(for image: RAWImage, heatmap: [Float], reference: Double) -> some View {
+        let grid = SharpnessScoring.gridSize
+        ZStack {
+            if let thumb = image.thumbnail {
+                Image(nsImage: thumb)
+                    .resizable()
+                    .aspectRatio(contentMode: .fit)
+            } else {
+                Rectangle()
+                    .fill(Color.gray.opacity(0.3))
+            }
+        }
+        .frame(width: 72, height: 72)
+        .overlay {
+            // Scaled to the folder's best score, so a soft frame shows no bright regions
+            if heatmap.count == grid * grid, reference > 0, let size = image.thumbnail?.size {
+                let scale = 72 / max(size.width, size.height)
+                VStack(spacing: 0) {
+                    ForEach(0..<grid, id: \.self) { row in
+                        HStack(spacing: 0) {
+                            ForEach(0..<grid, id: \.self) { column in
+                                Color.green.opacity(0.6 * min(Double(heatmap[row * grid + column]) / reference, 1))
+                            }
+                        }
+                    }
+                }
+                .frame(width: size.width * scale, height: size.height * scale)
+            }
+        }
+        .cornerRadius(4)
+    }
+
+    private func rescore() async {
+        ranked = nil
+        progress = 0
+        let urls = images.map(\.url)
+        let weighting = weighting
+        let cancellation = cancellation
+        let finished = await Task.detached(priority: .userInitiated) {
+            SharpnessScoring.score(urls, weighting: weighting) { fraction in
+                Task { @MainActor in
+                    self.progress = fraction
+                }
+                return !cancellation.isCancelled
+            }
+        }.value
+        guard finished, !Task.isCancelled else { return }
+
+        ranked = images
+            .compactMap { image in SharpnessScoring.score(for: image.url, weighting: weighting).map { RankedImage(image: image, score: $0) } }
+            .sorted { $0.score.value > $1.score.value }
+    }
+}
@@ -0,0 +1,194 @@
+//
+//  StackingView.swift
+//  Dirty RAW
+//
+
+import SwiftUI
+import UniformTypeIdentifiers
+
+/// Sheet that merges a burst of NEF/NRW files into one linear TIFF (see `NKFrameStacker`).
+struct StackingView: View {
+    /// Candidate frames; only Nikon RAW files can be stacked.
+    let images: [RAWImage]
+    /// Called with the written TIFF so it can be opened like any other image.
+    let onStacked: (URL) -> Void
+
+    @Environment(\.dismiss) private var dismiss
+    @State private var selection: Set<URL> = []
+    @State private var mode: NKStackMode = .sigmaClippedMean
+    @State private var clipSigma = 2.5
+    @State private var progress: Double?
+    @State private var cancellation: StackCancellation?
+    @State private var errorMessage: String?
+
+    private var orderedSelection: [URL] {
+        images.map(\.url).filter { selection.contains($0) }
+    }
+
+    var body: some View {
+        VStack(alignment: .leading, spacing: 12) {
+            Text("Stack Frames")
+                .font(.headline)
+
+            List(images, id: \.url) { image in
+                Toggle(isOn: Binding(
+                    get: { selection.contains(image.url) },
+                    set: { isOn in
+                        if isOn {
+                            selection.insert(image.url)
+                        } else {
+                            selection.remove(image.url)
+                        }
+                    }
+                )) {
+                    Text(image.url.lastPathComponent)
+                }
+            }
+            .frame(minHeight: 200)
+            .disabled(progress != nil)
+
+            HStack {
+                Button("Select All") { selection = Set(images.map(\.url)) }
+                Button("Select None") { selection = [] }
+                Spacer()
+                Text("\(selection.count) frames")
+                    .foregroundColor(.secondary)
+            }
+            .disabled(progress != nil)
+
+            Picker("Combine", selection: $mode) {
+                Text("Mean").tag(NKStackMode.mean)
+                Text("Median").tag(NKStackMode.median)
+                Text("Sigma-clipped mean").tag(NKStackMode.sigmaClippedMean)
+            }
+            .disabled(progress != nil)
+
+            if mode == .sigmaClippedMean {
+                HStack {
+                    Text("Clip at")
+                    Slider(value: $clipSigma, in: 1...4, step: 0.1)
+                    Text(String(format: "%.1f σ", clipSigma))
+                        .font(.system(.body, design: .monospaced))
+                        .foregroundColor(.secondary)
+                }
+                .disabled(progress != nil)
+            }
+
+            Text("Mean reduces noise the most; median and sigma-clipped mean also remove people and traffic moving through the frame. Frames are aligned to the first selected one. Developed frames are spilled to the temporary folder (about 8 bytes per pixel each) while stacking.")
+                .font(.caption)
+                .foregroundColor(.secondary)
+                .fixedSize(horizontal: false, vertical: true)
+
+            if let progress {
+                ProgressView(value: progress)
+            }
+            if let errorMessage {
+                Text(errorMessage)
+                    .font(.caption)
+                    .foregroundColor(.red)
+            }
+
+            HStack {
+                Spacer()
+                Button("Cancel") {
+                    if let cancellation {
+                        cancellation.cancel()
+                    } else {
+                        dismiss()
+                    }
+                }
+                .keyboardShortcut(.cancelAction)
+                Button("Stack…") { chooseDestination() }
+                    .keyboardShortcut(.defaultAction)
+                    .disabled(selection.count < 2 || progress != nil)
+            }
+        }
+        .padding()
+        .frame(width: 440)
+    }
+
+    // MARK: - Stacking
+
+    private func chooseDestination() {
+        let paths = orderedSelection.map(\.path)
+        guard paths.count >= 2, let first = orderedSelection.first else { return }
+
+        let panel = NSSavePanel()
+        panel.allowedContentTypes = [.tiff]
+        panel.nameFieldStringValue = first.deletingPathExtension().lastPathComponent + " Stack"
+        panel.canCreateDirectories = true
+        panel.begin { response in
+            guard response == .OK, let url = panel.url else { return }
+            stack(paths: paths, to: url)
+        }
+    }
+
+    private func stack(paths: [String], to url: URL) {
+        let mode = mode
+        let clipSigma = clipSigma
+        let colorSpace = ImageProcessor.shared.outputColorSpace
+        let cancellation = StackCancellation()
+        self.cancellation = cancellation
+        progress = 0
+        errorMessage = nil
+
+        Task.detached(priority: .userInitiated) {
+            let stacked = NKFrameStacker.makeStackedImage(
+                paths: paths,
+                mode: mode,
+                clipSigma: clipSigma,
+                colorSpace: colorSpace
+            ) { fraction in
+                Task { @MainActor in
+                    if self.progress != nil {
+                        self.progress = fraction
+                    }
+                }
+                return !cancellation.isCancelled
+            }
+
+            var failure: String?
+            if let stacked {
+                // Written as half float, so the stack stays linear and unclipped for editing
+                let image = NSImage(cgImage: stacked, size: NSSize(width: stacked.width, height: stacked.height))
+                do {
+                    try TIFFExporter.export(image: image, to: url, bitDepth: 16)
+                } catch {
+                    failure = "Failed to write TIFF: \(error.localizedDescription)"
+                }
+            } else if !cancellation.isCancelled {
+                failure = "Stacking failed. The frames must be NEF or NRW files of the same size."
+            }
+
+            let cancelled = cancellation.isCancelled
+            await MainActor.run {
+                self.progress = nil
+                self.cancellation = nil
+                if let failure {
+                    self.errorMessage = failure
+                } else if !cancelled {
+                    self.onStacked(url)
+                    self.dismiss()
+                }
+            }
+        }
+    }
+}
+
+/// Cancel flag read by the stacker's progress callback on its worker thread.
+final class StackCancellation: @unchecked Sendable {
+    private let lock = NSLock()
+    private var cancelled = false
+
+    var isCancelled: Bool {
+        lock.lock()
+        defer { lock.unlock() }
+        return cancelled
+    }
+
+    func cancel() {
+        lock.lock()
+        cancelled = true
+        lock.unlock()
+    }
+}